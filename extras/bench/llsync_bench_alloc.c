@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// the allocator of glibc wrapped by the symbols of the executable, which the shared libraries bind to as well
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+#include <malloc.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "llsync_bench_alloc.h"
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+
+bool llsync_bench_alloc_enabled(void)
+{
+    return false;
+}
+
+void llsync_bench_alloc_get(llsync_bench_alloc_stats *stats)
+{
+    stats->count = 0;
+    stats->bytes = 0;
+    stats->live  = 0;
+    stats->peak  = 0;
+}
+
+void llsync_bench_alloc_peak_reset(void) {}
+
+void llsync_bench_alloc_trap(bool enable) {}
+
+#else
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void  __libc_free(void *ptr);
+
+static uint64_t sg_alloc_count = 0;
+static uint64_t sg_alloc_bytes = 0;
+static uint64_t sg_alloc_live  = 0;
+static uint64_t sg_alloc_peak  = 0;
+static bool     sg_alloc_trap  = false;
+
+static void *bench_alloc_add(void *ptr, size_t size, size_t old)
+{
+    uint64_t live = 0;
+    uint64_t peak = 0;
+
+    if (NULL == ptr) {
+        return NULL;
+    }
+    if (__atomic_load_n(&sg_alloc_trap, __ATOMIC_RELAXED)) {
+        abort();
+    }
+    __atomic_fetch_add(&sg_alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&sg_alloc_bytes, size, __ATOMIC_RELAXED);
+    live = __atomic_add_fetch(&sg_alloc_live, malloc_usable_size(ptr) - old, __ATOMIC_RELAXED);
+    peak = __atomic_load_n(&sg_alloc_peak, __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&sg_alloc_peak, &peak, live, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    return ptr;
+}
+
+void *malloc(size_t size)
+{
+    return bench_alloc_add(__libc_malloc(size), size, 0);
+}
+
+void *calloc(size_t num, size_t size)
+{
+    return bench_alloc_add(__libc_calloc(num, size), num * size, 0);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void * ret = __libc_realloc(ptr, size);
+
+    if (NULL == ret) {
+        // realloc(ptr, 0) frees ptr
+        if (ptr && 0 == size) {
+            __atomic_fetch_sub(&sg_alloc_live, old, __ATOMIC_RELAXED);
+        }
+        return NULL;
+    }
+    return bench_alloc_add(ret, size, old);
+}
+
+void *memalign(size_t align, size_t size)
+{
+    return bench_alloc_add(__libc_memalign(align, size), size, 0);
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+int posix_memalign(void **ptr, size_t align, size_t size)
+{
+    void *ret = memalign(align, size);
+
+    if (NULL == ret) {
+        return ENOMEM;
+    }
+    *ptr = ret;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    if (NULL == ptr) {
+        return;
+    }
+    __atomic_fetch_sub(&sg_alloc_live, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __libc_free(ptr);
+}
+
+bool llsync_bench_alloc_enabled(void)
+{
+    return true;
+}
+
+void llsync_bench_alloc_get(llsync_bench_alloc_stats *stats)
+{
+    stats->count = __atomic_load_n(&sg_alloc_count, __ATOMIC_RELAXED);
+    stats->bytes = __atomic_load_n(&sg_alloc_bytes, __ATOMIC_RELAXED);
+    stats->live  = __atomic_load_n(&sg_alloc_live, __ATOMIC_RELAXED);
+    stats->peak  = __atomic_load_n(&sg_alloc_peak, __ATOMIC_RELAXED);
+}
+
+void llsync_bench_alloc_peak_reset(void)
+{
+    __atomic_store_n(&sg_alloc_peak, __atomic_load_n(&sg_alloc_live, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+void llsync_bench_alloc_trap(bool enable)
+{
+    __atomic_store_n(&sg_alloc_trap, enable, __ATOMIC_RELAXED);
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LLSYNC_BENCH_ALLOC_H
+#define LLSYNC_BENCH_ALLOC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the heap of the benchmarks: malloc, calloc, realloc and free of the whole process, operator new included, are
+// interposed and counted. not available with a sanitizer, which has its own allocator
+
+typedef struct {
+    uint64_t count;  // the allocations, a realloc is one
+    uint64_t bytes;  // the bytes asked for
+    uint64_t live;   // the bytes allocated and not freed, by malloc_usable_size()
+    uint64_t peak;   // the max of live since the last llsync_bench_alloc_peak_reset()
+} llsync_bench_alloc_stats;
+
+/**
+ * @brief whether the allocations are counted, false if built with a sanitizer
+ */
+bool llsync_bench_alloc_enabled(void);
+
+/**
+ * @brief the counters since the process started
+ */
+void llsync_bench_alloc_get(llsync_bench_alloc_stats *stats);
+
+/**
+ * @brief start the peak from the bytes live now
+ */
+void llsync_bench_alloc_peak_reset(void);
+
+/**
+ * @brief abort() at the next allocation if enable, run in a debugger to see where the allocation is from
+ */
+void llsync_bench_alloc_trap(bool enable);
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // LLSYNC_BENCH_ALLOC_H
@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// the hot paths of the data codec over synthetic thing models: the tlv parse, the control frames, the property
+// reports, the report of one property by id, by a PropertyHandle and from a variable bound, the full and partial
+// reports of a struct with one member changed, the samples of a series, the get and set of the structs and the arrays,
+// and the slicing of the notifications. every model is a device bound and connected by the simulated phone, its
+// notifications are counted and dropped. the result is in the go benchmark format, compare two runs with benchstat
+// usage: llsync_bench_codec [-t min time per benchmark in ms] [-f name filter]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LLsync.h"
+#include "core/ble_qiot_common.h"
+#include "core/ble_qiot_llsync_data.h"
+#include "core/ble_qiot_llsync_device.h"
+#include "core/ble_qiot_llsync_event.h"
+#include "core/ble_qiot_log.h"
+#include "core/ble_qiot_service.h"
+#include "core/ble_qiot_template.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_phone.h"
+#include "llsync_bench_alloc.h"
+#include "llsync_bench_model.h"
+
+#define BENCH_PRODUCT_ID "BENCHCODEC"
+#define BENCH_MAX_ITERS  (1u << 30)
+
+static const BenchModelSpec sg_models[] = {
+    // name, properties, structs, arrays, strings, members, string size, array type, events, actions, params, array size
+    {"flat1", 1, 0, 0, 0, 0, 0, BLE_QIOT_DATA_TYPE_INT},
+    {"flat8", 8, 0, 0, 0, 0, 0, BLE_QIOT_DATA_TYPE_INT},
+    {"flat32", 32, 0, 0, 0, 0, 0, BLE_QIOT_DATA_TYPE_INT},
+    {"str16x4", 8, 0, 0, 4, 0, 16, BLE_QIOT_DATA_TYPE_INT},
+    {"str128x4", 8, 0, 0, 4, 0, 128, BLE_QIOT_DATA_TYPE_INT},
+    {"struct8", 1, 1, 0, 0, 8, 16, BLE_QIOT_DATA_TYPE_INT},
+    {"struct16", 1, 1, 0, 0, 16, 32, BLE_QIOT_DATA_TYPE_INT},
+    {"array_int", 1, 0, 1, 0, 0, 0, BLE_QIOT_DATA_TYPE_INT},
+    {"array_str32", 1, 0, 1, 0, 0, 32, BLE_QIOT_DATA_TYPE_STRING},
+    {"array_struct4", 1, 0, 1, 0, 4, 16, BLE_QIOT_DATA_TYPE_STRUCT},
+    {"array_int64", 1, 0, 1, 0, 0, 0, BLE_QIOT_DATA_TYPE_INT, 0, 0, 0, BLE_QIOT_PROPERTY_MAX_ARRAY_SIZE},
+    {"mixed32", 32, 2, 2, 8, 8, 32, BLE_QIOT_DATA_TYPE_STRUCT},
+};
+
+// the lengths of the notifications sliced
+static const uint16_t sg_notify_sizes[] = {16, 180, 1024, BLE_QIOT_EVENT_MAX_SIZE};
+
+struct BenchDevice {
+    const BenchModelSpec *spec;
+    LLsync *              llsync;
+    char                  control[BLE_QIOT_EVENT_MAX_SIZE];  // every property written by the phone
+    uint16_t              controlLen;
+};
+
+#define BENCH_MODEL_NUM (sizeof(sg_models) / sizeof(sg_models[0]))
+
+// the devices live until the exit
+static BenchDevice sg_devices[BENCH_MODEL_NUM];
+static double      sg_min_time    = 0.2;  // unit: s
+static const char *sg_filter      = NULL;
+static uint64_t    sg_notify_len  = 0;
+static uint32_t    sg_notify_nums = 0;
+
+static void bench_sink(const uint8_t *buf, uint16_t len, void *user)
+{
+    sg_notify_len += len;
+    sg_notify_nums++;
+}
+
+// runs op until it takes the min time, op returns false on error
+template <typename Op>
+static void bench_run(const char *name, const char *model, uint32_t bytes, Op op)
+{
+    char                     fullName[96];
+    llsync_bench_alloc_stats before;
+    llsync_bench_alloc_stats after;
+    double                   start = 0;
+    double                   cost  = 0;
+    uint32_t                 iters = 1;
+    uint32_t                 i     = 0;
+
+    snprintf(fullName, sizeof(fullName), "Benchmark%s/%s", name, model);
+    if (sg_filter && !strstr(fullName, sg_filter)) {
+        return;
+    }
+    // the first call warms the caches and checks the op works
+    if (!op()) {
+        fprintf(stderr, "%s failed\n", fullName);
+        return;
+    }
+    for (;;) {
+        llsync_bench_alloc_get(&before);
+        start = bench_now();
+        for (i = 0; i < iters; i++) {
+            op();
+        }
+        cost = bench_now() - start;
+        llsync_bench_alloc_get(&after);
+        if (cost >= sg_min_time || iters >= BENCH_MAX_ITERS) {
+            break;
+        }
+        // aim at the min time from the rate measured, at most 100 times more a round
+        iters = cost > 0 && sg_min_time * 1.2 / cost * iters < iters * 100.0 ? sg_min_time * 1.2 / cost * iters + 1
+                                                                           : iters * 100;
+        iters = iters > BENCH_MAX_ITERS ? BENCH_MAX_ITERS : iters;
+    }
+    printf("%-40s %10u %12.1f ns/op %10.2f MB/s %10.1f B/op %8.2f allocs/op\n", fullName, iters, cost * 1e9 / iters,
+           bytes * (double)iters / cost / 1e6, (double)(after.bytes - before.bytes) / iters,
+           (double)(after.count - before.count) / iters);
+}
+
+static bool bench_device_init(BenchDevice &dev, const BenchModelSpec &spec, int index)
+{
+    char    deviceName[BLE_QIOT_DEVICE_NAME_LEN + 1];
+    uint8_t mac[BLE_QIOT_MAC_LEN] = {0x02, 0x51, 0x4D, 0x43, 0x00, (uint8_t)index};
+    int     ret                   = 0;
+
+    snprintf(deviceName, sizeof(deviceName), "codec_%s", spec.name);
+    dev.spec   = &spec;
+    dev.llsync = bench_device_create(spec, BENCH_PRODUCT_ID, deviceName, mac, [&spec](LLsync &llsync) {
+        bench_model_fill(llsync.thingModel(), spec);
+        return true;
+    });
+    if (!dev.llsync) {
+        return false;
+    }
+
+    QiotCtxScope scope(dev.llsync->Context());
+    ble_qiot_host_set_notify_cb(bench_sink, NULL);
+
+    ret = bench_control_encode(dev.llsync->thingModel(), spec.properties, dev.control, sizeof(dev.control));
+    if (ret < 0)
+        return false;
+    dev.controlLen = ret;
+    return true;
+}
+
+static bool bench_parse_frame(const char *buf, int len)
+{
+    e_ble_tlv tlv;
+    int       off = 0;
+    int       ret = 0;
+
+    while (off < len) {
+        ret = ble_lldata_parse_tlv(buf + off, len - off, &tlv);
+        if (ret <= 0)
+            return false;
+        off += ret;
+    }
+    return off == len;
+}
+
+// the get and set of the first property of the type, a struct or an array
+static void bench_member_get_set(BenchDevice &dev, int type, const char *getName, const char *setName)
+{
+    static char buf[BLE_QIOT_EVENT_MAX_SIZE];
+    static char val[BLE_QIOT_EVENT_MAX_SIZE];
+    int         getLen = 0;
+    e_ble_tlv   tlv;
+    int         id = 0;
+
+    for (id = 0; id < dev.spec->properties; id++) {
+        if ((dev.llsync->thingModel().GetPropertyType(id) & 0x0f) == type)
+            break;
+    }
+    if (id == dev.spec->properties)
+        return;
+
+    getLen = ble_user_property_get_data_by_id(id, buf, sizeof(buf));
+    bench_run(getName, dev.spec->name, getLen > 0 ? getLen : 0,
+              [&]() { return ble_user_property_get_data_by_id(id, buf, sizeof(buf)) > 0; });
+
+    tlv.type = type;
+    tlv.id   = id;
+    tlv.len  = bench_value_encode(dev.llsync->thingModel().GetPropertyCtx(id), val, sizeof(val));
+    tlv.val  = val;
+    bench_run(setName, dev.spec->name, tlv.len, [&]() { return BLE_QIOT_RS_OK == ble_user_property_set_data(&tlv); });
+}
+
+// the set and report of one property by its id, by a handle and bound to a variable, the last int property is the
+// longest to find by id
+static void bench_property_report(BenchDevice &dev)
+{
+    ThingModel &        model = dev.llsync->thingModel();
+    PropertyHandle<int> handle;
+    int                 id    = 0;
+    int                 val   = 0;
+    int                 bound = 0;
+
+    for (id = dev.spec->properties - 1; id >= 0; id--) {
+        if (model.GetPropertyType(id) == BLE_QIOT_DATA_TYPE_INT)
+            break;
+    }
+    if (id < 0)
+        return;
+
+    const char *name = model.GetPropertyCtx(id)->ID();
+    handle           = model.Property<int>(name);
+    bench_run("ReportById", dev.spec->name, 0, [&]() { return model.ReportProperty(name, (uint32_t)(val++ % 100)); });
+    bench_run("ReportHandle", dev.spec->name, 0, [&]() { return handle.Report(val++ % 100); });
+    if (model.BindProperty(name, bound)) {
+        bench_run("ReportBound", dev.spec->name, 0, [&]() {
+            bound = val++ % 100;
+            return model.ReportProperty(id);
+        });
+        model.UnbindProperty(name);
+    }
+}
+
+// a struct with one member changed reported in full and by a partial report, the bytes are of one notification
+static void bench_struct_report(BenchDevice &dev)
+{
+    ThingModel &model = dev.llsync->thingModel();
+    QiotData *  dat   = model.GetPropertyCtx((uint8_t)0);
+    uint32_t    val   = 0;
+    uint64_t    len   = 0;
+
+    if (!dat || dat->GetType() != BLE_QIOT_DATA_TYPE_STRUCT || dat->GetChildCtx(0)->GetType() != BLE_QIOT_DATA_TYPE_INT)
+        return;
+
+    auto op = [&]() { return dat->SetValue(0u, val++ % 100) && model.ReportProperty((uint8_t)0); };
+    len = sg_notify_len;
+    op();
+    bench_run("ReportStruct", dev.spec->name, sg_notify_len - len, op);
+    model.SetPartialReport(UINT16_MAX);
+    op();
+    len = sg_notify_len;
+    op();
+    bench_run("ReportStructPartial", dev.spec->name, sg_notify_len - len, op);
+    model.SetPartialReport(0);
+}
+
+// a sample of an int property averaged over 16 and of an array packing a sample an element, one report a window
+static void bench_series(BenchDevice &dev)
+{
+    ThingModel &model = dev.llsync->thingModel();
+    int         avg   = -1;
+    int         pack  = -1;
+    int         val   = 0;
+
+    for (int id = 0; id < dev.spec->properties; id++) {
+        QiotData *dat = model.GetPropertyCtx(id);
+        if (avg < 0 && dat->GetType() == BLE_QIOT_DATA_TYPE_INT)
+            avg = model.AddSeries(dat->ID(), 16, QIOT_AGGREGATE_AVG);
+        else if (pack < 0 && dat->GetType() == (BLE_QIOT_DATA_TYPE_ARRAY | BLE_QIOT_ARRAY_INT_BIT_MASK))
+            pack = model.AddSeries(dat->ID(), dat->ChildsCount(), QIOT_AGGREGATE_PACK);
+    }
+    if (avg >= 0)
+        bench_run("SampleAvg", dev.spec->name, 0, [&]() { return model.Sample(avg, val++ % 100); });
+    if (pack >= 0)
+        bench_run("SamplePack", dev.spec->name, 0, [&]() { return model.Sample(pack, val++ % 100); });
+}
+
+static void bench_model(BenchDevice &dev)
+{
+    const BenchModelSpec &spec = *dev.spec;
+    uint32_t              nums = 0;
+    uint64_t              len  = 0;
+
+    QiotCtxScope scope(dev.llsync->Context());
+    bench_run("ParseTLV", spec.name, dev.controlLen,
+              [&]() { return bench_parse_frame(dev.control, dev.controlLen); });
+    bench_run("Control", spec.name, dev.controlLen,
+              [&]() { return BLE_QIOT_RS_OK == ble_lldata_property_request_handle(dev.control, dev.controlLen); });
+
+    nums = sg_notify_nums;
+    len  = sg_notify_len;
+    ble_user_property_get_report_data(0, spec.properties);
+    bench_run("Report", spec.name, sg_notify_nums > nums ? sg_notify_len - len : 0,
+              [&]() { return BLE_QIOT_RS_OK == ble_user_property_get_report_data(0, spec.properties); });
+
+    bench_property_report(dev);
+    bench_struct_report(dev);
+    bench_series(dev);
+    bench_member_get_set(dev, BLE_QIOT_DATA_TYPE_STRUCT, "StructGet", "StructSet");
+    bench_member_get_set(dev, BLE_QIOT_DATA_TYPE_ARRAY, "ArrayGet", "ArraySet");
+}
+
+static void bench_notify(BenchDevice &dev)
+{
+    static char buf[BLE_QIOT_EVENT_MAX_SIZE];
+    char        name[16];
+
+    QiotCtxScope scope(dev.llsync->Context());
+    memset(buf, 0x5A, sizeof(buf));
+    for (uint16_t size : sg_notify_sizes) {
+        snprintf(name, sizeof(name), "%u", size);
+        bench_run("Notify", name, size, [&]() {
+            return BLE_QIOT_RS_OK == ble_event_notify2(BLE_QIOT_EVENT_UP_PROPERTY_REPORT, 0, NULL, 0, buf, size);
+        });
+    }
+}
+
+static void bench_usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-t min time per benchmark in ms] [-f name filter]\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "t:f:")) != -1) {
+        switch (opt) {
+            case 't':
+                sg_min_time = atoi(optarg) / 1000.0;
+                break;
+            case 'f':
+                sg_filter = optarg;
+                break;
+            default:
+                bench_usage(argv[0]);
+        }
+    }
+    if (sg_min_time <= 0) {
+        bench_usage(argv[0]);
+    }
+
+    // the writes of the phone are handled before it waits for the reply
+    ble_qiot_host_dispatch_inline();
+    for (size_t i = 0; i < BENCH_MODEL_NUM; i++) {
+        if (!bench_device_init(sg_devices[i], sg_models[i], i)) {
+            fprintf(stderr, "model %s: create device failed\n", sg_models[i].name);
+            return 1;
+        }
+    }
+
+    {
+        QiotCtxScope scope(sg_devices[0].llsync->Context());
+        printf("mtu: %u\n", llsync_mtu_get());
+    }
+    printf("allocs: %s\n", llsync_bench_alloc_enabled() ? "counted" : "not counted, built with a sanitizer");
+    for (size_t i = 0; i < BENCH_MODEL_NUM; i++) {
+        bench_model(sg_devices[i]);
+    }
+    bench_notify(sg_devices[0]);
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// the time and the heap of ThingModel::Load() over synthetic thing models. Load is the json dom built by CJsonObject
+// and the tree of QiotData built from it, the dom alone is measured as well and the tree is the difference. the heap
+// is the peak while loading and the bytes resident after, the dom is freed at the end of Load. the result is in the go
+// benchmark format, compare two runs with benchstat
+// usage: llsync_bench_load [-t min time per benchmark in ms] [-g] [-p properties] [-s structs] [-a arrays]
+//                          [-S strings] [-m members] [-l string size] [-T array type] [-e events] [-A actions]
+//                          [-P params]
+// a model option runs the large preset changed by the options instead of the presets, -g prints the json of the
+// model instead of loading it
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CJsonObject.h"
+#include "ThingModel.h"
+#include "core/ble_qiot_log.h"
+#include "core/ble_qiot_template.h"
+#include "llsync_bench_alloc.h"
+#include "llsync_bench_model.h"
+
+#define BENCH_MAX_ITERS (1u << 20)
+
+static const BenchModelSpec sg_presets[] = {
+    // name, properties, structs, arrays, strings, members, string size, array type, events, actions, params
+    {"small", 8, 0, 0, 2, 0, 16, BLE_QIOT_DATA_TYPE_INT, 1, 1, 2},
+    {"medium", 32, 2, 2, 4, 4, 32, BLE_QIOT_DATA_TYPE_STRUCT, 8, 4, 4},
+    {"large", 32, 8, 8, 8, 16, 64, BLE_QIOT_DATA_TYPE_STRUCT, 32, 32, 16},
+};
+
+struct BenchLoadResult {
+    uint32_t iters;
+    double   cost;      // unit: s
+    uint64_t bytes;     // the bytes allocated
+    uint64_t allocs;
+    uint64_t peak;      // the max over the iterations
+    uint64_t resident;  // of the last iteration
+};
+
+static double sg_min_time = 0.5;  // unit: s
+
+// op(base, cost, resident) loads once, sets the time of the load and the bytes live after it over base, then frees
+// what it loaded, the time of the free is not counted
+template <typename Op>
+static bool bench_measure(Op op, BenchLoadResult &result)
+{
+    llsync_bench_alloc_stats before;
+    llsync_bench_alloc_stats after;
+    llsync_bench_alloc_stats start;
+    double                   cost = 0;
+
+    result.iters = 1;
+    for (;;) {
+        result.cost = 0;
+        result.peak = 0;
+        llsync_bench_alloc_get(&start);
+        for (uint32_t i = 0; i < result.iters; i++) {
+            llsync_bench_alloc_get(&before);
+            llsync_bench_alloc_peak_reset();
+            if (!op(before.live, cost, result.resident)) {
+                return false;
+            }
+            result.cost += cost;
+            llsync_bench_alloc_get(&after);
+            result.peak = after.peak - before.live > result.peak ? after.peak - before.live : result.peak;
+        }
+        llsync_bench_alloc_get(&after);
+        result.bytes  = after.bytes - start.bytes;
+        result.allocs = after.count - start.count;
+        if (result.cost >= sg_min_time || result.iters >= BENCH_MAX_ITERS) {
+            return true;
+        }
+        result.iters = result.cost > 0 && sg_min_time * 1.2 / result.cost < 100
+                           ? sg_min_time * 1.2 / result.cost * result.iters + 1
+                           : result.iters * 100;
+    }
+}
+
+static void bench_print(const char *name, const char *model, size_t jsonLen, const BenchLoadResult &r)
+{
+    char fullName[96];
+
+    snprintf(fullName, sizeof(fullName), "Benchmark%s/%s", name, model);
+    printf("%-28s %8u %12.0f ns/op %8.2f MB/s %10.0f B/op %8.0f allocs/op %10llu peak-B %10llu resident-B\n",
+           fullName, r.iters, r.cost * 1e9 / r.iters, jsonLen * (double)r.iters / r.cost / 1e6,
+           (double)r.bytes / r.iters, (double)r.allocs / r.iters, (unsigned long long)r.peak,
+           (unsigned long long)r.resident);
+}
+
+static bool bench_load(const BenchModelSpec &spec)
+{
+    std::string     json = bench_model_json(spec);
+    BenchLoadResult dom;
+    BenchLoadResult load;
+    BenchLoadResult tree;
+
+    auto domOp = [&](uint64_t base, double &cost, uint64_t &resident) {
+        double                   start = bench_now();
+        neb::CJsonObject *       dom   = new neb::CJsonObject(json);
+        llsync_bench_alloc_stats now;
+
+        cost = bench_now() - start;
+        llsync_bench_alloc_get(&now);
+        resident = now.live - base;
+        delete dom;
+        return true;
+    };
+    auto loadOp = [&](uint64_t base, double &cost, uint64_t &resident) {
+        double                   start = bench_now();
+        ThingModel *             model = new ThingModel();
+        bool                     ret   = model->Load(json.c_str());
+        llsync_bench_alloc_stats now;
+
+        cost = bench_now() - start;
+        llsync_bench_alloc_get(&now);
+        resident = now.live - base;
+        delete model;
+        return ret;
+    };
+    bool ok = bench_measure(domOp, dom) && bench_measure(loadOp, load);
+    if (!ok) {
+        fprintf(stderr, "model %s: load failed\n", spec.name);
+        return false;
+    }
+
+    // the tree is what Load costs more than the dom, per iteration
+    tree.iters    = load.iters;
+    tree.cost     = load.cost - dom.cost / dom.iters * load.iters;
+    tree.bytes    = load.bytes - dom.bytes / dom.iters * load.iters;
+    tree.allocs   = load.allocs - dom.allocs / dom.iters * load.iters;
+    tree.peak     = load.peak > dom.resident ? load.peak - dom.resident : 0;
+    tree.resident = load.resident;
+    bench_print("DOM", spec.name, json.size(), dom);
+    bench_print("Tree", spec.name, json.size(), tree);
+    bench_print("Load", spec.name, json.size(), load);
+    return true;
+}
+
+static void bench_usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-t min time per benchmark in ms] [-g] [-p properties] [-s structs] [-a arrays] [-S strings]\n"
+            "          [-m members] [-l string size] [-T int|float|string|struct] [-e events] [-A actions]\n"
+            "          [-P params]\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    BenchModelSpec custom = sg_presets[2];
+    bool           own    = false;
+    bool           dump   = false;
+    int            opt    = 0;
+
+    custom.name = "custom";
+    while ((opt = getopt(argc, argv, "t:gp:s:a:S:m:l:T:e:A:P:")) != -1) {
+        own |= !strchr("tg", opt);
+        switch (opt) {
+            case 't':
+                sg_min_time = atoi(optarg) / 1000.0;
+                break;
+            case 'g':
+                dump = true;
+                break;
+            case 'p':
+                custom.properties = atoi(optarg);
+                break;
+            case 's':
+                custom.structs = atoi(optarg);
+                break;
+            case 'a':
+                custom.arrays = atoi(optarg);
+                break;
+            case 'S':
+                custom.strings = atoi(optarg);
+                break;
+            case 'm':
+                custom.members = atoi(optarg);
+                break;
+            case 'l':
+                custom.stringSize = atoi(optarg);
+                break;
+            case 'T':
+                custom.arrayType = !strcmp(optarg, "float")    ? BLE_QIOT_DATA_TYPE_FLOAT
+                                   : !strcmp(optarg, "string") ? BLE_QIOT_DATA_TYPE_STRING
+                                   : !strcmp(optarg, "struct") ? BLE_QIOT_DATA_TYPE_STRUCT
+                                                               : BLE_QIOT_DATA_TYPE_INT;
+                break;
+            case 'e':
+                custom.events = atoi(optarg);
+                break;
+            case 'A':
+                custom.actions = atoi(optarg);
+                break;
+            case 'P':
+                custom.params = atoi(optarg);
+                break;
+            default:
+                bench_usage(argv[0]);
+        }
+    }
+    if (sg_min_time <= 0 || custom.properties <= 0 || custom.properties > 32 ||
+        custom.structs + custom.arrays + custom.strings > custom.properties || custom.members <= 0 ||
+        custom.params <= 0 || custom.events < 0 || custom.actions < 0 || custom.stringSize < 0) {
+        bench_usage(argv[0]);
+    }
+    if (dump) {
+        printf("%s\n", bench_model_json(own ? custom : sg_presets[2]).c_str());
+        return 0;
+    }
+
+    // a model with no event or action logs an error on every load
+    ble_qiot_set_log_level(BLE_QIOT_LOG_LEVEL_NONE);
+    printf("allocs: %s\n", llsync_bench_alloc_enabled() ? "counted" : "not counted, built with a sanitizer");
+    if (own) {
+        return bench_load(custom) ? 0 : 1;
+    }
+    for (const BenchModelSpec &spec : sg_presets) {
+        if (!bench_load(spec)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "llsync_bench_model.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "core/ble_qiot_common.h"
+#include "core/ble_qiot_llsync_event.h"
+#include "core/ble_qiot_log.h"
+#include "core/ble_qiot_template.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_phone.h"
+
+#define BENCH_PSK "MTIzNDU2Nzg5MDEyMzQ1Ng=="
+
+using std::string;
+
+static const int sg_scalar_types[] = {
+    BLE_QIOT_DATA_TYPE_BOOL, BLE_QIOT_DATA_TYPE_INT, BLE_QIOT_DATA_TYPE_ENUM,
+    BLE_QIOT_DATA_TYPE_FLOAT, BLE_QIOT_DATA_TYPE_TIME,
+};
+static const int sg_member_types[] = {
+    BLE_QIOT_DATA_TYPE_INT, BLE_QIOT_DATA_TYPE_BOOL, BLE_QIOT_DATA_TYPE_STRING, BLE_QIOT_DATA_TYPE_FLOAT,
+};
+
+#define BENCH_ARRAY_NUM(a) (sizeof(a) / sizeof((a)[0]))
+
+static int bench_property_type(const BenchModelSpec &spec, int index)
+{
+    if (index < spec.structs)
+        return BLE_QIOT_DATA_TYPE_STRUCT;
+    index -= spec.structs;
+    if (index < spec.arrays)
+        return BLE_QIOT_DATA_TYPE_ARRAY;
+    index -= spec.arrays;
+    if (index < spec.strings)
+        return BLE_QIOT_DATA_TYPE_STRING;
+    index -= spec.strings;
+    return sg_scalar_types[index % BENCH_ARRAY_NUM(sg_scalar_types)];
+}
+
+// the define of a type which is not a struct or an array, the fields the console writes
+static string bench_define(int type, int stringMax)
+{
+    switch (type) {
+    case BLE_QIOT_DATA_TYPE_BOOL:
+        return "{\"type\":\"bool\",\"mapping\":{\"0\":\"off\",\"1\":\"on\"}}";
+    case BLE_QIOT_DATA_TYPE_INT:
+        return "{\"type\":\"int\",\"min\":\"0\",\"max\":\"100\",\"start\":\"0\",\"step\":\"1\",\"unit\":\"\"}";
+    case BLE_QIOT_DATA_TYPE_STRING:
+        return "{\"type\":\"string\",\"min\":\"0\",\"max\":\"" + std::to_string(stringMax) + "\"}";
+    case BLE_QIOT_DATA_TYPE_FLOAT:
+        return "{\"type\":\"float\",\"min\":\"0\",\"max\":\"100\",\"start\":\"0\",\"step\":\"0.1\",\"unit\":\"\"}";
+    case BLE_QIOT_DATA_TYPE_ENUM:
+        return "{\"type\":\"enum\",\"mapping\":{\"0\":\"low\",\"1\":\"middle\",\"2\":\"high\"}}";
+    case BLE_QIOT_DATA_TYPE_TIME:
+        return "{\"type\":\"timestamp\"}";
+    }
+    return "{}";
+}
+
+// the members of a struct under typeKey, dataType, or the params of an event or an action under define
+static string bench_specs(int num, const char *prefix, const char *typeKey, int stringMax)
+{
+    string json = "[";
+
+    for (int i = 0; i < num; i++) {
+        string id = prefix + std::to_string(i);
+        json += i ? "," : "";
+        json += "{\"id\":\"" + id + "\",\"name\":\"" + id + "\",\"" + typeKey +
+                "\":" + bench_define(sg_member_types[i % BENCH_ARRAY_NUM(sg_member_types)], stringMax) + "}";
+    }
+    return json + "]";
+}
+
+string bench_model_json(const BenchModelSpec &spec)
+{
+    string json    = "{\"version\":\"1.0\",\"profile\":{\"ProductId\":\"BENCHMODEL\",\"CategoryId\":\"1\"},";
+    string members = bench_specs(spec.members, "m", "dataType", spec.stringSize);
+    string params  = bench_specs(spec.params, "v", "define", spec.stringSize);
+    string input   = bench_specs(spec.params, "i", "define", spec.stringSize);
+    string output  = bench_specs(spec.params, "o", "define", spec.stringSize);
+
+    json += "\"properties\":[";
+    for (int i = 0; i < spec.properties; i++) {
+        string id   = "p" + std::to_string(i);
+        int    type = bench_property_type(spec, i);
+
+        json += i ? "," : "";
+        json += "{\"id\":\"" + id + "\",\"name\":\"" + id + "\",\"desc\":\"\",\"mode\":\"rw\",\"define\":";
+        if (type == BLE_QIOT_DATA_TYPE_STRUCT) {
+            json += "{\"type\":\"struct\",\"specs\":" + members + "}";
+        } else if (type == BLE_QIOT_DATA_TYPE_ARRAY) {
+            json += "{\"type\":\"array\",";
+            if (spec.arraySize)
+                json += "\"size\":\"" + std::to_string(spec.arraySize) + "\",";
+            json += "\"arrayInfo\":";
+            if (spec.arrayType == BLE_QIOT_DATA_TYPE_STRUCT)
+                json += "{\"type\":\"struct\",\"specs\":" + members + "}";
+            else
+                json += bench_define(spec.arrayType, spec.stringSize);
+            json += "}";
+        } else {
+            json += bench_define(type, spec.stringSize);
+        }
+        json += ",\"required\":false}";
+    }
+    json += "],\"events\":[";
+    for (int i = 0; i < spec.events; i++) {
+        string id = "e" + std::to_string(i);
+        json += i ? "," : "";
+        json += "{\"id\":\"" + id + "\",\"name\":\"" + id + "\",\"desc\":\"\",\"type\":\"info\",\"required\":false," +
+                "\"params\":" + params + "}";
+    }
+    json += "],\"actions\":[";
+    for (int i = 0; i < spec.actions; i++) {
+        string id = "a" + std::to_string(i);
+        json += i ? "," : "";
+        json += "{\"id\":\"" + id + "\",\"name\":\"" + id + "\",\"desc\":\"\",\"input\":" + input +
+                ",\"output\":" + output + ",\"required\":false}";
+    }
+    json += "]}";
+
+    return json;
+}
+
+static void bench_value_fill(QiotData *dat, const BenchModelSpec &spec, int index)
+{
+    switch (dat->GetType() & 0x0f) {
+    case BLE_QIOT_DATA_TYPE_STRING:
+        dat->SetValue(string(spec.stringSize, 'a' + index % 26).c_str());
+        break;
+    case BLE_QIOT_DATA_TYPE_STRUCT:
+    case BLE_QIOT_DATA_TYPE_ARRAY:
+        for (unsigned int i = 0; i < dat->ChildsCount(); i++)
+            bench_value_fill(dat->GetChildCtx(i), spec, index + i);
+        break;
+    case BLE_QIOT_DATA_TYPE_BOOL:
+        dat->SetValue(index & 1);
+        break;
+    case BLE_QIOT_DATA_TYPE_ENUM:
+        dat->SetValue(index % 3);
+        break;
+    default:
+        dat->SetValue(index + 1);
+    }
+}
+
+void bench_model_fill(ThingModel &model, const BenchModelSpec &spec)
+{
+    for (int i = 0; i < spec.properties; i++)
+        bench_value_fill(model.GetPropertyCtx(i), spec, i);
+}
+
+// a struct written by the phone, the members are tlv
+static int bench_struct_encode(QiotData *dat, char *buf, uint16_t len)
+{
+    char val[BLE_QIOT_EVENT_MAX_SIZE];
+    int  off = 0;
+    int  ret = 0;
+
+    for (unsigned int i = 0; i < dat->ChildsCount(); i++) {
+        QiotData *member = dat->GetChildCtx(i);
+        ret              = bench_value_encode(member, val, sizeof(val));
+        if (ret < 0)
+            return -1;
+        ret = ble_qiot_phone_tlv_put((uint8_t *)buf + off, len - off, member->GetType() & 0x0f, i, val, ret);
+        if (ret < 0)
+            return -1;
+        off += ret;
+    }
+    return off;
+}
+
+// an array written by the phone, unlike the reports of the device the elements have no tlv head
+static int bench_array_encode(QiotData *dat, char *buf, uint16_t len)
+{
+    int      off     = 0;
+    int      ret     = 0;
+    uint16_t val_len = 0;
+
+    for (unsigned int i = 0; i < dat->ArrayLen(); i++) {
+        QiotData *elem = dat->GetChildCtx(i);
+        if (BLE_QIOT_DATA_TYPE_INT == elem->GetType() || BLE_QIOT_DATA_TYPE_FLOAT == elem->GetType()) {
+            ret = elem->GetValue(buf + off, len - off);
+        } else {
+            if (len - off < BLE_QIOT_STRING_TYPE_LEN)
+                return -1;
+            ret = bench_value_encode(elem, buf + off + BLE_QIOT_STRING_TYPE_LEN,
+                                     len - off - BLE_QIOT_STRING_TYPE_LEN);
+            val_len = HTONS(ret);
+            memcpy(buf + off, &val_len, sizeof(val_len));
+            off += BLE_QIOT_STRING_TYPE_LEN;
+        }
+        if (ret < 0)
+            return -1;
+        off += ret;
+    }
+    return off;
+}
+
+int bench_value_encode(QiotData *dat, char *buf, uint16_t len)
+{
+    switch (dat->GetType() & 0x0f) {
+    case BLE_QIOT_DATA_TYPE_STRUCT:
+        return bench_struct_encode(dat, buf, len);
+    case BLE_QIOT_DATA_TYPE_ARRAY:
+        return bench_array_encode(dat, buf, len);
+    }
+    return dat->GetValue(buf, len);
+}
+
+int bench_control_encode(ThingModel &model, int properties, char *buf, uint16_t len)
+{
+    char val[BLE_QIOT_EVENT_MAX_SIZE];
+    int  off = 0;
+    int  ret = 0;
+
+    for (int i = 0; i < properties; i++) {
+        QiotData *property = model.GetPropertyCtx(i);
+        ret                = bench_value_encode(property, val, sizeof(val));
+        if (ret < 0)
+            return -1;
+        ret = ble_qiot_phone_tlv_put((uint8_t *)buf + off, len - off, property->GetType() & 0x0f, i, val, ret);
+        if (ret < 0)
+            return -1;
+        off += ret;
+    }
+    return off;
+}
+
+static void bench_device_free(LLsync *llsync)
+{
+    ble_qiot_host_dev_destroy(llsync->Context());
+    delete llsync;
+}
+
+LLsync *bench_device_create(const BenchModelSpec &spec, const char *productId, const char *deviceName,
+                            const uint8_t *mac, const std::function<bool(LLsync &)> &prepare)
+{
+    LLsync *llsync = new LLsync();
+
+    if (!llsync->Context() || !ble_qiot_host_dev_create(llsync->Context(), mac)) {
+        delete llsync;
+        return NULL;
+    }
+    llsync->set_product_id(productId);
+    llsync->set_device_name(deviceName);
+    llsync->set_device_secret(BENCH_PSK);
+    if (!llsync->thingModel().Load(bench_model_json(spec).c_str()) || (prepare && !prepare(*llsync))) {
+        bench_device_free(llsync);
+        return NULL;
+    }
+
+    QiotCtxScope scope(llsync->Context());
+    llsync->Start();
+    ble_qiot_set_log_level(BLE_QIOT_LOG_LEVEL_ERR);
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_init(productId, deviceName, BENCH_PSK)) {
+        bench_device_free(llsync);
+        return NULL;
+    }
+    ble_qiot_phone_link_up();
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_bind() || BLE_QIOT_RS_OK != ble_qiot_phone_connect()) {
+        ble_qiot_phone_link_down();
+        bench_device_free(llsync);
+        return NULL;
+    }
+    return llsync;
+}
+
+double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "LLsync.h"
+#include "ThingModel.h"
+
+// a synthetic thing model of the benchmarks. the properties are the structs first, then the arrays, the strings and
+// the scalars, which cycle through bool, int, enum, float and timestamp. the members of a struct, the params of an
+// event and the input and output of an action cycle through int, bool, string and float. the arrays have arraySize
+// elements, all live
+struct BenchModelSpec {
+    const char *name;
+    int         properties;  // 1 to 32, the tlv id has 5 bits
+    int         structs;
+    int         arrays;
+    int         strings;
+    int         members;     // the members of a struct, the struct elements of an array included
+    int         stringSize;  // the length of the string values and the max of the strings in the model
+    int         arrayType;   // the type of the array elements, BLE_QIOT_DATA_TYPE_INT, FLOAT, STRING or STRUCT
+    int         events;
+    int         actions;
+    int         params;      // the params of an event, the input and the output of an action, at least 1
+    int         arraySize;   // the size of the arrays in the model, 0 for BLE_QIOT_PROPERTY_DEFAULT_ARRAY_SIZE
+};
+
+// the json of the thing model, as downloaded from the iot explorer console
+std::string bench_model_json(const BenchModelSpec &spec);
+
+// set every value of the model, the strings to stringSize characters
+void bench_model_fill(ThingModel &model, const BenchModelSpec &spec);
+
+// the value of dat as written by the phone, a struct is the tlv of the members and the elements of an array have no
+// tlv head. returns the length, negative if buf is not enough
+int bench_value_encode(QiotData *dat, char *buf, uint16_t len);
+
+// the tlv of the first properties of the model, a control frame written by the phone. returns the length, negative if
+// buf is not enough
+int bench_control_encode(ThingModel &model, int properties, char *buf, uint16_t len);
+
+// a device on the host port with the model of spec loaded, bound and connected by the simulated phone. prepare runs
+// after the load and before Start(), like the user code setting the values and the subscribers. returns NULL on error,
+// the device is freed
+LLsync *bench_device_create(const BenchModelSpec &spec, const char *productId, const char *deviceName,
+                            const uint8_t *mac, const std::function<bool(LLsync &)> &prepare = nullptr);
+
+// the monotonic clock, unit: s
+double bench_now(void);
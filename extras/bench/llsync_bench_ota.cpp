@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// streams a synthetic ota image from the simulated phone to the device over a simulated link, on the virtual clock so
+// the retry timers of the device cost no real time and a seed gives the same result in every run. the link has an att
+// mtu, a bit rate, a latency, a window of writes in flight and drops or delays the ota data packets; the flash takes
+// the erase and program time given. the result is written in json to stdout or the file of -o
+// usage: llsync_bench_ota [-s size in KB] [-m att mtu] [-b rate in kbps] [-L latency in ms] [-w window]
+//                         [-l loss %] [-r reorder %] [-e erase us] [-p program us] [-i interrupt at %] [-S seed]
+//                         [-o json file]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "LLsync.h"
+#include "core/ble_qiot_common.h"
+#include "core/ble_qiot_llsync_device.h"
+#include "core/ble_qiot_llsync_ota.h"
+#include "core/ble_qiot_service.h"
+#include "core/ble_qiot_log.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_phone.h"
+#include "llsync_bench_model.h"
+
+#define BENCH_PRODUCT_ID   "BENCHOTA01"
+#define BENCH_DEVICE_NAME  "bench_ota"
+#define BENCH_PSK          "MTIzNDU2Nzg5MDEyMzQ1Ng=="
+#define BENCH_PDU_OVERHEAD 17    // the bytes of the link layer, l2cap and att headers of an att pdu
+#define BENCH_RECONNECT_US 1000000  // the time the phone takes to connect again after the link is lost
+
+static const char *BENCH_MODEL =
+    "{\"version\":\"1.0\",\"properties\":["
+    "{\"id\":\"power_switch\",\"mode\":\"rw\",\"define\":{\"type\":\"bool\"}}"
+    "],\"events\":[],\"actions\":[]}";
+
+struct BenchConf {
+    uint32_t size;       // unit: byte
+    uint16_t mtu;        // the att mtu
+    uint32_t rate;       // unit: kbps
+    uint32_t latency;    // unit: us
+    uint32_t window;     // the writes in flight before the phone waits
+    double   loss;       // the probability of an att pdu lost
+    double   reorder;    // the probability of a write overtaken by the next ones
+    uint32_t eraseUs;
+    uint32_t programUs;
+    uint32_t interrupt;  // the link is lost once after the bytes delivered, 0 is never
+    uint32_t seed;
+};
+
+struct BenchLink {
+    bool     up;
+    uint32_t generation;  // the packets of a lost connection are not delivered
+    uint16_t mtu;         // the att mtu exchanged
+    uint64_t free;        // the time the link finishes sending what is queued, unit: us
+    uint64_t lastDue;
+    uint32_t inflight;
+    uint32_t random;
+    uint32_t acked;  // the file offset the device acked last
+    bool     interrupted;
+};
+
+struct BenchStats {
+    uint64_t dataBytes;  // the ota file bytes written by the phone
+    uint64_t delivered;  // the ota file bytes delivered to the device
+    uint32_t packets;
+    uint32_t lost;
+    uint32_t reordered;
+    uint32_t interruptedAt;  // the file offset the device had acked when the link was lost
+    uint32_t attempts;
+};
+
+struct BenchPacket {
+    uint32_t generation;
+    bool     down;  // a notification to the phone
+    uint16_t uuid;
+    uint16_t len;
+    uint8_t  data[BLE_QIOT_EVENT_MAX_SIZE];
+};
+
+static BenchConf  sg_conf;
+static BenchLink  sg_link;
+static BenchStats sg_stats;
+
+// xorshift, the same seed gives the same losses
+static double bench_random(void)
+{
+    sg_link.random ^= sg_link.random << 13;
+    sg_link.random ^= sg_link.random >> 17;
+    sg_link.random ^= sg_link.random << 5;
+    return sg_link.random / 4294967296.0;
+}
+
+static uint64_t bench_airtime(uint32_t bytes)
+{
+    return (uint64_t)bytes * 8 * 1000 / sg_conf.rate;
+}
+
+static void bench_link_drop(void)
+{
+    if (!sg_link.up) {
+        return;
+    }
+    sg_link.up = false;
+    sg_link.generation++;
+    sg_link.inflight = 0;
+    ble_qiot_host_disconnect();
+}
+
+static void bench_deliver(void *user)
+{
+    BenchPacket *packet = (BenchPacket *)user;
+
+    if (packet->generation != sg_link.generation) {
+        delete packet;
+        return;
+    }
+    if (packet->down) {
+        ble_qiot_phone_notify(packet->data, packet->len);
+        delete packet;
+        return;
+    }
+    sg_link.inflight--;
+    ble_qiot_host_write(packet->uuid, packet->data, packet->len);
+    if (IOT_BLE_UUID_OTA == packet->uuid && BLE_QIOT_OTA_MSG_DATA == packet->data[0]) {
+        sg_stats.delivered += packet->len - BLE_QIOT_OTA_DATA_HEADER_LEN;
+        if (sg_conf.interrupt && !sg_link.interrupted && sg_stats.delivered >= sg_conf.interrupt) {
+            // the delivered bytes count the retransmits, the resume is compared with the offset acked
+            sg_link.interrupted    = true;
+            sg_stats.interruptedAt = sg_link.acked;
+            bench_link_drop();
+        }
+    }
+    delete packet;
+}
+
+static ble_qiot_ret_status_t bench_write(uint16_t uuid, const uint8_t *buf, uint16_t len, void *user)
+{
+    uint16_t payload = sg_link.mtu - 3;
+    uint32_t pdus    = (len + payload - 1) / payload;
+    uint64_t now     = 0;
+    uint64_t due     = 0;
+    bool     data    = IOT_BLE_UUID_OTA == uuid && len > 0 && BLE_QIOT_OTA_MSG_DATA == buf[0];
+    bool     lost    = false;
+    uint32_t i       = 0;
+
+    // the controller takes no more writes while the window is full, like a write without response blocking
+    while (sg_link.up && sg_link.inflight >= sg_conf.window) {
+        ble_qiot_host_vclock_step(sg_link.lastDue);
+    }
+    if (!sg_link.up) {
+        return BLE_QIOT_RS_ERR;
+    }
+    if (data) {
+        sg_stats.dataBytes += len - BLE_QIOT_OTA_DATA_HEADER_LEN;
+    }
+    sg_stats.packets++;
+
+    now          = ble_qiot_host_vclock_now();
+    sg_link.free = (sg_link.free > now ? sg_link.free : now) + bench_airtime(len + pdus * BENCH_PDU_OVERHEAD);
+    // the losses only hit the ota data, the other messages have no retry in the phone
+    for (i = 0; data && i < pdus; i++) {
+        lost |= bench_random() < sg_conf.loss;
+    }
+    if (lost) {
+        sg_stats.lost++;
+        return BLE_QIOT_RS_OK;
+    }
+    due = sg_link.free + sg_conf.latency;
+    if (data && bench_random() < sg_conf.reorder) {
+        due += 2 * bench_airtime(len + pdus * BENCH_PDU_OVERHEAD);
+        sg_stats.reordered++;
+    }
+
+    BenchPacket *packet = new BenchPacket();
+    packet->generation  = sg_link.generation;
+    packet->down        = false;
+    packet->uuid        = uuid;
+    packet->len         = len;
+    memcpy(packet->data, buf, len);
+    if (BLE_QIOT_RS_OK != ble_qiot_host_vclock_post(due - now, bench_deliver, packet)) {
+        delete packet;
+        return BLE_QIOT_RS_ERR;
+    }
+    sg_link.inflight++;
+    sg_link.lastDue = due > sg_link.lastDue ? due : sg_link.lastDue;
+
+    return BLE_QIOT_RS_OK;
+}
+
+// the notifications are not lost, only delayed
+static void bench_notify(const uint8_t *buf, uint16_t len, void *user)
+{
+    if (!sg_link.up || len > BLE_QIOT_EVENT_MAX_SIZE) {
+        return;
+    }
+    // 1 byte type + 2 bytes length + 1 byte seq expected + 4 bytes size received, never sliced
+    if (BLE_QIOT_EVENT_UP_REPLY_OTA_DATA == buf[0] && len >= 8) {
+        sg_link.acked = (uint32_t)buf[4] << 24 | (uint32_t)buf[5] << 16 | (uint32_t)buf[6] << 8 | buf[7];
+    }
+    BenchPacket *packet = new BenchPacket();
+    packet->generation  = sg_link.generation;
+    packet->down        = true;
+    packet->len         = len;
+    memcpy(packet->data, buf, len);
+    if (BLE_QIOT_RS_OK != ble_qiot_host_vclock_post(sg_conf.latency, bench_deliver, packet)) {
+        delete packet;
+    }
+}
+
+static void bench_connect(void *user)
+{
+    sg_link.up  = true;
+    sg_link.mtu = ATT_DEFAULT_MTU;
+    ble_qiot_host_connect();
+}
+
+static void bench_disconnect(void *user)
+{
+    bench_link_drop();
+}
+
+static void bench_mtu_exchange(uint16_t att_mtu, void *user)
+{
+    sg_link.mtu = att_mtu < sg_conf.mtu ? att_mtu : sg_conf.mtu;
+    ble_qiot_host_mtu_exchange(sg_link.mtu);
+}
+
+static const ble_qiot_phone_link sg_bench_link = {
+    bench_write,
+    bench_connect,
+    bench_disconnect,
+    bench_mtu_exchange,
+};
+
+static void bench_usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-s size in KB] [-m att mtu] [-b rate in kbps] [-L latency in ms] [-w window]\n"
+            "          [-l loss %%] [-r reorder %%] [-e erase us] [-p program us] [-i interrupt at %%] [-S seed]\n"
+            "          [-o json file]\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    LLsync *                   llsync    = LLsync::GetInstance();
+    const char *               output    = NULL;
+    FILE *                     out       = stdout;
+    double                     interrupt = 0;
+    double                     realStart = 0;
+    double                     realCost  = 0;
+    uint64_t                   simStart  = 0;
+    uint64_t                   simCost   = 0;
+    uint64_t                   flashBusy = 0;
+    int                        ret       = BLE_QIOT_RS_ERR;
+    int                        opt       = 0;
+    ble_qiot_host_flash_timing timing;
+    ble_qiot_phone_stats       phone;
+
+    // an esp32 like default: 4 KB sector erase and 256 bytes page program of a spi nor flash
+    sg_conf = {256 * 1024, 247, 1000, 15000, 4, 0, 0, 40000, 600, 0, 1};
+    while ((opt = getopt(argc, argv, "s:m:b:L:w:l:r:e:p:i:S:o:")) != -1) {
+        switch (opt) {
+            case 's':
+                sg_conf.size = atoi(optarg) * 1024;
+                break;
+            case 'm':
+                sg_conf.mtu = atoi(optarg);
+                break;
+            case 'b':
+                sg_conf.rate = atoi(optarg);
+                break;
+            case 'L':
+                sg_conf.latency = atof(optarg) * 1000;
+                break;
+            case 'w':
+                sg_conf.window = atoi(optarg);
+                break;
+            case 'l':
+                sg_conf.loss = atof(optarg) / 100;
+                break;
+            case 'r':
+                sg_conf.reorder = atof(optarg) / 100;
+                break;
+            case 'e':
+                sg_conf.eraseUs = atoi(optarg);
+                break;
+            case 'p':
+                sg_conf.programUs = atoi(optarg);
+                break;
+            case 'i':
+                interrupt = atof(optarg) / 100;
+                break;
+            case 'S':
+                sg_conf.seed = strtoul(optarg, NULL, 0);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                bench_usage(argv[0]);
+        }
+    }
+    if (!sg_conf.size || sg_conf.size > BLE_QIOT_RECORD_FLASH_ADDR - BLE_QIOT_HOST_OTA_ADDR ||
+        sg_conf.mtu < ATT_DEFAULT_MTU || !sg_conf.rate || !sg_conf.window || sg_conf.loss < 0 ||
+        sg_conf.loss >= 1 || sg_conf.reorder < 0 || sg_conf.reorder > 1 || interrupt < 0 || interrupt >= 1) {
+        bench_usage(argv[0]);
+    }
+    sg_conf.interrupt = sg_conf.size * interrupt;
+    sg_link.random    = sg_conf.seed ? sg_conf.seed : 1;
+
+    std::vector<uint8_t> file(sg_conf.size);
+    unsigned             seed = sg_conf.seed;
+    for (auto &b : file) {
+        b = rand_r(&seed);
+    }
+
+    ble_qiot_host_vclock_enable();
+    timing.erase_us   = sg_conf.eraseUs;
+    timing.program_us = sg_conf.programUs;
+    ble_qiot_host_flash_timing_set(&timing);
+    ble_qiot_host_set_notify_cb(bench_notify, NULL);
+    llsync->set_product_id(BENCH_PRODUCT_ID);
+    llsync->set_device_name(BENCH_DEVICE_NAME);
+    llsync->set_device_secret(BENCH_PSK);
+    if (!llsync->thingModel().Load(BENCH_MODEL)) {
+        fprintf(stderr, "load thing model failed\n");
+        return 1;
+    }
+    llsync->Start();
+    ble_qiot_set_log_level(BLE_QIOT_LOG_LEVEL_ERR);
+
+    ble_qiot_phone_set_link(&sg_bench_link, NULL);
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_init(BENCH_PRODUCT_ID, BENCH_DEVICE_NAME, BENCH_PSK)) {
+        return 1;
+    }
+    ble_qiot_phone_link_up();
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_bind() || BLE_QIOT_RS_OK != ble_qiot_phone_connect()) {
+        fprintf(stderr, "bind failed\n");
+        return 1;
+    }
+
+    realStart = bench_now();
+    simStart  = ble_qiot_host_vclock_now();
+    flashBusy = ble_qiot_host_flash_busy();
+    // the phone connects again and resumes once if the link is lost
+    for (sg_stats.attempts = 1;; sg_stats.attempts++) {
+        ret = ble_qiot_phone_ota(file.data(), file.size(), "9.9.9");
+        if (BLE_QIOT_RS_OK == ret || sg_link.up || sg_stats.attempts > 1) {
+            break;
+        }
+        ble_qiot_phone_link_down();
+        ble_qiot_host_vclock_advance(BENCH_RECONNECT_US);
+        ble_qiot_phone_link_up();
+        if (BLE_QIOT_RS_OK != ble_qiot_phone_connect()) {
+            break;
+        }
+    }
+    simCost   = ble_qiot_host_vclock_now() - simStart;
+    realCost  = bench_now() - realStart;
+    flashBusy = ble_qiot_host_flash_busy() - flashBusy;
+    ble_qiot_phone_stats_get(&phone);
+
+    // the logs of the sdk go to stdout
+    if (output && NULL == (out = fopen(output, "w"))) {
+        perror(output);
+        return 1;
+    }
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": {\"size\": %u, \"mtu\": %u, \"rate_kbps\": %u, \"latency_ms\": %.3f, \"window\": %u, "
+           "\"loss\": %.4f, \"reorder\": %.4f, \"erase_us\": %u, \"program_us\": %u, \"interrupt_at\": %u, "
+           "\"seed\": %u},\n",
+           sg_conf.size, sg_conf.mtu, sg_conf.rate, sg_conf.latency / 1000.0, sg_conf.window, sg_conf.loss,
+           sg_conf.reorder, sg_conf.eraseUs, sg_conf.programUs, sg_conf.interrupt, sg_conf.seed);
+    fprintf(out, "  \"ok\": %s,\n", BLE_QIOT_RS_OK == ret && BLE_QIOT_OTA_SUCCESS == ble_qiot_host_ota_result() ? "true"
+                                                                                                      : "false");
+    fprintf(out, "  \"ota_result\": %d,\n", ble_qiot_host_ota_result());
+    fprintf(out, "  \"sim_s\": %.6f,\n", simCost / 1e6);
+    fprintf(out, "  \"real_s\": %.6f,\n", realCost);
+    fprintf(out, "  \"sim_s_per_real_s\": %.1f,\n", realCost > 0 ? simCost / 1e6 / realCost : 0);
+    fprintf(out, "  \"throughput_kbps\": %.3f,\n", simCost ? sg_conf.size * 8.0 * 1000 / simCost : 0);
+    fprintf(out, "  \"packets\": %u,\n", sg_stats.packets);
+    fprintf(out, "  \"packets_lost\": %u,\n", sg_stats.lost);
+    fprintf(out, "  \"packets_reordered\": %u,\n", sg_stats.reordered);
+    fprintf(out, "  \"data_bytes\": %llu,\n", (unsigned long long)sg_stats.dataBytes);
+    fprintf(out, "  \"retransmitted_bytes\": %llu,\n",
+           (unsigned long long)(sg_stats.dataBytes > sg_conf.size ? sg_stats.dataBytes - sg_conf.size : 0));
+    fprintf(out, "  \"phone_resends\": %u,\n", phone.ota_resends);
+#if BLE_QIOT_METRICS_ENABLE
+    ble_qiot_metrics metrics;
+    llsync->GetMetrics(metrics);
+    fprintf(out, "  \"device_timer_retries\": %u,\n", metrics.counter[BLE_QIOT_METRIC_OTA_RETRANSMIT]);
+    fprintf(out, "  \"device_seq_misses\": %u,\n", metrics.counter[BLE_QIOT_METRIC_OTA_SEQ_MISS]);
+#endif
+    fprintf(out, "  \"flash_s\": %.6f,\n", flashBusy / 1e6);
+    fprintf(out, "  \"flash_share\": %.4f,\n", simCost ? (double)flashBusy / simCost : 0);
+    fprintf(out, "  \"resume\": {\"attempts\": %u, \"interrupted_at\": %u, \"resumed_from\": %u}\n", sg_stats.attempts,
+           sg_stats.interruptedAt, sg_stats.attempts > 1 ? phone.ota_resumed : 0);
+    fprintf(out, "}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    return BLE_QIOT_RS_OK == ret ? 0 : 1;
+}
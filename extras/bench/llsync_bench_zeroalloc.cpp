@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// the steady state of a device does not allocate. every model is a device bound and connected by the simulated phone,
+// after Start() and one warm-up round the control frames, the property reports, the event posts and the actions run
+// with the heap allocations counted. the strings written by the phone and by the user change length every round, from
+// empty up to the max of the model, the arrays written by the phone change length too. exits 1 if a path allocates, run it with -x in a debugger to see where from
+// usage: llsync_bench_zeroalloc [-n rounds] [-x]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LLsync.h"
+#include "core/ble_qiot_llsync_device.h"
+#include "core/ble_qiot_log.h"
+#include "core/ble_qiot_service.h"
+#include "core/ble_qiot_template.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_phone.h"
+#include "llsync_bench_alloc.h"
+#include "llsync_bench_model.h"
+
+#define ZA_PRODUCT_ID "BENCHALLOC"
+#define ZA_STEPS      8  // the string lengths of a round, from 0 to the max of the model
+
+static const BenchModelSpec sg_models[] = {
+    // name, properties, structs, arrays, strings, members, string size, array type, events, actions, params, array size
+    {"flat", 8, 0, 0, 2, 0, 32, BLE_QIOT_DATA_TYPE_INT, 2, 2, 4},
+    {"struct", 8, 2, 0, 2, 8, 48, BLE_QIOT_DATA_TYPE_INT, 2, 2, 8},
+    {"array_str", 4, 0, 2, 1, 0, 32, BLE_QIOT_DATA_TYPE_STRING, 1, 1, 4, 8},
+    {"array_struct", 4, 1, 2, 1, 4, 24, BLE_QIOT_DATA_TYPE_STRUCT, 1, 1, 4, 8},
+};
+
+enum {
+    ZA_CONTROL,
+    ZA_REPORT,
+    ZA_EVENT,
+    ZA_ACTION,
+    ZA_PATH_NUM,
+};
+static const char *sg_path_names[ZA_PATH_NUM] = {"control", "report", "event", "action"};
+
+#define ZA_MODEL_NUM (sizeof(sg_models) / sizeof(sg_models[0]))
+
+// the devices live until the exit
+static LLsync *sg_devices[ZA_MODEL_NUM];
+static int     sg_rounds = 20;
+static bool    sg_trap   = false;
+static uint32_t sg_notified;  // the calls of the subscribers
+// the tail of the text is a string of any length up to BLE_QIOT_EVENT_MAX_SIZE, no copy is needed to set it
+static char sg_text[BLE_QIOT_EVENT_MAX_SIZE + 1];
+// a subscriber of each property of the devices, freed with a device not created
+static std::unique_ptr<QiotSubscription[]> sg_subs[ZA_MODEL_NUM];
+
+// the string length of step of a round, the steps go up and down so a string grows after it shrinks
+static int za_string_len(int step, int max)
+{
+    return step * 5 % ZA_STEPS * max / (ZA_STEPS - 1);
+}
+
+// every string under dat gets len characters, as the user code sets its values
+static void za_strings_set(QiotData *dat, int len)
+{
+    switch (dat->GetType() & 0x0f) {
+    case BLE_QIOT_DATA_TYPE_STRING:
+        dat->SetValue(sg_text + BLE_QIOT_EVENT_MAX_SIZE - len);
+        break;
+    case BLE_QIOT_DATA_TYPE_STRUCT:
+    case BLE_QIOT_DATA_TYPE_ARRAY:
+        for (unsigned int i = 0; i < dat->ChildsCount(); i++)
+            za_strings_set(dat->GetChildCtx(i), len);
+        break;
+    }
+}
+
+// the writes of the phone for each step, encoded by a model of the phone before the counting
+struct ZaFrames {
+    std::vector<std::string> control;
+    std::vector<std::string> action;  // ZA_STEPS of each action
+};
+
+static bool za_frames_build(const BenchModelSpec &spec, ZaFrames &frames)
+{
+    static char buf[BLE_QIOT_EVENT_MAX_SIZE];
+    ThingModel  phone;
+    int         len = 0;
+
+    if (!phone.Load(bench_model_json(spec).c_str())) {
+        return false;
+    }
+    bench_model_fill(phone, spec);
+    for (int step = 0; step < ZA_STEPS; step++) {
+        for (int i = 0; i < spec.properties; i++) {
+            QiotData *property = phone.GetPropertyCtx(i);
+            za_strings_set(property, za_string_len(step, spec.stringSize));
+            property->SetArrayLen(za_string_len(step, property->ChildsCount()));
+        }
+        len = bench_control_encode(phone, spec.properties, buf, sizeof(buf));
+        if (len < 0)
+            return false;
+        frames.control.push_back(std::string(buf, len));
+    }
+    for (int i = 0; i < spec.actions; i++) {
+        for (int step = 0; step < ZA_STEPS; step++) {
+            za_strings_set(phone.GetActionInputCtx(i), za_string_len(step, spec.stringSize));
+            len = bench_value_encode(phone.GetActionInputCtx(i), buf, sizeof(buf));
+            if (len < 0)
+                return false;
+            frames.action.push_back(std::string(buf, len));
+        }
+    }
+    return true;
+}
+
+static LLsync *za_device_create(const BenchModelSpec &spec, int index)
+{
+    char    deviceName[BLE_QIOT_DEVICE_NAME_LEN + 1];
+    uint8_t mac[BLE_QIOT_MAC_LEN] = {0x02, 0x5A, 0x41, 0x4C, 0x00, (uint8_t)index};
+    LLsync *llsync                = NULL;
+
+    snprintf(deviceName, sizeof(deviceName), "zalloc_%s", spec.name);
+    llsync = bench_device_create(spec, ZA_PRODUCT_ID, deviceName, mac, [&spec, index](LLsync &dev) {
+        // a subscriber of each property, the control frames dispatch to them
+        sg_subs[index].reset(new QiotSubscription[spec.properties]);
+        for (int i = 0; i < spec.properties; i++) {
+            sg_subs[index][i].SetHandler([](QiotData &) { sg_notified++; });
+            if (!dev.thingModel().Subscribe(dev.thingModel().GetPropertyCtx(i)->ID(), sg_subs[index][i])) {
+                return false;
+            }
+        }
+        return true;
+    });
+    if (!llsync) {
+        sg_subs[index].reset();
+    }
+    return llsync;
+}
+
+// one step of a path, false on error
+static bool za_step(LLsync *llsync, const BenchModelSpec &spec, const ZaFrames &frames, int path, int step)
+{
+    ThingModel &model = llsync->thingModel();
+    int         len   = za_string_len(step, spec.stringSize);
+    uint8_t     output[BLE_QIOT_EVENT_MAX_SIZE];
+    bool        ok = true;
+
+    switch (path) {
+    case ZA_CONTROL: {
+        uint32_t notified = sg_notified;
+        return BLE_QIOT_REPLY_SUCCESS ==
+                   ble_qiot_phone_control((const uint8_t *)frames.control[step].data(), frames.control[step].size()) &&
+               sg_notified - notified == (uint32_t)spec.properties;
+    }
+    case ZA_REPORT:
+        for (int i = 0; i < spec.properties; i++)
+            za_strings_set(model.GetPropertyCtx(i), len);
+        ok = BLE_QIOT_RS_OK == ble_event_report_property();
+        ble_qiot_phone_flush();
+        return ok;
+    case ZA_EVENT:
+        for (int i = 0; i < spec.events && ok; i++) {
+            za_strings_set(model.GetEventCtx(i), len);
+            ok = model.PostEvent((uint8_t)i);
+            ble_qiot_phone_flush();
+        }
+        return ok;
+    case ZA_ACTION:
+        for (int i = 0; i < spec.actions && ok; i++) {
+            const std::string &input = frames.action[i * ZA_STEPS + step];
+            za_strings_set(model.GetActionOutputCtx(i), len);
+            ok = ble_qiot_phone_action(i, (const uint8_t *)input.data(), input.size(), output, sizeof(output)) > 0 &&
+                 BLE_QIOT_REPLY_SUCCESS == output[0];
+        }
+        return ok;
+    }
+    return false;
+}
+
+// runs the paths of a model, the allocations of each path are added to allocs
+static bool za_model(int index, uint64_t allocs[ZA_PATH_NUM], uint64_t bytes[ZA_PATH_NUM], uint32_t ops[ZA_PATH_NUM])
+{
+    const BenchModelSpec &   spec = sg_models[index];
+    ZaFrames                 frames;
+    llsync_bench_alloc_stats before;
+    llsync_bench_alloc_stats after;
+
+    if (!za_frames_build(spec, frames)) {
+        fprintf(stderr, "model %s: encode the frames failed\n", spec.name);
+        return false;
+    }
+    sg_devices[index] = za_device_create(spec, index);
+    if (!sg_devices[index]) {
+        fprintf(stderr, "model %s: create device failed\n", spec.name);
+        return false;
+    }
+
+    QiotCtxScope scope(sg_devices[index]->Context());
+    // the warm-up, anything done once like the first use of a lock is not counted
+    for (int path = 0; path < ZA_PATH_NUM; path++) {
+        if (!za_step(sg_devices[index], spec, frames, path, 0)) {
+            fprintf(stderr, "model %s: %s failed\n", spec.name, sg_path_names[path]);
+            return false;
+        }
+    }
+    for (int path = 0; path < ZA_PATH_NUM; path++) {
+        llsync_bench_alloc_get(&before);
+        llsync_bench_alloc_trap(sg_trap);
+        for (int round = 0; round < sg_rounds; round++) {
+            for (int step = 0; step < ZA_STEPS; step++) {
+                if (!za_step(sg_devices[index], spec, frames, path, step)) {
+                    llsync_bench_alloc_trap(false);
+                    fprintf(stderr, "model %s: %s failed at step %d\n", spec.name, sg_path_names[path], step);
+                    return false;
+                }
+            }
+        }
+        llsync_bench_alloc_trap(false);
+        llsync_bench_alloc_get(&after);
+        allocs[path] = after.count - before.count;
+        bytes[path]  = after.bytes - before.bytes;
+        ops[path]    = sg_rounds * ZA_STEPS;
+    }
+    return true;
+}
+
+static void za_usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-n rounds] [-x]\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t allocs[ZA_PATH_NUM];
+    uint64_t bytes[ZA_PATH_NUM];
+    uint32_t ops[ZA_PATH_NUM];
+    int      fails = 0;
+    int      opt   = 0;
+
+    while ((opt = getopt(argc, argv, "n:x")) != -1) {
+        switch (opt) {
+            case 'n':
+                sg_rounds = atoi(optarg);
+                break;
+            case 'x':
+                sg_trap = true;
+                break;
+            default:
+                za_usage(argv[0]);
+        }
+    }
+    if (sg_rounds <= 0) {
+        za_usage(argv[0]);
+    }
+
+    memset(sg_text, 'z', BLE_QIOT_EVENT_MAX_SIZE);
+    // the writes of the phone are handled before it waits for the reply
+    ble_qiot_host_dispatch_inline();
+    printf("allocs: %s\n", llsync_bench_alloc_enabled() ? "counted" : "not counted, built with a sanitizer");
+    printf("%-16s %-8s %8s %10s %10s\n", "model", "path", "ops", "allocs", "bytes");
+    for (size_t i = 0; i < ZA_MODEL_NUM; i++) {
+        if (!za_model(i, allocs, bytes, ops)) {
+            return 1;
+        }
+        for (int path = 0; path < ZA_PATH_NUM; path++) {
+            printf("%-16s %-8s %8u %10llu %10llu%s\n", sg_models[i].name, sg_path_names[path], ops[path],
+                   (unsigned long long)allocs[path], (unsigned long long)bytes[path], allocs[path] ? "  FAIL" : "");
+            fails += allocs[path] ? 1 : 0;
+        }
+    }
+    if (fails) {
+        printf("%d paths allocate in the steady state\n", fails);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
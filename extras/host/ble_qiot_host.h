@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef QCLOUD_BLE_QIOT_HOST_H
+#define QCLOUD_BLE_QIOT_HOST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble_qiot_export.h"
+
+// the size of the simulated flash, covers BLE_QIOT_RECORD_FLASH_ADDR and the ota info page
+#define BLE_QIOT_HOST_FLASH_SIZE (4 * 1024 * 1024)
+// the ota file is downloaded to the flash from the address, up to BLE_QIOT_RECORD_FLASH_ADDR
+#define BLE_QIOT_HOST_OTA_ADDR (0x100000)
+
+// the notification sent by the device on the event characteristic
+typedef void (*ble_qiot_host_notify_cb)(const uint8_t *buf, uint16_t len, void *user);
+
+// the host port state of a device, every context but the default one needs its own. the functions below work on the
+// device of the context current in the calling thread, select it by ble_qiot_ctx_switch() before calling them
+typedef struct ble_qiot_host_dev_t_ ble_qiot_host_dev_t;
+
+/**
+ * @brief create the host port state of a device and attach it to the context
+ * @param ctx the context of the device, from ble_qiot_ctx_create()
+ * @param mac the 6 bytes mac returned by ble_get_mac()
+ * @return the device, NULL if out of memory
+ */
+ble_qiot_host_dev_t *ble_qiot_host_dev_create(ble_qiot_ctx_t *ctx, const uint8_t *mac);
+
+/**
+ * @brief close the flash of the device and detach it from the context
+ * @note  the device must be disconnected and none of its timers is running
+ */
+void ble_qiot_host_dev_destroy(ble_qiot_ctx_t *ctx);
+
+/**
+ * @brief handle the writes in the thread calling ble_qiot_host_write() instead of the dispatch worker
+ * @note  the dispatch queue has a single producer, call it before the first device starts if the writes come from
+ * more than one thread
+ */
+void ble_qiot_host_dispatch_inline(void);
+
+/**
+ * @brief run the timers and ble_get_timestamp_us() on a virtual clock instead of the monotonic clock
+ * @return BLE_QIOT_RS_OK is success, other is error
+ * @note  call it before the first timer is created. the clock starts at 0 and only moves by
+ * ble_qiot_host_vclock_step() or ble_qiot_host_vclock_advance(), the timers fire in the thread moving it, in the order
+ * of their deadlines and the ones due at the same time in the order they were started. the writes are handled
+ * inline as by ble_qiot_host_dispatch_inline(), so a simulation in one thread is reproducible
+ */
+ble_qiot_ret_status_t ble_qiot_host_vclock_enable(void);
+
+/**
+ * @brief whether the virtual clock is enabled
+ */
+bool ble_qiot_host_vclock_enabled(void);
+
+/**
+ * @brief the virtual time, unit: us
+ */
+uint64_t ble_qiot_host_vclock_now(void);
+
+/**
+ * @brief move the clock to the earliest deadline not later than until and fire that timer
+ * @param until the virtual time, unit: us
+ * @return true if a timer fired, false if none is due until then and the clock is moved to until
+ */
+bool ble_qiot_host_vclock_step(uint64_t until);
+
+/**
+ * @brief move the clock forward, firing the timers due in order
+ * @param us the time to move, unit: us
+ * @return the number of the timers fired
+ */
+uint32_t ble_qiot_host_vclock_advance(uint64_t us);
+
+/**
+ * @brief move the clock forward without firing the timers, like a busy mcu, the timers due fire late on the next step
+ * @param us the time spent, unit: us
+ */
+void ble_qiot_host_vclock_consume(uint64_t us);
+
+/**
+ * @brief call a function on the virtual clock, e.g. deliver a packet of a simulated link
+ * @param delay the time from now, unit: us
+ * @param event called once in the thread moving the clock, with the context current when posted
+ * @return BLE_QIOT_RS_OK is success, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_host_vclock_post(uint64_t delay, void (*event)(void *user), void *user);
+
+/**
+ * @brief the simulated seconds per real second since the virtual clock was enabled
+ */
+double ble_qiot_host_vclock_speed(void);
+
+// the time the operations of the simulated flash take, 0 is instant
+typedef struct {
+    uint32_t erase_us;    // erase a page of BLE_QIOT_RECORD_FLASH_PAGESIZE
+    uint32_t program_us;  // program 256 bytes
+} ble_qiot_host_flash_timing;
+
+/**
+ * @brief set the time the flash operations of the device take
+ * @note  the time passes by ble_qiot_host_vclock_consume() on the virtual clock, otherwise it is only counted
+ */
+void ble_qiot_host_flash_timing_set(const ble_qiot_host_flash_timing *timing);
+
+/**
+ * @brief the time the device spent in the flash operations, unit: us
+ */
+uint64_t ble_qiot_host_flash_busy(void);
+
+/**
+ * @brief map the flash to a file, the sdk data is kept between the runs
+ * @param path the file is created and filled with 0xFF if not exist, NULL maps an anonymous flash erased on demand
+ * @return BLE_QIOT_RS_OK is success, other is error
+ * @note  an anonymous flash is mapped on the first access if the function is not called
+ */
+ble_qiot_ret_status_t ble_qiot_host_flash_open(const char *path);
+
+/**
+ * @brief sync and unmap the flash
+ */
+void ble_qiot_host_flash_close(void);
+
+/**
+ * @brief set the mac returned by ble_get_mac(), 6 bytes
+ */
+void ble_qiot_host_set_mac(const uint8_t *mac);
+
+/**
+ * @brief the result of the last ota, BLE_QIOT_OTA_SUCCESS or the error, -1 if no ota finished
+ */
+int ble_qiot_host_ota_result(void);
+
+/**
+ * @brief set the receiver of the notifications, it is called in the context of ble_send_notify()
+ */
+void ble_qiot_host_set_notify_cb(ble_qiot_host_notify_cb cb, void *user);
+
+/**
+ * @brief the remote connects, like the gap connect event
+ */
+void ble_qiot_host_connect(void);
+
+/**
+ * @brief the remote disconnects, like the gap disconnect event, the advertising restarts
+ */
+void ble_qiot_host_disconnect(void);
+
+/**
+ * @brief the att mtu exchanged with the remote
+ */
+void ble_qiot_host_mtu_exchange(uint16_t att_mtu);
+
+/**
+ * @brief the remote writes a characteristic
+ * @param char_uuid IOT_BLE_UUID_DEVICE_INFO, IOT_BLE_UUID_DATA or IOT_BLE_UUID_OTA
+ * @return BLE_QIOT_RS_OK is success, other is error
+ * @note  only one thread is allowed to write, the write waits while the dispatch queue is full like the link layer
+ * flow control
+ */
+ble_qiot_ret_status_t ble_qiot_host_write(uint16_t char_uuid, const uint8_t *buf, uint16_t len);
+
+/**
+ * @brief copy the manufacturer data advertised
+ * @return the length, 0 if the advertising is stopped
+ */
+int ble_qiot_host_adv_get(uint8_t *buf, uint8_t buf_len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_HOST_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// the state the host port keeps for each device, shared by ble_qiot_host_device.c and ble_qiot_host_service.c
+#ifndef QCLOUD_BLE_QIOT_HOST_DEV_H
+#define QCLOUD_BLE_QIOT_HOST_DEV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ble_qiot_common.h"
+#include "ble_qiot_config.h"
+#include "ble_qiot_export.h"
+#include "ble_qiot_import.h"
+#include "ble_qiot_host.h"
+
+#define BLE_HOST_FLASH_PAGE_NUM (BLE_QIOT_HOST_FLASH_SIZE / BLE_QIOT_RECORD_FLASH_PAGESIZE)
+
+struct ble_qiot_host_dev_t_ {
+    uint8_t         mac[BLE_QIOT_MAC_LEN];
+    pthread_mutex_t flash_lock;
+    char *          flash;
+    int             flash_fd;
+    // the anonymous flash is erased page by page on the first access, an idle device only costs the pages it uses
+    uint8_t flash_erased[BLE_HOST_FLASH_PAGE_NUM / 8];
+    int     ota_result;
+
+    ble_qiot_host_flash_timing flash_timing;
+    uint64_t                   flash_busy;  // unit: us
+
+    ble_qiot_host_notify_cb notify_cb;
+    void *                  notify_user;
+    pthread_mutex_t         adv_lock;
+    uint8_t                 adv_data[31];
+    uint8_t                 adv_len;
+};
+
+// the device of the default context
+extern ble_qiot_host_dev_t llsync_g_host_dev_default;
+
+// the timers on the virtual clock, used by the timer imports if ble_qiot_host_vclock_enable() is called
+ble_timer_t           ble_host_vtimer_create(uint8_t type, ble_timer_cb timeout_handle);
+ble_qiot_ret_status_t ble_host_vtimer_start(ble_timer_t timer_id, uint32_t period);
+ble_qiot_ret_status_t ble_host_vtimer_stop(ble_timer_t timer_id);
+ble_qiot_ret_status_t ble_host_vtimer_delete(ble_timer_t timer_id);
+
+// the device of the context current in the calling thread
+static inline ble_qiot_host_dev_t *ble_host_dev(void)
+{
+    ble_qiot_host_dev_t *dev = (ble_qiot_host_dev_t *)ble_qiot_ctx_port(ble_qiot_ctx_current());
+
+    return NULL != dev ? dev : &llsync_g_host_dev_default;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_HOST_DEV_H
@@ -0,0 +1,518 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// linux implementation of the device imports: mmap flash, timerfd timers and the ota download area. the timers and
+// the timestamp run on ble_qiot_host_vclock.c instead if the virtual clock is enabled
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_DEVICE_LEVEL
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+
+#include "ble_qiot_common.h"
+#include "ble_qiot_export.h"
+#include "ble_qiot_import.h"
+#include "ble_qiot_log.h"
+#include "ble_qiot_param_check.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_dev.h"
+
+ble_qiot_host_dev_t llsync_g_host_dev_default = {
+    .mac        = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55},
+    .flash_lock = PTHREAD_MUTEX_INITIALIZER,
+    .flash      = NULL,
+    .flash_fd   = -1,
+    .ota_result = -1,
+    .adv_lock   = PTHREAD_MUTEX_INITIALIZER,
+};
+
+ble_qiot_host_dev_t *ble_qiot_host_dev_create(ble_qiot_ctx_t *ctx, const uint8_t *mac)
+{
+    ble_qiot_host_dev_t *dev = NULL;
+
+    POINTER_SANITY_CHECK(ctx, NULL);
+    POINTER_SANITY_CHECK(mac, NULL);
+
+    dev = calloc(1, sizeof(ble_qiot_host_dev_t));
+    if (NULL == dev) {
+        return NULL;
+    }
+    memcpy(dev->mac, mac, BLE_QIOT_MAC_LEN);
+    pthread_mutex_init(&dev->flash_lock, NULL);
+    pthread_mutex_init(&dev->adv_lock, NULL);
+    dev->flash_fd   = -1;
+    dev->ota_result = -1;
+    ble_qiot_ctx_port_set(ctx, dev);
+
+    return dev;
+}
+
+void ble_qiot_host_dev_destroy(ble_qiot_ctx_t *ctx)
+{
+    ble_qiot_host_dev_t *dev  = NULL;
+    ble_qiot_ctx_t *     prev = NULL;
+
+    if (NULL == ctx || NULL == (dev = (ble_qiot_host_dev_t *)ble_qiot_ctx_port(ctx))) {
+        return;
+    }
+    prev = ble_qiot_ctx_switch(ctx);
+    ble_qiot_host_flash_close();
+    (void)ble_qiot_ctx_switch(prev);
+    ble_qiot_ctx_port_set(ctx, NULL);
+    pthread_mutex_destroy(&dev->flash_lock);
+    pthread_mutex_destroy(&dev->adv_lock);
+    free(dev);
+}
+
+int ble_get_mac(char *mac)
+{
+    memcpy(mac, ble_host_dev()->mac, BLE_QIOT_MAC_LEN);
+
+    return 0;
+}
+
+void ble_qiot_host_set_mac(const uint8_t *mac)
+{
+    memcpy(ble_host_dev()->mac, mac, BLE_QIOT_MAC_LEN);
+}
+
+static ble_qiot_ret_status_t ble_host_flash_map(ble_qiot_host_dev_t *dev, const char *path)
+{
+    struct stat st;
+    bool        fresh = false;
+
+    if (NULL == path) {
+        // the pages read as 0 until used, ble_host_flash_get() erases them on the first access
+        dev->flash = mmap(NULL, BLE_QIOT_HOST_FLASH_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (MAP_FAILED == dev->flash) {
+            dev->flash = NULL;
+            return BLE_QIOT_RS_ERR_FLASH;
+        }
+        memset(dev->flash_erased, 0, sizeof(dev->flash_erased));
+        return BLE_QIOT_RS_OK;
+    }
+
+    dev->flash_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (dev->flash_fd < 0) {
+        ble_qiot_log_e("open flash file %s failed, errno %d", path, errno);
+        return BLE_QIOT_RS_ERR_FLASH;
+    }
+    if (0 != fstat(dev->flash_fd, &st) || 0 != ftruncate(dev->flash_fd, BLE_QIOT_HOST_FLASH_SIZE)) {
+        goto err;
+    }
+    fresh      = (st.st_size < BLE_QIOT_HOST_FLASH_SIZE);
+    dev->flash = mmap(NULL, BLE_QIOT_HOST_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, dev->flash_fd, 0);
+    if (MAP_FAILED == dev->flash) {
+        dev->flash = NULL;
+        goto err;
+    }
+    // the part extended by ftruncate reads as 0, erase it like a new chip
+    if (fresh) {
+        memset(dev->flash + st.st_size, 0xFF, BLE_QIOT_HOST_FLASH_SIZE - st.st_size);
+    }
+    memset(dev->flash_erased, 0xFF, sizeof(dev->flash_erased));
+    return BLE_QIOT_RS_OK;
+
+err:
+    ble_qiot_log_e("map flash file %s failed, errno %d", path, errno);
+    close(dev->flash_fd);
+    dev->flash_fd = -1;
+    return BLE_QIOT_RS_ERR_FLASH;
+}
+
+ble_qiot_ret_status_t ble_qiot_host_flash_open(const char *path)
+{
+    ble_qiot_host_dev_t * dev = ble_host_dev();
+    ble_qiot_ret_status_t ret = BLE_QIOT_RS_OK;
+
+    pthread_mutex_lock(&dev->flash_lock);
+    if (NULL == dev->flash) {
+        ret = ble_host_flash_map(dev, path);
+    }
+    pthread_mutex_unlock(&dev->flash_lock);
+
+    return ret;
+}
+
+void ble_qiot_host_flash_close(void)
+{
+    ble_qiot_host_dev_t *dev = ble_host_dev();
+
+    pthread_mutex_lock(&dev->flash_lock);
+    if (NULL != dev->flash) {
+        if (dev->flash_fd >= 0) {
+            msync(dev->flash, BLE_QIOT_HOST_FLASH_SIZE, MS_SYNC);
+            close(dev->flash_fd);
+            dev->flash_fd = -1;
+        }
+        munmap(dev->flash, BLE_QIOT_HOST_FLASH_SIZE);
+        dev->flash = NULL;
+    }
+    pthread_mutex_unlock(&dev->flash_lock);
+}
+
+static char *ble_host_flash_get(uint32_t flash_addr, uint32_t len)
+{
+    ble_qiot_host_dev_t *dev  = ble_host_dev();
+    uint32_t             page = 0;
+
+    if ((uint64_t)flash_addr + len > BLE_QIOT_HOST_FLASH_SIZE) {
+        ble_qiot_log_e("flash access out of range, addr 0x%x, len %d", flash_addr, len);
+        return NULL;
+    }
+    if (NULL == dev->flash && BLE_QIOT_RS_OK != ble_qiot_host_flash_open(NULL)) {
+        return NULL;
+    }
+    for (page = flash_addr / BLE_QIOT_RECORD_FLASH_PAGESIZE;
+         len && page <= (flash_addr + len - 1) / BLE_QIOT_RECORD_FLASH_PAGESIZE; page++) {
+        if (!(dev->flash_erased[page / 8] & (1 << (page % 8)))) {
+            memset(dev->flash + page * BLE_QIOT_RECORD_FLASH_PAGESIZE, 0xFF, BLE_QIOT_RECORD_FLASH_PAGESIZE);
+            dev->flash_erased[page / 8] |= 1 << (page % 8);
+        }
+    }
+
+    return dev->flash + flash_addr;
+}
+
+void ble_qiot_host_flash_timing_set(const ble_qiot_host_flash_timing *timing)
+{
+    ble_qiot_host_dev_t *dev = ble_host_dev();
+
+    pthread_mutex_lock(&dev->flash_lock);
+    memcpy(&dev->flash_timing, timing, sizeof(ble_qiot_host_flash_timing));
+    pthread_mutex_unlock(&dev->flash_lock);
+}
+
+uint64_t ble_qiot_host_flash_busy(void)
+{
+    return __atomic_load_n(&ble_host_dev()->flash_busy, __ATOMIC_RELAXED);
+}
+
+static void ble_host_flash_busy(uint32_t us)
+{
+    if (0 == us) {
+        return;
+    }
+    __atomic_add_fetch(&ble_host_dev()->flash_busy, us, __ATOMIC_RELAXED);
+    if (ble_qiot_host_vclock_enabled()) {
+        ble_qiot_host_vclock_consume(us);
+    }
+}
+
+static void ble_host_flash_program(uint16_t len)
+{
+    ble_host_flash_busy((len + 255) / 256 * ble_host_dev()->flash_timing.program_us);
+}
+
+static void ble_host_flash_erase(uint32_t flash_addr)
+{
+    char *page = ble_host_flash_get(flash_addr / BLE_QIOT_RECORD_FLASH_PAGESIZE * BLE_QIOT_RECORD_FLASH_PAGESIZE,
+                                    BLE_QIOT_RECORD_FLASH_PAGESIZE);
+
+    if (NULL != page) {
+        memset(page, 0xFF, BLE_QIOT_RECORD_FLASH_PAGESIZE);
+        ble_host_flash_busy(ble_host_dev()->flash_timing.erase_us);
+    }
+}
+
+int ble_write_flash(uint32_t flash_addr, const char *write_buf, uint16_t write_len)
+{
+    char *p = ble_host_flash_get(flash_addr, write_len);
+
+    if (NULL == p) {
+        return BLE_QIOT_RS_ERR_FLASH;
+    }
+    // the same as the esp32 port, the page is erased before written
+    ble_host_flash_erase(flash_addr);
+    memcpy(p, write_buf, write_len);
+    ble_host_flash_program(write_len);
+
+    return write_len;
+}
+
+int ble_read_flash(uint32_t flash_addr, char *read_buf, uint16_t read_len)
+{
+    char *p = ble_host_flash_get(flash_addr, read_len);
+
+    if (NULL == p) {
+        return BLE_QIOT_RS_ERR_FLASH;
+    }
+    memcpy(read_buf, p, read_len);
+
+    return read_len;
+}
+
+// the timers are timerfds polled by a thread, the callbacks are called in the thread like the freertos timer task
+typedef struct ble_host_timer_ {
+    struct ble_host_timer_ *next;
+    int                     fd;
+    uint8_t                 type;
+    ble_timer_cb            handle;
+    ble_qiot_ctx_t *        ctx;  // the device which created the timer
+} ble_host_timer;
+
+static pthread_mutex_t sg_host_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static ble_host_timer *sg_host_timers     = NULL;
+static int             sg_host_timer_epfd = -1;
+
+static void *ble_host_timer_thread(void *param)
+{
+    struct epoll_event events[8];
+    ble_host_timer *   p_timer = NULL;
+    ble_timer_cb       handle  = NULL;
+    ble_qiot_ctx_t *   ctx     = NULL;
+    uint64_t           expired = 0;
+    int                count   = 0;
+    int                i       = 0;
+
+    for (;;) {
+        count = epoll_wait(sg_host_timer_epfd, events, sizeof(events) / sizeof(events[0]), -1);
+        for (i = 0; i < count; i++) {
+            handle = NULL;
+            // the timer may be deleted after epoll_wait returned, only use the timers still in the list
+            pthread_mutex_lock(&sg_host_timer_lock);
+            for (p_timer = sg_host_timers; NULL != p_timer; p_timer = p_timer->next) {
+                if (p_timer == events[i].data.ptr) {
+                    if (sizeof(expired) == read(p_timer->fd, &expired, sizeof(expired))) {
+                        handle = p_timer->handle;
+                        ctx    = p_timer->ctx;
+                    }
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&sg_host_timer_lock);
+            // the callback may stop or delete the timer
+            if (NULL != handle) {
+                (void)ble_qiot_ctx_switch(ctx);
+                handle(p_timer);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static ble_qiot_ret_status_t ble_host_timer_init(void)
+{
+    pthread_t thread;
+
+    if (sg_host_timer_epfd >= 0) {
+        return BLE_QIOT_RS_OK;
+    }
+    sg_host_timer_epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (sg_host_timer_epfd < 0) {
+        return BLE_QIOT_RS_ERR;
+    }
+    if (0 != pthread_create(&thread, NULL, ble_host_timer_thread, NULL)) {
+        close(sg_host_timer_epfd);
+        sg_host_timer_epfd = -1;
+        return BLE_QIOT_RS_ERR;
+    }
+    pthread_detach(thread);
+
+    return BLE_QIOT_RS_OK;
+}
+
+ble_timer_t ble_timer_create(uint8_t type, ble_timer_cb timeout_handle)
+{
+    struct epoll_event ev;
+    ble_host_timer *   p_timer = NULL;
+
+    if (ble_qiot_host_vclock_enabled()) {
+        return ble_host_vtimer_create(type, timeout_handle);
+    }
+    pthread_mutex_lock(&sg_host_timer_lock);
+    if (BLE_QIOT_RS_OK != ble_host_timer_init()) {
+        goto err;
+    }
+    p_timer = malloc(sizeof(ble_host_timer));
+    if (NULL == p_timer) {
+        goto err;
+    }
+    p_timer->type   = type;
+    p_timer->handle = timeout_handle;
+    p_timer->ctx    = ble_qiot_ctx_current();
+    p_timer->fd     = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (p_timer->fd < 0) {
+        goto err;
+    }
+    ev.events   = EPOLLIN;
+    ev.data.ptr = p_timer;
+    if (0 != epoll_ctl(sg_host_timer_epfd, EPOLL_CTL_ADD, p_timer->fd, &ev)) {
+        close(p_timer->fd);
+        goto err;
+    }
+    p_timer->next  = sg_host_timers;
+    sg_host_timers = p_timer;
+    pthread_mutex_unlock(&sg_host_timer_lock);
+
+    return (ble_timer_t)p_timer;
+
+err:
+    pthread_mutex_unlock(&sg_host_timer_lock);
+    free(p_timer);
+    ble_qiot_log_e("create timer failed, errno %d", errno);
+    return NULL;
+}
+
+static ble_qiot_ret_status_t ble_host_timer_set(ble_host_timer *p_timer, uint32_t period)
+{
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec  = period / 1000;
+    spec.it_value.tv_nsec = (period % 1000) * 1000000;
+    if (BLE_TIMER_PERIOD_TYPE == p_timer->type) {
+        spec.it_interval = spec.it_value;
+    }
+
+    return 0 == timerfd_settime(p_timer->fd, 0, &spec, NULL) ? BLE_QIOT_RS_OK : BLE_QIOT_RS_ERR;
+}
+
+ble_qiot_ret_status_t ble_timer_start(ble_timer_t timer_id, uint32_t period)
+{
+    POINTER_SANITY_CHECK(timer_id, BLE_QIOT_RS_ERR_PARA);
+
+    // a zero period disarms a timerfd, fire as soon as possible instead
+    if (ble_qiot_host_vclock_enabled()) {
+        return ble_host_vtimer_start(timer_id, period ? period : 1);
+    }
+    return ble_host_timer_set((ble_host_timer *)timer_id, period ? period : 1);
+}
+
+ble_qiot_ret_status_t ble_timer_stop(ble_timer_t timer_id)
+{
+    POINTER_SANITY_CHECK(timer_id, BLE_QIOT_RS_ERR_PARA);
+
+    if (ble_qiot_host_vclock_enabled()) {
+        return ble_host_vtimer_stop(timer_id);
+    }
+    return ble_host_timer_set((ble_host_timer *)timer_id, 0);
+}
+
+ble_qiot_ret_status_t ble_timer_delete(ble_timer_t timer_id)
+{
+    ble_host_timer * p_timer = (ble_host_timer *)timer_id;
+    ble_host_timer **pp      = NULL;
+
+    POINTER_SANITY_CHECK(timer_id, BLE_QIOT_RS_ERR_PARA);
+    if (ble_qiot_host_vclock_enabled()) {
+        return ble_host_vtimer_delete(timer_id);
+    }
+    pthread_mutex_lock(&sg_host_timer_lock);
+    for (pp = &sg_host_timers; NULL != *pp; pp = &(*pp)->next) {
+        if (*pp == p_timer) {
+            *pp = p_timer->next;
+            break;
+        }
+    }
+    epoll_ctl(sg_host_timer_epfd, EPOLL_CTL_DEL, p_timer->fd, NULL);
+    close(p_timer->fd);
+    pthread_mutex_unlock(&sg_host_timer_lock);
+    free(p_timer);
+
+    return BLE_QIOT_RS_OK;
+}
+
+uint32_t ble_get_timestamp_us(void)
+{
+    struct timespec ts;
+
+    if (ble_qiot_host_vclock_enabled()) {
+        return (uint32_t)ble_qiot_host_vclock_now();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+uint8_t ble_get_core_id(void)
+{
+    int cpu = sched_getcpu();
+
+    return cpu < 0 ? 0 : (uint8_t)cpu;
+}
+
+// return ATT MTU
+uint16_t ble_get_user_data_mtu_size(void)
+{
+    return BLE_QIOT_EVENT_BUF_SIZE;
+}
+
+uint8_t ble_ota_is_enable(const char *version)
+{
+    ble_qiot_log_i("ota version: %s, enable ota", version);
+    return BLE_OTA_ENABLE;
+}
+
+uint32_t ble_ota_get_download_addr(void)
+{
+    return BLE_QIOT_HOST_OTA_ADDR;
+}
+
+int ble_ota_write_flash(uint32_t flash_addr, const char *write_buf, uint16_t write_len)
+{
+    char *p = NULL;
+
+    if (flash_addr + write_len > BLE_QIOT_RECORD_FLASH_ADDR) {
+        ble_qiot_log_e("ota file overflow the download area, addr 0x%x, len %d", flash_addr, write_len);
+        return BLE_QIOT_RS_ERR_FLASH;
+    }
+    p = ble_host_flash_get(flash_addr, write_len);
+    if (NULL == p) {
+        return BLE_QIOT_RS_ERR_FLASH;
+    }
+    // the same erase rule as the esp32 port, erase the page when the write starts it or crosses into the next one
+    if (flash_addr % BLE_QIOT_RECORD_FLASH_PAGESIZE == 0) {
+        ble_host_flash_erase(flash_addr);
+    } else if ((flash_addr + write_len - 1) / BLE_QIOT_RECORD_FLASH_PAGESIZE !=
+               flash_addr / BLE_QIOT_RECORD_FLASH_PAGESIZE) {
+        ble_host_flash_erase((flash_addr / BLE_QIOT_RECORD_FLASH_PAGESIZE + 1) * BLE_QIOT_RECORD_FLASH_PAGESIZE);
+    }
+    memcpy(p, write_buf, write_len);
+    ble_host_flash_program(write_len);
+
+    return write_len;
+}
+
+int ble_qiot_host_ota_result(void)
+{
+    return __atomic_load_n(&ble_host_dev()->ota_result, __ATOMIC_ACQUIRE);
+}
+
+void ble_qiot_ota_final_handle(uint8_t result)
+{
+    // there is no partition to boot on the host, the file stays in the download area for checking
+    ble_qiot_log_i("ble ota_final_handle, result %d", result);
+    __atomic_store_n(&ble_host_dev()->ota_result, result, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
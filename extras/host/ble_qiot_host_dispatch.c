@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// pthread implementation of the dispatch imports, to run the worker of ble_qiot_dispatch.c on a host
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_DEVICE_LEVEL
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "ble_qiot_import.h"
+#include "ble_qiot_log.h"
+#include "ble_qiot_host.h"
+
+#if BLE_QIOT_DISPATCH_ENABLE
+
+static pthread_t       sg_dispatch_thread;
+static pthread_mutex_t sg_dispatch_lock    = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  sg_dispatch_cond    = PTHREAD_COND_INITIALIZER;
+static uint32_t        sg_dispatch_wakeups = 0;  // pending wakeups, like the freertos task notification value
+static pthread_cond_t  sg_dispatch_freed   = PTHREAD_COND_INITIALIZER;
+static bool            sg_dispatch_free    = false;  // a wakeup of the producer pending, like a binary semaphore
+static bool            sg_dispatch_inline  = false;  // see ble_qiot_host_dispatch_inline()
+static void (*sg_dispatch_entry)(void)     = NULL;
+
+static void *ble_dispatch_thread_entry(void *param)
+{
+    sg_dispatch_entry();
+    return NULL;
+}
+
+ble_qiot_ret_status_t ble_dispatch_task_create(void (*entry)(void))
+{
+    pthread_attr_t attr;
+    int            ret = 0;
+
+    // the core handles the writes in the callback if the task is not created
+    if (sg_dispatch_inline) {
+        return BLE_QIOT_RS_ERR;
+    }
+    sg_dispatch_entry = entry;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, BLE_QIOT_DISPATCH_TASK_STACK < 65536 ? 65536 : BLE_QIOT_DISPATCH_TASK_STACK);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = pthread_create(&sg_dispatch_thread, &attr, ble_dispatch_thread_entry, NULL);
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        ble_qiot_log_e("dispatch thread create failed: %d", ret);
+        return BLE_QIOT_RS_ERR;
+    }
+
+    return BLE_QIOT_RS_OK;
+}
+
+void ble_dispatch_wakeup(void)
+{
+    pthread_mutex_lock(&sg_dispatch_lock);
+    sg_dispatch_wakeups++;
+    pthread_cond_signal(&sg_dispatch_cond);
+    pthread_mutex_unlock(&sg_dispatch_lock);
+}
+
+void ble_dispatch_wait(void)
+{
+    pthread_mutex_lock(&sg_dispatch_lock);
+    while (!sg_dispatch_wakeups) {
+        pthread_cond_wait(&sg_dispatch_cond, &sg_dispatch_lock);
+    }
+    sg_dispatch_wakeups = 0;
+    pthread_mutex_unlock(&sg_dispatch_lock);
+}
+
+void ble_dispatch_producer_wakeup(void)
+{
+    pthread_mutex_lock(&sg_dispatch_lock);
+    sg_dispatch_free = true;
+    pthread_cond_signal(&sg_dispatch_freed);
+    pthread_mutex_unlock(&sg_dispatch_lock);
+}
+
+ble_qiot_ret_status_t ble_dispatch_producer_wait(uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    int             ret = 0;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&sg_dispatch_lock);
+    while (!sg_dispatch_free && !ret) {
+        ret = pthread_cond_timedwait(&sg_dispatch_freed, &sg_dispatch_lock, &deadline);
+    }
+    ret              = sg_dispatch_free ? BLE_QIOT_RS_OK : BLE_QIOT_RS_ERR;
+    sg_dispatch_free = false;
+    pthread_mutex_unlock(&sg_dispatch_lock);
+
+    return (ble_qiot_ret_status_t)ret;
+}
+
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+
+void ble_qiot_host_dispatch_inline(void)
+{
+#if BLE_QIOT_DISPATCH_ENABLE
+    sg_dispatch_inline = true;
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+}
+
+#ifdef __cplusplus
+}
+#endif
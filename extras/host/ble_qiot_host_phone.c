@@ -0,0 +1,699 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ble_qiot_common.h"
+#include "ble_qiot_crc.h"
+#include "ble_qiot_hmac.h"
+#include "ble_qiot_llsync_device.h"
+#include "ble_qiot_llsync_event.h"
+#include "ble_qiot_llsync_ota.h"
+#include "ble_qiot_param_check.h"
+#include "ble_qiot_service.h"
+#include "ble_qiot_template.h"
+#include "ble_qiot_utils_base64.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_phone.h"
+
+#define BLE_PHONE_HEADER_LEN      3  // 1 byte type + 2 bytes length
+#define BLE_PHONE_AUTO_REPLY_NUM  8
+#define BLE_PHONE_SLICE_FLAG(_S)  ((_S) << 6)
+
+typedef struct {
+    bool     used;
+    uint8_t  type;
+    uint16_t len;
+    uint32_t seq;  // the order received
+    uint8_t  buf[BLE_QIOT_PHONE_MSG_SIZE];
+} ble_phone_msg_t;
+
+typedef struct {
+    char     product_id[BLE_QIOT_PRODUCT_ID_LEN];
+    char     device_name[BLE_QIOT_DEVICE_NAME_LEN + 1];
+    uint8_t  secret[BLE_QIOT_PSK_LEN / 4 * 3];
+    size_t   secret_len;
+    char     local_psk[BLE_LOCAL_PSK_LEN];
+    uint16_t write_mtu;  // the max length of a write, att mtu - 3
+    unsigned seed;
+    bool     auto_reply;
+} ble_phone_t;
+
+static ble_phone_t          sg_phone;
+static pthread_mutex_t      sg_phone_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       sg_phone_cond;
+static ble_phone_msg_t      sg_phone_msgs[BLE_QIOT_PHONE_MSG_NUM];
+static ble_phone_msg_t      sg_phone_rx;  // the message in reassembling
+static uint32_t             sg_phone_seq = 0;
+static uint8_t              sg_phone_replies[BLE_PHONE_AUTO_REPLY_NUM][2];
+static uint8_t              sg_phone_reply_num = 0;
+static ble_qiot_phone_stats sg_phone_stats;
+
+static ble_qiot_ret_status_t ble_phone_loopback_write(uint16_t char_uuid, const uint8_t *buf, uint16_t len,
+                                                      void *user)
+{
+    return ble_qiot_host_write(char_uuid, buf, len);
+}
+
+static void ble_phone_loopback_connect(void *user)
+{
+    ble_qiot_host_connect();
+}
+
+static void ble_phone_loopback_disconnect(void *user)
+{
+    ble_qiot_host_disconnect();
+}
+
+static void ble_phone_loopback_mtu_exchange(uint16_t att_mtu, void *user)
+{
+    ble_qiot_host_mtu_exchange(att_mtu);
+}
+
+static const ble_qiot_phone_link sg_phone_loopback = {
+    .write        = ble_phone_loopback_write,
+    .connect      = ble_phone_loopback_connect,
+    .disconnect   = ble_phone_loopback_disconnect,
+    .mtu_exchange = ble_phone_loopback_mtu_exchange,
+};
+static const ble_qiot_phone_link *sg_phone_link      = &sg_phone_loopback;
+static void *                     sg_phone_link_user = NULL;
+
+static uint64_t ble_phone_now_ms(void)
+{
+    struct timespec ts;
+
+    if (ble_qiot_host_vclock_enabled()) {
+        return ble_qiot_host_vclock_now() / 1000;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// called with the lock held
+static void ble_phone_msg_deliver(uint8_t type, const uint8_t *buf, uint16_t len)
+{
+    ble_phone_msg_t *slot   = NULL;
+    ble_phone_msg_t *oldest = NULL;
+    int              i      = 0;
+
+    if (sg_phone.auto_reply && sg_phone_reply_num < BLE_PHONE_AUTO_REPLY_NUM) {
+        if (BLE_QIOT_EVENT_UP_PROPERTY_REPORT == type) {
+            sg_phone_replies[sg_phone_reply_num][0] =
+                BLE_QIOT_PACKAGE_MSG_HEAD(BLE_QIOT_MSG_TYPE_PROPERTY, BLE_QIOT_EFFECT_REPLY,
+                                          BLE_QIOT_DATA_DOWN_REPORT_REPLY);
+            sg_phone_replies[sg_phone_reply_num++][1] = BLE_QIOT_REPLY_SUCCESS;
+        } else if (BLE_QIOT_EVENT_UP_EVENT_POST == type && len > 0) {
+            // the event id is the header of the post
+            sg_phone_replies[sg_phone_reply_num][0] =
+                BLE_QIOT_PACKAGE_MSG_HEAD(BLE_QIOT_MSG_TYPE_EVENT, BLE_QIOT_EFFECT_REPLY, buf[0]);
+            sg_phone_replies[sg_phone_reply_num++][1] = BLE_QIOT_REPLY_SUCCESS;
+        }
+    }
+
+    for (i = 0; i < BLE_QIOT_PHONE_MSG_NUM; i++) {
+        if (!sg_phone_msgs[i].used) {
+            slot = &sg_phone_msgs[i];
+            break;
+        }
+        if (NULL == oldest || sg_phone_msgs[i].seq < oldest->seq) {
+            oldest = &sg_phone_msgs[i];
+        }
+    }
+    if (NULL == slot) {
+        slot = oldest;
+        sg_phone_stats.dropped++;
+    }
+    slot->used = true;
+    slot->type = type;
+    slot->len  = len;
+    slot->seq  = sg_phone_seq++;
+    if (len) {
+        memcpy(slot->buf, buf, len);
+    }
+    sg_phone_stats.messages++;
+    pthread_cond_broadcast(&sg_phone_cond);
+}
+
+// the notifications of the device, called in the device context
+static void ble_phone_notify(const uint8_t *buf, uint16_t len, void *user)
+{
+    uint8_t  slice_state = BLE_QIOT_EVENT_NO_SLICE;
+    uint16_t data_len    = 0;
+
+    pthread_mutex_lock(&sg_phone_lock);
+    sg_phone_stats.frames++;
+    if (len < BLE_PHONE_HEADER_LEN) {
+        // the notification without payload
+        ble_phone_msg_deliver(buf[0], NULL, 0);
+        pthread_mutex_unlock(&sg_phone_lock);
+        return;
+    }
+    slice_state = buf[1] >> 6;
+    data_len    = len - BLE_PHONE_HEADER_LEN;
+    if (BLE_QIOT_EVENT_NO_SLICE == slice_state) {
+        ble_phone_msg_deliver(buf[0], buf + BLE_PHONE_HEADER_LEN, data_len);
+    } else if (BLE_QIOT_EVENT_SLICE_HEAD == slice_state) {
+        sg_phone_rx.used = true;
+        sg_phone_rx.type = buf[0];
+        sg_phone_rx.len  = 0;
+    }
+    if (BLE_QIOT_EVENT_NO_SLICE != slice_state) {
+        if (!sg_phone_rx.used || sg_phone_rx.type != buf[0] ||
+            sg_phone_rx.len + data_len > sizeof(sg_phone_rx.buf)) {
+            sg_phone_rx.used = false;
+            sg_phone_stats.dropped++;
+        } else {
+            memcpy(sg_phone_rx.buf + sg_phone_rx.len, buf + BLE_PHONE_HEADER_LEN, data_len);
+            sg_phone_rx.len += data_len;
+            if (BLE_QIOT_EVENT_SLICE_FOOT == slice_state) {
+                sg_phone_rx.used = false;
+                ble_phone_msg_deliver(sg_phone_rx.type, sg_phone_rx.buf, sg_phone_rx.len);
+            }
+        }
+    }
+    pthread_mutex_unlock(&sg_phone_lock);
+}
+
+static ble_qiot_ret_status_t ble_phone_write(uint16_t char_uuid, const uint8_t *buf, uint16_t len)
+{
+    pthread_mutex_lock(&sg_phone_lock);
+    sg_phone_stats.writes++;
+    sg_phone_stats.write_bytes += len;
+    pthread_mutex_unlock(&sg_phone_lock);
+
+    return sg_phone_link->write(char_uuid, buf, len, sg_phone_link_user);
+}
+
+// send the replies queued by the notification callback, the writes are only sent in the phone thread
+static void ble_phone_auto_reply_flush(void)
+{
+    uint8_t replies[BLE_PHONE_AUTO_REPLY_NUM][2];
+    uint8_t num = 0;
+    uint8_t i   = 0;
+
+    pthread_mutex_lock(&sg_phone_lock);
+    num = sg_phone_reply_num;
+    memcpy(replies, sg_phone_replies, sizeof(replies[0]) * num);
+    sg_phone_reply_num = 0;
+    sg_phone_stats.auto_replies += num;
+    pthread_mutex_unlock(&sg_phone_lock);
+
+    for (i = 0; i < num; i++) {
+        ble_phone_write(IOT_BLE_UUID_DATA, replies[i], sizeof(replies[i]));
+    }
+}
+
+ble_qiot_ret_status_t ble_qiot_phone_init(const char *product_id, const char *device_name, const char *psk)
+{
+    pthread_condattr_t attr;
+
+    POINTER_SANITY_CHECK(product_id, BLE_QIOT_RS_ERR_PARA);
+    POINTER_SANITY_CHECK(device_name, BLE_QIOT_RS_ERR_PARA);
+    POINTER_SANITY_CHECK(psk, BLE_QIOT_RS_ERR_PARA);
+    if (strlen(product_id) != BLE_QIOT_PRODUCT_ID_LEN || strlen(device_name) > BLE_QIOT_DEVICE_NAME_LEN) {
+        return BLE_QIOT_RS_ERR_PARA;
+    }
+
+    pthread_mutex_lock(&sg_phone_lock);
+    memset(&sg_phone, 0, sizeof(sg_phone));
+    memcpy(sg_phone.product_id, product_id, BLE_QIOT_PRODUCT_ID_LEN);
+    strcpy(sg_phone.device_name, device_name);
+    if (BLE_QIOT_RS_OK != qcloud_iot_utils_base64decode(sg_phone.secret, sizeof(sg_phone.secret),
+                                                         &sg_phone.secret_len, (const unsigned char *)psk,
+                                                         strlen(psk))) {
+        pthread_mutex_unlock(&sg_phone_lock);
+        return BLE_QIOT_RS_ERR_PARA;
+    }
+    sg_phone.write_mtu  = ATT_MTU_TO_LLSYNC_MTU(ATT_DEFAULT_MTU);
+    sg_phone.seed       = 1;  // the same nonces and keys in every run
+    sg_phone.auto_reply = true;
+    memset(sg_phone_msgs, 0, sizeof(sg_phone_msgs));
+    memset(&sg_phone_rx, 0, sizeof(sg_phone_rx));
+    memset(&sg_phone_stats, 0, sizeof(sg_phone_stats));
+    sg_phone_reply_num = 0;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sg_phone_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_unlock(&sg_phone_lock);
+
+    if (&sg_phone_loopback == sg_phone_link) {
+        ble_qiot_host_set_notify_cb(ble_phone_notify, NULL);
+    }
+
+    return BLE_QIOT_RS_OK;
+}
+
+void ble_qiot_phone_set_link(const ble_qiot_phone_link *link, void *user)
+{
+    sg_phone_link      = NULL != link ? link : &sg_phone_loopback;
+    sg_phone_link_user = user;
+}
+
+void ble_qiot_phone_notify(const uint8_t *buf, uint16_t len)
+{
+    if (NULL == buf || 0 == len) {
+        return;
+    }
+    ble_phone_notify(buf, len, NULL);
+}
+
+void ble_qiot_phone_auto_reply(bool enable)
+{
+    pthread_mutex_lock(&sg_phone_lock);
+    sg_phone.auto_reply = enable;
+    pthread_mutex_unlock(&sg_phone_lock);
+}
+
+int ble_qiot_phone_wait(uint8_t type, uint8_t *buf, uint16_t buf_len, uint32_t timeout_ms)
+{
+    uint64_t         deadline = ble_phone_now_ms() + timeout_ms;
+    ble_phone_msg_t *found    = NULL;
+    struct timespec  ts;
+    int              len     = 0;
+    int              replies = 0;
+    int              i       = 0;
+
+    for (;;) {
+        ble_phone_auto_reply_flush();
+
+        pthread_mutex_lock(&sg_phone_lock);
+        found = NULL;
+        for (i = 0; i < BLE_QIOT_PHONE_MSG_NUM; i++) {
+            if (sg_phone_msgs[i].used && sg_phone_msgs[i].type == type &&
+                (NULL == found || sg_phone_msgs[i].seq < found->seq)) {
+                found = &sg_phone_msgs[i];
+            }
+        }
+        if (NULL != found) {
+            len = found->len;
+            if (NULL != buf) {
+                memcpy(buf, found->buf, len > buf_len ? buf_len : len);
+            }
+            found->used = false;
+            pthread_mutex_unlock(&sg_phone_lock);
+            return len;
+        }
+        if (ble_phone_now_ms() >= deadline) {
+            pthread_mutex_unlock(&sg_phone_lock);
+            return BLE_QIOT_RS_ERR;
+        }
+        // nothing else runs on the virtual clock, fire the next timer of the device or time out
+        if (ble_qiot_host_vclock_enabled()) {
+            replies = sg_phone_reply_num;
+            pthread_mutex_unlock(&sg_phone_lock);
+            if (0 == replies) {
+                (void)ble_qiot_host_vclock_step(deadline * 1000);
+            }
+            continue;
+        }
+        // a notification wakes up the wait, and the auto replies it queued are sent in the next round
+        ts.tv_sec  = deadline / 1000;
+        ts.tv_nsec = (deadline % 1000) * 1000000;
+        if (0 == sg_phone_reply_num) {
+            pthread_cond_timedwait(&sg_phone_cond, &sg_phone_lock, &ts);
+        }
+        pthread_mutex_unlock(&sg_phone_lock);
+    }
+}
+
+void ble_qiot_phone_flush(void)
+{
+    ble_phone_auto_reply_flush();
+    pthread_mutex_lock(&sg_phone_lock);
+    memset(sg_phone_msgs, 0, sizeof(sg_phone_msgs));
+    pthread_mutex_unlock(&sg_phone_lock);
+}
+
+ble_qiot_ret_status_t ble_qiot_phone_send(uint16_t char_uuid, uint8_t type, const uint8_t *payload,
+                                          uint16_t payload_len)
+{
+    uint8_t               frame[BLE_QIOT_PHONE_MSG_SIZE + BLE_PHONE_HEADER_LEN];
+    uint16_t              chunk_max = sg_phone.write_mtu - BLE_PHONE_HEADER_LEN;
+    uint16_t              offset    = 0;
+    uint16_t              chunk     = 0;
+    uint8_t               flag      = 0;
+    ble_qiot_ret_status_t ret       = BLE_QIOT_RS_OK;
+
+    BUFF_LEN_SANITY_CHECK(BLE_QIOT_PHONE_MSG_SIZE, payload_len, BLE_QIOT_RS_ERR_PARA);
+    ble_phone_auto_reply_flush();
+    // the slices repeat the type, the high 2 bits of the length are the slice flag
+    do {
+        chunk = payload_len - offset > chunk_max ? chunk_max : payload_len - offset;
+        if (chunk == payload_len) {
+            flag = 0;
+        } else if (0 == offset) {
+            flag = BLE_PHONE_SLICE_FLAG(BLE_QIOT_EVENT_SLICE_HEAD);
+        } else if (offset + chunk == payload_len) {
+            flag = BLE_PHONE_SLICE_FLAG(BLE_QIOT_EVENT_SLICE_FOOT);
+        } else {
+            flag = BLE_PHONE_SLICE_FLAG(BLE_QIOT_EVENT_SLICE_BODY);
+        }
+        frame[0] = type;
+        frame[1] = flag | ((chunk >> 8) & 0x3F);
+        frame[2] = chunk & 0xFF;
+        if (chunk) {
+            memcpy(frame + BLE_PHONE_HEADER_LEN, payload + offset, chunk);
+        }
+        ret = ble_phone_write(char_uuid, frame, chunk + BLE_PHONE_HEADER_LEN);
+        offset += chunk;
+    } while (BLE_QIOT_RS_OK == ret && offset < payload_len);
+
+    return ret;
+}
+
+void ble_qiot_phone_link_up(void)
+{
+    pthread_mutex_lock(&sg_phone_lock);
+    sg_phone.write_mtu = ATT_MTU_TO_LLSYNC_MTU(ATT_DEFAULT_MTU);
+    memset(&sg_phone_rx, 0, sizeof(sg_phone_rx));
+    pthread_mutex_unlock(&sg_phone_lock);
+    sg_phone_link->connect(sg_phone_link_user);
+}
+
+void ble_qiot_phone_link_down(void)
+{
+    sg_phone_link->disconnect(sg_phone_link_user);
+}
+
+static void ble_phone_put_u32(uint8_t *buf, uint32_t val)
+{
+    val = HTONL(val);
+    memcpy(buf, &val, sizeof(val));
+}
+
+static uint32_t ble_phone_get_u32(const uint8_t *buf)
+{
+    uint32_t val = 0;
+
+    memcpy(&val, buf, sizeof(val));
+    return NTOHL(val);
+}
+
+ble_qiot_ret_status_t ble_qiot_phone_bind(void)
+{
+    uint8_t  payload[sizeof(ble_core_data)];
+    uint8_t  reply[SHA1_DIGEST_SIZE + BLE_QIOT_DEVICE_NAME_LEN];
+    char     sign_info[80];
+    char     sign[SHA1_DIGEST_SIZE];
+    int      sign_info_len = 0;
+    int      reply_len     = 0;
+    uint32_t nonce         = rand_r(&sg_phone.seed);
+    uint32_t timestamp     = (uint32_t)time(NULL);
+    int      i             = 0;
+
+    ble_qiot_phone_flush();
+    ble_phone_put_u32(payload, nonce);
+    ble_phone_put_u32(payload + sizeof(uint32_t), timestamp);
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_SYNC_TIME, payload,
+                                              sizeof(ble_bind_data))) {
+        return BLE_QIOT_RS_ERR;
+    }
+    reply_len = ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_BIND_SIGN_RET, reply, sizeof(reply), BLE_QIOT_PHONE_TIMEOUT);
+    if (reply_len < SHA1_DIGEST_SIZE) {
+        return BLE_QIOT_RS_ERR;
+    }
+
+    // [10 bytes product_id] + [x bytes device name] + ';' + nonce + ';' + expiration
+    memcpy(sign_info, sg_phone.product_id, BLE_QIOT_PRODUCT_ID_LEN);
+    sign_info_len = BLE_QIOT_PRODUCT_ID_LEN;
+    sign_info_len += snprintf(sign_info + sign_info_len, sizeof(sign_info) - sign_info_len, "%s;%u;%u",
+                              sg_phone.device_name, nonce, timestamp + BLE_EXPIRATION_TIME);
+    llsync_utils_hmac_sha1(sign_info, sign_info_len, sign, (const char *)sg_phone.secret, sg_phone.secret_len);
+    if (0 != memcmp(reply, sign, SHA1_DIGEST_SIZE) || (size_t)(reply_len - SHA1_DIGEST_SIZE) != strlen(sg_phone.device_name) ||
+        0 != memcmp(reply + SHA1_DIGEST_SIZE, sg_phone.device_name, reply_len - SHA1_DIGEST_SIZE)) {
+        ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_BIND_FAIL, NULL, 0);
+        return BLE_QIOT_RS_VALID_SIGN_ERR;
+    }
+
+    // the server generates the key of the connections and the identify of the binding
+    payload[0] = E_LLSYNC_BIND_SUCC;
+    for (i = 1; i < (int)sizeof(payload); i++) {
+        payload[i] = (uint8_t)rand_r(&sg_phone.seed);
+    }
+    memcpy(sg_phone.local_psk, payload + 1, BLE_LOCAL_PSK_LEN);
+
+    return ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_BIND_SUCC, payload, sizeof(payload));
+}
+
+ble_qiot_ret_status_t ble_qiot_phone_connect(void)
+{
+    uint8_t  payload[sizeof(ble_conn_data)];
+    uint8_t  reply[SHA1_DIGEST_SIZE + BLE_QIOT_DEVICE_NAME_LEN];
+    char     sign_info[80];
+    uint8_t  mtu_result[BLE_PHONE_HEADER_LEN];
+    int      sign_info_len = 0;
+    int      reply_len     = 0;
+    uint16_t mtu           = 0;
+    uint32_t timestamp     = (uint32_t)time(NULL);
+
+    ble_qiot_phone_flush();
+    sign_info_len = snprintf(sign_info, sizeof(sign_info), "%d", (int)timestamp);
+    ble_phone_put_u32(payload, timestamp);
+    llsync_utils_hmac_sha1(sign_info, sign_info_len, (char *)payload + sizeof(uint32_t), sg_phone.local_psk,
+                           BLE_LOCAL_PSK_LEN);
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_CONN_VALID, payload,
+                                              sizeof(payload))) {
+        return BLE_QIOT_RS_ERR;
+    }
+    reply_len = ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_CONN_SIGN_RET, reply, sizeof(reply), BLE_QIOT_PHONE_TIMEOUT);
+    if (reply_len < SHA1_DIGEST_SIZE) {
+        return BLE_QIOT_RS_ERR;
+    }
+
+    // expiration time + product id + device name
+    sign_info_len = snprintf(sign_info, sizeof(sign_info), "%d", (int)(timestamp + BLE_EXPIRATION_TIME));
+    memcpy(sign_info + sign_info_len, sg_phone.product_id, BLE_QIOT_PRODUCT_ID_LEN);
+    sign_info_len += BLE_QIOT_PRODUCT_ID_LEN;
+    memcpy(sign_info + sign_info_len, sg_phone.device_name, strlen(sg_phone.device_name));
+    sign_info_len += strlen(sg_phone.device_name);
+    llsync_utils_hmac_sha1(sign_info, sign_info_len, (char *)payload, sg_phone.local_psk, BLE_LOCAL_PSK_LEN);
+    if (0 != memcmp(reply, payload, SHA1_DIGEST_SIZE)) {
+        ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_CONN_FAIL, NULL, 0);
+        return BLE_QIOT_RS_VALID_SIGN_ERR;
+    }
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_CONN_SUCC, NULL, 0)) {
+        return BLE_QIOT_RS_ERR;
+    }
+
+    // the device reports the protocol version, the mtu and the developer version after connected
+    reply_len = ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_REPORT_MTU, reply, sizeof(reply), BLE_QIOT_PHONE_TIMEOUT);
+    if (reply_len < 4) {
+        return BLE_QIOT_RS_ERR;
+    }
+    memcpy(&mtu, reply + 1, sizeof(mtu));
+    mtu = NTOHS(mtu);
+    if (mtu & LLSYNC_MTU_SET_MASK) {
+        mtu &= ~LLSYNC_MTU_SET_MASK;
+        mtu = mtu > BLE_QIOT_PHONE_DEFAULT_MTU ? BLE_QIOT_PHONE_DEFAULT_MTU : mtu;
+        sg_phone_link->mtu_exchange(mtu, sg_phone_link_user);
+        if (ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_SYNC_MTU, NULL, 0, BLE_QIOT_PHONE_TIMEOUT) < 0) {
+            return BLE_QIOT_RS_ERR;
+        }
+        pthread_mutex_lock(&sg_phone_lock);
+        sg_phone.write_mtu = ATT_MTU_TO_LLSYNC_MTU(mtu);
+        pthread_mutex_unlock(&sg_phone_lock);
+        // 1 byte type + 2 bytes att mtu set
+        mtu           = HTONS(mtu);
+        mtu_result[0] = E_DEV_MSG_SET_MTU_RESULT;
+        memcpy(mtu_result + 1, &mtu, sizeof(mtu));
+        return ble_phone_write(IOT_BLE_UUID_DEVICE_INFO, mtu_result, sizeof(mtu_result));
+    }
+
+    return BLE_QIOT_RS_OK;
+}
+
+ble_qiot_ret_status_t ble_qiot_phone_unbind(void)
+{
+    char sign[SHA1_DIGEST_SIZE];
+    char reply[SHA1_DIGEST_SIZE];
+
+    ble_qiot_phone_flush();
+    llsync_utils_hmac_sha1(BLE_UNBIND_REQUEST_STR, BLE_UNBIND_REQUEST_STR_LEN, sign, sg_phone.local_psk,
+                           BLE_LOCAL_PSK_LEN);
+    if (BLE_QIOT_RS_OK !=
+        ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_UNBIND, (const uint8_t *)sign, sizeof(sign))) {
+        return BLE_QIOT_RS_ERR;
+    }
+    if (ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_UNBIND_SIGN_RET, (uint8_t *)reply, sizeof(reply),
+                            BLE_QIOT_PHONE_TIMEOUT) < SHA1_DIGEST_SIZE) {
+        return BLE_QIOT_RS_ERR;
+    }
+    llsync_utils_hmac_sha1(BLE_UNBIND_RESPONSE, BLE_UNBIND_RESPONSE_STR_LEN, sign, sg_phone.local_psk,
+                           BLE_LOCAL_PSK_LEN);
+    if (0 != memcmp(reply, sign, SHA1_DIGEST_SIZE)) {
+        ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_UNBIND_FAIL, NULL, 0);
+        return BLE_QIOT_RS_VALID_SIGN_ERR;
+    }
+
+    return ble_qiot_phone_send(IOT_BLE_UUID_DEVICE_INFO, E_DEV_MSG_UNBIND_SUCC, NULL, 0);
+}
+
+int ble_qiot_phone_tlv_put(uint8_t *buf, uint16_t buf_len, uint8_t type, uint8_t id, const void *val,
+                           uint16_t val_len)
+{
+    uint16_t len     = 0;
+    uint16_t net_len = HTONS(val_len);
+    bool     var_len = (BLE_QIOT_DATA_TYPE_STRING == type) || (BLE_QIOT_DATA_TYPE_STRUCT == type) ||
+                   (BLE_QIOT_DATA_TYPE_ARRAY == type);
+
+    POINTER_SANITY_CHECK(buf, BLE_QIOT_RS_ERR_PARA);
+    BUFF_LEN_SANITY_CHECK(buf_len, (int)(1 + (var_len ? sizeof(net_len) : 0) + val_len), BLE_QIOT_RS_ERR_PARA);
+    buf[len++] = BLE_QIOT_PACKAGE_TLV_HEAD(type, id);
+    if (var_len) {
+        memcpy(buf + len, &net_len, sizeof(net_len));
+        len += sizeof(net_len);
+    }
+    memcpy(buf + len, val, val_len);
+
+    return len + val_len;
+}
+
+int ble_qiot_phone_control(const uint8_t *tlv, uint16_t tlv_len)
+{
+    uint8_t result = 0;
+
+    ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_CONTROL_REPLY, NULL, 0, 0);
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_send(IOT_BLE_UUID_DATA, BLE_QIOT_CONTROL_DATA_TYPE, tlv, tlv_len)) {
+        return BLE_QIOT_RS_ERR;
+    }
+    if (ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_CONTROL_REPLY, &result, sizeof(result), BLE_QIOT_PHONE_TIMEOUT) < 1) {
+        return BLE_QIOT_RS_ERR;
+    }
+
+    return (int8_t)result;
+}
+
+int ble_qiot_phone_action(uint8_t action_id, const uint8_t *tlv, uint16_t tlv_len, uint8_t *output,
+                          uint16_t output_len)
+{
+    uint8_t head = BLE_QIOT_PACKAGE_MSG_HEAD(BLE_QIOT_MSG_TYPE_ACTION, BLE_QIOT_EFFECT_REQUEST, action_id);
+
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_send(IOT_BLE_UUID_DATA, head, tlv, tlv_len)) {
+        return BLE_QIOT_RS_ERR;
+    }
+
+    return ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_ACTION_REPLY, output, output_len, BLE_QIOT_PHONE_TIMEOUT);
+}
+
+ble_qiot_ret_status_t ble_qiot_phone_ota(const uint8_t *file, uint32_t file_size, const char *version)
+{
+    uint8_t  payload[BLE_QIOT_PHONE_MSG_SIZE];
+    uint8_t  reply[16];
+    uint8_t  version_len  = strlen(version);
+    uint8_t  package_nums = 0;
+    uint16_t data_size    = 0;
+    uint32_t timeout      = 0;
+    uint32_t offset       = 0;
+    uint32_t acked        = 0;
+    uint32_t chunk        = 0;
+    uint8_t  seq          = 0;
+    bool     loop_end     = false;
+    int      len          = 0;
+
+    POINTER_SANITY_CHECK(file, BLE_QIOT_RS_ERR_PARA);
+    BUFF_LEN_SANITY_CHECK(BLE_QIOT_OTA_MAX_VERSION_STR, version_len, BLE_QIOT_RS_ERR_PARA);
+    ble_qiot_phone_flush();
+
+    // 4 bytes size + 4 bytes crc + 1 byte version length + version
+    ble_phone_put_u32(payload, file_size);
+    ble_phone_put_u32(payload + 4, ble_qiot_crc32(0, file, file_size));
+    payload[8] = version_len;
+    memcpy(payload + 9, version, version_len);
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_send(IOT_BLE_UUID_OTA, BLE_QIOT_OTA_MSG_REQUEST, payload, 9 + version_len)) {
+        return BLE_QIOT_RS_ERR;
+    }
+    // 1 byte flag + 1 byte package numbers + 1 byte package size + 1 byte retry timeout + 1 byte reboot time + 4
+    // bytes size received + 1 byte package interval
+    len = ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_REPLY_OTA_REPORT, reply, sizeof(reply), BLE_QIOT_PHONE_TIMEOUT);
+    if (len < 10 || !(reply[0] & BLE_QIOT_OTA_ENABLE)) {
+        return BLE_QIOT_RS_ERR;
+    }
+    package_nums = reply[1];
+    data_size    = reply[2] - BLE_QIOT_OTA_DATA_HEADER_LEN;
+    // the device requests again after the retry timeout, and gives up after BLE_QIOT_OTA_MAX_RETRY_COUNT times
+    timeout = reply[3] * 1000 * (BLE_QIOT_OTA_MAX_RETRY_COUNT + 1);
+    offset  = (reply[0] & BLE_QIOT_OTA_RESUME_ENABLE) ? ble_phone_get_u32(reply + 5) : 0;
+    if (offset > file_size) {
+        offset = 0;
+    }
+    pthread_mutex_lock(&sg_phone_lock);
+    sg_phone_stats.ota_resumed = offset;
+    pthread_mutex_unlock(&sg_phone_lock);
+
+    while (offset < file_size || acked < file_size) {
+        if (offset < file_size) {
+            // 1 byte type + 1 byte length + 1 byte seq + data
+            chunk      = file_size - offset > data_size ? data_size : file_size - offset;
+            payload[0] = BLE_QIOT_OTA_MSG_DATA;
+            payload[1] = chunk + 1;
+            payload[2] = seq;
+            memcpy(payload + 3, file + offset, chunk);
+            if (BLE_QIOT_RS_OK != ble_phone_write(IOT_BLE_UUID_OTA, payload, chunk + 3)) {
+                return BLE_QIOT_RS_ERR;
+            }
+            offset += chunk;
+            seq++;
+        }
+        // the device replies at the end of a loop or the file, or if it misses a package
+        loop_end = (seq == package_nums) || (offset == file_size);
+        len      = ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_REPLY_OTA_DATA, reply, sizeof(reply), loop_end ? timeout : 0);
+        if (len < 5) {
+            if (loop_end) {
+                return BLE_QIOT_RS_ERR;
+            }
+            continue;
+        }
+        // 1 byte seq expected + 4 bytes size received, continue from there
+        acked = ble_phone_get_u32(reply + 1);
+        if (acked > file_size) {
+            return BLE_QIOT_RS_ERR;
+        }
+        if (acked < offset) {
+            pthread_mutex_lock(&sg_phone_lock);
+            sg_phone_stats.ota_resends += (offset - acked + data_size - 1) / data_size;
+            pthread_mutex_unlock(&sg_phone_lock);
+        }
+        offset = acked;
+        seq    = reply[0] >= package_nums ? 0 : reply[0];
+    }
+
+    payload[0] = BLE_QIOT_OTA_MSG_END;
+    if (BLE_QIOT_RS_OK != ble_phone_write(IOT_BLE_UUID_OTA, payload, 1)) {
+        return BLE_QIOT_RS_ERR;
+    }
+    len = ble_qiot_phone_wait(BLE_QIOT_EVENT_UP_REPORT_CHECK_RESULT, reply, sizeof(reply), BLE_QIOT_PHONE_TIMEOUT);
+    if (len < 1 || !(reply[0] & BLE_QIOT_OTA_VALID_SUCCESS)) {
+        return BLE_QIOT_RS_ERR;
+    }
+
+    return BLE_QIOT_RS_OK;
+}
+
+void ble_qiot_phone_stats_get(ble_qiot_phone_stats *stats)
+{
+    pthread_mutex_lock(&sg_phone_lock);
+    memcpy(stats, &sg_phone_stats, sizeof(ble_qiot_phone_stats));
+    pthread_mutex_unlock(&sg_phone_lock);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef QCLOUD_BLE_QIOT_HOST_PHONE_H
+#define QCLOUD_BLE_QIOT_HOST_PHONE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble_qiot_export.h"
+
+// a simulated Tencent Lianlian, it speaks the llsync protocol to the device over the host loopback. the phone
+// verifies the signatures of the device like the server does, so a wrong psk or a broken sign fails the bind or the
+// connection. the api is called in one thread, the notifications are received in the device context and queued. on
+// the virtual clock a wait fires the timers of the device instead of sleeping
+
+#define BLE_QIOT_PHONE_MSG_NUM     16                    // the notifications queued, the oldest dropped if full
+#define BLE_QIOT_PHONE_MSG_SIZE    BLE_QIOT_EVENT_MAX_SIZE  // the max length of a reassembled notification
+#define BLE_QIOT_PHONE_TIMEOUT     3000                  // the default wait of a reply, unit: ms
+#define BLE_QIOT_PHONE_DEFAULT_MTU BLE_QIOT_EVENT_BUF_SIZE  // the att mtu the phone asks for
+
+// the ble link between the phone and the device, the default is the loopback to the device in the process
+typedef struct {
+    ble_qiot_ret_status_t (*write)(uint16_t char_uuid, const uint8_t *buf, uint16_t len, void *user);
+    void (*connect)(void *user);
+    void (*disconnect)(void *user);
+    void (*mtu_exchange)(uint16_t att_mtu, void *user);
+} ble_qiot_phone_link;
+
+typedef struct {
+    uint32_t messages;       // the notifications reassembled
+    uint32_t frames;         // the notifications received
+    uint32_t dropped;        // the notifications dropped because the queue was full
+    uint32_t writes;         // the writes sent
+    uint32_t write_bytes;    // the bytes written
+    uint32_t auto_replies;   // the report and event replies sent automatically
+    uint32_t ota_resends;    // the ota packages sent again
+    uint32_t ota_resumed;    // the offset the last ota resumed from, 0 if it started over
+} ble_qiot_phone_stats;
+
+/**
+ * @brief set the device identity known by the server and reset the phone
+ * @param product_id  10 bytes product id
+ * @param device_name device name
+ * @param psk         the base64 device secret
+ * @return BLE_QIOT_RS_OK is success, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_phone_init(const char *product_id, const char *device_name, const char *psk);
+
+/**
+ * @brief talk to the device over another link, e.g. the socket of llsync_host_daemon
+ * @param link the link, NULL restores the loopback
+ * @param user passed to the functions of the link
+ * @note  call it before ble_qiot_phone_init(), the notifications received by the link are passed to
+ * ble_qiot_phone_notify()
+ */
+void ble_qiot_phone_set_link(const ble_qiot_phone_link *link, void *user);
+
+/**
+ * @brief a notification of the event characteristic received by the link
+ */
+void ble_qiot_phone_notify(const uint8_t *buf, uint16_t len);
+
+/**
+ * @brief reply the property reports and the event posts automatically, default is true
+ */
+void ble_qiot_phone_auto_reply(bool enable);
+
+/**
+ * @brief bind the device, the device must be connected by ble_qiot_phone_link_up()
+ * @return BLE_QIOT_RS_OK is success, BLE_QIOT_RS_VALID_SIGN_ERR if the device sign is wrong, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_phone_bind(void);
+
+/**
+ * @brief connect the ble link, the gap connect event of the device
+ */
+void ble_qiot_phone_link_up(void);
+
+/**
+ * @brief disconnect the ble link, the gap disconnect event of the device
+ */
+void ble_qiot_phone_link_down(void);
+
+/**
+ * @brief authenticate the connection of a bound device and set the mtu
+ * @return BLE_QIOT_RS_OK is success, BLE_QIOT_RS_VALID_SIGN_ERR if the device sign is wrong, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_phone_connect(void);
+
+/**
+ * @brief unbind the device
+ * @return BLE_QIOT_RS_OK is success, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_phone_unbind(void);
+
+/**
+ * @brief append a tlv to a message
+ * @param type  BLE_QIOT_DATA_TYPE_XXX, the 2 bytes length is added for string, struct and array
+ * @param val   the value in network byte order
+ * @return the length appended, negative if the buffer is not enough
+ */
+int ble_qiot_phone_tlv_put(uint8_t *buf, uint16_t buf_len, uint8_t type, uint8_t id, const void *val,
+                           uint16_t val_len);
+
+/**
+ * @brief control the properties and wait for the reply
+ * @param tlv the properties built by ble_qiot_phone_tlv_put()
+ * @return the result replied, BLE_QIOT_REPLY_SUCCESS or the error, negative if no reply
+ */
+int ble_qiot_phone_control(const uint8_t *tlv, uint16_t tlv_len);
+
+/**
+ * @brief call an action and wait for the reply
+ * @param output the reply, 1 byte result + 1 byte action id + the output tlv, can be NULL
+ * @return the length of the reply, negative if no reply
+ */
+int ble_qiot_phone_action(uint8_t action_id, const uint8_t *tlv, uint16_t tlv_len, uint8_t *output,
+                          uint16_t output_len);
+
+/**
+ * @brief send a message with the 3 bytes header, type + 2 bytes length, sliced by the mtu
+ * @param char_uuid IOT_BLE_UUID_DEVICE_INFO, IOT_BLE_UUID_DATA or IOT_BLE_UUID_OTA
+ * @return BLE_QIOT_RS_OK is success, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_phone_send(uint16_t char_uuid, uint8_t type, const uint8_t *payload,
+                                          uint16_t payload_len);
+
+/**
+ * @brief wait for a notification and remove it from the queue
+ * @param type       BLE_QIOT_EVENT_UP_XXX
+ * @param buf        the payload after the 3 bytes header, can be NULL
+ * @param timeout_ms 0 only checks the queue
+ * @return the length of the payload, negative if timeout
+ */
+int ble_qiot_phone_wait(uint8_t type, uint8_t *buf, uint16_t buf_len, uint32_t timeout_ms);
+
+/**
+ * @brief drop the notifications queued
+ */
+void ble_qiot_phone_flush(void);
+
+/**
+ * @brief download a file to the device by ota, the lost packages are sent again as the device requests
+ * @return BLE_QIOT_RS_OK if the device checked the file, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_phone_ota(const uint8_t *file, uint32_t file_size, const char *version);
+
+/**
+ * @brief copy the counters of the phone
+ */
+void ble_qiot_phone_stats_get(ble_qiot_phone_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_HOST_PHONE_H
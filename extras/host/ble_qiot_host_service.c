@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// linux implementation of the ble service imports, the gatt link is a loopback to an in-process remote
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_SERVICE_LEVEL
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "ble_qiot_dispatch.h"
+#include "ble_qiot_export.h"
+#include "ble_qiot_import.h"
+#include "ble_qiot_log.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_dev.h"
+
+// the services are the same for all the devices
+static const qiot_service_init_s *sg_host_service = NULL;
+
+void ble_services_add(const qiot_service_init_s *p_service)
+{
+    sg_host_service = p_service;
+}
+
+ble_qiot_ret_status_t ble_advertising_start(adv_info_s *adv)
+{
+    ble_qiot_host_dev_t *dev = ble_host_dev();
+    uint8_t              len = 0;
+
+    pthread_mutex_lock(&dev->adv_lock);
+    memcpy(dev->adv_data, &adv->manufacturer_info.company_identifier, sizeof(uint16_t));
+    len = sizeof(uint16_t);
+    if (adv->manufacturer_info.adv_data_len > sizeof(dev->adv_data) - len) {
+        pthread_mutex_unlock(&dev->adv_lock);
+        ble_qiot_log_e("adv data too long: %d", adv->manufacturer_info.adv_data_len);
+        return BLE_QIOT_RS_ERR_PARA;
+    }
+    memcpy(dev->adv_data + len, adv->manufacturer_info.adv_data, adv->manufacturer_info.adv_data_len);
+    dev->adv_len = len + adv->manufacturer_info.adv_data_len;
+    pthread_mutex_unlock(&dev->adv_lock);
+
+    return BLE_QIOT_RS_OK;
+}
+
+ble_qiot_ret_status_t ble_advertising_stop(void)
+{
+    ble_qiot_host_dev_t *dev = ble_host_dev();
+
+    pthread_mutex_lock(&dev->adv_lock);
+    dev->adv_len = 0;
+    pthread_mutex_unlock(&dev->adv_lock);
+
+    return BLE_QIOT_RS_OK;
+}
+
+int ble_qiot_host_adv_get(uint8_t *buf, uint8_t buf_len)
+{
+    ble_qiot_host_dev_t *dev = ble_host_dev();
+    int                  len = 0;
+
+    pthread_mutex_lock(&dev->adv_lock);
+    len = dev->adv_len > buf_len ? buf_len : dev->adv_len;
+    memcpy(buf, dev->adv_data, len);
+    pthread_mutex_unlock(&dev->adv_lock);
+
+    return len;
+}
+
+void ble_qiot_host_set_notify_cb(ble_qiot_host_notify_cb cb, void *user)
+{
+    ble_qiot_host_dev_t *dev = ble_host_dev();
+
+    dev->notify_user = user;
+    __atomic_store_n(&dev->notify_cb, cb, __ATOMIC_RELEASE);
+}
+
+ble_qiot_ret_status_t ble_send_notify(uint8_t *buf, uint8_t len)
+{
+    ble_qiot_host_dev_t *   dev = ble_host_dev();
+    ble_qiot_host_notify_cb cb  = __atomic_load_n(&dev->notify_cb, __ATOMIC_ACQUIRE);
+
+    // nobody subscribes the notification, the same as a remote not connected
+    if (NULL == cb) {
+        return BLE_QIOT_RS_ERR;
+    }
+    cb(buf, len, dev->notify_user);
+
+    return BLE_QIOT_RS_OK;
+}
+
+// the gap events of a real stack come after the writes received before them, handle the writes queued first
+static void ble_host_dispatch_drain(void)
+{
+#if BLE_QIOT_DISPATCH_ENABLE
+    while (ble_qiot_dispatch_pending()) {
+        sched_yield();
+    }
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+}
+
+void ble_qiot_host_connect(void)
+{
+    ble_host_dispatch_drain();
+    ble_gap_connect_cb();
+}
+
+void ble_qiot_host_disconnect(void)
+{
+    ble_host_dispatch_drain();
+    ble_gap_disconnect_cb();
+    ble_qiot_advertising_start();
+}
+
+void ble_qiot_host_mtu_exchange(uint16_t att_mtu)
+{
+    ble_host_dispatch_drain();
+    ble_event_sync_mtu(att_mtu);
+}
+
+ble_qiot_ret_status_t ble_qiot_host_write(uint16_t char_uuid, const uint8_t *buf, uint16_t len)
+{
+    const qiot_char_s *p_char = NULL;
+
+    if (NULL == sg_host_service) {
+        ble_qiot_log_e("services not added");
+        return BLE_QIOT_RS_ERR;
+    }
+    if (char_uuid == sg_host_service->device_info.uuid16) {
+        p_char = &sg_host_service->device_info;
+    } else if (char_uuid == sg_host_service->data.uuid16) {
+        p_char = &sg_host_service->data;
+    } else if (char_uuid == sg_host_service->ota.uuid16) {
+        p_char = &sg_host_service->ota;
+    }
+    if (NULL == p_char || NULL == p_char->on_write) {
+        ble_qiot_log_e("write to unknown characteristic 0x%04x", char_uuid);
+        return BLE_QIOT_RS_ERR_PARA;
+    }
+    // the core waits for a free buffer of the dispatch queue
+    p_char->on_write(buf, len);
+
+    return BLE_QIOT_RS_OK;
+}
+
+// called by LLsync::Start(), the same entry as the esp32 port
+void ble_qiot_service_init(void)
+{
+    if (BLE_QIOT_RS_OK != ble_qiot_explorer_init()) {
+        ble_qiot_log_e("llsync init failed");
+        return;
+    }
+    ble_qiot_advertising_start();
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// the frames on the socket of llsync_host_daemon
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "ble_qiot_host_sock.h"
+#include "ble_qiot_utils_base64.h"
+
+ble_qiot_ret_status_t ble_qiot_host_sock_send(int fd, uint8_t op, uint16_t arg, const uint8_t *data, uint16_t len)
+{
+    uint8_t       header[BLE_QIOT_HOST_SOCK_HEADER_LEN];
+    struct iovec  iov[2];
+    struct msghdr msg;
+    struct pollfd pfd;
+    ssize_t       ret = 0;
+
+    if (len > BLE_QIOT_HOST_SOCK_DATA_MAX) {
+        return BLE_QIOT_RS_ERR_PARA;
+    }
+    header[0] = len >> 8;
+    header[1] = len;
+    header[2] = op;
+    header[3] = arg >> 8;
+    header[4] = arg;
+
+    iov[0].iov_base = header;
+    iov[0].iov_len  = sizeof(header);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len  = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = len ? 2 : 1;
+    while (msg.msg_iovlen) {
+        ret = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            if (EAGAIN != errno) {
+                return BLE_QIOT_RS_ERR;
+            }
+            // the peer reads slower than the device sends, wait like the link layer flow control
+            pfd.fd     = fd;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, BLE_QIOT_HOST_SOCK_SEND_TIMEOUT) <= 0) {
+                return BLE_QIOT_RS_ERR;
+            }
+            continue;
+        }
+        // skip what is sent
+        while (msg.msg_iovlen && (size_t)ret >= msg.msg_iov->iov_len) {
+            ret -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen) {
+            msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + ret;
+            msg.msg_iov->iov_len -= ret;
+        }
+    }
+
+    return BLE_QIOT_RS_OK;
+}
+
+int ble_qiot_host_sock_parse(const uint8_t *buf, int len, ble_qiot_host_sock_frame *frame)
+{
+    uint16_t data_len = 0;
+
+    if (len < BLE_QIOT_HOST_SOCK_HEADER_LEN) {
+        return 0;
+    }
+    data_len = (buf[0] << 8) | buf[1];
+    if (data_len > BLE_QIOT_HOST_SOCK_DATA_MAX) {
+        return -1;
+    }
+    if (len < BLE_QIOT_HOST_SOCK_HEADER_LEN + data_len) {
+        return 0;
+    }
+    frame->op   = buf[2];
+    frame->arg  = (buf[3] << 8) | buf[4];
+    frame->len  = data_len;
+    frame->data = buf + BLE_QIOT_HOST_SOCK_HEADER_LEN;
+
+    return BLE_QIOT_HOST_SOCK_HEADER_LEN + data_len;
+}
+
+void ble_qiot_host_sock_identity(uint16_t index, char *device_name, char *psk, uint8_t *mac)
+{
+    uint8_t  secret[BLE_QIOT_PSK_LEN / 4 * 3];
+    uint32_t seed    = 0x9E3779B9u * (index + 1);
+    size_t   psk_len = 0;
+    size_t   i       = 0;
+
+    snprintf(device_name, BLE_QIOT_DEVICE_NAME_LEN + 1, "sim_%05u", index);
+    // xorshift, the secret only has to differ between the devices
+    for (i = 0; i < sizeof(secret); i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        secret[i] = seed;
+    }
+    qcloud_iot_utils_base64encode((unsigned char *)psk, BLE_QIOT_PSK_LEN + 1, &psk_len, secret, sizeof(secret));
+    psk[psk_len] = '\0';
+    mac[0]       = 0x02;  // locally administered
+    mac[1]       = 0x51;
+    mac[2]       = 0x4D;
+    mac[3]       = 0x00;
+    mac[4]       = index >> 8;
+    mac[5]       = index;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef QCLOUD_BLE_QIOT_HOST_SOCK_H
+#define QCLOUD_BLE_QIOT_HOST_SOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "ble_qiot_common.h"
+#include "ble_qiot_export.h"
+
+// the frames between llsync_host_daemon and the phones on its unix stream socket. a connection is the radio of one
+// phone, it selects a simulated device by ATTACH and then works like the ble link to it:
+// [2 bytes data length][1 byte op][2 bytes arg][data], the numbers are in network order
+#define BLE_QIOT_HOST_SOCK_HEADER_LEN   5
+#define BLE_QIOT_HOST_SOCK_DATA_MAX     1024  // larger than any att value
+#define BLE_QIOT_HOST_SOCK_SEND_TIMEOUT 1000  // the wait for the peer reading, unit: ms
+
+typedef enum {
+    // the phone to the daemon
+    BLE_QIOT_HOST_SOCK_ATTACH = 0x01,  // arg is the device index, the daemon replies ADV or ERROR
+    BLE_QIOT_HOST_SOCK_CONNECT,        // the gap connect event
+    BLE_QIOT_HOST_SOCK_DISCONNECT,     // the gap disconnect event, the socket closed is the same
+    BLE_QIOT_HOST_SOCK_MTU,            // arg is the att mtu exchanged
+    BLE_QIOT_HOST_SOCK_WRITE,          // arg is the uuid of the characteristic, data is the value
+
+    // the daemon to the phone
+    BLE_QIOT_HOST_SOCK_ADV = 0x81,  // data is the manufacturer data advertised, empty if not advertising
+    BLE_QIOT_HOST_SOCK_NOTIFY,      // data is a notification of the event characteristic
+    BLE_QIOT_HOST_SOCK_ERROR,       // arg is the ble_qiot_ret_status_t of the attach, the daemon closes the socket
+} e_ble_qiot_host_sock_op;
+
+typedef struct {
+    uint8_t        op;
+    uint16_t       arg;
+    uint16_t       len;
+    const uint8_t *data;
+} ble_qiot_host_sock_frame;
+
+/**
+ * @brief send a frame, waits BLE_QIOT_HOST_SOCK_SEND_TIMEOUT at most if the socket is full
+ * @return BLE_QIOT_RS_OK is success, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_host_sock_send(int fd, uint8_t op, uint16_t arg, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief parse a frame at the start of the buffer received
+ * @param frame the frame, the data points into buf
+ * @return the length of the frame, 0 if the frame is not complete, negative if the frame is broken
+ */
+int ble_qiot_host_sock_parse(const uint8_t *buf, int len, ble_qiot_host_sock_frame *frame);
+
+/**
+ * @brief the identity of the simulated device of an index, known by both the daemon and the phones
+ * @param device_name BLE_QIOT_DEVICE_NAME_LEN + 1 bytes
+ * @param psk         BLE_QIOT_PSK_LEN + 1 bytes, the base64 device secret
+ * @param mac         BLE_QIOT_MAC_LEN bytes
+ */
+void ble_qiot_host_sock_identity(uint16_t index, char *device_name, char *psk, uint8_t *mac);
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_HOST_SOCK_H
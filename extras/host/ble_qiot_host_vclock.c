@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// the virtual clock of the host port: a discrete event scheduler, the timers and the events posted are kept in a min
+// heap by deadline and fired by the thread advancing the clock, nothing runs in the background
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_DEVICE_LEVEL
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ble_qiot_common.h"
+#include "ble_qiot_export.h"
+#include "ble_qiot_import.h"
+#include "ble_qiot_log.h"
+#include "ble_qiot_param_check.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_dev.h"
+
+typedef struct {
+    uint64_t        deadline;  // unit: us
+    uint64_t        seq;       // the order of the starts, the timers due at the same time fire in this order
+    uint64_t        period;    // unit: us
+    int             index;     // the position in the heap, -1 if stopped
+    uint8_t         type;
+    ble_timer_cb    handle;
+    ble_qiot_ctx_t *ctx;  // the device which created the timer
+    void (*event)(void *user);  // a posted event instead of a timer, freed after called
+    void *user;
+} ble_host_vtimer;
+
+static pthread_mutex_t   sg_vclock_lock     = PTHREAD_MUTEX_INITIALIZER;
+static bool              sg_vclock_enabled  = false;
+static uint64_t          sg_vclock_now      = 0;  // unit: us
+static uint64_t          sg_vclock_seq      = 0;
+static uint64_t          sg_vclock_real     = 0;  // the monotonic clock when enabled, unit: us
+static ble_host_vtimer **sg_vclock_heap     = NULL;
+static int               sg_vclock_heap_num = 0;
+static int               sg_vclock_heap_cap = 0;
+
+static uint64_t ble_vclock_real_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool ble_vclock_before(const ble_host_vtimer *a, const ble_host_vtimer *b)
+{
+    return a->deadline < b->deadline || (a->deadline == b->deadline && a->seq < b->seq);
+}
+
+static void ble_vclock_heap_set(int index, ble_host_vtimer *p_timer)
+{
+    sg_vclock_heap[index] = p_timer;
+    p_timer->index        = index;
+}
+
+static void ble_vclock_sift_up(int index)
+{
+    ble_host_vtimer *p_timer = sg_vclock_heap[index];
+    int              parent  = 0;
+
+    while (index > 0) {
+        parent = (index - 1) / 2;
+        if (!ble_vclock_before(p_timer, sg_vclock_heap[parent])) {
+            break;
+        }
+        ble_vclock_heap_set(index, sg_vclock_heap[parent]);
+        index = parent;
+    }
+    ble_vclock_heap_set(index, p_timer);
+}
+
+static void ble_vclock_sift_down(int index)
+{
+    ble_host_vtimer *p_timer = sg_vclock_heap[index];
+    int              child   = 0;
+
+    for (;;) {
+        child = index * 2 + 1;
+        if (child >= sg_vclock_heap_num) {
+            break;
+        }
+        if (child + 1 < sg_vclock_heap_num && ble_vclock_before(sg_vclock_heap[child + 1], sg_vclock_heap[child])) {
+            child++;
+        }
+        if (!ble_vclock_before(sg_vclock_heap[child], p_timer)) {
+            break;
+        }
+        ble_vclock_heap_set(index, sg_vclock_heap[child]);
+        index = child;
+    }
+    ble_vclock_heap_set(index, p_timer);
+}
+
+// called with the lock held
+static ble_qiot_ret_status_t ble_vclock_push(ble_host_vtimer *p_timer)
+{
+    ble_host_vtimer **heap = NULL;
+    int               cap  = sg_vclock_heap_cap ? sg_vclock_heap_cap * 2 : 16;
+
+    if (sg_vclock_heap_num == sg_vclock_heap_cap) {
+        heap = realloc(sg_vclock_heap, cap * sizeof(ble_host_vtimer *));
+        if (NULL == heap) {
+            return BLE_QIOT_RS_ERR;
+        }
+        sg_vclock_heap     = heap;
+        sg_vclock_heap_cap = cap;
+    }
+    p_timer->seq = sg_vclock_seq++;
+    ble_vclock_heap_set(sg_vclock_heap_num++, p_timer);
+    ble_vclock_sift_up(p_timer->index);
+
+    return BLE_QIOT_RS_OK;
+}
+
+// called with the lock held
+static void ble_vclock_remove(ble_host_vtimer *p_timer)
+{
+    int              index = p_timer->index;
+    ble_host_vtimer *last  = NULL;
+
+    if (index < 0) {
+        return;
+    }
+    p_timer->index = -1;
+    last           = sg_vclock_heap[--sg_vclock_heap_num];
+    if (last == p_timer) {
+        return;
+    }
+    ble_vclock_heap_set(index, last);
+    if (index > 0 && ble_vclock_before(last, sg_vclock_heap[(index - 1) / 2])) {
+        ble_vclock_sift_up(index);
+    } else {
+        ble_vclock_sift_down(index);
+    }
+}
+
+ble_qiot_ret_status_t ble_qiot_host_vclock_enable(void)
+{
+    pthread_mutex_lock(&sg_vclock_lock);
+    sg_vclock_enabled = true;
+    sg_vclock_real    = ble_vclock_real_us();
+    pthread_mutex_unlock(&sg_vclock_lock);
+    // a dispatch worker would handle the writes while the clock moves
+    ble_qiot_host_dispatch_inline();
+
+    return BLE_QIOT_RS_OK;
+}
+
+bool ble_qiot_host_vclock_enabled(void)
+{
+    return sg_vclock_enabled;
+}
+
+uint64_t ble_qiot_host_vclock_now(void)
+{
+    uint64_t now = 0;
+
+    pthread_mutex_lock(&sg_vclock_lock);
+    now = sg_vclock_now;
+    pthread_mutex_unlock(&sg_vclock_lock);
+
+    return now;
+}
+
+bool ble_qiot_host_vclock_step(uint64_t until)
+{
+    ble_host_vtimer *p_timer = NULL;
+    ble_timer_cb     handle  = NULL;
+    ble_qiot_ctx_t * ctx     = NULL;
+
+    pthread_mutex_lock(&sg_vclock_lock);
+    if (0 == sg_vclock_heap_num || sg_vclock_heap[0]->deadline > until) {
+        if (until > sg_vclock_now) {
+            sg_vclock_now = until;
+        }
+        pthread_mutex_unlock(&sg_vclock_lock);
+        return false;
+    }
+    p_timer = sg_vclock_heap[0];
+    ble_vclock_remove(p_timer);
+    if (p_timer->deadline > sg_vclock_now) {
+        sg_vclock_now = p_timer->deadline;
+    }
+    // a periodic timer keeps its phase, the callback may stop or delete it
+    if (BLE_TIMER_PERIOD_TYPE == p_timer->type) {
+        p_timer->deadline += p_timer->period;
+        (void)ble_vclock_push(p_timer);
+    }
+    handle = p_timer->handle;
+    ctx    = p_timer->ctx;
+    pthread_mutex_unlock(&sg_vclock_lock);
+
+    ctx = ble_qiot_ctx_switch(ctx);
+    if (NULL != p_timer->event) {
+        p_timer->event(p_timer->user);
+        free(p_timer);
+    } else {
+        handle(p_timer);
+    }
+    (void)ble_qiot_ctx_switch(ctx);
+
+    return true;
+}
+
+uint32_t ble_qiot_host_vclock_advance(uint64_t us)
+{
+    uint64_t until = ble_qiot_host_vclock_now() + us;
+    uint32_t fired = 0;
+
+    while (ble_qiot_host_vclock_step(until)) {
+        fired++;
+    }
+
+    return fired;
+}
+
+void ble_qiot_host_vclock_consume(uint64_t us)
+{
+    pthread_mutex_lock(&sg_vclock_lock);
+    sg_vclock_now += us;
+    pthread_mutex_unlock(&sg_vclock_lock);
+}
+
+ble_qiot_ret_status_t ble_qiot_host_vclock_post(uint64_t delay, void (*event)(void *user), void *user)
+{
+    ble_host_vtimer *     p_timer = NULL;
+    ble_qiot_ret_status_t ret     = BLE_QIOT_RS_OK;
+
+    POINTER_SANITY_CHECK(event, BLE_QIOT_RS_ERR_PARA);
+    p_timer = calloc(1, sizeof(ble_host_vtimer));
+    if (NULL == p_timer) {
+        return BLE_QIOT_RS_ERR;
+    }
+    p_timer->type  = BLE_TIMER_ONE_SHOT_TYPE;
+    p_timer->ctx   = ble_qiot_ctx_current();
+    p_timer->event = event;
+    p_timer->user  = user;
+
+    pthread_mutex_lock(&sg_vclock_lock);
+    p_timer->deadline = sg_vclock_now + delay;
+    ret               = ble_vclock_push(p_timer);
+    pthread_mutex_unlock(&sg_vclock_lock);
+    if (BLE_QIOT_RS_OK != ret) {
+        free(p_timer);
+    }
+
+    return ret;
+}
+
+double ble_qiot_host_vclock_speed(void)
+{
+    uint64_t real = 0;
+    uint64_t now  = 0;
+
+    pthread_mutex_lock(&sg_vclock_lock);
+    real = ble_vclock_real_us() - sg_vclock_real;
+    now  = sg_vclock_now;
+    pthread_mutex_unlock(&sg_vclock_lock);
+
+    return real ? (double)now / real : 0;
+}
+
+ble_timer_t ble_host_vtimer_create(uint8_t type, ble_timer_cb timeout_handle)
+{
+    ble_host_vtimer *p_timer = calloc(1, sizeof(ble_host_vtimer));
+
+    if (NULL == p_timer) {
+        ble_qiot_log_e("create timer failed");
+        return NULL;
+    }
+    p_timer->type   = type;
+    p_timer->handle = timeout_handle;
+    p_timer->ctx    = ble_qiot_ctx_current();
+    p_timer->index  = -1;
+
+    return (ble_timer_t)p_timer;
+}
+
+ble_qiot_ret_status_t ble_host_vtimer_start(ble_timer_t timer_id, uint32_t period)
+{
+    ble_host_vtimer *     p_timer = (ble_host_vtimer *)timer_id;
+    ble_qiot_ret_status_t ret     = BLE_QIOT_RS_OK;
+
+    pthread_mutex_lock(&sg_vclock_lock);
+    ble_vclock_remove(p_timer);
+    p_timer->period   = (uint64_t)period * 1000;
+    p_timer->deadline = sg_vclock_now + p_timer->period;
+    ret               = ble_vclock_push(p_timer);
+    pthread_mutex_unlock(&sg_vclock_lock);
+
+    return ret;
+}
+
+ble_qiot_ret_status_t ble_host_vtimer_stop(ble_timer_t timer_id)
+{
+    pthread_mutex_lock(&sg_vclock_lock);
+    ble_vclock_remove((ble_host_vtimer *)timer_id);
+    pthread_mutex_unlock(&sg_vclock_lock);
+
+    return BLE_QIOT_RS_OK;
+}
+
+ble_qiot_ret_status_t ble_host_vtimer_delete(ble_timer_t timer_id)
+{
+    (void)ble_host_vtimer_stop(timer_id);
+    free(timer_id);
+
+    return BLE_QIOT_RS_OK;
+}
+
+#ifdef __cplusplus
+}
+#endif
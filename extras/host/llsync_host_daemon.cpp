@@ -0,0 +1,479 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// hosts simulated llsync devices for the phones on a unix socket, the frames are in ble_qiot_host_sock.h. each device
+// is a LLsync with its own context, thing model and flash. the connections are spread on the event loop threads, the
+// writes of a connection are handled in its loop thread like the ble task of a device
+// usage: llsync_host_daemon -s <socket> [-n devices] [-t threads] [-m model.json] [-p product id] [-f flash dir]
+//                           [-i stats interval in s] [-v]
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "LLsync.h"
+#include "core/ble_qiot_common.h"
+#include "core/ble_qiot_context.h"
+#include "core/ble_qiot_llsync_device.h"
+#include "core/ble_qiot_log.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_sock.h"
+
+#define SIM_PRODUCT_ID "SIMDEVICE1"
+#define SIM_EVENT_NUM  64
+
+static const char *SIM_MODEL =
+    "{\"version\":\"1.0\",\"properties\":["
+    "{\"id\":\"power_switch\",\"mode\":\"rw\",\"define\":{\"type\":\"bool\"}},"
+    "{\"id\":\"brightness\",\"mode\":\"rw\",\"define\":{\"type\":\"int\",\"min\":\"0\",\"max\":\"100\"}},"
+    "{\"id\":\"name\",\"mode\":\"rw\",\"define\":{\"type\":\"string\",\"min\":\"0\",\"max\":\"64\"}}"
+    "],\"events\":[],\"actions\":[]}";
+
+struct SimSession;
+
+struct SimDevice {
+    uint16_t        index;
+    LLsync *        llsync;
+    pthread_mutex_t lock;     // protects the session and the sending to it
+    SimSession *    session;  // the phone connected, NULL if none
+};
+
+struct SimSession {
+    int        fd;
+    SimDevice *dev;
+    int        inLen;
+    uint8_t    in[2 * (BLE_QIOT_HOST_SOCK_HEADER_LEN + BLE_QIOT_HOST_SOCK_DATA_MAX)];
+};
+
+struct SimStats {
+    uint64_t sessions;       // the phones attached
+    uint64_t sessionsEnded;  // the phones detached
+    uint64_t rejected;       // the attaches refused
+    uint64_t writes;
+    uint64_t notifications;
+    uint64_t sendFailed;     // the notifications lost because the phone did not read
+};
+
+// never freed, the loop threads run until the process exits
+static SimDevice *           sg_devices    = NULL;
+static int                   sg_device_num = 0;
+static int                   sg_listen_fd  = -1;
+static SimStats              sg_stats;
+static volatile sig_atomic_t sg_stop      = 0;
+static e_ble_qiot_log_level  sg_log_level = BLE_QIOT_LOG_LEVEL_WARN;
+
+#define SIM_STAT_INC(_field)  __atomic_add_fetch(&sg_stats._field, 1, __ATOMIC_RELAXED)
+#define SIM_STAT_LOAD(_field) __atomic_load_n(&sg_stats._field, __ATOMIC_RELAXED)
+
+static double sim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long sim_rss_kb(void)
+{
+    long  pages = 0;
+    FILE *fp    = fopen("/proc/self/statm", "r");
+
+    if (!fp)
+        return 0;
+    if (fscanf(fp, "%*s %ld", &pages) != 1)
+        pages = 0;
+    fclose(fp);
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// called with the device locked
+static void sim_send_locked(SimDevice *dev, uint8_t op, const uint8_t *data, uint16_t len)
+{
+    if (!dev->session)
+        return;
+    if (BLE_QIOT_RS_OK != ble_qiot_host_sock_send(dev->session->fd, op, 0, data, len)) {
+        SIM_STAT_INC(sendFailed);
+        // the loop thread sees the hang up and closes the session
+        shutdown(dev->session->fd, SHUT_RDWR);
+    }
+}
+
+// the notifications of a device, called in the loop thread of its session or in the timer thread
+static void sim_notify(const uint8_t *buf, uint16_t len, void *user)
+{
+    SimDevice *dev = (SimDevice *)user;
+
+    pthread_mutex_lock(&dev->lock);
+    if (dev->session)
+        SIM_STAT_INC(notifications);
+    sim_send_locked(dev, BLE_QIOT_HOST_SOCK_NOTIFY, buf, len);
+    pthread_mutex_unlock(&dev->lock);
+}
+
+static bool sim_attach(SimSession *s, uint16_t index)
+{
+    uint8_t    adv[31];
+    int        advLen = 0;
+    SimDevice *dev    = NULL;
+
+    if (s->dev || index >= sg_device_num) {
+        SIM_STAT_INC(rejected);
+        ble_qiot_host_sock_send(s->fd, BLE_QIOT_HOST_SOCK_ERROR, (uint16_t)BLE_QIOT_RS_ERR_PARA, NULL, 0);
+        return false;
+    }
+    dev = &sg_devices[index];
+    pthread_mutex_lock(&dev->lock);
+    if (dev->session) {
+        pthread_mutex_unlock(&dev->lock);
+        SIM_STAT_INC(rejected);
+        // a device talks to one phone at a time
+        ble_qiot_host_sock_send(s->fd, BLE_QIOT_HOST_SOCK_ERROR, (uint16_t)BLE_QIOT_RS_ERR, NULL, 0);
+        return false;
+    }
+    dev->session = s;
+    s->dev       = dev;
+    {
+        QiotCtxScope scope(dev->llsync->Context());
+        advLen = ble_qiot_host_adv_get(adv, sizeof(adv));
+    }
+    sim_send_locked(dev, BLE_QIOT_HOST_SOCK_ADV, adv, advLen);
+    pthread_mutex_unlock(&dev->lock);
+    SIM_STAT_INC(sessions);
+
+    return true;
+}
+
+static void sim_detach(SimSession *s)
+{
+    SimDevice *dev = s->dev;
+
+    if (!dev)
+        return;
+    // the notifications from now on are lost like on a link down
+    pthread_mutex_lock(&dev->lock);
+    dev->session = NULL;
+    pthread_mutex_unlock(&dev->lock);
+    {
+        QiotCtxScope scope(dev->llsync->Context());
+        if (ble_is_connected())
+            ble_qiot_host_disconnect();
+    }
+    s->dev = NULL;
+    SIM_STAT_INC(sessionsEnded);
+}
+
+static bool sim_frame_handle(SimSession *s, const ble_qiot_host_sock_frame &frame)
+{
+    if (BLE_QIOT_HOST_SOCK_ATTACH == frame.op)
+        return sim_attach(s, frame.arg);
+    if (!s->dev)
+        return false;
+
+    QiotCtxScope scope(s->dev->llsync->Context());
+    switch (frame.op) {
+        case BLE_QIOT_HOST_SOCK_CONNECT:
+            ble_qiot_host_connect();
+            break;
+        case BLE_QIOT_HOST_SOCK_DISCONNECT:
+            ble_qiot_host_disconnect();
+            break;
+        case BLE_QIOT_HOST_SOCK_MTU:
+            ble_qiot_host_mtu_exchange(frame.arg);
+            break;
+        case BLE_QIOT_HOST_SOCK_WRITE:
+            SIM_STAT_INC(writes);
+            ble_qiot_host_write(frame.arg, frame.data, frame.len);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+static void sim_session_close(int epfd, SimSession *s)
+{
+    sim_detach(s);
+    epoll_ctl(epfd, EPOLL_CTL_DEL, s->fd, NULL);
+    close(s->fd);
+    delete s;
+}
+
+// read what arrived and handle the complete frames, false if the session is over
+static bool sim_session_read(SimSession *s)
+{
+    ble_qiot_host_sock_frame frame;
+
+    for (;;) {
+        ssize_t n = read(s->fd, s->in + s->inLen, sizeof(s->in) - s->inLen);
+        if (n == 0)
+            return false;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN;
+        }
+        s->inLen += n;
+
+        int off = 0;
+        int ret = 0;
+        while ((ret = ble_qiot_host_sock_parse(s->in + off, s->inLen - off, &frame)) > 0) {
+            if (!sim_frame_handle(s, frame))
+                return false;
+            off += ret;
+        }
+        if (ret < 0)
+            return false;
+        s->inLen -= off;
+        memmove(s->in, s->in + off, s->inLen);
+    }
+}
+
+static void sim_accept(int epfd)
+{
+    struct epoll_event ev;
+
+    for (;;) {
+        int fd = accept4(sg_listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        SimSession *s = new SimSession();
+        s->fd         = fd;
+        s->dev        = NULL;
+        s->inLen      = 0;
+        ev.events     = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr   = s;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+            close(fd);
+            delete s;
+        }
+    }
+}
+
+// the loops share the listening socket, EPOLLEXCLUSIVE wakes one of them for a new phone
+static void *sim_loop(void *param)
+{
+    struct epoll_event events[SIM_EVENT_NUM];
+    struct epoll_event ev;
+    int                epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    ev.events   = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = NULL;
+    if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, sg_listen_fd, &ev)) {
+        perror("epoll");
+        exit(1);
+    }
+    for (;;) {
+        int count = epoll_wait(epfd, events, SIM_EVENT_NUM, -1);
+        for (int i = 0; i < count; i++) {
+            SimSession *s = (SimSession *)events[i].data.ptr;
+            if (!s) {
+                sim_accept(epfd);
+                continue;
+            }
+            if ((events[i].events & (EPOLLERR | EPOLLHUP)) || !sim_session_read(s))
+                sim_session_close(epfd, s);
+        }
+    }
+    return NULL;
+}
+
+static bool sim_devices_create(int num, const std::string &model, const char *productId, const char *flashDir)
+{
+    char    deviceName[BLE_QIOT_DEVICE_NAME_LEN + 1];
+    char    psk[BLE_QIOT_PSK_LEN + 1];
+    uint8_t mac[BLE_QIOT_MAC_LEN];
+
+    sg_devices    = new SimDevice[num];
+    sg_device_num = num;
+    for (int i = 0; i < num; i++) {
+        SimDevice &dev = sg_devices[i];
+        dev.index      = i;
+        dev.session    = NULL;
+        pthread_mutex_init(&dev.lock, NULL);
+        dev.llsync = new LLsync();
+        ble_qiot_host_sock_identity(i, deviceName, psk, mac);
+        if (!dev.llsync->Context() || !ble_qiot_host_dev_create(dev.llsync->Context(), mac)) {
+            fprintf(stderr, "device %d: out of memory\n", i);
+            return false;
+        }
+        dev.llsync->set_product_id(productId);
+        dev.llsync->set_device_name(deviceName);
+        dev.llsync->set_device_secret(psk);
+        if (!dev.llsync->thingModel().Load(model.c_str())) {
+            fprintf(stderr, "device %d: load thing model failed\n", i);
+            return false;
+        }
+
+        QiotCtxScope scope(dev.llsync->Context());
+        if (flashDir) {
+            std::string path = std::string(flashDir) + "/" + deviceName + ".flash";
+            if (BLE_QIOT_RS_OK != ble_qiot_host_flash_open(path.c_str()))
+                return false;
+        }
+        ble_qiot_host_set_notify_cb(sim_notify, &dev);
+        dev.llsync->Start();
+        // the init of the stack sets the level to info
+        ble_qiot_set_log_level(sg_log_level);
+    }
+    return true;
+}
+
+static void sim_stats_print(double start, double &last, SimStats &prev)
+{
+    SimStats cur;
+    double   now = sim_now();
+
+    cur.sessions      = SIM_STAT_LOAD(sessions);
+    cur.sessionsEnded = SIM_STAT_LOAD(sessionsEnded);
+    cur.rejected      = SIM_STAT_LOAD(rejected);
+    cur.writes        = SIM_STAT_LOAD(writes);
+    cur.notifications = SIM_STAT_LOAD(notifications);
+    cur.sendFailed    = SIM_STAT_LOAD(sendFailed);
+    printf("%8.1fs active %llu sessions %llu (%.1f/s) rejected %llu writes %llu (%.1f/s) notifications %llu lost "
+           "%llu rss %ld KB\n",
+           now - start, (unsigned long long)(cur.sessions - cur.sessionsEnded), (unsigned long long)cur.sessions,
+           (cur.sessions - prev.sessions) / (now - last), (unsigned long long)cur.rejected,
+           (unsigned long long)cur.writes, (cur.writes - prev.writes) / (now - last),
+           (unsigned long long)cur.notifications, (unsigned long long)cur.sendFailed, sim_rss_kb());
+    fflush(stdout);
+    prev = cur;
+    last = now;
+}
+
+static void sim_signal(int sig)
+{
+    sg_stop = 1;
+}
+
+static void sim_usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s -s <socket> [-n devices] [-t threads] [-m model.json] [-p product id] [-f flash dir]\n"
+            "          [-i stats interval in s] [-v]\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *       sockPath  = NULL;
+    const char *       productId = SIM_PRODUCT_ID;
+    const char *       flashDir  = NULL;
+    std::string        model     = SIM_MODEL;
+    int                num       = 16;
+    int                threads   = sysconf(_SC_NPROCESSORS_ONLN);
+    int                interval  = 5;
+    bool               verbose   = false;
+    int                opt       = 0;
+    struct sockaddr_un addr;
+
+    while ((opt = getopt(argc, argv, "s:n:t:m:p:f:i:v")) != -1) {
+        switch (opt) {
+            case 's':
+                sockPath = optarg;
+                break;
+            case 'n':
+                num = atoi(optarg);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'm': {
+                std::ifstream     file(optarg);
+                std::stringstream ss;
+                ss << file.rdbuf();
+                model = ss.str();
+                break;
+            }
+            case 'p':
+                productId = optarg;
+                break;
+            case 'f':
+                flashDir = optarg;
+                break;
+            case 'i':
+                interval = atoi(optarg);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                sim_usage(argv[0]);
+        }
+    }
+    if (!sockPath || num <= 0 || num > 65536 || threads <= 0 || interval <= 0 ||
+        strlen(productId) != BLE_QIOT_PRODUCT_ID_LEN || strlen(sockPath) >= sizeof(addr.sun_path))
+        sim_usage(argv[0]);
+
+    if (verbose)
+        sg_log_level = BLE_QIOT_LOG_LEVEL_INFO;
+    ble_qiot_set_log_level(sg_log_level);
+    // the writes come from all the loop threads, the dispatch queue has a single producer
+    ble_qiot_host_dispatch_inline();
+    if (flashDir)
+        mkdir(flashDir, 0755);
+
+    long   rss   = sim_rss_kb();
+    double start = sim_now();
+    if (!sim_devices_create(num, model, productId, flashDir))
+        return 1;
+    printf("%d devices started in %.3f s, %ld KB each, context %zu bytes, session %zu bytes\n", num,
+           sim_now() - start, (sim_rss_kb() - rss) / num, sizeof(ble_qiot_ctx_t), sizeof(SimSession));
+
+    sg_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sockPath);
+    unlink(sockPath);
+    if (sg_listen_fd < 0 || bind(sg_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(sg_listen_fd, SOMAXCONN)) {
+        perror(sockPath);
+        return 1;
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, sim_loop, NULL)) {
+            perror("pthread_create");
+            return 1;
+        }
+        pthread_detach(thread);
+    }
+    printf("serving on %s with %d threads\n", sockPath, threads);
+    fflush(stdout);
+
+    signal(SIGINT, sim_signal);
+    signal(SIGTERM, sim_signal);
+    signal(SIGPIPE, SIG_IGN);
+    SimStats prev;
+    double   last = sim_now();
+    memset(&prev, 0, sizeof(prev));
+    start = last;
+    while (!sg_stop) {
+        for (int i = 0; i < interval * 10 && !sg_stop; i++)
+            usleep(100 * 1000);
+        sim_stats_print(start, last, prev);
+    }
+    unlink(sockPath);
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// runs the whole stack on linux against the simulated phone: bind, connect, control, ota and unbind
+// usage: llsync_host_demo [flash file or ""] [ota size in KB] [vclock]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "LLsync.h"
+#include "core/ble_qiot_common.h"
+#include "core/ble_qiot_template.h"
+#include "ble_qiot_host.h"
+#include "ble_qiot_host_phone.h"
+
+#define DEMO_PRODUCT_ID  "HOSTDEMO01"
+#define DEMO_DEVICE_NAME "host_light"
+#define DEMO_PSK         "MTIzNDU2Nzg5MDEyMzQ1Ng=="
+
+static const char *DEMO_MODEL =
+    "{\"version\":\"1.0\",\"properties\":["
+    "{\"id\":\"power_switch\",\"mode\":\"rw\",\"define\":{\"type\":\"bool\"}},"
+    "{\"id\":\"brightness\",\"mode\":\"rw\",\"define\":{\"type\":\"int\",\"min\":\"0\",\"max\":\"100\"}},"
+    "{\"id\":\"name\",\"mode\":\"rw\",\"define\":{\"type\":\"string\",\"min\":\"0\",\"max\":\"64\"}}"
+    "],\"events\":[],\"actions\":[]}";
+
+static double demo_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define DEMO_CHECK(_expr)                                        \
+    do {                                                         \
+        int _ret = (_expr);                                      \
+        if (_ret) {                                              \
+            printf("%s failed: %d\n", #_expr, _ret);             \
+            return 1;                                            \
+        }                                                        \
+    } while (0)
+
+int main(int argc, char **argv)
+{
+    const char *flash    = argc > 1 && argv[1][0] ? argv[1] : NULL;  // "" for the anonymous flash
+    uint32_t    ota_size = (argc > 2 ? atoi(argv[2]) : 256) * 1024;
+    LLsync *    llsync   = LLsync::GetInstance();
+    uint8_t     tlv[64];
+    int         tlv_len    = 0;
+    uint8_t     power      = 1;
+    uint32_t    brightness = HTONL(80);
+    int         changed    = 0;
+
+    // the timers run on the virtual clock, the waits of the phone move it instead of sleeping
+    if (argc > 3 && !strcmp(argv[3], "vclock")) {
+        DEMO_CHECK(ble_qiot_host_vclock_enable());
+    }
+    DEMO_CHECK(ble_qiot_host_flash_open(flash));
+    llsync->set_product_id(DEMO_PRODUCT_ID);
+    llsync->set_device_name(DEMO_DEVICE_NAME);
+    llsync->set_device_secret(DEMO_PSK);
+    if (!llsync->thingModel().Load(DEMO_MODEL)) {
+        printf("load thing model failed\n");
+        return 1;
+    }
+    QiotDataHandler handler = [&changed](QiotData &property) { changed++; };
+    llsync->thingModel().AddPropertyHandler(&handler);
+    llsync->Start();
+
+    DEMO_CHECK(ble_qiot_phone_init(DEMO_PRODUCT_ID, DEMO_DEVICE_NAME, DEMO_PSK));
+    ble_qiot_phone_link_up();
+    DEMO_CHECK(ble_qiot_phone_bind());
+    DEMO_CHECK(ble_qiot_phone_connect());
+    printf("bound and connected\n");
+
+    tlv_len += ble_qiot_phone_tlv_put(tlv + tlv_len, sizeof(tlv) - tlv_len, BLE_QIOT_DATA_TYPE_BOOL, 0, &power,
+                                      sizeof(power));
+    tlv_len += ble_qiot_phone_tlv_put(tlv + tlv_len, sizeof(tlv) - tlv_len, BLE_QIOT_DATA_TYPE_INT, 1, &brightness,
+                                      sizeof(brightness));
+    tlv_len += ble_qiot_phone_tlv_put(tlv + tlv_len, sizeof(tlv) - tlv_len, BLE_QIOT_DATA_TYPE_STRING, 2, "desk", 4);
+    DEMO_CHECK(ble_qiot_phone_control(tlv, tlv_len));
+    printf("control replied, %d properties changed\n", changed);
+
+    if (ota_size) {
+        std::vector<uint8_t> file(ota_size);
+        unsigned             seed = 1;
+        for (auto &b : file) {
+            b = rand_r(&seed);
+        }
+        double start = demo_now();
+        DEMO_CHECK(ble_qiot_phone_ota(file.data(), file.size(), "0.0.5"));
+        double cost = demo_now() - start;
+        printf("ota %u bytes in %.3f s, %.1f KB/s, result %d\n", ota_size, cost, ota_size / cost / 1024,
+               ble_qiot_host_ota_result());
+    }
+
+    DEMO_CHECK(ble_qiot_phone_unbind());
+    ble_qiot_phone_link_down();
+
+#if BLE_QIOT_METRICS_ENABLE
+    ble_qiot_metrics metrics;
+    llsync->GetMetrics(metrics);
+    for (int i = 0; i < BLE_QIOT_METRIC_BUTT; i++) {
+        if (metrics.counter[i]) {
+            printf("%-24s %u\n", ble_qiot_metric_name(i), metrics.counter[i]);
+        }
+    }
+#endif
+#if BLE_QIOT_STACK_ENABLE
+    ble_qiot_stack_stats stack;
+    for (int i = 0; i < BLE_QIOT_STACK_BUTT; i++) {
+        if (llsync->GetStackUsage(i, stack) && stack.calls) {
+            printf("stack %-18s %6u bytes, %u calls%s\n", ble_qiot_stack_entry_name(i), stack.max, stack.calls,
+                   stack.saturated ? ", saturated" : "");
+        }
+    }
+#endif
+    ble_qiot_phone_stats stats;
+    ble_qiot_phone_stats_get(&stats);
+    printf("phone: %u writes, %u bytes, %u notifications, %u messages, %u dropped\n", stats.writes,
+           stats.write_bytes, stats.frames, stats.messages, stats.dropped);
+    if (ble_qiot_host_vclock_enabled()) {
+        printf("virtual clock: %.3f s simulated, %.1f simulated s per real s\n",
+               ble_qiot_host_vclock_now() / 1e6, ble_qiot_host_vclock_speed());
+    }
+    ble_qiot_host_flash_close();
+
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+// drives llsync_host_daemon with simulated phones: each worker process is a phone, it walks its share of the devices
+// and binds, connects, controls and unbinds each of them. prints the sessions per second and the session latency
+// usage: llsync_host_load -s <socket> [-n devices] [-w workers] [-d duration in s] [-c controls] [-p product id]
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "ble_qiot_common.h"
+#include "ble_qiot_log.h"
+#include "ble_qiot_template.h"
+#include "ble_qiot_host_phone.h"
+#include "ble_qiot_host_sock.h"
+
+#define LOAD_PRODUCT_ID "SIMDEVICE1"
+#define LOAD_FAILED     (-1.0)  // the latency reported for a session failed
+
+typedef struct {
+    const char *sock_path;
+    const char *product_id;
+    int         devices;
+    int         workers;
+    int         duration;
+    int         controls;
+} load_conf;
+
+static double load_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static ble_qiot_ret_status_t load_link_write(uint16_t char_uuid, const uint8_t *buf, uint16_t len, void *user)
+{
+    return ble_qiot_host_sock_send(*(int *)user, BLE_QIOT_HOST_SOCK_WRITE, char_uuid, buf, len);
+}
+
+static void load_link_connect(void *user)
+{
+    ble_qiot_host_sock_send(*(int *)user, BLE_QIOT_HOST_SOCK_CONNECT, 0, NULL, 0);
+}
+
+static void load_link_disconnect(void *user)
+{
+    ble_qiot_host_sock_send(*(int *)user, BLE_QIOT_HOST_SOCK_DISCONNECT, 0, NULL, 0);
+}
+
+static void load_link_mtu_exchange(uint16_t att_mtu, void *user)
+{
+    ble_qiot_host_sock_send(*(int *)user, BLE_QIOT_HOST_SOCK_MTU, att_mtu, NULL, 0);
+}
+
+static const ble_qiot_phone_link sg_load_link = {
+    .write        = load_link_write,
+    .connect      = load_link_connect,
+    .disconnect   = load_link_disconnect,
+    .mtu_exchange = load_link_mtu_exchange,
+};
+
+static uint8_t sg_load_in[2 * (BLE_QIOT_HOST_SOCK_HEADER_LEN + BLE_QIOT_HOST_SOCK_DATA_MAX)];
+static int     sg_load_in_len   = 0;
+static int     sg_load_consumed = 0;  // the frame returned last, dropped on the next read
+
+// read the next frame from the daemon, the data stays valid until the next call
+static int load_read_frame(int fd, ble_qiot_host_sock_frame *frame)
+{
+    int     ret = 0;
+    ssize_t n   = 0;
+
+    sg_load_in_len -= sg_load_consumed;
+    memmove(sg_load_in, sg_load_in + sg_load_consumed, sg_load_in_len);
+    sg_load_consumed = 0;
+    while (0 == (ret = ble_qiot_host_sock_parse(sg_load_in, sg_load_in_len, frame))) {
+        n = read(fd, sg_load_in + sg_load_in_len, sizeof(sg_load_in) - sg_load_in_len);
+        if (n < 0 && EINTR == errno) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        sg_load_in_len += n;
+    }
+    sg_load_consumed = ret > 0 ? ret : 0;
+
+    return ret;
+}
+
+// pass the notifications of the device to the phone until the socket is closed
+static void *load_reader(void *param)
+{
+    ble_qiot_host_sock_frame frame;
+    int                      fd = *(int *)param;
+
+    while (load_read_frame(fd, &frame) > 0) {
+        if (BLE_QIOT_HOST_SOCK_NOTIFY == frame.op) {
+            ble_qiot_phone_notify(frame.data, frame.len);
+        }
+    }
+    return NULL;
+}
+
+static int load_attach(const load_conf *conf, uint16_t index)
+{
+    struct sockaddr_un       addr;
+    ble_qiot_host_sock_frame frame;
+    int                      fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, conf->sock_path, sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        goto err;
+    }
+    sg_load_in_len   = 0;
+    sg_load_consumed = 0;
+    if (BLE_QIOT_RS_OK != ble_qiot_host_sock_send(fd, BLE_QIOT_HOST_SOCK_ATTACH, index, NULL, 0) ||
+        load_read_frame(fd, &frame) <= 0 || BLE_QIOT_HOST_SOCK_ADV != frame.op) {
+        goto err;
+    }
+    return fd;
+
+err:
+    if (fd >= 0) {
+        close(fd);
+    }
+    return -1;
+}
+
+static int load_session(const load_conf *conf, uint16_t index)
+{
+    char      device_name[BLE_QIOT_DEVICE_NAME_LEN + 1];
+    char      psk[BLE_QIOT_PSK_LEN + 1];
+    uint8_t   mac[BLE_QIOT_MAC_LEN];
+    uint8_t   tlv[16];
+    int       tlv_len = 0;
+    int       ret     = BLE_QIOT_RS_ERR;
+    int       fd      = load_attach(conf, index);
+    pthread_t reader;
+    uint8_t   power      = 0;
+    uint32_t  brightness = 0;
+    int       i          = 0;
+
+    if (fd < 0) {
+        return BLE_QIOT_RS_ERR;
+    }
+    ble_qiot_host_sock_identity(index, device_name, psk, mac);
+    ble_qiot_phone_set_link(&sg_load_link, &fd);
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_init(conf->product_id, device_name, psk) ||
+        pthread_create(&reader, NULL, load_reader, &fd)) {
+        close(fd);
+        return BLE_QIOT_RS_ERR;
+    }
+
+    ble_qiot_phone_link_up();
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_bind() || BLE_QIOT_RS_OK != ble_qiot_phone_connect()) {
+        goto end;
+    }
+    for (i = 0; i < conf->controls; i++) {
+        power      = i & 1;
+        brightness = HTONL(i % 101);
+        tlv_len    = ble_qiot_phone_tlv_put(tlv, sizeof(tlv), BLE_QIOT_DATA_TYPE_BOOL, 0, &power, sizeof(power));
+        tlv_len += ble_qiot_phone_tlv_put(tlv + tlv_len, sizeof(tlv) - tlv_len, BLE_QIOT_DATA_TYPE_INT, 1,
+                                          &brightness, sizeof(brightness));
+        if (0 != ble_qiot_phone_control(tlv, tlv_len)) {
+            goto end;
+        }
+    }
+    if (BLE_QIOT_RS_OK != ble_qiot_phone_unbind()) {
+        goto end;
+    }
+    ret = BLE_QIOT_RS_OK;
+
+end:
+    ble_qiot_phone_link_down();
+    shutdown(fd, SHUT_RDWR);
+    pthread_join(reader, NULL);
+    close(fd);
+    return ret;
+}
+
+// a worker owns the devices worker, worker + workers, ... so no two phones ask for the same device
+static void load_worker(const load_conf *conf, int worker, int out)
+{
+    double end   = load_now() + conf->duration;
+    double start = 0;
+    double cost  = 0;
+    int    index = worker;
+
+    while (load_now() < end) {
+        start = load_now();
+        cost  = BLE_QIOT_RS_OK == load_session(conf, index) ? load_now() - start : LOAD_FAILED;
+        if (write(out, &cost, sizeof(cost)) != sizeof(cost)) {
+            break;
+        }
+        index += conf->workers;
+        if (index >= conf->devices) {
+            index = worker;
+        }
+    }
+}
+
+static int load_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void load_usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s -s <socket> [-n devices] [-w workers] [-d duration in s] [-c controls] [-p product id]\n",
+            name);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    load_conf conf     = {NULL, LOAD_PRODUCT_ID, 16, 4, 10, 4};
+    double *  costs    = NULL;
+    size_t    num      = 0;
+    size_t    cap      = 0;
+    int       failed   = 0;
+    int       pipefd[2];
+    double    cost  = 0;
+    double    start = 0;
+    double    total = 0;
+    int       opt   = 0;
+    int       i     = 0;
+
+    while ((opt = getopt(argc, argv, "s:n:w:d:c:p:")) != -1) {
+        switch (opt) {
+            case 's':
+                conf.sock_path = optarg;
+                break;
+            case 'n':
+                conf.devices = atoi(optarg);
+                break;
+            case 'w':
+                conf.workers = atoi(optarg);
+                break;
+            case 'd':
+                conf.duration = atoi(optarg);
+                break;
+            case 'c':
+                conf.controls = atoi(optarg);
+                break;
+            case 'p':
+                conf.product_id = optarg;
+                break;
+            default:
+                load_usage(argv[0]);
+        }
+    }
+    if (!conf.sock_path || conf.devices <= 0 || conf.devices > 65536 || conf.workers <= 0 ||
+        conf.workers > conf.devices || conf.duration <= 0 || conf.controls < 0) {
+        load_usage(argv[0]);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    ble_qiot_set_log_level(BLE_QIOT_LOG_LEVEL_WARN);
+    if (pipe(pipefd)) {
+        perror("pipe");
+        return 1;
+    }
+    start = load_now();
+    for (i = 0; i < conf.workers; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (0 == pid) {
+            close(pipefd[0]);
+            load_worker(&conf, i, pipefd[1]);
+            _exit(0);
+        }
+    }
+    close(pipefd[1]);
+
+    while (read(pipefd[0], &cost, sizeof(cost)) == sizeof(cost)) {
+        if (cost == LOAD_FAILED) {
+            failed++;
+            continue;
+        }
+        if (num == cap) {
+            cap   = cap ? cap * 2 : 1024;
+            costs = (double *)realloc(costs, cap * sizeof(double));
+        }
+        costs[num++] = cost;
+    }
+    while (wait(NULL) > 0) {
+    }
+    total = load_now() - start;
+
+    printf("%d workers, %d devices, %d controls per session\n", conf.workers, conf.devices, conf.controls);
+    printf("%zu sessions in %.1f s, %.1f sessions/s, %d failed\n", num, total, num / total, failed);
+    if (num) {
+        qsort(costs, num, sizeof(double), load_cmp);
+        printf("session latency p50 %.2f ms p99 %.2f ms max %.2f ms\n", costs[num / 2] * 1000,
+               costs[num * 99 / 100] * 1000, costs[num - 1] * 1000);
+    }
+    free(costs);
+
+    return failed ? 1 : 0;
+}
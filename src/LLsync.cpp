@@ -2,6 +2,7 @@
 #include "LLsync.h"
 #include <string.h>
 #include "core/ble_qiot_template.h"
+#include "core/ble_qiot_log.h"
 
 using std::string;
 using neb::CJsonObject;
@@ -9,11 +10,67 @@ using neb::CJsonObject;
 extern "C" void ble_qiot_service_init(void);
 extern "C" void ble_qiot_ota_final_handle(uint8_t result);
 
+LLsync::LLsync()
+    : _running(false),
+      _ctx(ble_qiot_ctx_create(this)),
+      _actionTimer(NULL),
+      _actionTimerRunning(false)
+{
+    _thingModel.SetContext(_ctx);
+}
+
+LLsync::LLsync(ble_qiot_ctx_t *ctx)
+    : _running(false),
+      _ctx(ctx),
+      _actionTimer(NULL),
+      _actionTimerRunning(false)
+{
+    ble_qiot_ctx_user_set(_ctx, this);
+    _thingModel.SetContext(_ctx);
+}
+
+LLsync::~LLsync()
+{
+    if (_actionTimer) {
+        ble_timer_stop(_actionTimer);
+        ble_timer_delete(_actionTimer);
+    }
+    ble_qiot_ctx_destroy(_ctx);
+}
+
+// called on the device, the timer runs on the device which created it
+void LLsync::ActionTimerStart()
+{
+    if (!_actionTimer) {
+        _actionTimer = ble_timer_create(BLE_TIMER_PERIOD_TYPE, action_timer_cb);
+        if (!_actionTimer) {
+            ble_qiot_log_e("action timer create failed");
+            return;
+        }
+    }
+    if (!__atomic_exchange_n(&_actionTimerRunning, true, __ATOMIC_SEQ_CST))
+        ble_timer_start(_actionTimer, BLE_QIOT_ACTION_TIMER_MS);
+}
+
+void LLsync::action_timer_cb(void *param)
+{
+    LLsync *llsync = LLsync::Current();
+
+    if (llsync->_thingModel.ActionsTimeout())
+        return;
+    // no timeout left. an action deferred while stopping is seen by the check after, or starts the timer itself
+    ble_timer_stop(llsync->_actionTimer);
+    __atomic_store_n(&llsync->_actionTimerRunning, false, __ATOMIC_SEQ_CST);
+    if (llsync->_thingModel.ActionsTimeout())
+        llsync->ActionTimerStart();
+}
+
 void LLsync::Start(void)
 {
     if (_running)
         return;
     _running = true;
+    QiotCtxScope scope(_ctx);
     ble_ota_callback_reg(LLsync::ota_start_cb, LLsync::ota_stop_cb, LLsync::ota_valid_file_cb);
     ble_qiot_service_init();
 }
@@ -24,7 +81,7 @@ void LLsync::Stop()
 
 void LLsync::ota_start_cb()
 {
-    LLsync::GetInstance()->EventNotify(OTA_START);
+    LLsync::Current()->EventNotify(OTA_START);
 }
 
 void LLsync::ota_stop_cb(uint8_t result)
@@ -35,7 +92,7 @@ void LLsync::ota_stop_cb(uint8_t result)
     if (result) {
         evt = OTA_FAIL;
     }
-    LLsync::GetInstance()->EventNotify(evt);
+    LLsync::Current()->EventNotify(evt);
 }
 
 ble_qiot_ret_status_t LLsync::ota_valid_file_cb(uint32_t file_size, char *file_version)
@@ -43,108 +100,134 @@ ble_qiot_ret_status_t LLsync::ota_valid_file_cb(uint32_t file_size, char *file_v
     return BLE_QIOT_RS_OK;
 }
 
+#if BLE_QIOT_TRACE_ENABLE
+static const char *TRACE_MSG_NAME[BLE_QIOT_TRACE_MSG_BUTT + 1] = {
+    "control", "property reply", "event reply", "action", "unknown"
+};
+static const char *TRACE_STAGE_NAME[BLE_QIOT_TRACE_STAGE_BUTT] = {
+    "write", "reassemble", "set", "handler", "notify", "total"
+};
+
+string LLsync::ExportTrace()
+{
+    ble_qiot_trace_event events[BLE_QIOT_TRACE_EVENT_NUM];
+    char buf[192];
+    string json = "{\"traceEvents\":[{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+                  "\"args\":{\"name\":\"notify\"}},";
+    int count = ble_qiot_trace_events_get(events, BLE_QIOT_TRACE_EVENT_NUM);
+
+    // a row for each message type, the notifications out of any message are in row 0
+    for (int i = 0; i <= BLE_QIOT_TRACE_MSG_BUTT; i++) {
+        snprintf(buf, sizeof(buf), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                 "\"args\":{\"name\":\"%s\"}},", i + 1, TRACE_MSG_NAME[i]);
+        json += buf;
+    }
+    for (int i = 0; i < count; i++) {
+        ble_qiot_trace_event &e = events[i];
+        if (!e.seq) {
+            snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%u,\"pid\":1,\"tid\":0},",
+                     TRACE_STAGE_NAME[e.stage], e.timestamp);
+            json += buf;
+            continue;
+        }
+        // the stages before reassembled do not know the message type yet, take it from the later stages
+        uint8_t type = e.msg_type;
+        for (int j = i + 1; j < count && type == BLE_QIOT_TRACE_MSG_BUTT; j++) {
+            if (events[j].seq == e.seq)
+                type = events[j].msg_type;
+        }
+        snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%u,\"dur\":%u,"
+                 "\"pid\":1,\"tid\":%d,\"args\":{\"seq\":%u}},",
+                 e.stage == BLE_QIOT_TRACE_TOTAL ? TRACE_MSG_NAME[type] : TRACE_STAGE_NAME[e.stage],
+                 TRACE_MSG_NAME[type], e.timestamp - e.duration, e.duration, type + 1, e.seq);
+        json += buf;
+    }
+    json.back() = ']';
+    json += "}";
+    return json;
+}
+#endif
+
 extern "C" void llsync_connect_status_notify(int status)
 {
     LLsync::Event evt = LLsync::Event::CONNECT;
     if (!status) {
         evt = LLsync::Event::DISCONNECT;
     }
-    LLsync::GetInstance()->EventNotify(evt);
+    LLsync::Current()->EventNotify(evt);
 }
 
 extern "C" int ble_get_product_key(char *product_secret)
 {
-    string &productSecret = LLsync::GetInstance()->get_product_secret();
+    string &productSecret = LLsync::Current()->get_product_secret();
     memcpy(product_secret, productSecret.c_str(), productSecret.length());
     return 0;
 }
 
 extern "C" int ble_get_product_id(char *product_id)
 {
-    string &productId = LLsync::GetInstance()->get_product_id();
+    string &productId = LLsync::Current()->get_product_id();
     memcpy(product_id, productId.c_str(), productId.length());
     return 0;
 }
 
 extern "C" int ble_get_device_name(char *device_name)
 {
-    string &deviceName = LLsync::GetInstance()->get_device_name();
+    string &deviceName = LLsync::Current()->get_device_name();
     memcpy(device_name, deviceName.c_str(), deviceName.length());
     return deviceName.length();
 }
 
 extern "C" int ble_get_psk(char *psk)
 {
-    string &device_secret = LLsync::GetInstance()->get_device_secret();
+    string &device_secret = LLsync::Current()->get_device_secret();
     memcpy(psk, device_secret.c_str(), device_secret.length());
     return 0;
 }
 
 extern "C" uint8_t ble_get_property_type_by_id(uint8_t id)
 {
-    return LLsync::GetInstance()->thingModel().GetPropertyType(id) & 0x0f;
+    return LLsync::Current()->thingModel().GetPropertyType(id) & 0x0f;
 }
 
 extern "C" void *ble_property_ctx_get(uint8_t id)
 {
-    return LLsync::GetInstance()->thingModel().GetPropertyCtx(id);
+    return LLsync::Current()->thingModel().GetPropertyCtx(id);
 }
 
 extern "C" uint8_t ble_get_property_size()
 {
-    return LLsync::GetInstance()->thingModel().PropertiesSize();
+    return LLsync::Current()->thingModel().PropertiesSize();
 }
 
-extern "C" void ble_property_change_notify(const e_ble_tlv *tlv)
+extern "C" void ble_property_changes_notify(const uint8_t *ids, uint8_t num)
 {
-    QiotData *ctx = LLsync::GetInstance()->thingModel().GetPropertyCtx(tlv->id);
-    if (ctx)
-        LLsync::GetInstance()->thingModel().PropertyNotify(*ctx);
+    LLsync::Current()->thingModel().PropertiesNotify(ids, num);
 }
 
-extern "C" int ble_event_get_id_array_size(uint8_t event_id)
+extern "C" void *ble_event_ctx_get(uint8_t event_id)
 {
-    QiotData *eventCtx = LLsync::GetInstance()->thingModel().GetEventCtx(event_id);
-    if (eventCtx)
-        return eventCtx->ChildsCount();
-    return 0;
-}
-
-extern "C" uint8_t ble_event_get_param_id_type(uint8_t event_id, uint8_t param_id)
-{
-    QiotData *eventCtx =  LLsync::GetInstance()->thingModel().GetEventCtx(event_id);
-    if (!eventCtx)
-        return BLE_QIOT_DATA_TYPE_BUTT;
-    QiotData *paramCtx = eventCtx->GetChildCtx(param_id);
-    if (!paramCtx)
-        return BLE_QIOT_DATA_TYPE_BUTT;
-    return paramCtx->GetType();
-}
-
-extern "C" int ble_event_get_data_by_id(uint8_t event_id, uint8_t param_id, char *out_buf, uint16_t buf_len)
-{
-    QiotData *eventCtx = LLsync::GetInstance()->thingModel().GetEventCtx(event_id);
-    if (!eventCtx)
-        return -1;
-    QiotData *paramCtx = eventCtx->GetChildCtx(param_id);
-    if (!paramCtx)
-        return -1;
-    return paramCtx->GetValue(out_buf, buf_len);
+    return LLsync::Current()->thingModel().GetEventCtx(event_id);
 }
 
 extern "C" void *ble_actions_input_ctx_get(uint8_t id)
 {
-    return LLsync::GetInstance()->thingModel().GetActionInputCtx(id);
+    return LLsync::Current()->thingModel().GetActionInputCtx(id);
 }
 
-extern "C" void ble_actions_input_notify(uint8_t id, uint8_t output_flag[])
+extern "C" int ble_actions_input_notify(uint8_t id, uint8_t output_flag[])
 {
-    LLsync::GetInstance()->thingModel().ActionsNotify(id, output_flag);
+    LLsync *llsync = LLsync::Current();
+    int     ret    = llsync->thingModel().ActionsNotify(id, output_flag);
+
+    if (BLE_QIOT_ACTION_REPLY_DEFERRED == ret)
+        llsync->ActionTimerStart();
+    return ret;
 }
 
 extern "C" uint8_t ble_action_get_output_type_by_id(uint8_t action_id, uint8_t output_id)
 {
-    QiotData *action_output = LLsync::GetInstance()->thingModel().GetActionOutputCtx(action_id);
+    QiotData *action_output = LLsync::Current()->thingModel().GetActionOutputCtx(action_id);
     if (!action_output)
         return BLE_QIOT_DATA_TYPE_BUTT;
     QiotData *ctx = action_output->GetChildCtx(output_id);
@@ -155,7 +238,7 @@ extern "C" uint8_t ble_action_get_output_type_by_id(uint8_t action_id, uint8_t o
 
 extern "C" int ble_action_user_handle_output_param(uint8_t action_id, uint8_t output_id, char *buf, uint16_t buf_len)
 {
-    QiotData *action_output = LLsync::GetInstance()->thingModel().GetActionOutputCtx(action_id);
+    QiotData *action_output = LLsync::Current()->thingModel().GetActionOutputCtx(action_id);
     if (!action_output)
         return -1;
     QiotData *ctx = action_output->GetChildCtx(output_id);
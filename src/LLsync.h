@@ -5,8 +5,14 @@
 #include <string>
 #include <list>
 #include "core/ble_qiot_export.h"
+#include "core/ble_qiot_import.h"
+#include "core/ble_qiot_metrics.h"
+#include "core/ble_qiot_stack.h"
+#include "core/ble_qiot_trace.h"
 #include "ThingModel.h"
+#ifdef ARDUINO
 #include "Log.h"
+#endif
 
 class LLsync
 {
@@ -21,12 +27,27 @@ public:
     typedef std::function<void(int)> EventHandler;
 
 public:
+    // the device on the default context, enough for a board with one device
     static LLsync *GetInstance(void) {
         static LLsync *p = NULL;
         if (!p)
-            p = new LLsync();
+            p = new LLsync(ble_qiot_ctx_default());
         return p;
     }
+    // the device the core is running on, the callbacks from the core find their device here
+    static LLsync *Current(void) {
+        LLsync *p = (LLsync *)ble_qiot_ctx_user(ble_qiot_ctx_current());
+        if (!p)
+            p = GetInstance();
+        return p;
+    }
+    // another device in the same process with its own context and thing model, select it by
+    // QiotCtxScope scope(llsync->Context()) before calling the sdk api or the write callbacks
+    LLsync();
+    ~LLsync();
+    ble_qiot_ctx_t *Context() {
+        return _ctx;
+    }
     void Start();
     void Stop();
     void AddEventHandler(EventHandler *handler) {
@@ -70,11 +91,41 @@ public:
         for (auto h : _handles)
             (*h)(event);
     }
+    // check the timeouts of the actions in flight
+    void ActionTimerStart();
+
+#if BLE_QIOT_METRICS_ENABLE
+    // the protocol counters since the last reset, the name of a counter is ble_qiot_metric_name(id)
+    void GetMetrics(ble_qiot_metrics &metrics, bool reset = false) {
+        ble_qiot_metrics_snapshot(&metrics, reset);
+    }
+#endif
+
+#if BLE_QIOT_STACK_ENABLE
+    // the deepest stack used by an entry point of the sdk, entry is e_ble_qiot_stack_entry
+    bool GetStackUsage(uint8_t entry, ble_qiot_stack_stats &stats) {
+        return BLE_QIOT_RS_OK == ble_qiot_stack_get(entry, &stats);
+    }
+#endif
+
+#if BLE_QIOT_TRACE_ENABLE
+    // latency of the messages from Tencent Lianlian, msgType is e_ble_qiot_trace_msg and stage is
+    // e_ble_qiot_trace_stage
+    bool GetLatencyHistogram(uint8_t msgType, uint8_t stage, ble_qiot_trace_hist &hist) {
+        return BLE_QIOT_RS_OK == ble_qiot_trace_hist_get(msgType, stage, &hist);
+    }
+    void ResetLatency() {
+        ble_qiot_trace_reset();
+    }
+    // the recent stages in chrome trace json, open it in chrome://tracing or ui.perfetto.dev
+    std::string ExportTrace();
+#endif
 
 private:
     static void ota_start_cb();
     static void ota_stop_cb(uint8_t result);
     static ble_qiot_ret_status_t ota_valid_file_cb(uint32_t file_size, char *file_version);
+    static void action_timer_cb(void *param);
 
 private:
     std::string _productID;
@@ -84,12 +135,12 @@ private:
     ThingModel _thingModel;
     std::list<EventHandler*> _handles;
     bool _running;
+    ble_qiot_ctx_t *_ctx;
+    ble_timer_t _actionTimer;  // see ThingModel::SetActionHandler()
+    bool _actionTimerRunning;
 
 private:
-    LLsync()
-        : _running(false)
-    {}
-    ~LLsync() {}
+    explicit LLsync(ble_qiot_ctx_t *ctx);
     LLsync(LLsync&) = delete;
     void operator=(LLsync&) = delete;
 };
@@ -1,8 +1,15 @@
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_THINGMODEL_LEVEL
+
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include "ThingModel.h"
 #include "core/ble_qiot_template.h"
+#include "core/ble_qiot_import.h"
 #include "core/ble_qiot_log.h"
 #include "core/ble_qiot_llsync_data.h"
+#include "core/ble_qiot_metrics.h"
+#include "core/ble_qiot_service.h"
 
 static const char *VERSION = "version";
 static const char *TYPE = "type";
@@ -33,6 +40,7 @@ static const char *DATATYPE = "dataType";
 static const char *ARRAY = "array";
 static const char *ARRAYINFO = "arrayInfo";
 static const char *PARAMS = "params";
+static const char *SIZE = "size";
 static const char *INPUT = "input";
 static const char *OUTPUT = "output";
 
@@ -84,6 +92,36 @@ static const char *IntTypeToStr(int type)
     return "errorType";
 }
 
+// the max length of a string from its define, the strings with no max are only limited by the message size
+static uint16_t StringMax(CJsonObject &define)
+{
+    string s_max;
+    int max = -1;
+    if (define.Get(MAX, s_max))
+        max = atoi(s_max.c_str());
+    else
+        define.Get(MAX, max);
+    if (max < 0 || max > BLE_QIOT_EVENT_MAX_SIZE)
+        return BLE_QIOT_EVENT_MAX_SIZE;
+    return max;
+}
+
+// the elements of an array from its define, BLE_QIOT_PROPERTY_DEFAULT_ARRAY_SIZE if the model has no size
+static uint8_t ArraySize(CJsonObject &define)
+{
+    string s_size;
+    int size = BLE_QIOT_PROPERTY_DEFAULT_ARRAY_SIZE;
+    if (define.Get(SIZE, s_size))
+        size = atoi(s_size.c_str());
+    else
+        define.Get(SIZE, size);
+    if (size <= 0)
+        return BLE_QIOT_PROPERTY_DEFAULT_ARRAY_SIZE;
+    if (size > BLE_QIOT_PROPERTY_MAX_ARRAY_SIZE)
+        return BLE_QIOT_PROPERTY_MAX_ARRAY_SIZE;
+    return size;
+}
+
 void QiotData::Dump(const char *preFormat)
 {
     BLE_QIOT_LOG_PRINT("%sid:%s | type:%s | value:", preFormat, _id.c_str(), IntTypeToStr(_type));
@@ -92,19 +130,25 @@ void QiotData::Dump(const char *preFormat)
     case BLE_QIOT_DATA_TYPE_INT:
     case BLE_QIOT_DATA_TYPE_ENUM:
     case BLE_QIOT_DATA_TYPE_TIME:
-        BLE_QIOT_LOG_PRINT("%d", _val);
+        BLE_QIOT_LOG_PRINT("%d", Raw());
         break;
     case BLE_QIOT_DATA_TYPE_FLOAT:
-        BLE_QIOT_LOG_PRINT("%f", (float)_val);
+        BLE_QIOT_LOG_PRINT("%f", QiotDataTraits<float>::Get(*this));
         break;
     case BLE_QIOT_DATA_TYPE_STRING:
+        if (_bind) {
+            BLE_QIOT_LOG_PRINT("%.*s", ValueLen(), (const char *)_bind);
+            break;
+        }
         for (char c : _strVal)
             BLE_QIOT_LOG_PRINT("%c", c);
         break;
     case BLE_QIOT_DATA_TYPE_STRUCT:
-    case BLE_QIOT_DATA_TYPE_ARRAY:
         BLE_QIOT_LOG_PRINT(" | childs: %d", ChildsCount());
         break;
+    case BLE_QIOT_DATA_TYPE_ARRAY:
+        BLE_QIOT_LOG_PRINT(" | childs: %d/%d", ArrayLen(), ChildsCount());
+        break;
     }
     BLE_QIOT_LOG_PRINT("\n");
     string childFormat("    ");
@@ -116,16 +160,43 @@ void QiotData::Dump(const char *preFormat)
 
 QiotData::QiotData(const char *id, int type)
     : _id(id),
-      _type(type)
+      _type(type),
+      _val(0),
+      _strNul(false),
+      _strMax(BLE_QIOT_EVENT_MAX_SIZE),
+      _bind(NULL),
+      _bindSize(0),
+      _len(0),
+      _dirty(true),
+      _skip(false)
 {
 }
 
 QiotData::QiotData(string &id, int type)
     : _id(id),
-      _type(type)
+      _type(type),
+      _val(0),
+      _strNul(false),
+      _strMax(BLE_QIOT_EVENT_MAX_SIZE),
+      _bind(NULL),
+      _bindSize(0),
+      _len(0),
+      _dirty(true),
+      _skip(false)
 {
 }
 
+// the copies of the array elements do not keep the capacity, reserve after the whole model is built
+void QiotData::ReserveValue()
+{
+    if (_type == BLE_QIOT_DATA_TYPE_STRING && !_bind) {
+        int size = _strMax + 1;
+        _strVal.reserve(size < BLE_QIOT_STRING_RESERVE_SIZE ? size : BLE_QIOT_STRING_RESERVE_SIZE);
+    }
+    for (auto &child : _childs)
+        child.ReserveValue();
+}
+
 bool QiotData::SetValue(uint32_t val)
 {
     switch (_type) {
@@ -134,56 +205,191 @@ bool QiotData::SetValue(uint32_t val)
     case BLE_QIOT_DATA_TYPE_FLOAT:
     case BLE_QIOT_DATA_TYPE_ENUM:
     case BLE_QIOT_DATA_TYPE_TIME:
-        _val = val;
+        SetRaw(val);
         return true;
     }
     return false;
 }
 
+// a string is bound to a char array, scalars to a variable of 1, 2 or 4 bytes. the value of the model is dropped
+bool QiotData::Bind(void *addr, uint16_t size, int type)
+{
+    if (type != _type) {
+        ble_qiot_log_e("qiot_data %s is %s, cannot bind %s\n", _id.c_str(), IntTypeToStr(_type), IntTypeToStr(type));
+        return false;
+    }
+    switch (_type) {
+    case BLE_QIOT_DATA_TYPE_STRING:
+        if (!size)
+            return false;
+        ((char *)addr)[size - 1] = '\0';
+        std::vector<char>().swap(_strVal);
+        break;
+    case BLE_QIOT_DATA_TYPE_BOOL:
+    case BLE_QIOT_DATA_TYPE_ENUM:
+        if (size != sizeof(uint8_t) && size != sizeof(uint16_t) && size != sizeof(uint32_t))
+            return false;
+        break;
+    case BLE_QIOT_DATA_TYPE_INT:
+    case BLE_QIOT_DATA_TYPE_FLOAT:
+    case BLE_QIOT_DATA_TYPE_TIME:
+        if (size != sizeof(uint32_t))
+            return false;
+        break;
+    default:
+        return false;
+    }
+    _bind = addr;
+    _bindSize = size;
+    _dirty = true;
+    return true;
+}
+
+// the value is copied back to the model
+void QiotData::Unbind()
+{
+    if (_bind && _type == BLE_QIOT_DATA_TYPE_STRING) {
+        _strVal.assign((const char *)_bind, (const char *)_bind + ValueLen() + 1);
+        _strNul = false;
+    } else if (_bind)
+        _val = Raw();
+    _bind = NULL;
+    _bindSize = 0;
+    for (auto &child : _childs)
+        child.Unbind();
+}
+
 bool QiotData::SetValue(const char *str)
 {
     if (_type != BLE_QIOT_DATA_TYPE_STRING)
         return false;
-    int len = strlen(str) + 1;
+    int len = strlen(str);
+    int strMax = _bind && _bindSize <= _strMax ? _bindSize - 1 : _strMax;
+    if (len > strMax) {
+        ble_qiot_log_e("qiot_data %s string length %d over max %d\n", _id.c_str(), len, strMax);
+        return false;
+    }
+    len += 1;
+    _dirty = true;
+    if (_bind) {
+        memmove(_bind, str, len);
+        return true;
+    }
     _strVal.resize(len);
     memcpy(_strVal.data(), str, len);
+    _strNul = false;
     return true;
 }
 
+bool QiotData::CheckValue(const char *dat, int len)
+{
+    switch (_type) {
+    case BLE_QIOT_DATA_TYPE_INT:
+    case BLE_QIOT_DATA_TYPE_TIME:
+    case BLE_QIOT_DATA_TYPE_FLOAT:
+        return len == BLE_QIOT_DATA_INT_TYPE_LEN;
+    case BLE_QIOT_DATA_TYPE_BOOL:
+        return len == BLE_QIOT_DATA_BOOL_TYPE_LEN;
+    case BLE_QIOT_DATA_TYPE_ENUM:
+        return len == BLE_QIOT_DATA_ENUM_TYPE_LEN;
+    case BLE_QIOT_DATA_TYPE_STRING: {
+        // the terminating nul kept by SetValue(const char *) is not counted
+        int strLen = len - (len > 0 && !dat[len - 1]);
+        int strMax = _bind && _bindSize <= _strMax ? _bindSize - 1 : _strMax;
+        if (strLen > strMax) {
+            ble_qiot_log_e("qiot_data %s string length %d over max %d\n", _id.c_str(), strLen, strMax);
+            return false;
+        }
+        return true;
+    }
+    }
+    ble_qiot_log_e("qiot_data type %s cannot set val\n", IntTypeToStr(_type));
+    return false;
+}
+
 bool QiotData::SetValue(const char *dat, int len)
 {
+    if (!CheckValue(dat, len))
+        return false;
     switch (_type) {
     case BLE_QIOT_DATA_TYPE_INT:
     case BLE_QIOT_DATA_TYPE_TIME:
     case BLE_QIOT_DATA_TYPE_FLOAT: {
-        if (len != BLE_QIOT_DATA_INT_TYPE_LEN)
-            return false;
         uint32_t val = ((uint32_t)dat[0] << 24) | (dat[1] << 16) | (dat[2] << 8) | dat[3];
-        _val = val;
+        SetRaw(val);
         return true;
     }
     case BLE_QIOT_DATA_TYPE_BOOL: {
-        if (len != BLE_QIOT_DATA_BOOL_TYPE_LEN)
-            return false;
-        _val = dat[0];
+        SetRaw(dat[0]);
         return true;
     }
-    case BLE_QIOT_DATA_TYPE_STRING:
-        _strVal.resize(len);
+    case BLE_QIOT_DATA_TYPE_STRING: {
+        _dirty = true;
+        if (_bind) {
+            int strLen = len - (len > 0 && !dat[len - 1]);
+            memcpy(_bind, dat, strLen);
+            ((char *)_bind)[strLen] = '\0';
+            return true;
+        }
+        // the value is sent back as received, a nul is added if it has none
+        _strNul = len == 0 || dat[len - 1];
+        _strVal.resize(len + _strNul);
         memcpy(_strVal.data(), dat, len);
+        if (_strNul)
+            _strVal[len] = '\0';
         return true;
+    }
     case BLE_QIOT_DATA_TYPE_ENUM: {
-        if (len != BLE_QIOT_DATA_ENUM_TYPE_LEN)
-            return false;
         uint16_t val = ((uint16_t)dat[0] << 8) | dat[1];
-        _val = val;
+        SetRaw(val);
         return true;
     }
     }
-    ble_qiot_log_e("qiot_data type %s cannot set val\n", IntTypeToStr(_type));
     return false;
 }
 
+bool QiotData::SetArrayLen(unsigned int len)
+{
+    if (_type != BLE_QIOT_DATA_TYPE_ARRAY || len > _childs.size())
+        return false;
+    _dirty |= len != _len;
+    _len = len;
+    return true;
+}
+
+bool QiotData::Changed()
+{
+    if (_dirty)
+        return true;
+    if (_bind)
+        return (_type == BLE_QIOT_DATA_TYPE_STRING ? StringHash() : Raw()) != _val;
+    for (auto &child : _childs) {
+        if (child.Changed())
+            return true;
+    }
+    return false;
+}
+
+void QiotData::ClearChanged()
+{
+    _dirty = false;
+    if (_bind)
+        _val = _type == BLE_QIOT_DATA_TYPE_STRING ? StringHash() : Raw();
+    for (auto &child : _childs)
+        child.ClearChanged();
+}
+
+// fnv-1a of a bound string, to find it changed with no copy of it
+uint32_t QiotData::StringHash()
+{
+    const uint8_t *str = (const uint8_t *)_bind;
+    uint32_t hash = 2166136261u;
+    int len = ValueLen();
+    for (int i = 0; i < len; i++)
+        hash = (hash ^ str[i]) * 16777619u;
+    return hash;
+}
+
 bool QiotData::SetValue(unsigned int index, uint32_t val)
 {
     if (index >= _childs.size())
@@ -201,11 +407,14 @@ bool QiotData::SetValue(unsigned int index, const char *val, int len)
 
 int QiotData::GetValue(char *buf, uint16_t buf_len)
 {
+    // no data to post, the member is not sent
+    if (_skip)
+        return 0;
     switch (_type) {
     case BLE_QIOT_DATA_TYPE_INT:
     case BLE_QIOT_DATA_TYPE_FLOAT:
     case BLE_QIOT_DATA_TYPE_TIME: {
-        uint32_t val = _val;
+        uint32_t val = Raw();
         buf[0] = (val >> 24) & 0xff;
         buf[1] = (val >> 16) & 0xff;
         buf[2] = (val >> 8) & 0xff;
@@ -213,25 +422,34 @@ int QiotData::GetValue(char *buf, uint16_t buf_len)
         return BLE_QIOT_DATA_INT_TYPE_LEN;
     }
     case BLE_QIOT_DATA_TYPE_ENUM: {
-        uint16_t val = _val;
+        uint16_t val = Raw();
         buf[0] = (val >> 8) & 0xff;
         buf[1] = (val >> 0) & 0xff;
         return BLE_QIOT_DATA_ENUM_TYPE_LEN;
     }
     case BLE_QIOT_DATA_TYPE_BOOL: {
-        if (_val)
+        if (Raw())
             buf[0] = 1;
         else
             buf[0] = 0;
         return BLE_QIOT_DATA_BOOL_TYPE_LEN;
     }
     case BLE_QIOT_DATA_TYPE_STRING: {
-        if (buf_len < _strVal.size()) {
+        // the text of a bound string, with no terminating nul
+        if (_bind) {
+            int len = ValueLen();
+            if (buf_len < len)
+                return -1;
+            memcpy(buf, _bind, len);
+            return len;
+        }
+        int len = ValueLen();
+        if (buf_len < len) {
             return -1;
         } else {
-            memcpy(buf, _strVal.data(), _strVal.size());
+            memcpy(buf, _strVal.data(), len);
         }
-        return _strVal.size();
+        return len;
     }
     }
     ble_qiot_log_e("qiot_data type %s cannot get val\n", IntTypeToStr(_type));
@@ -257,7 +475,9 @@ int QiotData::ValueLen()
     case BLE_QIOT_DATA_TYPE_BOOL:
         return BLE_QIOT_DATA_BOOL_TYPE_LEN;
     case BLE_QIOT_DATA_TYPE_STRING:
-        return _strVal.size();
+        if (_bind)
+            return strnlen((const char *)_bind, _bindSize);
+        return _strVal.size() - _strNul;
     }
     return -1;
 }
@@ -310,9 +530,17 @@ extern "C" uint8_t ble_qiot_data_type_get(void *ctx)
 extern "C" uint8_t ble_struct_array_get_elem_cnt(void *ctx)
 {
     QiotData *h = (QiotData *)ctx;
+    if ((h->GetType() & 0x0f) == BLE_QIOT_DATA_TYPE_ARRAY)
+        return h->Skipped() ? 0 : h->ArrayLen();
     return h->ChildsCount();
 }
 
+extern "C" int ble_struct_array_set_elem_cnt(void *ctx, uint8_t cnt)
+{
+    QiotData *h = (QiotData *)ctx;
+    return !h->SetArrayLen(cnt);
+}
+
 extern "C" int ble_struct_array_elem_set(void *ctx, uint8_t id, const char *val, int len)
 {
     QiotData *h = (QiotData *)ctx;
@@ -325,6 +553,12 @@ extern "C" int ble_qiot_data_set(void *ctx, const char *buf, uint16_t buf_len)
     return !h->SetValue(buf, buf_len);
 }
 
+extern "C" int ble_qiot_data_check(void *ctx, const char *buf, uint16_t buf_len)
+{
+    QiotData *h = (QiotData *)ctx;
+    return !h->CheckValue(buf, buf_len);
+}
+
 extern "C" int ble_qiot_data_get(void *ctx, char *buf, uint16_t buf_len)
 {
     QiotData *h = (QiotData *)ctx;
@@ -384,6 +618,14 @@ bool ThingModel::Load(const char *jsonStr)
         }
         ble_qiot_log_e("parse actions fail\n");
     }
+    _properties->ReserveValue();
+    if (_events)
+        _events->ReserveValue();
+    if (_actions)
+        _actions->ReserveValue();
+    _subscriptions.assign(PropertiesSize(), NULL);
+    if (_actions)
+        _actionRuns.resize(_actions->ChildsCount());
     _valid = true;
     return true;
 }
@@ -452,10 +694,18 @@ bool ThingModel::ParseEvents(CJsonObject &events)
         }
         _events->_childs.push_back(QiotData(id, BLE_QIOT_DATA_TYPE_STRUCT));
         CJsonObject &params = event[PARAMS];
-        if (!ParseStruct(params, _events->_childs.back(), DEFINE, true)) {
-            ble_qiot_log_e("event params parse fail\n%s\n", params.ToFormattedString().c_str());
+        int paramsSize = params.GetArraySize();
+        if (paramsSize <= 0) {
+            ble_qiot_log_e("event params is null or not a array\n%s\n", event.ToFormattedString().c_str());
             return false;
         }
+        // the params are as the properties, a struct or an array is sent with its length
+        for (int j = 0; j < paramsSize; j++) {
+            if (!ParseDefine(params[j], _events->_childs.back())) {
+                ble_qiot_log_e("event params parse fail\n%s\n", params.ToFormattedString().c_str());
+                return false;
+            }
+        }
     }
     return true;
 }
@@ -477,29 +727,41 @@ bool ThingModel::ParseProperties(CJsonObject &properties)
 
     for (int i = 0; i < size; ++i) {
         CJsonObject &property = properties[i];
-        string id, s_type;
-        if (!property.Get(ID, id) || !property[DEFINE].Get(TYPE, s_type)) {
-            ble_qiot_log_e("property no id or define.type param\n%s\n", property.ToFormattedString().c_str());
+        if (!ParseDefine(property, *_properties)) {
+            ble_qiot_log_e("property parse fail\n%s\n", property.ToFormattedString().c_str());
             return false;
         }
-        int type = StrTypeToInt(s_type);
-        if (type == BLE_QIOT_DATA_TYPE_BUTT) {
-            ble_qiot_log_e("property type %s is unknown\n%s\n", s_type.c_str(), property.ToFormattedString().c_str());
+    }
+    return true;
+}
+
+// a property or the param of an event, of any type but a struct in a struct or an array in an array
+bool ThingModel::ParseDefine(CJsonObject &item, QiotData &parent)
+{
+    string id, s_type;
+    if (!item.Get(ID, id) || !item[DEFINE].Get(TYPE, s_type)) {
+        ble_qiot_log_e("no id or define.type param\n");
+        return false;
+    }
+    int type = StrTypeToInt(s_type);
+    if (type == BLE_QIOT_DATA_TYPE_BUTT) {
+        ble_qiot_log_e("type %s is unknown\n", s_type.c_str());
+        return false;
+    }
+    parent._childs.push_back(QiotData(id, type));
+    if (type == BLE_QIOT_DATA_TYPE_STRING) {
+        parent._childs.back()._strMax = StringMax(item[DEFINE]);
+    } else if (type == BLE_QIOT_DATA_TYPE_STRUCT) {
+        CJsonObject &specs = item[DEFINE][SPECS];
+        if (!ParseStruct(specs, parent._childs.back(), DATATYPE, false)) {
+            ble_qiot_log_e("struct specs parse fail\n%s\n", specs.ToFormattedString().c_str());
             return false;
         }
-        _properties->_childs.push_back(QiotData(id, type));
-        if (type == BLE_QIOT_DATA_TYPE_STRUCT) {
-            CJsonObject &specs = property[DEFINE][SPECS];
-            if (!ParseStruct(specs, _properties->_childs.back(), DATATYPE, false)) {
-                ble_qiot_log_e("property struct specs parse fail\n%s\n", specs.ToFormattedString().c_str());
-                return false;
-            }
-        } else if (type == BLE_QIOT_DATA_TYPE_ARRAY) {
-            CJsonObject &arrayInfo = property[DEFINE][ARRAYINFO];
-            if (!ParseArray(arrayInfo, _properties->_childs.back(), DATATYPE, false)) {
-                ble_qiot_log_e("property array arrayInfo parse fail\n%s\n", arrayInfo.ToFormattedString().c_str());
-                return false;
-            }
+    } else if (type == BLE_QIOT_DATA_TYPE_ARRAY) {
+        CJsonObject &arrayInfo = item[DEFINE][ARRAYINFO];
+        if (!ParseArray(arrayInfo, parent._childs.back(), DATATYPE, false, ArraySize(item[DEFINE]))) {
+            ble_qiot_log_e("array arrayInfo parse fail\n%s\n", arrayInfo.ToFormattedString().c_str());
+            return false;
         }
     }
     return true;
@@ -527,9 +789,11 @@ bool ThingModel::ParseStruct(CJsonObject &Struct, QiotData &dat, const char* typ
             return false;
         }
         dat._childs.push_back(QiotData(id, type));
-        if (type == BLE_QIOT_DATA_TYPE_ARRAY) {
+        if (type == BLE_QIOT_DATA_TYPE_STRING) {
+            dat._childs.back()._strMax = StringMax(item[typeKey]);
+        } else if (type == BLE_QIOT_DATA_TYPE_ARRAY) {
             CJsonObject &child = item[typeKey][ARRAYINFO];
-            if (!ParseArray(child, dat._childs.back(), typeKey, true)) {
+            if (!ParseArray(child, dat._childs.back(), typeKey, true, ArraySize(item[typeKey]))) {
                 ble_qiot_log_e("struct member array parase arrayInfo fail\n%s\n", child.ToFormattedString().c_str());
                 return false;
             }
@@ -538,7 +802,8 @@ bool ThingModel::ParseStruct(CJsonObject &Struct, QiotData &dat, const char* typ
     return true;
 }
 
-bool ThingModel::ParseArray(CJsonObject &array, QiotData &dat, const char *typeKey, bool noStruct)
+// the elements are allocated once here, size copies of the first
+bool ThingModel::ParseArray(CJsonObject &array, QiotData &dat, const char *typeKey, bool noStruct, uint8_t size)
 {
     string s_type;
     if (!array.Get(TYPE, s_type)) {
@@ -555,14 +820,18 @@ bool ThingModel::ParseArray(CJsonObject &array, QiotData &dat, const char *typeK
         return false;
     }
     dat._childs.push_back(QiotData("", type));
-    if (type == BLE_QIOT_DATA_TYPE_STRUCT) {
+    if (type == BLE_QIOT_DATA_TYPE_STRING) {
+        dat._childs.back()._strMax = StringMax(array);
+    } else if (type == BLE_QIOT_DATA_TYPE_STRUCT) {
         CJsonObject &child = array[SPECS];
         if (!ParseStruct(child, dat._childs.back(), typeKey, true)) {
             ble_qiot_log_e("array parase struct specs fail\n%s\n", child.ToFormattedString().c_str());
             return false;
         }
     }
-    dat._childs.resize(BLE_QIOT_PROPERTY_DEFAULT_ARRAY_SIZE, dat._childs[0]);
+    dat._childs.reserve(size);
+    dat._childs.resize(size, dat._childs[0]);
+    dat._len = size;
     return true;
 }
 
@@ -601,34 +870,453 @@ QiotData* ThingModel::GetPropertyCtx(const char *id)
 
 bool ThingModel::ReportProperty(const char *id, const char *val)
 {
-    unsigned int i;
-    QiotData *property;
-    for (i = 0; i < _properties->ChildsCount(); ++ i) {
-        property = _properties->_childs.data() + i;
-        if (property->_id == id) {
-            if (property->SetValue(val)) {
-                return !ble_user_property_get_report_data(i, i + 1);
-            }
+    QiotData *property = GetPropertyCtx(id);
+    if (!property || !property->SetValue(val))
+        return false;
+    return ReportProperty(property - _properties->_childs.data());
+}
+
+bool ThingModel::ReportProperty(const char *id, uint32_t val)
+{
+    QiotData *property = GetPropertyCtx(id);
+    if (!property || !property->SetValue(val))
+        return false;
+    return ReportProperty(property - _properties->_childs.data());
+}
+
+bool ThingModel::Bind(const char *id, void *addr, size_t size, int type, size_t count, const QiotBindField *fields,
+                      size_t fieldsNum, QiotDataHandler &onChange)
+{
+    QiotData *property = GetPropertyCtx(id);
+    bool ret = true;
+
+    if (!property || !addr || size > UINT16_MAX) {
+        ble_qiot_log_e("property %s cannot bind\n", id);
+        return false;
+    }
+    if (count) {
+        // the elements of the model are bound to the first of the array of the user
+        if (property->_type != BLE_QIOT_DATA_TYPE_ARRAY || count < property->ChildsCount()) {
+            ble_qiot_log_e("property %s is not an array of %d elements at most\n", id, (int)count);
             return false;
         }
+        for (unsigned int i = 0; i < property->ChildsCount() && ret; i++) {
+            uint8_t *elem = (uint8_t *)addr + i * size;
+            if (fields)
+                ret = BindStruct(property->_childs[i], elem, size, fields, fieldsNum);
+            else
+                ret = property->_childs[i].Bind(elem, size, type);
+        }
+    } else if (fields) {
+        ret = BindStruct(*property, (uint8_t *)addr, size, fields, fieldsNum);
+    } else {
+        ret = property->Bind(addr, size, type);
     }
-    return false;
+    if (!ret) {
+        ble_qiot_log_e("property %s bind fail\n", id);
+        UnbindProperty(id);
+        return false;
+    }
+    unsigned int index = property - _properties->_childs.data();
+    if (_bindHandlers.size() < PropertiesSize())
+        _bindHandlers.resize(PropertiesSize());
+    _bindHandlers[index] = onChange;
+    return true;
 }
 
-bool ThingModel::ReportProperty(const char *id, uint32_t val)
+bool ThingModel::BindStruct(QiotData &dat, uint8_t *base, size_t size, const QiotBindField *fields, size_t fieldsNum)
 {
-    unsigned int i;
-    QiotData *property;
-    for (i = 0; i < _properties->ChildsCount(); ++ i) {
-        property = _properties->_childs.data() + i;
-        if (property->_id == id) {
-            if (property->SetValue(val)) {
-                return !ble_user_property_get_report_data(i, i + 1);
+    if (dat._type != BLE_QIOT_DATA_TYPE_STRUCT)
+        return false;
+    for (size_t i = 0; i < fieldsNum; i++) {
+        QiotData *member = NULL;
+        for (auto &child : dat._childs) {
+            if (child._id == fields[i].id) {
+                member = &child;
+                break;
             }
+        }
+        if (!member || fields[i].offset + fields[i].size > size) {
+            ble_qiot_log_e("struct %s has no member %s\n", dat._id.c_str(), fields[i].id);
             return false;
         }
+        if (!member->Bind(base + fields[i].offset, fields[i].size, fields[i].type))
+            return false;
     }
-    return false;
+    return true;
+}
+
+bool ThingModel::UnbindProperty(const char *id)
+{
+    QiotData *property = GetPropertyCtx(id);
+
+    if (!property)
+        return false;
+    property->Unbind();
+    property->ReserveValue();
+    unsigned int index = property - _properties->_childs.data();
+    if (index < _bindHandlers.size())
+        _bindHandlers[index] = nullptr;
+    return true;
+}
+
+void ThingModel::PropertyNotify(QiotData &property)
+{
+    unsigned int index = &property - _properties->_childs.data();
+    DispatchCursor cursor = {index < _subscriptions.size() ? _subscriptions[index] : NULL, NULL, _cursors};
+
+    if (index < _bindHandlers.size() && _bindHandlers[index])
+        _bindHandlers[index](property);
+    for (auto hander : _propertiesHandler)
+        (*hander)(property);
+    if (!cursor.next)
+        return;
+    for (cursor.last = cursor.next; cursor.last->_next;)
+        cursor.last = cursor.last->_next;
+    // the next one is taken before the call, Unsubscribe() moves it on if the handler removes it
+    _cursors = &cursor;
+    while (cursor.next) {
+        QiotSubscription *sub = cursor.next;
+        cursor.next = sub == cursor.last ? NULL : sub->_next;
+        if (sub->_handler)
+            sub->_handler(property);
+    }
+    _cursors = cursor.outer;
+}
+
+QiotSubscription::~QiotSubscription()
+{
+    if (_model)
+        _model->Unsubscribe(*this);
+}
+
+bool ThingModel::Subscribe(const char *id, QiotSubscription &sub)
+{
+    QiotData *property = GetPropertyCtx(id);
+
+    if (!property)
+        return false;
+    return Subscribe(property - _properties->_childs.data(), sub);
+}
+
+bool ThingModel::Subscribe(uint8_t index, QiotSubscription &sub)
+{
+    if (index >= _subscriptions.size())
+        return false;
+    if (sub._model)
+        sub._model->Unsubscribe(sub);
+
+    QiotSubscription **tail = &_subscriptions[index];
+    sub._prev = NULL;
+    while (*tail) {
+        sub._prev = *tail;
+        tail = &(*tail)->_next;
+    }
+    *tail = &sub;
+    sub._next = NULL;
+    sub._model = this;
+    sub._index = index;
+    return true;
+}
+
+void ThingModel::Unsubscribe(QiotSubscription &sub)
+{
+    if (sub._model != this)
+        return;
+    for (DispatchCursor *cursor = _cursors; cursor; cursor = cursor->outer) {
+        if (cursor->next == &sub)
+            cursor->next = cursor->last == &sub ? NULL : sub._next;
+        if (cursor->last == &sub)
+            cursor->last = sub._prev;
+    }
+    if (sub._prev)
+        sub._prev->_next = sub._next;
+    else
+        _subscriptions[sub._index] = sub._next;
+    if (sub._next)
+        sub._next->_prev = sub._prev;
+    sub._model = NULL;
+    sub._prev = NULL;
+    sub._next = NULL;
+}
+
+// the subscriptions are not linked to a model destroyed
+void ThingModel::UnsubscribeAll()
+{
+    for (auto first : _subscriptions) {
+        for (QiotSubscription *sub = first; sub;) {
+            QiotSubscription *next = sub->_next;
+            sub->_model = NULL;
+            sub->_prev = NULL;
+            sub->_next = NULL;
+            sub = next;
+        }
+    }
+    _subscriptions.clear();
+}
+
+void ThingModel::PropertiesNotify(const uint8_t *ids, uint8_t num)
+{
+    QiotData *changed[BLE_QIOT_PROPERTY_ID_MAX];
+    uint8_t changedNum = 0;
+
+    for (uint8_t i = 0; i < num && changedNum < BLE_QIOT_PROPERTY_ID_MAX; i++) {
+        QiotData *property = GetPropertyCtx(ids[i]);
+        if (!property)
+            continue;
+        changed[changedNum++] = property;
+        PropertyNotify(*property);
+    }
+    if (!changedNum)
+        return;
+    for (auto hander : _changesHandler)
+        (*hander)(changed, changedNum);
+}
+
+bool ThingModel::ReportProperty(uint8_t index)
+{
+    if (!PropertyValid(index))
+        return false;
+    return ReportProperties(index, index + 1);
+}
+
+bool ThingModel::ReportProperties()
+{
+    if (!_valid || !_properties)
+        return false;
+    return ReportProperties(0, PropertiesSize());
+}
+
+void ThingModel::SetPartialReport(uint16_t fullEvery)
+{
+    _fullEvery = fullEvery;
+    _partials.assign(PropertiesSize(), 0);
+}
+
+bool ThingModel::SetDeadband(const char *id, float absolute, float relative, float hysteresis)
+{
+    QiotData *property = GetPropertyCtx(id);
+
+    if (!property || (property->_type != BLE_QIOT_DATA_TYPE_INT && property->_type != BLE_QIOT_DATA_TYPE_FLOAT) ||
+        absolute < 0 || relative < 0 || hysteresis < 0) {
+        ble_qiot_log_e("property %s cannot have a deadband\n", id);
+        return false;
+    }
+    if (_deadbands.size() < PropertiesSize())
+        _deadbands.resize(PropertiesSize(), Deadband());
+    Deadband &deadband = _deadbands[property - _properties->_childs.data()];
+    deadband.absolute = absolute;
+    deadband.relative = relative;
+    deadband.hysteresis = hysteresis;
+    return true;
+}
+
+uint32_t ThingModel::ReportSuppressed(const char *id)
+{
+    QiotData *property = GetPropertyCtx(id);
+
+    if (!property)
+        return 0;
+    unsigned int index = property - _properties->_childs.data();
+    return index < _deadbands.size() ? _deadbands[index].suppressed : 0;
+}
+
+double ThingModel::NumericValue(QiotData &dat)
+{
+    if (dat._type == BLE_QIOT_DATA_TYPE_FLOAT)
+        return QiotDataTraits<float>::Get(dat);
+    return QiotDataTraits<int>::Get(dat);
+}
+
+void ThingModel::SetNumericValue(QiotData &dat, double val)
+{
+    if (dat._type == BLE_QIOT_DATA_TYPE_FLOAT)
+        QiotDataTraits<float>::Set(dat, val);
+    else
+        QiotDataTraits<int>::Set(dat, lround(val));
+}
+
+int ThingModel::AddSeries(const char *id, uint16_t window, uint8_t aggregates)
+{
+    QiotData *property = GetPropertyCtx(id);
+    uint8_t type = property ? property->GetType() : BLE_QIOT_DATA_TYPE_BUTT;
+    int num = 0;
+    bool ok = false;
+
+    for (uint8_t bit = QIOT_AGGREGATE_MIN; bit <= QIOT_AGGREGATE_LAST; bit <<= 1)
+        num += (aggregates & bit) ? 1 : 0;
+    switch (type) {
+    case BLE_QIOT_DATA_TYPE_INT:
+    case BLE_QIOT_DATA_TYPE_FLOAT:
+        ok = num == 1 && aggregates < QIOT_AGGREGATE_PACK;
+        break;
+    case BLE_QIOT_DATA_TYPE_ARRAY | BLE_QIOT_ARRAY_INT_BIT_MASK:
+    case BLE_QIOT_DATA_TYPE_ARRAY | BLE_QIOT_ARRAY_FLOAT_BIT_MASK:
+        if (aggregates == QIOT_AGGREGATE_PACK)
+            ok = window <= property->ChildsCount();
+        else
+            ok = num && (unsigned int)num <= property->ChildsCount() && aggregates < QIOT_AGGREGATE_PACK;
+        break;
+    }
+    if (!ok || !window) {
+        ble_qiot_log_e("property %s cannot be sampled by window %d aggregates 0x%x\n", id, window, aggregates);
+        return -1;
+    }
+    _series.push_back(Series());
+    Series &series = _series.back();
+    series.index = property - _properties->_childs.data();
+    series.aggregates = aggregates;
+    series.window = window;
+    if (aggregates == QIOT_AGGREGATE_PACK)
+        series.samples.resize(window);
+    return _series.size() - 1;
+}
+
+bool ThingModel::Sample(int series, double val)
+{
+    if (series < 0 || (unsigned int)series >= _series.size())
+        return false;
+    Series &entry = _series[series];
+
+    if (entry.aggregates == QIOT_AGGREGATE_PACK) {
+        entry.samples[entry.head] = val;
+        entry.head = (entry.head + 1) % entry.window;
+        entry.count += entry.count < entry.window ? 1 : 0;
+    } else {
+        entry.min = entry.count && entry.min < val ? entry.min : val;
+        entry.max = entry.count && entry.max > val ? entry.max : val;
+        entry.sum = entry.count ? entry.sum + val : val;
+        entry.count++;
+    }
+    entry.last = val;
+    if (++entry.pending < entry.window)
+        return true;
+    return FlushSeries(series);
+}
+
+bool ThingModel::FlushSeries(int series)
+{
+    if (series < 0 || (unsigned int)series >= _series.size())
+        return false;
+    Series &entry = _series[series];
+    QiotData &property = _properties->_childs[entry.index];
+
+    if (!entry.count)
+        return true;
+    entry.pending = 0;
+    if (entry.aggregates == QIOT_AGGREGATE_PACK) {
+        // the oldest first
+        uint16_t start = (entry.head + entry.window - entry.count) % entry.window;
+        for (uint32_t i = 0; i < entry.count; i++)
+            SetNumericValue(property._childs[i], entry.samples[(start + i) % entry.window]);
+        property.SetArrayLen(entry.count);
+    } else {
+        double vals[] = {entry.min, entry.max, entry.sum / entry.count, entry.last};
+        unsigned int num = 0;
+        for (unsigned int i = 0; i < sizeof(vals) / sizeof(vals[0]); i++) {
+            if (!(entry.aggregates & (1 << i)))
+                continue;
+            if (property._type == BLE_QIOT_DATA_TYPE_ARRAY)
+                SetNumericValue(property._childs[num], vals[i]);
+            else
+                SetNumericValue(property, vals[i]);
+            num++;
+        }
+        if (property._type == BLE_QIOT_DATA_TYPE_ARRAY)
+            property.SetArrayLen(num);
+    }
+    if (!ReportProperty(entry.index))
+        return false;
+    entry.count = 0;
+    return true;
+}
+
+bool ThingModel::ReportProperties(uint8_t start, uint8_t end)
+{
+    bool send = false;
+    bool ret = true;
+
+    for (uint8_t i = start; i < end; i++)
+        send |= ReportPrepare(i);
+    if (send) {
+        QiotCtxScope scope(_ctx);
+        ret = !ble_user_property_get_report_data(start, end);
+    } else {
+        // counted as the core does for the properties with no data to post
+        QiotCtxScope scope(_ctx);
+        BLE_QIOT_METRIC_ADD(BLE_QIOT_METRIC_REPORT_SUPPRESSED, end - start);
+    }
+    for (uint8_t i = start; i < end; i++)
+        ReportFinish(i, send && ret);
+    return ret;
+}
+
+// the members of a struct not changed are skipped by a partial report, a property within its deadband is skipped
+// whole. false if nothing of the property is to send
+bool ThingModel::ReportPrepare(uint8_t index)
+{
+    QiotData &property = _properties->_childs[index];
+
+    if (index < _deadbands.size() &&
+        (_deadbands[index].absolute || _deadbands[index].relative || _deadbands[index].hysteresis)) {
+        Deadband &deadband = _deadbands[index];
+        if (!deadband.valid)
+            return true;
+        double delta = NumericValue(property) - deadband.reported;
+        double band = fmax(deadband.absolute, deadband.relative * fabs(deadband.reported));
+        if (deadband.direction * delta < 0)
+            band += deadband.hysteresis;
+        if (fabs(delta) > band)
+            return true;
+        property._skip = true;
+        deadband.suppressed++;
+        return false;
+    }
+    if (!_fullEvery || property._type != BLE_QIOT_DATA_TYPE_STRUCT || index >= _partials.size() ||
+        _partials[index] + 1 >= _fullEvery)
+        return true;
+    bool changed = false;
+    for (auto &member : property._childs) {
+        member._skip = !member.Changed();
+        changed |= !member._skip;
+    }
+    return changed;
+}
+
+void ThingModel::ReportFinish(uint8_t index, bool sent)
+{
+    QiotData &property = _properties->_childs[index];
+    bool skipped = false;
+    bool posted = false;
+
+    for (auto &member : property._childs) {
+        skipped |= member._skip;
+        posted |= !member._skip;
+        member._skip = false;
+    }
+    if (property._skip) {
+        property._skip = false;
+        return;
+    }
+    if (!sent)
+        return;
+    if (index < _deadbands.size() &&
+        (property._type == BLE_QIOT_DATA_TYPE_INT || property._type == BLE_QIOT_DATA_TYPE_FLOAT)) {
+        Deadband &deadband = _deadbands[index];
+        double val = NumericValue(property);
+        if (deadband.valid && val != deadband.reported)
+            deadband.direction = val > deadband.reported ? 1 : -1;
+        deadband.reported = val;
+        deadband.valid = true;
+    }
+    // a report of all the members is a full one, even if partial
+    if (index < _partials.size() && property._type == BLE_QIOT_DATA_TYPE_STRUCT) {
+        if (!skipped)
+            _partials[index] = 0;
+        else if (posted)
+            _partials[index]++;
+    }
+    property.ClearChanged();
 }
 
 QiotData* ThingModel::GetEventCtx(uint8_t index)
@@ -640,6 +1328,24 @@ QiotData* ThingModel::GetEventCtx(uint8_t index)
     return (_events->_childs.data() + index);
 }
 
+QiotData* ThingModel::GetEventCtx(const char *id)
+{
+    if (!_valid || !_events)
+        return NULL;
+    for (auto it = _events->_childs.begin(); it != _events->_childs.end(); ++it)
+        if (it->_id == id)
+            return &(*it);
+    return NULL;
+}
+
+bool ThingModel::PostEvent(uint8_t index)
+{
+    if (!GetEventCtx(index))
+        return false;
+    QiotCtxScope scope(_ctx);
+    return BLE_QIOT_RS_OK == ble_event_post(index);
+}
+
 QiotData* ThingModel::GetActionInputCtx(uint8_t index)
 {
     if (!_valid || !_actions || (index >= _actions->_childs.size())) {
@@ -657,3 +1363,122 @@ QiotData* ThingModel::GetActionOutputCtx(uint8_t index)
     }
     return _actions->_childs[index].GetChildCtx(1);
 }
+
+// the timestamp in us wraps in 71 minutes
+#define QIOT_ACTION_TIMEOUT_MAX_MS (3600 * 1000)
+
+bool ThingModel::SetActionHandler(const char *id, QiotActionHandler handler, uint32_t timeoutMs)
+{
+    if (!_valid || !_actions || timeoutMs > QIOT_ACTION_TIMEOUT_MAX_MS)
+        return false;
+    for (unsigned int i = 0; i < _actions->_childs.size() && i < _actionRuns.size(); i++) {
+        if (_actions->_childs[i]._id == id) {
+            _actionRuns[i].handler = handler;
+            _actionRuns[i].timeout = timeoutMs * 1000;
+            return true;
+        }
+    }
+    ble_qiot_log_e("action %s not found\n", id);
+    return false;
+}
+
+int ThingModel::ActionsNotify(uint8_t index, uint8_t output_flag[])
+{
+    if (index >= _actionRuns.size() || !_actionRuns[index].handler)
+        return BLE_QIOT_REPLY_SUCCESS;
+
+    ActionRun &action = _actionRuns[index];
+    uint32_t state = __atomic_load_n(&action.state, __ATOMIC_SEQ_CST);
+    if (state & (ACTION_RUNNING | ACTION_IN_HANDLER)) {
+        ble_qiot_log_e("action %s is running\n", _actions->_childs[index].ID());
+        return BLE_QIOT_REPLY_FAIL;
+    }
+    uint32_t run = (state | (ACTION_RUN - 1)) + 1;
+    action.started = ble_get_timestamp_us();
+    __atomic_store_n(&action.state, run | ACTION_RUNNING | ACTION_IN_HANDLER, __ATOMIC_SEQ_CST);
+    action.handler(QiotAction(this, index, run));
+    // a run completed while the handler was running is replied here, with the reply of the data write
+    state = __atomic_fetch_and(&action.state, ~(uint32_t)ACTION_IN_HANDLER, __ATOMIC_SEQ_CST);
+    if (state & ACTION_RUNNING)
+        return BLE_QIOT_ACTION_REPLY_DEFERRED;
+    if (state & ACTION_FAILED)
+        return BLE_QIOT_REPLY_FAIL;
+    ActionOutputFlags(index, output_flag);
+    return BLE_QIOT_REPLY_SUCCESS;
+}
+
+bool ThingModel::ActionComplete(uint8_t index, uint32_t run, bool success)
+{
+    if (index >= _actionRuns.size())
+        return false;
+
+    ActionRun &action = _actionRuns[index];
+    uint32_t state = __atomic_load_n(&action.state, __ATOMIC_SEQ_CST);
+    do {
+        if ((state & ~(ACTION_RUN - 1)) != run || !(state & ACTION_RUNNING))
+            return false;
+    } while (!__atomic_compare_exchange_n(&action.state, &state,
+                                          (state & ~ACTION_RUNNING) | (success ? 0 : ACTION_FAILED), false,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+    if (state & ACTION_IN_HANDLER)
+        return true;
+    return ActionReply(index, success ? BLE_QIOT_REPLY_SUCCESS : BLE_QIOT_REPLY_FAIL);
+}
+
+bool ThingModel::ActionsTimeout()
+{
+    uint32_t now = ble_get_timestamp_us();
+    bool pending = false;
+
+    for (unsigned int i = 0; i < _actionRuns.size(); i++) {
+        ActionRun &action = _actionRuns[i];
+        uint32_t state = __atomic_load_n(&action.state, __ATOMIC_SEQ_CST);
+        if (!(state & ACTION_RUNNING) || !action.timeout)
+            continue;
+        // a handler still running is timed out after it returns
+        if ((state & ACTION_IN_HANDLER) || now - action.started < action.timeout ||
+            !__atomic_compare_exchange_n(&action.state, &state, (state & ~ACTION_RUNNING) | ACTION_FAILED, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            pending = true;
+            continue;
+        }
+        ble_qiot_log_e("action %s timed out\n", _actions->_childs[i].ID());
+        BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_ACTION_TIMEOUT);
+        ActionReply(i, BLE_QIOT_REPLY_FAIL);
+    }
+    return pending;
+}
+
+bool ThingModel::ActionReply(uint8_t index, int8_t result)
+{
+    uint8_t output_flag[BLE_QIOT_PROPERTY_ID_MAX] = {0};
+
+    if (BLE_QIOT_REPLY_SUCCESS == result)
+        ActionOutputFlags(index, output_flag);
+    QiotCtxScope scope(_ctx);
+    return BLE_QIOT_RS_OK == ble_action_reply(index, result, output_flag, sizeof(output_flag));
+}
+
+// all the output params are replied
+void ThingModel::ActionOutputFlags(uint8_t index, uint8_t output_flag[])
+{
+    QiotData *output = GetActionOutputCtx(index);
+
+    for (unsigned int i = 0; output && i < output->ChildsCount() && i < BLE_QIOT_PROPERTY_ID_MAX; i++)
+        output_flag[i] = 1;
+}
+
+QiotData *QiotAction::Input()
+{
+    return _model ? _model->GetActionInputCtx(_index) : NULL;
+}
+
+QiotData *QiotAction::Output()
+{
+    return _model ? _model->GetActionOutputCtx(_index) : NULL;
+}
+
+bool QiotAction::Complete(bool success)
+{
+    return _model && _model->ActionComplete(_index, _run, success);
+}
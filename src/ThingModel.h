@@ -2,12 +2,24 @@
 
 #include <string>
 #include <vector>
+#include <cstddef>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <functional>
 #include <list>
+#include <type_traits>
 #include "CJsonObject.h"
+#include "core/ble_qiot_export.h"
+#include "core/ble_qiot_template.h"
 
 class ThingModel;
+template <typename T> class PropertyHandle;
+
+// the c++ type of a property value: bool, int, float, an enum type for enum, uint32_t for timestamp and const char *
+// for string. no traits for other types, so a PropertyHandle of them does not compile
+template <typename T, typename Enable = void>
+struct QiotDataTraits;
 
 class QiotData {
 
@@ -18,13 +30,15 @@ public:
     bool SetValue(uint32_t val);
     bool SetValue(const char *str);
     bool SetValue(const char *dat, int len);
+    // the value from the remote is accepted by SetValue(dat, len), nothing is set
+    bool CheckValue(const char *dat, int len);
     bool SetValue(unsigned int index, uint32_t val);
     bool SetValue(unsigned int index, const char *val, int len);
 
     int GetValue(uint8_t index, char *buf, uint16_t buf_len);
     int GetValue(char *buf, uint16_t buf_len);
     uint32_t GetValue() {
-        return _val;
+        return Raw();
     }
     int ValueLen();
     QiotData *GetChildCtx(uint8_t index);
@@ -33,25 +47,347 @@ public:
     unsigned int ChildsCount() {
         return _childs.size();
     }
+    // the live elements of an array, the first ArrayLen() of the ChildsCount() allocated from the model are sent. it
+    // is the size of the model until set, the remote sets it on a write
+    unsigned int ArrayLen() {
+        return _len;
+    }
+    bool SetArrayLen(unsigned int len);
     const char *ID() {
         return _id.c_str();
     }
+    bool Bound() {
+        return _bind != NULL;
+    }
+    // changed since the last report, a struct or an array if any member is. a bound value is compared with the value
+    // reported
+    bool Changed();
+    // for internal, not sent by the report being encoded
+    bool Skipped() {
+        return _skip;
+    }
 
     // for debug
     void Dump(const char *preFormat = "");
 
+private:
+    void ReserveValue();
+    bool Bind(void *addr, uint16_t size, int type);
+    void Unbind();
+    void ClearChanged();
+    uint32_t StringHash();
+    // the value not of a string, in _val or in the memory bound
+    uint32_t Raw() {
+        if (!_bind)
+            return _val;
+        switch (_bindSize) {
+        case sizeof(uint8_t): {
+            uint8_t val;
+            memcpy(&val, _bind, sizeof(val));
+            return val;
+        }
+        case sizeof(uint16_t): {
+            uint16_t val;
+            memcpy(&val, _bind, sizeof(val));
+            return val;
+        }
+        }
+        uint32_t val;
+        memcpy(&val, _bind, sizeof(val));
+        return val;
+    }
+    void SetRaw(uint32_t val) {
+        _dirty = true;
+        if (!_bind) {
+            _val = val;
+        } else if (_bindSize == sizeof(uint8_t)) {
+            uint8_t v = val;
+            memcpy(_bind, &v, sizeof(v));
+        } else if (_bindSize == sizeof(uint16_t)) {
+            uint16_t v = val;
+            memcpy(_bind, &v, sizeof(v));
+        } else {
+            memcpy(_bind, &val, sizeof(val));
+        }
+    }
+
 private:
     std::string _id;
     int _type;
     uint32_t _val;
     std::vector<char> _strVal;
+    bool _strNul;  // the terminating nul of _strVal is added for Get(), not part of the value sent back
+    uint16_t _strMax;  // the max length of a string in the model, the terminating nul not counted
+    void *_bind;  // the memory of the user holding the value instead of _val or _strVal, see ThingModel::BindProperty()
+                  // _val is then the value reported, or the hash of a string
+    uint16_t _bindSize;  // the size of the bound variable, a string is a char array with the terminating nul
+    uint8_t _len;  // the live elements of an array
+    bool _dirty;  // set since the last report
+    bool _skip;  // not sent by the report being encoded, see ThingModel::SetPartialReport()
     std::vector<QiotData> _childs;
 
+private:
+    friend class ThingModel;
+    template <typename T, typename Enable> friend struct QiotDataTraits;
+};
+
+template <>
+struct QiotDataTraits<bool> {
+    static const int type = BLE_QIOT_DATA_TYPE_BOOL;
+    static bool Set(QiotData &dat, bool val) {
+        dat.SetRaw(val);
+        return true;
+    }
+    static bool Get(QiotData &dat) {
+        return dat.Raw();
+    }
+};
+
+template <>
+struct QiotDataTraits<int> {
+    static const int type = BLE_QIOT_DATA_TYPE_INT;
+    static bool Set(QiotData &dat, int val) {
+        dat.SetRaw((uint32_t)val);
+        return true;
+    }
+    static int Get(QiotData &dat) {
+        return (int)dat.Raw();
+    }
+};
+
+// the value is the bits of the float, as it is sent
+template <>
+struct QiotDataTraits<float> {
+    static const int type = BLE_QIOT_DATA_TYPE_FLOAT;
+    static bool Set(QiotData &dat, float val) {
+        uint32_t bits;
+        memcpy(&bits, &val, sizeof(val));
+        dat.SetRaw(bits);
+        return true;
+    }
+    static float Get(QiotData &dat) {
+        uint32_t bits = dat.Raw();
+        float val;
+        memcpy(&val, &bits, sizeof(val));
+        return val;
+    }
+};
+
+template <>
+struct QiotDataTraits<uint32_t> {
+    static const int type = BLE_QIOT_DATA_TYPE_TIME;
+    static bool Set(QiotData &dat, uint32_t val) {
+        dat.SetRaw(val);
+        return true;
+    }
+    static uint32_t Get(QiotData &dat) {
+        return dat.Raw();
+    }
+};
+
+template <typename T>
+struct QiotDataTraits<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+    static const int type = BLE_QIOT_DATA_TYPE_ENUM;
+    static bool Set(QiotData &dat, T val) {
+        dat.SetRaw((uint16_t)val);
+        return true;
+    }
+    static T Get(QiotData &dat) {
+        return (T)dat.Raw();
+    }
+};
+
+template <>
+struct QiotDataTraits<const char *> {
+    static const int type = BLE_QIOT_DATA_TYPE_STRING;
+    static bool Set(QiotData &dat, const char *val) {
+        return dat.SetValue(val);
+    }
+    static const char *Get(QiotData &dat) {
+        if (dat._bind)
+            return (const char *)dat._bind;
+        return dat._strVal.empty() ? "" : dat._strVal.data();
+    }
+};
+
+// the type in the model of a variable bound by ThingModel::BindProperty(), the types of QiotDataTraits and a char array
+// for a string
+template <typename T>
+struct QiotBindType {
+    static const int type = QiotDataTraits<T>::type;
+};
+
+template <size_t N>
+struct QiotBindType<char[N]> {
+    static const int type = BLE_QIOT_DATA_TYPE_STRING;
+};
+
+// a member of a struct of the user bound to a member of a struct property, by QIOT_BIND_FIELD()
+struct QiotBindField {
+    const char *id;  // the id of the member in the model
+    uint16_t offset;
+    uint16_t size;
+    int type;
+};
+
+// the field of member of the struct type Struct for the member id of the model, e.g.
+//     static const QiotBindField envFields[] = {
+//         QIOT_BIND_FIELD(Env, temperature, "temp"),
+//         QIOT_BIND_FIELD(Env, name, "name"),
+//     };
+#define QIOT_BIND_FIELD(Struct, member, id)                                                          \
+    {                                                                                                \
+        id, offsetof(Struct, member), sizeof(((Struct *)0)->member),                                 \
+            QiotBindType<typename std::remove_reference<decltype(((Struct *)0)->member)>::type>::type \
+    }
+
+// a property resolved once by ThingModel::Property(), Set() and Report() index the property directly with no lookup
+// of the id, the type is checked when resolved. the handle is valid until the model is loaded again
+template <typename T>
+class PropertyHandle
+{
+public:
+    PropertyHandle()
+        : _model(NULL),
+          _dat(NULL),
+          _index(0)
+    {}
+
+    bool Valid() const {
+        return _dat != NULL;
+    }
+    bool Set(T val) {
+        return _dat && QiotDataTraits<T>::Set(*_dat, val);
+    }
+    T Get() const {
+        return _dat ? QiotDataTraits<T>::Get(*_dat) : T();
+    }
+    // report the value set before
+    bool Report();
+    bool Report(T val) {
+        return Set(val) && Report();
+    }
+
+private:
+    PropertyHandle(ThingModel *model, QiotData *dat, uint8_t index)
+        : _model(model),
+          _dat(dat),
+          _index(index)
+    {}
+
+private:
+    ThingModel *_model;
+    QiotData *_dat;
+    uint8_t _index;
+
 private:
     friend class ThingModel;
 };
 
 typedef std::function<void(QiotData&)> QiotDataHandler;
+// the properties set by one control of the remote, each once
+typedef std::function<void(QiotData *const *changed, uint8_t num)> QiotChangesHandler;
+
+// a run of an action, passed to its handler, see ThingModel::SetActionHandler(). the handler reads the input, sets the
+// output and completes the run, at once or later from any task. copies refer to the same run, they are ignored after
+// the run is completed or timed out
+class QiotAction
+{
+public:
+    QiotAction()
+        : _model(NULL),
+          _index(0),
+          _run(0)
+    {}
+
+    bool Valid() const {
+        return _model != NULL;
+    }
+    QiotData *Input();
+    QiotData *Output();
+    // reply the output, or a failure. false if the run is over or the reply is not sent
+    bool Complete(bool success = true);
+
+private:
+    QiotAction(ThingModel *model, uint8_t index, uint32_t run)
+        : _model(model),
+          _index(index),
+          _run(run)
+    {}
+
+private:
+    ThingModel *_model;
+    uint8_t _index;
+    uint32_t _run;
+
+private:
+    friend class ThingModel;
+};
+
+typedef std::function<void(QiotAction action)> QiotActionHandler;
+
+// a handler of the writes of the remote to one property, see ThingModel::Subscribe(). the subscription is the node of
+// the list of its property, in the memory of the user, so subscribing and dispatching do not allocate. it is
+// unsubscribed when destroyed
+class QiotSubscription
+{
+public:
+    explicit QiotSubscription(QiotDataHandler handler = nullptr)
+        : _handler(handler),
+          _model(NULL),
+          _prev(NULL),
+          _next(NULL),
+          _index(0)
+    {}
+    ~QiotSubscription();
+
+    void SetHandler(QiotDataHandler handler) {
+        _handler = handler;
+    }
+    bool Subscribed() const {
+        return _model != NULL;
+    }
+
+private:
+    QiotDataHandler _handler;
+    ThingModel *_model;
+    QiotSubscription *_prev;
+    QiotSubscription *_next;
+    uint8_t _index;  // of the property
+
+private:
+    QiotSubscription(QiotSubscription&) = delete;
+    void operator=(QiotSubscription&) = delete;
+    friend class ThingModel;
+};
+
+// what a series of samples reports each window, see ThingModel::AddSeries()
+enum QiotAggregate {
+    QIOT_AGGREGATE_MIN = 0x01,
+    QIOT_AGGREGATE_MAX = 0x02,
+    QIOT_AGGREGATE_AVG = 0x04,
+    QIOT_AGGREGATE_LAST = 0x08,
+    QIOT_AGGREGATE_PACK = 0x10,  // the samples, in the order taken
+};
+
+// runs the core on the device of ctx until the end of the scope
+class QiotCtxScope
+{
+public:
+    explicit QiotCtxScope(ble_qiot_ctx_t *ctx)
+        : _prev(ble_qiot_ctx_switch(ctx))
+    {}
+    ~QiotCtxScope() {
+        ble_qiot_ctx_switch(_prev);
+    }
+
+private:
+    ble_qiot_ctx_t *_prev;
+
+private:
+    QiotCtxScope(QiotCtxScope&) = delete;
+    void operator=(QiotCtxScope&) = delete;
+};
 
 class ThingModel
 {
@@ -61,9 +397,13 @@ public:
         : _valid(false),
           _properties(NULL),
           _events(NULL),
-          _actions(NULL)
+          _actions(NULL),
+          _ctx(NULL),
+          _fullEvery(0),
+          _cursors(NULL)
     {}
     ~ThingModel() {
+        UnsubscribeAll();
         if (_properties)
             delete _properties;
         if (_events)
@@ -82,50 +422,244 @@ public:
     QiotData *GetPropertyCtx(const char *id);
     bool ReportProperty(const char *id, const char *val);
     bool ReportProperty(const char *id, uint32_t val);
+    bool ReportProperty(uint8_t index);
+    // all the properties in one report
+    bool ReportProperties();
+    // a struct property reports the members changed only, with a report of all the members after fullEvery - 1 of
+    // them. a struct with no member changed is not sent. 0 is off, the default, 1 reports all the members too. the
+    // reports of ble_event_report_property() and the replies to the remote are always full
+    void SetPartialReport(uint16_t fullEvery);
+    // an int or float property is not reported while it is within a band of the value reported last, the band is the
+    // larger of absolute and relative times the value reported. a change back against the direction of the last one
+    // reported needs hysteresis more. the first report is always sent. all 0 removes the deadband. the reports of
+    // ble_event_report_property() are not filtered
+    bool SetDeadband(const char *id, float absolute, float relative = 0, float hysteresis = 0);
+    // the reports of the property dropped by its deadband
+    uint32_t ReportSuppressed(const char *id);
+    // sample a property, one report every window samples instead of one a sample. an int or float property gets one
+    // aggregate of the window, an int or float array gets the aggregates set in the order of QiotAggregate, or the
+    // samples with QIOT_AGGREGATE_PACK and a window not over the elements of the array. the memory is fixed when
+    // added. returns the series for Sample(), -1 on error
+    int AddSeries(const char *id, uint16_t window, uint8_t aggregates);
+    // a sample of the series, the window is reported when full. if the report fails the next one is a window later,
+    // with the aggregates of the samples since the last report or the last window samples packed
+    bool Sample(int series, double val);
+    // report the samples taken so far
+    bool FlushSeries(int series);
+    // resolve a property by id for the set and report in O(1), the handle is not valid if the id is not found or the
+    // property is not of T, see QiotDataTraits
+    template <typename T>
+    PropertyHandle<T> Property(const char *id);
+    // keep the value of a property in the memory of the user, the reports read it and the writes of the remote store to
+    // it with no copy in between. the type is checked against the model, see QiotBindType. onChange is called after the
+    // remote writes the property, in the task of the ble stack as the handlers. the memory is read and written in that
+    // task too, the user locks it if it is changed by another task. the binding is until UnbindProperty()
+    template <typename T>
+    bool BindProperty(const char *id, T &val, QiotDataHandler onChange = nullptr) {
+        return Bind(id, &val, sizeof(T), QiotBindType<T>::type, 0, NULL, 0, onChange);
+    }
+    // a struct property, the members of the model with no field are kept in the model
+    template <typename S, size_t M>
+    bool BindProperty(const char *id, S &val, const QiotBindField (&fields)[M], QiotDataHandler onChange = nullptr) {
+        return Bind(id, &val, sizeof(S), BLE_QIOT_DATA_TYPE_STRUCT, 0, fields, M, onChange);
+    }
+    // an array property, the array of the user has at least the elements of the model
+    template <typename T, size_t N>
+    bool BindArray(const char *id, T (&val)[N], QiotDataHandler onChange = nullptr) {
+        return Bind(id, val, sizeof(T), QiotBindType<T>::type, N, NULL, 0, onChange);
+    }
+    template <typename S, size_t N, size_t M>
+    bool BindArray(const char *id, S (&val)[N], const QiotBindField (&fields)[M], QiotDataHandler onChange = nullptr) {
+        return Bind(id, val, sizeof(S), BLE_QIOT_DATA_TYPE_STRUCT, N, fields, M, onChange);
+    }
+    // the values are back in the model, not set
+    bool UnbindProperty(const char *id);
+    // the handler is called for the writes to every property, Subscribe() for those to one
     void AddPropertyHandler(QiotDataHandler *handler) {
         _propertiesHandler.push_back(handler);
     }
     void RemovePropertyHandler(QiotDataHandler *handler) {
         _propertiesHandler.remove(handler);
     }
+    // a control of the remote is set as a whole or not at all, the property handlers are called for each property set
+    // and then the changes handlers once with all of them
+    void AddChangesHandler(QiotChangesHandler *handler) {
+        _changesHandler.push_back(handler);
+    }
+    void RemoveChangesHandler(QiotChangesHandler *handler) {
+        _changesHandler.remove(handler);
+    }
+    // the handler of sub is called for the writes of the remote to the property only, after the property handlers and
+    // in the order subscribed. sub is linked in place and lives until unsubscribed, a subscription of another property
+    // moves it. a handler may subscribe and unsubscribe any subscription but not destroy its own, one unsubscribed is
+    // not called any more and one subscribed is called from the next write on
+    bool Subscribe(const char *id, QiotSubscription &sub);
+    template <typename T>
+    bool Subscribe(const PropertyHandle<T> &property, QiotSubscription &sub) {
+        return property.Valid() && Subscribe(property._index, sub);
+    }
+    void Unsubscribe(QiotSubscription &sub);
     unsigned int PropertiesSize() {
         if (_properties)
             return _properties->ChildsCount();
         return 0;
     }
     QiotData *GetEventCtx(uint8_t index);
+    QiotData *GetEventCtx(const char *id);
+    // post an event with the values of its params in the model, the core encodes them in one pass
+    bool PostEvent(uint8_t index);
+    // set the params of event id in the order of the model and post it. a param is of the c++ type of its type, see
+    // QiotDataTraits, or nullptr to keep the value in the model, as for a struct or an array set by GetEventCtx(). the
+    // params not given are kept too. nothing is posted if the event is not found or a param is not of the type given or
+    // not set, the params before it are set
+    template <typename... T>
+    bool PostEvent(const char *id, T... params);
     QiotData *GetActionInputCtx(uint8_t index);
     QiotData *GetActionOutputCtx(uint8_t index);
+    // run the action id by handler in the task of the ble stack, the reply with the output is sent when the run is
+    // completed. a run not completed in timeoutMs is replied failed, 0 waits forever, at most an hour. runs of different
+    // actions are in flight at once, a request for an action still running is replied failed. the timeout needs the
+    // model of an LLsync. nullptr removes the handler, the actions with no handler are replied at once with no output
+    bool SetActionHandler(const char *id, QiotActionHandler handler, uint32_t timeoutMs = BLE_QIOT_ACTION_TIMEOUT_MS);
 
     // for debug
     void Dump();
     // for internal
-    void PropertyNotify(QiotData &property) {
-        for (auto hander : _propertiesHandler)
-            (*hander)(property);
-    }
-    void ActionsNotify(uint8_t index, uint8_t output_flag[]) {
+    void SetContext(ble_qiot_ctx_t *ctx) {
+        _ctx = ctx;
     }
+    void PropertyNotify(QiotData &property);
+    void PropertiesNotify(const uint8_t *ids, uint8_t num);
+    // the reply to send now, e_ble_qiot_reply, or BLE_QIOT_ACTION_REPLY_DEFERRED
+    int ActionsNotify(uint8_t index, uint8_t output_flag[]);
+    // reply the runs timed out, true if runs with a timeout are still in flight
+    bool ActionsTimeout();
 
 private:
     bool PropertyValid(uint8_t index);
+    bool SetParams(QiotData&, uint8_t) {
+        return true;
+    }
+    template <typename T, typename... R>
+    bool SetParams(QiotData &event, uint8_t index, T param, R... rest) {
+        QiotData &dat = event._childs[index];
+        return dat._type == QiotDataTraits<T>::type && QiotDataTraits<T>::Set(dat, param) &&
+               SetParams(event, index + 1, rest...);
+    }
+    template <typename... R>
+    bool SetParams(QiotData &event, uint8_t index, std::nullptr_t, R... rest) {
+        return SetParams(event, index + 1, rest...);
+    }
+    bool Subscribe(uint8_t index, QiotSubscription &sub);
+    void UnsubscribeAll();
+    bool Bind(const char *id, void *addr, size_t size, int type, size_t count, const QiotBindField *fields,
+              size_t fieldsNum, QiotDataHandler &onChange);
+    bool BindStruct(QiotData &dat, uint8_t *base, size_t size, const QiotBindField *fields, size_t fieldsNum);
+    bool ReportProperties(uint8_t start, uint8_t end);
+    bool ReportPrepare(uint8_t index);
+    void ReportFinish(uint8_t index, bool sent);
+    bool ActionComplete(uint8_t index, uint32_t run, bool success);
+    bool ActionReply(uint8_t index, int8_t result);
+    void ActionOutputFlags(uint8_t index, uint8_t output_flag[]);
+    double NumericValue(QiotData &dat);
+    void SetNumericValue(QiotData &dat, double val);
 
 private:
     bool ParseProperties(neb::CJsonObject &properties);
     bool ParseEvents(neb::CJsonObject &events);
     bool ParseActions(neb::CJsonObject &actions);
+    bool ParseDefine(neb::CJsonObject &item, QiotData &parent);
     bool ParseStruct(neb::CJsonObject &Struct, QiotData &dat, const char *typeKey, bool noArray);
-    bool ParseArray(neb::CJsonObject &array, QiotData &dat, const char *typeKey, bool noStruct);
+    bool ParseArray(neb::CJsonObject &array, QiotData &dat, const char *typeKey, bool noStruct, uint8_t size);
 
 private:
     bool _valid;
     QiotData *_properties;
     std::list<QiotDataHandler*> _propertiesHandler;
+    std::vector<QiotDataHandler> _bindHandlers;  // the onChange of the bound properties, by index
+    std::list<QiotChangesHandler*> _changesHandler;
+    std::vector<QiotSubscription*> _subscriptions;  // the first subscription of each property, by index
     QiotData *_events;
     QiotData *_actions;
     std::list<QiotDataHandler*> _actionsHandler;
+    ble_qiot_ctx_t *_ctx;  // the device the reports are sent from
+    uint16_t _fullEvery;  // see SetPartialReport()
+    std::vector<uint16_t> _partials;  // the partial reports of each property since its last full one
+    struct Deadband {
+        float absolute;
+        float relative;
+        float hysteresis;
+        uint32_t suppressed;
+        double reported;  // the value reported last
+        int8_t direction;  // of the change reported last, 1 up, -1 down, 0 none yet
+        bool valid;  // reported once
+    };
+    std::vector<Deadband> _deadbands;  // by index, the absolute, relative and hysteresis 0 for none
+    struct Series {
+        uint8_t index;  // of the property
+        uint8_t aggregates;
+        uint16_t window;
+        uint16_t pending;  // the samples since the last report tried
+        uint16_t head;  // where the next packed sample goes
+        uint32_t count;  // the samples since the last report, at most window of them packed
+        double min;
+        double max;
+        double sum;
+        double last;
+        std::vector<double> samples;  // the ring of the packed samples, window of them
+    };
+    std::vector<Series> _series;
+    // the subscriptions left to a dispatch running, moved on if they are unsubscribed
+    struct DispatchCursor {
+        QiotSubscription *next;
+        QiotSubscription *last;  // the last subscribed when the dispatch started
+        DispatchCursor *outer;  // the dispatch running the handler which started this one
+    };
+    DispatchCursor *_cursors;  // the innermost dispatch running
+    // the state of a run, the number of the run in the bits from ACTION_RUN and the flags below it. it is changed by
+    // atomic operations, the handler, the task completing the run and the timer race for it
+    enum {
+        ACTION_RUNNING = 0x01,  // not completed
+        ACTION_IN_HANDLER = 0x02,  // the handler has not returned, ActionsNotify() replies a run completed in it
+        ACTION_FAILED = 0x04,
+        ACTION_RUN = 0x08,
+    };
+    struct ActionRun {
+        QiotActionHandler handler;
+        uint32_t timeout;  // unit: us, 0 for none
+        uint32_t started;  // ble_get_timestamp_us() of the run
+        uint32_t state;
+    };
+    std::vector<ActionRun> _actionRuns;  // by index
 
 private:
     ThingModel(ThingModel&) = delete;
     void operator=(ThingModel&) = delete;
+    friend class QiotAction;
 };
+
+template <typename T>
+PropertyHandle<T> ThingModel::Property(const char *id)
+{
+    QiotData *property = GetPropertyCtx(id);
+
+    if (!property || property->_type != QiotDataTraits<T>::type)
+        return PropertyHandle<T>();
+    return PropertyHandle<T>(this, property, property - _properties->_childs.data());
+}
+
+template <typename T>
+bool PropertyHandle<T>::Report()
+{
+    return _dat && _model->ReportProperty(_index);
+}
+
+template <typename... T>
+bool ThingModel::PostEvent(const char *id, T... params)
+{
+    QiotData *event = GetEventCtx(id);
+
+    if (!event || sizeof...(T) > event->ChildsCount() || !SetParams(*event, 0, params...))
+        return false;
+    return PostEvent((uint8_t)(event - _events->_childs.data()));
+}
@@ -13,6 +13,8 @@
 extern "C" {
 #endif
 
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_DEVICE_LEVEL
+
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -32,9 +34,12 @@ extern "C" {
 #include "esp_bt_device.h"
 #include "esp_spi_flash.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/timers.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 // divece info which defined in explorer platform
 static TimerHandle_t ota_reboot_timer;
@@ -63,11 +68,21 @@ int ble_read_flash(uint32_t flash_addr, char *read_buf, uint16_t read_len)
 }
 
 typedef struct ble_esp32_timer_id_ {
-    uint8_t       type;
-    ble_timer_cb  handle;
-    TimerHandle_t timer;
+    uint8_t         type;
+    ble_timer_cb    handle;
+    TimerHandle_t   timer;
+    ble_qiot_ctx_t *ctx;  // the device which created the timer
 } ble_esp32_timer_id;
 
+// the timer task is shared by all the devices, run the callback on the device which created the timer
+static void ble_esp32_timer_handle(TimerHandle_t timer)
+{
+    ble_esp32_timer_id *p_timer = (ble_esp32_timer_id *)pvTimerGetTimerID(timer);
+
+    (void)ble_qiot_ctx_switch(p_timer->ctx);
+    p_timer->handle(p_timer);
+}
+
 ble_timer_t ble_timer_create(uint8_t type, ble_timer_cb timeout_handle)
 {
     ble_esp32_timer_id *p_timer = malloc(sizeof(ble_esp32_timer_id));
@@ -78,6 +93,7 @@ ble_timer_t ble_timer_create(uint8_t type, ble_timer_cb timeout_handle)
     p_timer->type   = type;
     p_timer->handle = timeout_handle;
     p_timer->timer  = NULL;
+    p_timer->ctx    = ble_qiot_ctx_current();
 
     return (ble_timer_t)p_timer;
 }
@@ -89,7 +105,8 @@ ble_qiot_ret_status_t ble_timer_start(ble_timer_t timer_id, uint32_t period)
     if (NULL == p_timer->timer) {
         p_timer->timer =
             (ble_timer_t)xTimerCreate("ota_timer", period / portTICK_PERIOD_MS,
-                                      p_timer->type == BLE_TIMER_PERIOD_TYPE ? pdTRUE : pdFALSE, NULL, p_timer->handle);
+                                      p_timer->type == BLE_TIMER_PERIOD_TYPE ? pdTRUE : pdFALSE, p_timer,
+                                      ble_esp32_timer_handle);
     }
     xTimerReset(p_timer->timer, portMAX_DELAY);
 
@@ -113,6 +130,66 @@ ble_qiot_ret_status_t ble_timer_delete(ble_timer_t timer_id)
     return BLE_QIOT_RS_OK;
 }
 
+uint32_t ble_get_timestamp_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+uint8_t ble_get_core_id(void)
+{
+    return (uint8_t)xPortGetCoreID();
+}
+
+#if BLE_QIOT_DISPATCH_ENABLE
+static TaskHandle_t sg_dispatch_task = NULL;
+static SemaphoreHandle_t sg_dispatch_freed = NULL;  // the task gives it back to the ble stack task when a buffer is free
+static void (*sg_dispatch_entry)(void) = NULL;
+
+static void ble_dispatch_task_entry(void *param)
+{
+    sg_dispatch_entry();
+    vTaskDelete(NULL);
+}
+
+ble_qiot_ret_status_t ble_dispatch_task_create(void (*entry)(void))
+{
+    sg_dispatch_entry = entry;
+    // not the task notification of the ble stack task, the stack may use it
+    if (NULL == sg_dispatch_freed && NULL == (sg_dispatch_freed = xSemaphoreCreateBinary())) {
+        ble_qiot_log_e("dispatch semaphore create failed");
+        return BLE_QIOT_RS_ERR;
+    }
+    if (pdPASS != xTaskCreate(ble_dispatch_task_entry, "llsync", BLE_QIOT_DISPATCH_TASK_STACK, NULL,
+                              BLE_QIOT_DISPATCH_TASK_PRIO, &sg_dispatch_task)) {
+        ble_qiot_log_e("dispatch task create failed");
+        return BLE_QIOT_RS_ERR;
+    }
+    return BLE_QIOT_RS_OK;
+}
+
+void ble_dispatch_wakeup(void)
+{
+    // the notification value counts the wakeups, so a wakeup before the wait is not lost
+    xTaskNotifyGive(sg_dispatch_task);
+}
+
+void ble_dispatch_wait(void)
+{
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+void ble_dispatch_producer_wakeup(void)
+{
+    // a binary semaphore keeps the wakeup given before the wait
+    xSemaphoreGive(sg_dispatch_freed);
+}
+
+ble_qiot_ret_status_t ble_dispatch_producer_wait(uint32_t timeout_ms)
+{
+    return pdTRUE == xSemaphoreTake(sg_dispatch_freed, pdMS_TO_TICKS(timeout_ms)) ? BLE_QIOT_RS_OK : BLE_QIOT_RS_ERR;
+}
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+
 // return ATT MTU
 uint16_t ble_get_user_data_mtu_size(void)
 {
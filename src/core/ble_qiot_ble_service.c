@@ -13,6 +13,8 @@
 extern "C" {
 #endif
 
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_SERVICE_LEVEL
+
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -68,6 +70,10 @@ enum {
 #define PREPARE_BUF_MAX_SIZE    1024
 #define CHAR_DECLARATION_SIZE   (sizeof(uint8_t))
 
+#if BLE_QIOT_DISPATCH_ENABLE && (BLE_QIOT_DISPATCH_BUF_SIZE < PREPARE_BUF_MAX_SIZE)
+#error "BLE_QIOT_DISPATCH_BUF_SIZE must hold the longest write, PREPARE_BUF_MAX_SIZE"
+#endif
+
 #define ADV_CONFIG_FLAG (1 << 0)
 
 static uint8_t adv_config_done = 0;
@@ -81,6 +87,10 @@ typedef struct {
 } prepare_type_env_t;
 
 static prepare_type_env_t prepare_write_env;
+// the gatts callbacks run in the bluedroid task one by one, the long write and its response are kept in static
+// buffers instead of allocating them on every write
+static uint8_t        prepare_buf[PREPARE_BUF_MAX_SIZE];
+static esp_gatt_rsp_t prepare_rsp;
 
 static uint8_t raw_adv_data[32] = {
     /* flags */
@@ -299,37 +309,26 @@ void example_prepare_write_event_env(esp_gatt_if_t gatts_if, prepare_type_env_t
     ESP_LOGI(LLSYNC_LOG_TAG, "prepare write, handle = %d, value len = %d", param->write.handle, param->write.len);
     esp_gatt_status_t status = ESP_GATT_OK;
     if (prepare_write_env->prepare_buf == NULL) {
-        prepare_write_env->prepare_buf = (uint8_t *)malloc(PREPARE_BUF_MAX_SIZE * sizeof(uint8_t));
+        prepare_write_env->prepare_buf = prepare_buf;
         prepare_write_env->prepare_len = 0;
         prepare_write_env->handle      = 0;
-        if (prepare_write_env->prepare_buf == NULL) {
-            ESP_LOGE(LLSYNC_LOG_TAG, "%s, Gatt_server prep no mem", __func__);
-            status = ESP_GATT_NO_RESOURCES;
-        }
-    } else {
-        if (param->write.offset > PREPARE_BUF_MAX_SIZE) {
-            status = ESP_GATT_INVALID_OFFSET;
-        } else if ((param->write.offset + param->write.len) > PREPARE_BUF_MAX_SIZE) {
-            status = ESP_GATT_INVALID_ATTR_LEN;
-        }
+    }
+    if (param->write.offset > PREPARE_BUF_MAX_SIZE) {
+        status = ESP_GATT_INVALID_OFFSET;
+    } else if ((param->write.offset + param->write.len) > PREPARE_BUF_MAX_SIZE) {
+        status = ESP_GATT_INVALID_ATTR_LEN;
     }
     /*send response when param->write.need_rsp is true */
     if (param->write.need_rsp) {
-        esp_gatt_rsp_t *gatt_rsp = (esp_gatt_rsp_t *)malloc(sizeof(esp_gatt_rsp_t));
-        if (gatt_rsp != NULL) {
-            gatt_rsp->attr_value.len      = param->write.len;
-            gatt_rsp->attr_value.handle   = param->write.handle;
-            gatt_rsp->attr_value.offset   = param->write.offset;
-            gatt_rsp->attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
-            memcpy(gatt_rsp->attr_value.value, param->write.value, param->write.len);
-            esp_err_t response_err =
-                esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, gatt_rsp);
-            if (response_err != ESP_OK) {
-                ESP_LOGE(LLSYNC_LOG_TAG, "Send response error");
-            }
-            free(gatt_rsp);
-        } else {
-            ESP_LOGE(LLSYNC_LOG_TAG, "%s, malloc failed", __func__);
+        prepare_rsp.attr_value.len      = param->write.len;
+        prepare_rsp.attr_value.handle   = param->write.handle;
+        prepare_rsp.attr_value.offset   = param->write.offset;
+        prepare_rsp.attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+        memcpy(prepare_rsp.attr_value.value, param->write.value, param->write.len);
+        esp_err_t response_err =
+            esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, &prepare_rsp);
+        if (response_err != ESP_OK) {
+            ESP_LOGE(LLSYNC_LOG_TAG, "Send response error");
         }
     }
     if (status != ESP_GATT_OK) {
@@ -352,10 +351,7 @@ void example_exec_write_event_env(prepare_type_env_t *prepare_write_env, esp_ble
     } else {
         ESP_LOGI(LLSYNC_LOG_TAG, "ESP_GATT_PREP_WRITE_CANCEL");
     }
-    if (prepare_write_env->prepare_buf) {
-        free(prepare_write_env->prepare_buf);
-        prepare_write_env->prepare_buf = NULL;
-    }
+    prepare_write_env->prepare_buf = NULL;
     prepare_write_env->prepare_len = 0;
 }
 
@@ -20,7 +20,9 @@ extern "C" {
 #include <stdio.h>
 #include <stdint.h>
 
+#if defined(ESP_PLATFORM)
 #include "esp_log.h"
+#endif
 
 #define BLE_QIOT_SDK_VERSION "1.5.0"  // sdk version
 #define BLE_QIOT_SDK_DEBUG   0        // sdk debug
@@ -50,12 +52,89 @@ extern "C" {
 #define __ORDER_BIG_ENDIAN__    4321
 #define __BYTE_ORDER__          __ORDER_LITTLE_ENDIAN__
 
+// record the logs into a lock-free ring buffer instead of printing them in the caller context, the records are
+// formatted later by ble_qiot_log_ring_drain() in a low priority task, or read out by ble_qiot_log_ring_read() and
+// decoded offline. the hot path only copies the arguments, it never blocks and drops the record if the ring is full
+#define BLE_QIOT_LOG_RING_ENABLE 0
+#if BLE_QIOT_LOG_RING_ENABLE
+#define BLE_QIOT_LOG_RING_SIZE      64  // the number of records, must be power of 2
+#define BLE_QIOT_LOG_RING_MAX_ARGS  4   // the max number of arguments kept in a record
+#define BLE_QIOT_LOG_RING_DATA_SIZE 32  // the bytes of string arguments or hex snippet kept in a record
+#endif  // BLE_QIOT_LOG_RING_ENABLE
+
+// the compile-time log level of each module, the value is one of e_ble_qiot_log_level: 0 none, 1 error, 2 warning,
+// 3 info, 4 debug, 5 all. the log sites above the module level compile to nothing, their format strings and arguments
+// are not in the image, ble_qiot_set_log_level() still controls the levels kept. for release builds set the levels to
+// 1 or 2
+#define BLE_QIOT_LOG_BUILD_LEVEL      (BLE_QIOT_SDK_DEBUG ? 5 : 3)
+#define BLE_QIOT_LOG_DATA_LEVEL       BLE_QIOT_LOG_BUILD_LEVEL  // property, event and action data
+#define BLE_QIOT_LOG_OTA_LEVEL        BLE_QIOT_LOG_BUILD_LEVEL  // ota
+#define BLE_QIOT_LOG_DEVICE_LEVEL     BLE_QIOT_LOG_BUILD_LEVEL  // bind, connection and device info
+#define BLE_QIOT_LOG_SERVICE_LEVEL    BLE_QIOT_LOG_BUILD_LEVEL  // gatt service and message dispatch
+#define BLE_QIOT_LOG_THINGMODEL_LEVEL BLE_QIOT_LOG_BUILD_LEVEL  // data template parsing in ThingModel
+
+// trace the latency of the messages from Tencent Lianlian, from the gatt write to the reply notification. the time
+// spent in each stage is aggregated into histograms per message type, and the recent stages are kept for exporting
+// as chrome trace. the trace hooks compile to nothing if disabled
+#define BLE_QIOT_TRACE_ENABLE 0
+#if BLE_QIOT_TRACE_ENABLE
+#define BLE_QIOT_TRACE_HIST_BUCKETS 20   // bucket i counts the latency in [2^(i-1), 2^i) us, the last one is overflow
+#define BLE_QIOT_TRACE_EVENT_NUM    128  // the number of recent stages kept for exporting, must be power of 2
+#define BLE_QIOT_TRACE_DEFERRED_NUM 4    // the number of deferred actions traced until replied at the same time
+#endif  // BLE_QIOT_TRACE_ENABLE
+
+// count the protocol traffic and errors, see e_ble_qiot_metric. the counters are kept per cpu core and updated by
+// relaxed atomic add, read them by ble_qiot_metrics_snapshot()
+#define BLE_QIOT_METRICS_ENABLE 1
+#if BLE_QIOT_METRICS_ENABLE
+#define BLE_QIOT_METRICS_CORE_NUM 2  // the number of cpu cores
+#endif  // BLE_QIOT_METRICS_ENABLE
+
+// measure the stack used by the entry points of the sdk, see e_ble_qiot_stack_entry. the stack below the entry point
+// is painted on the way in and scanned on the way out, read the high-water marks by ble_qiot_stack_get(). the tasks
+// calling the entry points need BLE_QIOT_STACK_PAINT_SIZE bytes of stack more, for development only
+#define BLE_QIOT_STACK_ENABLE 0
+#if BLE_QIOT_STACK_ENABLE
+#define BLE_QIOT_STACK_PAINT_SIZE (2048 + BLE_QIOT_EVENT_MAX_SIZE)  // unit: byte, more than the deepest entry point
+#endif  // BLE_QIOT_STACK_ENABLE
+
+// handle the writes from the remote in a worker task instead of the ble stack callback. the callback copies the write
+// into a pooled buffer and queues it, the message parsing, user handlers, signing and flash writes run in the worker.
+// the callback blocks while all the buffers are in use until the worker frees one, a write acknowledged is never
+// dropped, see the dispatch counters in e_ble_qiot_metric. the worker is opt-in, with 0 all of the handling runs in the
+// ble stack callback
+#define BLE_QIOT_DISPATCH_ENABLE 0
+#if BLE_QIOT_DISPATCH_ENABLE
+#define BLE_QIOT_DISPATCH_POOL_SIZE  8     // the number of buffers, must be power of 2
+#define BLE_QIOT_DISPATCH_BUF_SIZE   1024  // at least the longest write of the port, PREPARE_BUF_MAX_SIZE on the esp32
+#define BLE_QIOT_DISPATCH_TASK_STACK (4096 + BLE_QIOT_EVENT_MAX_SIZE)  // unit: byte
+#define BLE_QIOT_DISPATCH_TASK_PRIO  5
+#define BLE_QIOT_DISPATCH_WAIT_MS    100   // a wait of the callback for a free buffer longer is counted as stalled
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+
+// the storage of a string in the thing model is reserved when the model is loaded, the max length of the string in the
+// model and at most BLE_QIOT_STRING_RESERVE_SIZE bytes, so setting the value does not allocate. a longer string
+// allocates when it grows past the reserve, set it to the longest max of the strings in your model for a steady state
+// without any heap allocation, at the cost of the memory reserved by every string
+#define BLE_QIOT_STRING_RESERVE_SIZE 256  // unit: byte
+
+// an action handled by ThingModel::SetActionHandler() is replied when its handler completes it, or replied failed after
+// its timeout. the timeouts are checked every BLE_QIOT_ACTION_TIMER_MS while an action is in flight
+#define BLE_QIOT_ACTION_TIMEOUT_MS 10000  // the default timeout, unit: ms
+#define BLE_QIOT_ACTION_TIMER_MS   100    // unit: ms
+
 // in some BLE stack ble_qiot_log_hex() maybe not work, user can use there own hexdump function
+#if defined(ESP_PLATFORM)
 #define BLE_QIOT_USER_DEFINE_HEXDUMP 1
+#else
+#define BLE_QIOT_USER_DEFINE_HEXDUMP 0
+#endif
 
-#if BLE_QIOT_USER_DEFINE_HEXDUMP
+#if BLE_QIOT_USER_DEFINE_HEXDUMP && !BLE_QIOT_LOG_RING_ENABLE
 #define ble_qiot_log_hex(level, hex_name, data, data_len) \
     do {                                                  \
+        if (!BLE_QIOT_LOG_ENABLED(level))                 \
+            break;                                        \
         esp_log_buffer_hex(hex_name, data, data_len);     \
     } while (0)
 #endif  // BLE_QIOT_USER_DEFINE_HEXDUMP
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+#include "ble_qiot_context.h"
+
+ble_qiot_ctx_t           llsync_g_ctx_default;
+__thread ble_qiot_ctx_t *llsync_g_ctx_current = NULL;
+
+ble_qiot_ctx_t *ble_qiot_ctx_create(void *user)
+{
+    ble_qiot_ctx_t *ctx = (ble_qiot_ctx_t *)calloc(1, sizeof(ble_qiot_ctx_t));
+
+    if (NULL != ctx) {
+        ctx->user = user;
+    }
+    return ctx;
+}
+
+void ble_qiot_ctx_destroy(ble_qiot_ctx_t *ctx)
+{
+    if (NULL == ctx || &llsync_g_ctx_default == ctx) {
+        return;
+    }
+#if BLE_QIOT_BUTTON_BROADCAST
+    if (NULL != ctx->bind_timer) {
+        ble_timer_delete(ctx->bind_timer);
+    }
+#endif  // BLE_QIOT_BUTTON_BROADCAST
+#if BLE_QIOT_LLSYNC_STANDARD && BLE_QIOT_SUPPORT_OTA
+    if (NULL != ctx->ota.timer) {
+        ble_timer_delete(ctx->ota.timer);
+    }
+#endif  // BLE_QIOT_LLSYNC_STANDARD && BLE_QIOT_SUPPORT_OTA
+    if (llsync_g_ctx_current == ctx) {
+        llsync_g_ctx_current = NULL;
+    }
+    free(ctx);
+}
+
+ble_qiot_ctx_t *ble_qiot_ctx_default(void)
+{
+    return &llsync_g_ctx_default;
+}
+
+ble_qiot_ctx_t *ble_qiot_ctx_current(void)
+{
+    return ble_qiot_ctx_get();
+}
+
+ble_qiot_ctx_t *ble_qiot_ctx_switch(ble_qiot_ctx_t *ctx)
+{
+    ble_qiot_ctx_t *prev = ble_qiot_ctx_get();
+
+    llsync_g_ctx_current = ctx;
+    return prev;
+}
+
+void ble_qiot_ctx_user_set(ble_qiot_ctx_t *ctx, void *user)
+{
+    ctx->user = user;
+}
+
+void *ble_qiot_ctx_user(const ble_qiot_ctx_t *ctx)
+{
+    return ctx->user;
+}
+
+void ble_qiot_ctx_port_set(ble_qiot_ctx_t *ctx, void *port)
+{
+    ctx->port = port;
+}
+
+void *ble_qiot_ctx_port(const ble_qiot_ctx_t *ctx)
+{
+    return ctx->port;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef QCLOUD_BLE_QIOT_CONTEXT_H
+#define QCLOUD_BLE_QIOT_CONTEXT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble_qiot_config.h"
+#include "ble_qiot_export.h"
+#include "ble_qiot_import.h"
+#include "ble_qiot_llsync_device.h"
+#include "ble_qiot_llsync_ota.h"
+
+// the state of a device, everything the protocol keeps between two messages
+struct ble_qiot_ctx_t_ {
+    void *user;  // the owner of the device, see ble_qiot_ctx_user_set()
+    void *port;  // the data of the port, see ble_qiot_ctx_port_set()
+
+    // ble_qiot_llsync_device.c
+    ble_core_data             core_data;    // ble data storage in flash
+    ble_device_info           device_info;  // device info storage in flash
+    e_llsync_bind_state       llsync_bind_state;
+    e_llsync_connection_state llsync_connection_state;
+    e_ble_connection_state    ble_connection_state;
+    uint16_t                  llsync_mtu;                         // the mtu for llsync slice data
+    ble_adv_cache_t           adv_cache[E_LLSYNC_BIND_SUCC + 1];  // broadcast data of each bind state
+
+    // ble_qiot_service.c, llsync support data fragment, so we need to package all the data before parsing
+    ble_event_slice_t slice_data;
+    // This flag is use to avoid attacker jump "ble_conn_get_authcode()" step, then
+    // send 'E_DEV_MSG_CONN_SUCC' msg, and device straightly set 'E_LLSYNC_CONNECTED' flag.
+    bool conn_flag;
+#if BLE_QIOT_BUTTON_BROADCAST
+    ble_timer_t bind_timer;
+#endif  // BLE_QIOT_BUTTON_BROADCAST
+#if BLE_QIOT_SECURE_BIND
+    ble_bind_data bind_auth_data;
+#endif  // BLE_QIOT_SECURE_BIND
+
+#if BLE_QIOT_LLSYNC_STANDARD && BLE_QIOT_SUPPORT_OTA
+    ble_ota_ctx_t ota;  // ble_qiot_llsync_ota.c
+#endif  // BLE_QIOT_LLSYNC_STANDARD && BLE_QIOT_SUPPORT_OTA
+};
+
+extern ble_qiot_ctx_t           llsync_g_ctx_default;
+extern __thread ble_qiot_ctx_t *llsync_g_ctx_current;
+
+// the device of the calling thread, the core reads its state from here
+static inline ble_qiot_ctx_t *ble_qiot_ctx_get(void)
+{
+    return llsync_g_ctx_current ? llsync_g_ctx_current : &llsync_g_ctx_default;
+}
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_CONTEXT_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_SERVICE_LEVEL
+
+#include "ble_qiot_dispatch.h"
+
+#if BLE_QIOT_DISPATCH_ENABLE
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "ble_qiot_context.h"
+#include "ble_qiot_import.h"
+#include "ble_qiot_log.h"
+#include "ble_qiot_metrics.h"
+
+#if (BLE_QIOT_DISPATCH_POOL_SIZE & (BLE_QIOT_DISPATCH_POOL_SIZE - 1)) != 0
+#error "BLE_QIOT_DISPATCH_POOL_SIZE must be power of 2"
+#endif
+
+typedef struct {
+    ble_dispatch_handler handler;
+    ble_qiot_ctx_t *     ctx;  // the device the write belongs to
+    uint16_t             len;
+    uint8_t              buf[BLE_QIOT_DISPATCH_BUF_SIZE];
+} ble_dispatch_slot_t;
+
+// single producer single consumer ring, the slots are the buffer pool. the producer owns the slots from head to
+// tail + POOL_SIZE, the consumer owns the slots from tail to head
+static ble_dispatch_slot_t sg_dispatch_pool[BLE_QIOT_DISPATCH_POOL_SIZE];
+static uint32_t            sg_dispatch_head    = 0;
+static uint32_t            sg_dispatch_tail    = 0;
+static uint8_t             sg_dispatch_peak    = 0;
+static bool                sg_dispatch_running = false;
+static bool                sg_dispatch_blocked = false;  // the producer waits for the consumer to free a slot
+static bool                sg_dispatch_failed  = false;  // the task is shared by the devices, not tried for each one
+
+static void ble_dispatch_task(void)
+{
+    uint32_t             head = 0;
+    uint32_t             tail = 0;
+    ble_dispatch_slot_t *slot = NULL;
+
+    for (;;) {
+        ble_dispatch_wait();
+        head = __atomic_load_n(&sg_dispatch_head, __ATOMIC_ACQUIRE);
+        tail = __atomic_load_n(&sg_dispatch_tail, __ATOMIC_RELAXED);
+        while (tail != head) {
+            slot = &sg_dispatch_pool[tail & (BLE_QIOT_DISPATCH_POOL_SIZE - 1)];
+            (void)ble_qiot_ctx_switch(slot->ctx);
+            slot->handler(slot->buf, slot->len);
+            // give the slot back to the producer, seq_cst against the blocked flag so a wakeup is not missed
+            __atomic_store_n(&sg_dispatch_tail, ++tail, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&sg_dispatch_blocked, __ATOMIC_SEQ_CST)) {
+                ble_dispatch_producer_wakeup();
+            }
+            head = __atomic_load_n(&sg_dispatch_head, __ATOMIC_ACQUIRE);
+        }
+    }
+}
+
+ble_qiot_ret_status_t ble_qiot_dispatch_init(void)
+{
+    if (sg_dispatch_running) {
+        return BLE_QIOT_RS_OK;
+    }
+    if (sg_dispatch_failed) {
+        return BLE_QIOT_RS_ERR;
+    }
+    if (BLE_QIOT_RS_OK != ble_dispatch_task_create(ble_dispatch_task)) {
+        sg_dispatch_failed = true;
+        // the port logs a real failure, a port without the task on purpose is not an error
+        ble_qiot_log_d("no dispatch task, handle the writes in the callback");
+        return BLE_QIOT_RS_ERR;
+    }
+    __atomic_store_n(&sg_dispatch_running, true, __ATOMIC_RELEASE);
+
+    return BLE_QIOT_RS_OK;
+}
+
+// wait until at most depth writes are queued. the callback is blocked as the link layer flow control would, a write
+// already acknowledged to the remote is never dropped. the worker wakes it up when a slot is freed, a wait timed out
+// is counted as stalled and waited again
+static uint32_t ble_dispatch_wait_depth(uint32_t head, uint32_t depth)
+{
+    uint32_t queued = head - __atomic_load_n(&sg_dispatch_tail, __ATOMIC_ACQUIRE);
+
+    if (queued <= depth) {
+        return queued;
+    }
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_DISPATCH_BLOCKED);
+    __atomic_store_n(&sg_dispatch_blocked, true, __ATOMIC_SEQ_CST);
+    for (;;) {
+        queued = head - __atomic_load_n(&sg_dispatch_tail, __ATOMIC_SEQ_CST);
+        if (queued <= depth) {
+            break;
+        }
+        if (BLE_QIOT_RS_OK != ble_dispatch_producer_wait(BLE_QIOT_DISPATCH_WAIT_MS)) {
+            BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_DISPATCH_STALLED);
+            ble_qiot_log_w("dispatch worker stalled, %u writes queued", (unsigned)queued);
+        }
+    }
+    __atomic_store_n(&sg_dispatch_blocked, false, __ATOMIC_RELAXED);
+
+    return queued;
+}
+
+// the writes and the events are handled in the order received, one at a time for all the devices
+static void ble_dispatch_enqueue(ble_dispatch_handler handler, const uint8_t *buf, uint16_t len)
+{
+    uint32_t             head  = sg_dispatch_head;
+    uint32_t             depth = 0;
+    ble_dispatch_slot_t *slot  = NULL;
+
+    if (!__atomic_load_n(&sg_dispatch_running, __ATOMIC_ACQUIRE)) {
+        BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_DISPATCH_INLINE);
+        handler(buf, len);
+        return;
+    }
+    if (len > BLE_QIOT_DISPATCH_BUF_SIZE) {
+        // not queued, handled after the worker is done with the writes before it
+        (void)ble_dispatch_wait_depth(head, 0);
+        BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_DISPATCH_INLINE);
+        handler(buf, len);
+        return;
+    }
+
+    depth = ble_dispatch_wait_depth(head, BLE_QIOT_DISPATCH_POOL_SIZE - 1);
+    if (depth + 1 > sg_dispatch_peak) {
+        sg_dispatch_peak = depth + 1;
+    }
+
+    slot          = &sg_dispatch_pool[head & (BLE_QIOT_DISPATCH_POOL_SIZE - 1)];
+    slot->handler = handler;
+    slot->ctx     = ble_qiot_ctx_current();
+    slot->len     = len;
+    if (len) {
+        memcpy(slot->buf, buf, len);
+    }
+    __atomic_store_n(&sg_dispatch_head, head + 1, __ATOMIC_RELEASE);
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_DISPATCH_QUEUED);
+
+    ble_dispatch_wakeup();
+}
+
+void ble_qiot_dispatch_put(ble_dispatch_handler handler, const uint8_t *buf, uint16_t len)
+{
+    ble_dispatch_enqueue(handler, buf, len);
+}
+
+void ble_qiot_dispatch_event(ble_dispatch_handler handler)
+{
+    ble_dispatch_enqueue(handler, NULL, 0);
+}
+
+uint8_t ble_qiot_dispatch_peak(void)
+{
+    return sg_dispatch_peak;
+}
+
+uint8_t ble_qiot_dispatch_pending(void)
+{
+    return __atomic_load_n(&sg_dispatch_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&sg_dispatch_tail, __ATOMIC_ACQUIRE);
+}
+
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+
+#ifdef __cplusplus
+}
+#endif
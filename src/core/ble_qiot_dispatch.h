@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef QCLOUD_BLE_QIOT_DISPATCH_H
+#define QCLOUD_BLE_QIOT_DISPATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "ble_qiot_export.h"
+
+typedef void (*ble_dispatch_handler)(const uint8_t *buf, uint16_t len);
+
+#if BLE_QIOT_DISPATCH_ENABLE
+// queue the write to the worker, the handler is called in the worker with a copy of the buffer
+#define BLE_QIOT_DISPATCH(handler, buf, len) ble_qiot_dispatch_put(handler, buf, len)
+// queue a connection event to the worker, keeping the order with the writes
+#define BLE_QIOT_DISPATCH_EVENT(handler) ble_qiot_dispatch_event(handler)
+
+/**
+ * @brief create the worker, the writes are handled in the callback until the worker is created
+ * @return BLE_QIOT_RS_OK is success, other is error
+ */
+ble_qiot_ret_status_t ble_qiot_dispatch_init(void);
+
+/**
+ * @brief copy the write into a pooled buffer and queue it to the worker, waiting for a free buffer if all are in use.
+ * a write longer than BLE_QIOT_DISPATCH_BUF_SIZE is handled in the caller after the writes queued before it
+ * @note  only one producer is allowed, the ble stack task that calls the write callbacks
+ */
+void ble_qiot_dispatch_put(ble_dispatch_handler handler, const uint8_t *buf, uint16_t len);
+
+/**
+ * @brief queue a connection event to the worker, the handler is called with no data
+ * @note  waits for a free buffer as ble_qiot_dispatch_put()
+ */
+void ble_qiot_dispatch_event(ble_dispatch_handler handler);
+
+/**
+ * @brief the max number of writes waiting in the queue since the worker created
+ */
+uint8_t ble_qiot_dispatch_peak(void);
+
+/**
+ * @brief the number of writes queued and not handled yet
+ */
+uint8_t ble_qiot_dispatch_pending(void);
+#else
+#define BLE_QIOT_DISPATCH(handler, buf, len) handler(buf, len)
+#define BLE_QIOT_DISPATCH_EVENT(handler)     handler(NULL, 0)
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_DISPATCH_H
@@ -85,6 +85,64 @@ typedef enum {
     BLE_QIOT_RS_VALID_SIGN_ERR = -4,
 } ble_qiot_ret_status_t;
 
+// the state of a device. the core works on the context current in the calling thread, the default context if none
+// is selected, so a process hosts a single device without any setup. to host more devices create a context for each
+// one, and select it by ble_qiot_ctx_switch() around ble_qiot_explorer_init(), the sdk api, the write callbacks and the
+// gap callbacks of the device. the callbacks from the sdk, like ble_get_product_id() and the data template functions,
+// are called with the context of the device current, find the device by ble_qiot_ctx_user(ble_qiot_ctx_current())
+typedef struct ble_qiot_ctx_t_ ble_qiot_ctx_t;
+
+/**
+ * @brief create the context of a device
+ * @param user the owner of the device, returned by ble_qiot_ctx_user()
+ * @return the context, NULL if out of memory
+ */
+ble_qiot_ctx_t *ble_qiot_ctx_create(void *user);
+
+/**
+ * @brief release a context created by ble_qiot_ctx_create()
+ * @note  the device must be disconnected and no callback of it is running or queued
+ */
+void ble_qiot_ctx_destroy(ble_qiot_ctx_t *ctx);
+
+/**
+ * @brief the context used if none is selected
+ */
+ble_qiot_ctx_t *ble_qiot_ctx_default(void);
+
+/**
+ * @brief the context selected in the calling thread
+ * @return the context, the default one if none is selected
+ */
+ble_qiot_ctx_t *ble_qiot_ctx_current(void);
+
+/**
+ * @brief select the context in the calling thread
+ * @param ctx the context, NULL selects the default one
+ * @return the context selected before, pass it to ble_qiot_ctx_switch() to restore
+ */
+ble_qiot_ctx_t *ble_qiot_ctx_switch(ble_qiot_ctx_t *ctx);
+
+/**
+ * @brief set the owner of the device
+ */
+void ble_qiot_ctx_user_set(ble_qiot_ctx_t *ctx, void *user);
+
+/**
+ * @brief get the owner of the device
+ */
+void *ble_qiot_ctx_user(const ble_qiot_ctx_t *ctx);
+
+/**
+ * @brief set the data of the port for the device, e.g. the flash or the connection of a simulated device
+ */
+void ble_qiot_ctx_port_set(ble_qiot_ctx_t *ctx, void *port);
+
+/**
+ * @brief get the data of the port for the device
+ */
+void *ble_qiot_ctx_port(const ble_qiot_ctx_t *ctx);
+
 /**
  * @brief get llsync services context
  *
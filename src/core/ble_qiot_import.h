@@ -85,11 +85,13 @@ enum {
 };
 typedef void *ble_timer_t;
 
-// timer callback prototype
+// timer callback prototype, param is the timer identifier
 typedef void (*ble_timer_cb)(void *param);
 
 /**
  * @brief create a timer
+ * @note  the callback must be called with the context current in the caller, save ble_qiot_ctx_current() here and
+ *        select it by ble_qiot_ctx_switch() before calling the callback
  * @param type timer type
  * @param timeout_handle timer callback
  * @return timer identifier is return, NULL is error
@@ -118,6 +120,54 @@ ble_qiot_ret_status_t ble_timer_stop(ble_timer_t timer_id);
  */
 ble_qiot_ret_status_t ble_timer_delete(ble_timer_t timer_id);
 
+/**
+ * @brief get a monotonic timestamp
+ * @return the time since boot, unit: us, wrap around is allowed
+ */
+uint32_t ble_get_timestamp_us(void);
+
+/**
+ * @brief get the id of the cpu core running the caller
+ * @return 0 on single core chips, the metrics counters are kept per core
+ */
+uint8_t ble_get_core_id(void);
+
+#if BLE_QIOT_DISPATCH_ENABLE
+/**
+ * @brief create the task handling the writes from the remote, the task runs entry() which never returns
+ * @note  the stack size is BLE_QIOT_DISPATCH_TASK_STACK and the priority BLE_QIOT_DISPATCH_TASK_PRIO
+ * @param entry the task function
+ * @return BLE_QIOT_RS_OK is success, other is error and the core handles the writes in the callback. the port logs
+ *         the failure, it returns an error silently if it handles the writes in the callback on purpose
+ */
+ble_qiot_ret_status_t ble_dispatch_task_create(void (*entry)(void));
+
+/**
+ * @brief wake up the task blocked in ble_dispatch_wait(), called in the ble stack callback
+ * @note  a wakeup before the wait must not be lost
+ */
+void ble_dispatch_wakeup(void);
+
+/**
+ * @brief block the task until ble_dispatch_wakeup() is called
+ */
+void ble_dispatch_wait(void);
+
+/**
+ * @brief wake up the ble stack callback blocked in ble_dispatch_producer_wait(), called in the task
+ * @note  a wakeup before the wait must not be lost
+ */
+void ble_dispatch_producer_wakeup(void);
+
+/**
+ * @brief block the ble stack callback until ble_dispatch_producer_wakeup() is called, waiting for a free buffer or for
+ * the task to finish the writes queued
+ * @param timeout_ms the max time to wait, unit: ms
+ * @return BLE_QIOT_RS_OK if woken up, other is timeout
+ */
+ble_qiot_ret_status_t ble_dispatch_producer_wait(uint32_t timeout_ms);
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+
 #ifdef BLE_QIOT_LLSYNC_STANDARD
 /**
  * @brief  get device product id
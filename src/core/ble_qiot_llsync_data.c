@@ -13,6 +13,8 @@
 extern "C" {
 #endif
 
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_DATA_LEVEL
+
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,7 +30,10 @@ extern "C" {
 #include "ble_qiot_utils_base64.h"
 #include "ble_qiot_log.h"
 #include "ble_qiot_param_check.h"
+#include "ble_qiot_metrics.h"
+#include "ble_qiot_trace.h"
 #include "ble_qiot_service.h"
+#include "ble_qiot_stack.h"
 #include "ble_qiot_template.h"
 #include "ble_qiot_llsync_data.h"
 
@@ -85,41 +90,76 @@ int ble_lldata_parse_tlv(const char *buf, int buf_len, e_ble_tlv *tlv)
     return ret_len;
 }
 
-// handle property data, method is control or get status
-static ble_qiot_ret_status_t ble_lldata_property_data_handle(bool is_request, const char *in_buf, int buf_len)
-{
 #ifdef BLE_QIOT_INCLUDE_PROPERTY
+// check or set the tlvs of property data, the ids set are added to changed. return the reply, or -1 if a tlv cannot be
+// parsed
+static int ble_lldata_property_tlvs_handle(const char *in_buf, int buf_len, bool check, uint32_t *changed)
+{
     uint16_t  parse_len = 0;
     int       ret_len   = 0;
     e_ble_tlv tlv;
-    int8_t    ret = BLE_QIOT_REPLY_SUCCESS;
-
-    ble_qiot_ret_status_t inform_ret = BLE_QIOT_RS_OK;
 
-    ble_qiot_log_d("handle property data");
     while (parse_len < buf_len) {
         memset(&tlv, 0, sizeof(e_ble_tlv));
         ret_len = ble_lldata_parse_tlv(in_buf + parse_len, buf_len - parse_len, &tlv);
         if (ret_len < 0) {
-            return BLE_QIOT_RS_ERR;
+            return -1;
         }
 
         parse_len += ret_len;
         if (parse_len > buf_len) {
             ble_qiot_log_e("invalid peroperty data, %d(property len) > %d(buf len)", parse_len, buf_len);
-            ret = BLE_QIOT_REPLY_DATA_ERR;
-            break;
+            return BLE_QIOT_REPLY_DATA_ERR;
         }
 
-        if (BLE_QIOT_RS_OK != ble_user_property_set_data(&tlv)) {
-            ret = BLE_QIOT_REPLY_FAIL;
-            break;
+        if (check) {
+            if (BLE_QIOT_RS_OK != ble_user_property_check_data(&tlv)) {
+                return BLE_QIOT_REPLY_FAIL;
+            }
         } else {
-            ble_property_change_notify(&tlv);
+            if (BLE_QIOT_RS_OK != ble_user_property_set_data(&tlv)) {
+                return BLE_QIOT_REPLY_FAIL;
+            }
+            *changed |= 1UL << tlv.id;
+        }
+    }
+    return BLE_QIOT_REPLY_SUCCESS;
+}
+#endif //BLE_QIOT_INCLUDE_PROPERTY
+
+// handle property data, method is control or get status. the data is a transaction, nothing is set unless every tlv
+// is valid, and the user is notified once with the properties set
+static ble_qiot_ret_status_t ble_lldata_property_data_handle(bool is_request, const char *in_buf, int buf_len)
+{
+#ifdef BLE_QIOT_INCLUDE_PROPERTY
+    uint32_t changed = 0;  // a bit of each property id set
+    uint8_t  ids[BLE_QIOT_PROPERTY_ID_MAX];
+    uint8_t  id_num = 0;
+    uint8_t  id     = 0;
+    int      ret    = BLE_QIOT_REPLY_SUCCESS;
+
+    ble_qiot_log_d("handle property data");
+    ret = ble_lldata_property_tlvs_handle(in_buf, buf_len, true, NULL);
+    if (ret < 0) {
+        return BLE_QIOT_RS_ERR;
+    }
+    if (BLE_QIOT_REPLY_SUCCESS == ret) {
+        // the check passed, the set fails only if the user changed the model in between
+        ret = ble_lldata_property_tlvs_handle(in_buf, buf_len, false, &changed);
+        BLE_QIOT_TRACE_POINT(BLE_QIOT_TRACE_SET);
+        for (id = 0; id < BLE_QIOT_PROPERTY_ID_MAX; id++) {
+            if (changed & (1UL << id)) {
+                ids[id_num++] = id;
+            }
+        }
+        if (id_num) {
+            ble_property_changes_notify(ids, id_num);
+            BLE_QIOT_TRACE_POINT(BLE_QIOT_TRACE_HANDLER);
         }
     }
     if (is_request) {
-        return ble_event_notify(BLE_QIOT_EVENT_UP_CONTROL_REPLY, NULL, 0, (const char *)&ret, sizeof(int8_t));
+        int8_t reply = (int8_t)ret;
+        return ble_event_notify(BLE_QIOT_EVENT_UP_CONTROL_REPLY, NULL, 0, (const char *)&reply, sizeof(int8_t));
     } else {
         return (BLE_QIOT_REPLY_SUCCESS == ret) ? BLE_QIOT_RS_OK : BLE_QIOT_RS_ERR;
     }
@@ -131,7 +171,7 @@ static ble_qiot_ret_status_t ble_lldata_property_data_handle(bool is_request, co
 
 #ifdef BLE_QIOT_INCLUDE_PROPERTY
 // post property
-ble_qiot_ret_status_t ble_user_property_get_report_data(uint8_t start_id, uint8_t end_id)
+static ble_qiot_ret_status_t ble_user_property_report_handle(uint8_t start_id, uint8_t end_id)
 {
     uint8_t  property_id   = 0;
     uint8_t  property_type = 0;
@@ -165,6 +205,7 @@ ble_qiot_ret_status_t ble_user_property_get_report_data(uint8_t start_id, uint8_
             data_len--;
             data_buf[data_len] = '0';
             ble_qiot_log_d("property: %d no data to post", property_id);
+            BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_REPORT_SUPPRESSED);
         } else {
             if ((BLE_QIOT_DATA_TYPE_STRING == property_type) || (BLE_QIOT_DATA_TYPE_STRUCT == property_type) || (BLE_QIOT_DATA_TYPE_ARRAY == property_type)) {
                 // filling the payload length
@@ -176,9 +217,20 @@ ble_qiot_ret_status_t ble_user_property_get_report_data(uint8_t start_id, uint8_
         }
     }
     // ble_qiot_log_hex(BLE_QIOT_LOG_LEVEL_INFO, "user data", data_buf, data_len);
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_REPORT_SENT);
 
     return ble_event_notify(BLE_QIOT_EVENT_UP_PROPERTY_REPORT, NULL, 0, (const char *)data_buf, data_len);
 }
+
+ble_qiot_ret_status_t ble_user_property_get_report_data(uint8_t start_id, uint8_t end_id)
+{
+    ble_qiot_ret_status_t ret = BLE_QIOT_RS_OK;
+
+    BLE_QIOT_STACK_ENTER(BLE_QIOT_STACK_REPORT);
+    ret = ble_user_property_report_handle(start_id, end_id);
+    BLE_QIOT_STACK_EXIT(BLE_QIOT_STACK_REPORT);
+    return ret;
+}
 #endif //BLE_QIOT_INCLUDE_PROPERTY
 
 // handle control
@@ -244,47 +296,42 @@ ble_qiot_ret_status_t ble_lldata_event_handle(uint8_t id, const char *in_buf, in
     return BLE_QIOT_RS_OK;
 }
 
-// handle action
-ble_qiot_ret_status_t ble_lldata_action_handle(uint8_t action_id, const char *in_buf, int len)
-{
 #ifdef BLE_QIOT_INCLUDE_ACTION
-    POINTER_SANITY_CHECK(in_buf, BLE_QIOT_RS_ERR_PARA);
+static ble_qiot_ret_status_t ble_lldata_action_fail_notify(uint8_t action_id, uint8_t handle_ret)
+{
+    uint8_t header_buf[2] = {BLE_QIOT_REPLY_FAIL, action_id};
+
+    return ble_event_notify(BLE_QIOT_EVENT_UP_ACTION_REPLY, header_buf, sizeof(header_buf),
+                            (const char *)&handle_ret, sizeof(uint8_t));
+}
+
+static ble_qiot_ret_status_t ble_lldata_action_fail_reply(uint8_t action_id, uint8_t handle_ret)
+{
+    ble_lldata_action_fail_notify(action_id, handle_ret);
+    return BLE_QIOT_RS_ERR;
+}
 
-    int      handle_ret       = BLE_QIOT_REPLY_SUCCESS;
+// encode the output of an action and reply, not inlined so the buffer is not on the stack while the handler runs
+static BLE_QIOT_NOINLINE ble_qiot_ret_status_t ble_lldata_action_output_reply(uint8_t        action_id,
+                                                                              const uint8_t *output_flag_array,
+                                                                              uint8_t        output_num)
+{
     uint8_t  output_id        = 0;
     uint8_t  output_type      = 0;
     uint16_t data_len         = 0;
     uint16_t data_buf_off     = 0;
     int      output_param_len = 0;
     uint16_t string_len       = 0;
-    uint8_t  header_buf[2]    = {0};
-
-    uint8_t   output_flag_array[32] = {0};
-    uint8_t   data_buf[BLE_QIOT_EVENT_MAX_SIZE]                 = {0};
-
-    header_buf[0] = BLE_QIOT_REPLY_SUCCESS;
-    header_buf[1] = action_id;
+    uint8_t  header_buf[2]    = {BLE_QIOT_REPLY_SUCCESS, action_id};
 
-    ble_qiot_log_d("input action: %d", action_id);
-    e_ble_tlv tlv;
-    tlv.type = BLE_QIOT_DATA_TYPE_STRUCT;
-    tlv.val = in_buf;
-    tlv.len = len;
-    tlv.id = action_id;
-    if (BLE_QIOT_RS_OK != ble_user_actions_input_set(&tlv)) {
-        ble_qiot_log_e("action id(%d) input value invalid", action_id);
-        goto end;
-    }
-
-    ble_actions_input_notify(action_id, output_flag_array);
+    uint8_t data_buf[BLE_QIOT_EVENT_MAX_SIZE] = {0};
 
-    for (output_id = 0; output_id < sizeof(output_flag_array); output_id++) {
+    for (output_id = 0; output_id < output_num; output_id++) {
         if (output_flag_array[output_id]) {
             output_type = ble_action_get_output_type_by_id(action_id, output_id);
             if (output_type >= BLE_QIOT_DATA_TYPE_BUTT) {
                 ble_qiot_log_e("action id(%d:%d) type invalid", action_id, output_id);
-                handle_ret = BLE_QIOT_REPLY_FAIL;
-                goto end;
+                return ble_lldata_action_fail_reply(action_id, BLE_QIOT_REPLY_FAIL);
             }
             data_buf[data_len++] = BLE_QIOT_PACKAGE_TLV_HEAD(output_type, output_id);
             data_buf_off         = data_len;
@@ -294,8 +341,7 @@ ble_qiot_ret_status_t ble_lldata_action_handle(uint8_t action_id, const char *in
             output_param_len = ble_action_user_handle_output_param(
                 action_id, output_id, (char *)data_buf + data_buf_off, sizeof(data_buf) - data_buf_off);
             if (output_param_len < 0) {
-                handle_ret = BLE_QIOT_REPLY_FAIL;
-                goto end;
+                return ble_lldata_action_fail_reply(action_id, BLE_QIOT_REPLY_FAIL);
             } else if (output_param_len == 0) {
                 // clean the head cause no data to post
                 data_len--;
@@ -314,12 +360,60 @@ ble_qiot_ret_status_t ble_lldata_action_handle(uint8_t action_id, const char *in
     // ble_qiot_log_hex(BLE_QIOT_LOG_LEVEL_INFO, "user data", data_buf, data_len);
     return ble_event_notify(BLE_QIOT_EVENT_UP_ACTION_REPLY, header_buf, sizeof(header_buf), (const char *)data_buf,
                             data_len);
+}
 
-end:
-    header_buf[0] = BLE_QIOT_REPLY_FAIL;
-    ble_event_notify(BLE_QIOT_EVENT_UP_ACTION_REPLY, header_buf, sizeof(header_buf), (const char *)&handle_ret,
-                     sizeof(uint8_t));
-    return BLE_QIOT_RS_ERR;
+// reply an action, the output marked in output_flag if result is BLE_QIOT_REPLY_SUCCESS. BLE_QIOT_RS_OK if sent
+int ble_action_reply(uint8_t action_id, int8_t result, const uint8_t *output_flag, uint8_t output_num)
+{
+    int ret = 0;
+
+    POINTER_SANITY_CHECK(output_flag, BLE_QIOT_RS_ERR_PARA);
+    BLE_QIOT_TRACE_ACTION_REPLY_BEGIN(action_id);
+    if (BLE_QIOT_REPLY_SUCCESS != result) {
+        ret = ble_lldata_action_fail_notify(action_id, result);
+    } else {
+        ret = ble_lldata_action_output_reply(action_id, output_flag, output_num);
+    }
+    BLE_QIOT_TRACE_ACTION_REPLY_END();
+
+    return ret;
+}
+#endif //BLE_QIOT_INCLUDE_ACTION
+
+// handle action
+ble_qiot_ret_status_t ble_lldata_action_handle(uint8_t action_id, const char *in_buf, int len)
+{
+#ifdef BLE_QIOT_INCLUDE_ACTION
+    POINTER_SANITY_CHECK(in_buf, BLE_QIOT_RS_ERR_PARA);
+
+    uint8_t output_flag_array[32] = {0};
+    int     ret                   = 0;
+
+    ble_qiot_log_d("input action: %d", action_id);
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_ACTION);
+    e_ble_tlv tlv;
+    tlv.type = BLE_QIOT_DATA_TYPE_STRUCT;
+    tlv.val = in_buf;
+    tlv.len = len;
+    tlv.id = action_id;
+    if (BLE_QIOT_RS_OK != ble_user_actions_input_set(&tlv)) {
+        ble_qiot_log_e("action id(%d) input value invalid", action_id);
+        return ble_lldata_action_fail_reply(action_id, BLE_QIOT_REPLY_SUCCESS);
+    }
+    BLE_QIOT_TRACE_POINT(BLE_QIOT_TRACE_SET);
+
+    BLE_QIOT_TRACE_ACTION_HANDLE(action_id);
+    ret = ble_actions_input_notify(action_id, output_flag_array);
+    BLE_QIOT_TRACE_POINT(BLE_QIOT_TRACE_HANDLER);
+    BLE_QIOT_TRACE_ACTION_DEFER(BLE_QIOT_ACTION_REPLY_DEFERRED == ret);
+    if (BLE_QIOT_ACTION_REPLY_DEFERRED == ret) {
+        return BLE_QIOT_RS_OK;
+    }
+
+    if (BLE_QIOT_REPLY_SUCCESS != ret) {
+        return ble_lldata_action_fail_reply(action_id, ret);
+    }
+    return ble_lldata_action_output_reply(action_id, output_flag_array, sizeof(output_flag_array));
 #else
     ble_qiot_log_e("action" BLE_QIOT_NOT_SUPPORT_WARN);
     return BLE_QIOT_RS_OK;
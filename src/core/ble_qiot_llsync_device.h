@@ -42,6 +42,9 @@ extern "C" {
 #define BLE_UNBIND_RESPONSE         "UnbindResponse"
 #define BLE_UNBIND_RESPONSE_STR_LEN (sizeof("UnbindResponse") - 1)
 
+// 1 byte state [+ 1 byte version] + 6 bytes mac + 10 bytes product id, or 1 byte state + 8 bytes md5 + 8 bytes identify
+#define BLE_ADV_PAYLOAD_MAX_LEN 20
+
 typedef enum {
     E_DEV_MSG_SYNC_TIME = 0,  // sync info before bind
     E_DEV_MSG_CONN_VALID,     // connect request
@@ -113,6 +116,13 @@ typedef struct ble_unbind_data_t_ {
     char sign_info[SHA1_DIGEST_SIZE];
 } ble_unbind_data;
 
+// encoded broadcast payload, one for each bind state
+typedef struct {
+    bool    valid;
+    uint8_t len;
+    char    buf[BLE_ADV_PAYLOAD_MAX_LEN];
+} ble_adv_cache_t;
+
 typedef struct {
     bool     have_data;  // start received package
     uint8_t  type;       // event type
@@ -141,9 +151,12 @@ bool llsync_is_connected(void);
 // get ble connection state
 bool ble_is_connected(void);
 
-// get broadcast data
+// get broadcast data, the payload is cached until the bind state or the device identity changed
 int ble_get_my_broadcast_data(char *out_buf, int buf_len);
 
+// drop the cached broadcast data, call it if the device identity changed
+void llsync_adv_cache_invalidate(void);
+
 // get bind authcode, return authcode length;
 // out_buf length must greater than  SHA1_DIGEST_SIZE + BLE_QIOT_DEVICE_NAME_LEN
 int ble_bind_get_authcode(const char *bind_data, uint16_t data_len, char *out_buf, uint16_t buf_len);
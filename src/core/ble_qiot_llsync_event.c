@@ -13,6 +13,8 @@
 extern "C" {
 #endif
 
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_DATA_LEVEL
+
 #include "ble_qiot_config.h"
 
 #include <stdbool.h>
@@ -25,6 +27,9 @@ extern "C" {
 #include "ble_qiot_template.h"
 #include "ble_qiot_llsync_device.h"
 #include "ble_qiot_llsync_event.h"
+#include "ble_qiot_metrics.h"
+#include "ble_qiot_stack.h"
+#include "ble_qiot_trace.h"
 
 // report device info
 ble_qiot_ret_status_t ble_event_report_device_info(uint8_t type)
@@ -123,8 +128,12 @@ ble_qiot_ret_status_t ble_event_notify2(uint8_t type, uint8_t length_flag, uint8
         ble_qiot_log_hex(BLE_QIOT_LOG_LEVEL_INFO, "post data", (char *)send_buf, send_len);
         if (0 != ble_send_notify(send_buf, send_len)) {
             ble_qiot_log_e("event(type: %d) post failed, len: %d", type, send_len);
+            BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_NOTIFY_FAILED);
             return BLE_QIOT_RS_ERR;
         }
+        BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_EVENT_OUT_FRAMES);
+        BLE_QIOT_METRIC_ADD(BLE_QIOT_METRIC_EVENT_OUT_BYTES, send_len);
+        BLE_QIOT_TRACE_POINT(BLE_QIOT_TRACE_NOTIFY);
     } while (left_len != 0);
 
     return BLE_QIOT_RS_OK;
@@ -206,38 +215,46 @@ ble_qiot_ret_status_t ble_event_sync_wait_time(void)
 }
 #endif //BLE_QIOT_SECURE_BIND
 
-ble_qiot_ret_status_t ble_event_post(uint8_t event_id)
-{
 #ifdef BLE_QIOT_INCLUDE_EVENT
-    uint8_t  param_id      = 0;
-    uint8_t  param_id_size = 0;
-    uint8_t  param_type    = 0;
-    int      param_len     = 0;
-    uint16_t data_len      = 0;
-    uint16_t data_buf_off  = 0;
-    uint16_t string_len    = 0;
-    uint8_t  header_buf    = {0};
+// the params are encoded in one pass from the event resolved once, a struct or an array param with its length
+static ble_qiot_ret_status_t ble_event_post_handle(uint8_t event_id)
+{
+    void *   event_ctx    = NULL;
+    void *   param_ctx    = NULL;
+    uint8_t  param_id     = 0;
+    uint8_t  param_type   = 0;
+    int      param_len    = 0;
+    uint16_t data_len     = 0;
+    uint16_t data_buf_off = 0;
+    uint16_t type_len     = 0;
+    uint8_t  header_buf   = {0};
 
     uint8_t data_buf[BLE_QIOT_EVENT_MAX_SIZE] = {0};
 
     ble_qiot_log_d("post event: %d", event_id);
-    param_id_size = ble_event_get_id_array_size(event_id);
-    // get all data
-    for (param_id = 0; param_id < param_id_size; param_id++) {
-        param_type = ble_event_get_param_id_type(event_id, param_id);
-        if (param_type >= BLE_QIOT_DATA_TYPE_BUTT) {
-            ble_qiot_log_e("invalid event(%d:%d) type", event_id, param_id);
+    event_ctx = ble_event_ctx_get(event_id);
+    if (NULL == event_ctx) {
+        ble_qiot_log_e("invalid event(%d)", event_id);
+        return BLE_QIOT_RS_ERR;
+    }
+    for (param_id = 0; NULL != (param_ctx = ble_struct_array_get_elem_ctx(event_ctx, param_id)); param_id++) {
+        param_type = ble_qiot_data_type_get(param_ctx) & 0x0f;
+        if (param_type >= BLE_QIOT_DATA_TYPE_BUTT || data_len >= sizeof(data_buf)) {
+            ble_qiot_log_e("invalid event(%d:%d) type or too long data", event_id, param_id);
             return BLE_QIOT_RS_ERR;
         }
 
         data_buf[data_len++] = BLE_QIOT_PACKAGE_TLV_HEAD(param_type, param_id);
         data_buf_off         = data_len;
-        if (BLE_QIOT_DATA_TYPE_STRING == param_type) {
-            // reserved 2 bytes for string type, other type have fixed length
+        if ((BLE_QIOT_DATA_TYPE_STRING == param_type) || (BLE_QIOT_DATA_TYPE_STRUCT == param_type) ||
+            (BLE_QIOT_DATA_TYPE_ARRAY == param_type)) {
+            // reserved 2 bytes for string/struct/array length, other type have fixed length
             data_buf_off += BLE_QIOT_STRING_TYPE_LEN;
         }
-        param_len = ble_event_get_data_by_id(event_id, param_id, (char *)data_buf + data_buf_off,
-                                             sizeof(data_buf) - data_buf_off);
+        if (data_buf_off > sizeof(data_buf)) {
+            return BLE_QIOT_RS_ERR;
+        }
+        param_len = ble_qiot_data_value_get(param_ctx, (char *)data_buf + data_buf_off, sizeof(data_buf) - data_buf_off);
         if (param_len < 0) {
             return BLE_QIOT_RS_ERR;
         } else if (param_len == 0) {
@@ -246,18 +263,31 @@ ble_qiot_ret_status_t ble_event_post(uint8_t event_id)
             data_buf[data_len] = '0';
             ble_qiot_log_d("event(%d: %d) no data to post", event_id, param_id);
         } else {
-            if (BLE_QIOT_DATA_TYPE_STRING == param_type) {
-                string_len = HTONS(param_len);
-                memcpy(data_buf + data_len, &string_len, sizeof(uint16_t));
+            if (data_buf_off != data_len) {
+                type_len = HTONS(param_len);
+                memcpy(data_buf + data_len, &type_len, sizeof(uint16_t));
                 data_len += sizeof(uint16_t);
             }
             data_len += param_len;
         }
     }
     header_buf = event_id;
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_EVENT);
 
     return ble_event_notify(BLE_QIOT_EVENT_UP_EVENT_POST, &header_buf, sizeof(header_buf), (const char *)data_buf,
                             data_len);
+}
+#endif //BLE_QIOT_INCLUDE_EVENT
+
+ble_qiot_ret_status_t ble_event_post(uint8_t event_id)
+{
+#ifdef BLE_QIOT_INCLUDE_EVENT
+    ble_qiot_ret_status_t ret = BLE_QIOT_RS_OK;
+
+    BLE_QIOT_STACK_ENTER(BLE_QIOT_STACK_EVENT_POST);
+    ret = ble_event_post_handle(event_id);
+    BLE_QIOT_STACK_EXIT(BLE_QIOT_STACK_EVENT_POST);
+    return ret;
 #else
     ble_qiot_log_e("event" BLE_QIOT_NOT_SUPPORT_WARN);
     return BLE_QIOT_RS_OK;
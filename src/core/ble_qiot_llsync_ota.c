@@ -13,6 +13,8 @@
 extern "C" {
 #endif
 
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_OTA_LEVEL
+
 #include "ble_qiot_config.h"
 
 #if BLE_QIOT_LLSYNC_STANDARD
@@ -23,112 +25,116 @@ extern "C" {
 #include "ble_qiot_export.h"
 #include "ble_qiot_import.h"
 #include "ble_qiot_common.h"
+#include "ble_qiot_context.h"
 #include "ble_qiot_llsync_data.h"
 #include "ble_qiot_llsync_event.h"
 #include "ble_qiot_utils_base64.h"
 #include "ble_qiot_crc.h"
 #include "ble_qiot_log.h"
+#include "ble_qiot_metrics.h"
 #include "ble_qiot_param_check.h"
 #include "ble_qiot_service.h"
+#include "ble_qiot_stack.h"
 #include "ble_qiot_template.h"
 #include "ble_qiot_llsync_ota.h"
 
 #if BLE_QIOT_SUPPORT_OTA
-static ble_ota_user_callback sg_ota_user_cb;  // user callback
-// 1. monitor the data and request from the server if data lost; 2. call the user function if no data for a long time
-static ble_timer_t sg_ota_timer                           = NULL;
-static uint8_t     sg_ota_timeout_cnt                     = 0;    // count the number of no data times
-static uint8_t     sg_ota_data_buf[BLE_QIOT_OTA_BUF_SIZE] = {0};  // storage ota data and write to the flash at once
-static uint16_t    sg_ota_data_buf_size                   = 0;    // the data size in the buffer
-static uint32_t    sg_ota_download_file_size              = 0;    // the data size download from the server
-static uint8_t     sg_ota_next_seq                        = 0;    // the next expect seq
-static uint32_t    sg_ota_download_address                = 0;    // the address saved ota file
-static uint8_t     sg_ota_download_percent                = 0;    // the percent of file had download
-static uint8_t     sg_ota_flag                            = 0;    // ota control info
-static ble_ota_info_record sg_ota_info;                           // the ota info storage in flash if support resuming
-static ble_ota_reply_t     sg_ota_reply_info;                     // record the last reply info
-
-#define BLE_QIOT_OTA_FLAG_SET(_BIT)    (sg_ota_flag |= (_BIT));
-#define BLE_QIOT_OTA_FLAG_CLR(_BIT)    (sg_ota_flag &= ~(_BIT));
-#define BLE_QIOT_OTA_FLAG_IS_SET(_BIT) ((sg_ota_flag & (_BIT)) == (_BIT))
+static inline ble_ota_ctx_t *ble_ota_ctx(void)
+{
+    return &ble_qiot_ctx_get()->ota;
+}
+
+#define BLE_QIOT_OTA_FLAG_SET(_BIT)    (ota->flag |= (_BIT));
+#define BLE_QIOT_OTA_FLAG_CLR(_BIT)    (ota->flag &= ~(_BIT));
+#define BLE_QIOT_OTA_FLAG_IS_SET(_BIT) ((ota->flag & (_BIT)) == (_BIT))
 
 static inline bool ble_qiot_ota_info_valid(void)
 {
-    return sg_ota_info.valid_flag == BLE_QIOT_OTA_PAGE_VALID_VAL;
+    return ble_ota_ctx()->info.valid_flag == BLE_QIOT_OTA_PAGE_VALID_VAL;
 }
 static inline uint8_t ble_ota_next_seq_get(void)
 {
-    return sg_ota_next_seq;
+    return ble_ota_ctx()->next_seq;
 }
 static inline void ble_ota_next_seq_inc(void)
 {
-    sg_ota_next_seq++;
+    ble_ota_ctx()->next_seq++;
 }
 static inline uint32_t ble_ota_download_address_get(void)
 {
-    return sg_ota_download_address;
+    return ble_ota_ctx()->download_address;
 }
 static inline void ble_ota_download_address_set(void)
 {
-    sg_ota_download_address = ble_ota_get_download_addr();
+    ble_ota_ctx()->download_address = ble_ota_get_download_addr();
     return;
 }
 static inline uint32_t ble_ota_download_size_get(void)
 {
-    return sg_ota_download_file_size;
+    return ble_ota_ctx()->download_file_size;
 }
 static inline void ble_ota_download_size_inc(uint32_t size)
 {
-    sg_ota_download_file_size += size;
+    ble_ota_ctx()->download_file_size += size;
 }
 static inline uint8_t ble_ota_file_percent_get(void)
 {
-    return sg_ota_download_percent;
+    return ble_ota_ctx()->download_percent;
 }
 static inline void ble_ota_file_percent_set(uint8_t percent)
 {
-    sg_ota_download_percent = percent;
+    ble_ota_ctx()->download_percent = percent;
 }
 void ble_ota_callback_reg(ble_ota_start_callback start_cb, ble_ota_stop_callback stop_cb,
                           ble_ota_valid_file_callback valid_file_cb)
 {
-    sg_ota_user_cb.start_cb      = start_cb;
-    sg_ota_user_cb.stop_cb       = stop_cb;
-    sg_ota_user_cb.valid_file_cb = valid_file_cb;
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
+    ota->user_cb.start_cb      = start_cb;
+    ota->user_cb.stop_cb       = stop_cb;
+    ota->user_cb.valid_file_cb = valid_file_cb;
 }
 static inline void ble_ota_user_start_cb(void)
 {
-    if (NULL != sg_ota_user_cb.start_cb) {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
+    if (NULL != ota->user_cb.start_cb) {
         ble_qiot_log_i("start callback begin");
-        sg_ota_user_cb.start_cb();
+        ota->user_cb.start_cb();
         ble_qiot_log_i("start callback end");
     }
 }
 static inline void ble_ota_user_stop_cb(uint8_t result)
 {
-    if (NULL != sg_ota_user_cb.stop_cb) {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
+    if (NULL != ota->user_cb.stop_cb) {
         ble_qiot_log_i("stop callback begin");
-        sg_ota_user_cb.stop_cb(result);
+        ota->user_cb.stop_cb(result);
         ble_qiot_log_i("stop callback end");
     }
 }
 static inline ble_qiot_ret_status_t ble_ota_user_valid_cb(void)
 {
-    if (NULL != sg_ota_user_cb.valid_file_cb) {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
+    if (NULL != ota->user_cb.valid_file_cb) {
         ble_qiot_log_i("valid callback begin");
-        return sg_ota_user_cb.valid_file_cb(sg_ota_info.download_file_info.file_size,
-                                            (char *)sg_ota_info.download_file_info.file_version);
+        return ota->user_cb.valid_file_cb(ota->info.download_file_info.file_size,
+                                            (char *)ota->info.download_file_info.file_version);
     }
     return BLE_QIOT_RS_OK;
 }
 static inline ble_qiot_ret_status_t ble_ota_write_info(void)
 {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
 #if BLE_QIOT_SUPPORT_RESUMING
-    sg_ota_info.valid_flag     = BLE_QIOT_OTA_PAGE_VALID_VAL;
-    sg_ota_info.last_file_size = ble_ota_download_size_get();
-    sg_ota_info.last_address   = ble_ota_download_address_get();
+    ota->info.valid_flag     = BLE_QIOT_OTA_PAGE_VALID_VAL;
+    ota->info.last_file_size = ble_ota_download_size_get();
+    ota->info.last_address   = ble_ota_download_address_get();
     if (sizeof(ble_ota_info_record) !=
-        ble_write_flash(BLE_QIOT_OTA_INFO_FLASH_ADDR, (const char *)&sg_ota_info, sizeof(ble_ota_info_record))) {
+        ble_write_flash(BLE_QIOT_OTA_INFO_FLASH_ADDR, (const char *)&ota->info, sizeof(ble_ota_info_record))) {
         ble_qiot_log_e("write ota info failed");
         return BLE_QIOT_RS_ERR;
     }
@@ -137,10 +143,12 @@ static inline ble_qiot_ret_status_t ble_ota_write_info(void)
 }
 static inline void ble_ota_clear_info(void)
 {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
 #if BLE_QIOT_SUPPORT_RESUMING
-    sg_ota_info.valid_flag = ~BLE_QIOT_OTA_PAGE_VALID_VAL;
+    ota->info.valid_flag = ~BLE_QIOT_OTA_PAGE_VALID_VAL;
     if (sizeof(ble_ota_info_record) !=
-        ble_write_flash(BLE_QIOT_OTA_INFO_FLASH_ADDR, (const char *)&sg_ota_info, sizeof(ble_ota_info_record))) {
+        ble_write_flash(BLE_QIOT_OTA_INFO_FLASH_ADDR, (const char *)&ota->info, sizeof(ble_ota_info_record))) {
         ble_qiot_log_e("clear ota info failed");
     }
 #endif //BLE_QIOT_SUPPORT_RESUMING
@@ -148,16 +156,17 @@ static inline void ble_ota_clear_info(void)
 }
 static inline ble_qiot_ret_status_t ble_ota_reply_ota_data(void)
 {
-    uint8_t  req       = ble_ota_next_seq_get();
-    uint32_t file_size = ble_ota_download_size_get();
+    ble_ota_ctx_t *ota       = ble_ota_ctx();
+    uint8_t        req       = ble_ota_next_seq_get();
+    uint32_t       file_size = ble_ota_download_size_get();
 
-    if (sg_ota_reply_info.file_size != file_size) {
-        sg_ota_reply_info.file_size = file_size;
-        sg_ota_reply_info.req       = req;
+    if (ota->reply_info.file_size != file_size) {
+        ota->reply_info.file_size = file_size;
+        ota->reply_info.req       = req;
     } else {
         // in the case that the device reply info missed, the timer reply info again but the seq increased, so we need
         // saved the last reply info and used in the time
-        req = sg_ota_reply_info.req;
+        req = ota->reply_info.req;
         // ble_qiot_log_d("used old file size %d, req %d", file_size, req);
     }
 
@@ -172,98 +181,113 @@ static inline ble_qiot_ret_status_t ble_ota_report_check_result(uint8_t firmware
 }
 static inline void ble_ota_timer_delete(void)
 {
-    if (NULL == sg_ota_timer) {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
+    if (NULL == ota->timer) {
         ble_qiot_log_e("ble ota timer invalid, delete failed");
         return;
     }
-    if (BLE_QIOT_RS_OK != ble_timer_delete(sg_ota_timer)) {
+    if (BLE_QIOT_RS_OK != ble_timer_delete(ota->timer)) {
         ble_qiot_log_e("ble ota timer delete failed");
     }
-    sg_ota_timer = NULL;
+    ota->timer = NULL;
     return;
 }
 static ble_qiot_ret_status_t ble_ota_write_data_to_flash(void)
 {
-    int ret        = 0;
-    int write_addr = 0;
+    ble_ota_ctx_t *ota        = ble_ota_ctx();
+    int            ret        = 0;
+    int            write_addr = 0;
 
     // the download size include the data size, so the write address exclude the data size
-    write_addr = ble_ota_download_address_get() + ble_ota_download_size_get() - sg_ota_data_buf_size;
-    ret        = ble_ota_write_flash(write_addr, (const char *)sg_ota_data_buf, sg_ota_data_buf_size);
-    if (ret != sg_ota_data_buf_size) {
+    write_addr = ble_ota_download_address_get() + ble_ota_download_size_get() - ota->data_buf_size;
+    ret        = ble_ota_write_flash(write_addr, (const char *)ota->data_buf, ota->data_buf_size);
+    if (ret != ota->data_buf_size) {
         ble_qiot_log_e("ota data write flash failed");
         return BLE_QIOT_RS_ERR;
     }
     return BLE_QIOT_RS_OK;
 }
-static void ble_ota_timer_callback(void *param)
+static void ble_ota_timer_handle(void)
 {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
     if (BLE_QIOT_OTA_FLAG_IS_SET(BLE_QIOT_OTA_RECV_DATA_BIT)) {
         BLE_QIOT_OTA_FLAG_CLR(BLE_QIOT_OTA_RECV_DATA_BIT);
         return;
     }
-    sg_ota_timeout_cnt++;
+    ota->timeout_cnt++;
 
-    ble_qiot_log_w("reply in the timer, count: %d", sg_ota_timeout_cnt);
+    ble_qiot_log_w("reply in the timer, count: %d", ota->timeout_cnt);
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_OTA_RETRANSMIT);
     ble_ota_reply_ota_data();
 
-    if (sg_ota_timeout_cnt >= BLE_QIOT_OTA_MAX_RETRY_COUNT) {
-        sg_ota_flag = 0;
+    if (ota->timeout_cnt >= BLE_QIOT_OTA_MAX_RETRY_COUNT) {
+        ota->flag = 0;
         ble_ota_timer_delete();
         // inform the user ota failed because timeout
         ble_ota_user_stop_cb(BLE_QIOT_OTA_ERR_TIMEOUT);
     }
 }
+static void ble_ota_timer_callback(void *param)
+{
+    BLE_QIOT_STACK_ENTER(BLE_QIOT_STACK_OTA_TIMER);
+    ble_ota_timer_handle();
+    BLE_QIOT_STACK_EXIT(BLE_QIOT_STACK_OTA_TIMER);
+}
 static inline void ble_ota_timer_start(void)
 {
-    if (NULL == sg_ota_timer) {
-        sg_ota_timer = ble_timer_create(BLE_TIMER_PERIOD_TYPE, ble_ota_timer_callback);
-        if (NULL == sg_ota_timer) {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
+    if (NULL == ota->timer) {
+        ota->timer = ble_timer_create(BLE_TIMER_PERIOD_TYPE, ble_ota_timer_callback);
+        if (NULL == ota->timer) {
             ble_qiot_log_e("ble ota timer create failed");
             return;
         }
     }
-    if (BLE_QIOT_RS_OK != ble_timer_start(sg_ota_timer, BLE_QIOT_RETRY_TIMEOUT * 1000)) {
+    if (BLE_QIOT_RS_OK != ble_timer_start(ota->timer, BLE_QIOT_RETRY_TIMEOUT * 1000)) {
         ble_qiot_log_e("ble ota timer start failed");
     }
     return;
 }
 static ble_qiot_ret_status_t ble_ota_init(void)
 {
-    uint32_t size_align   = 0;
-    uint8_t  file_percent = 0;
+    ble_ota_ctx_t *ota          = ble_ota_ctx();
+    uint32_t       size_align   = 0;
+    uint8_t        file_percent = 0;
 
     // init the ota env
-    memset(sg_ota_data_buf, 0, sizeof(sg_ota_data_buf));
-    sg_ota_data_buf_size = 0;
-    sg_ota_timeout_cnt   = 0;
-    memset(&sg_ota_info, 0, sizeof(ble_ota_info_record));
-    sg_ota_download_file_size = 0;
-    sg_ota_next_seq           = 0;
-    sg_ota_download_percent   = 0;
-    sg_ota_flag               = 0;
+    memset(ota->data_buf, 0, sizeof(ota->data_buf));
+    ota->data_buf_size = 0;
+    ota->timeout_cnt   = 0;
+    memset(&ota->info, 0, sizeof(ble_ota_info_record));
+    ota->download_file_size = 0;
+    ota->next_seq           = 0;
+    ota->download_percent   = 0;
+    ota->flag               = 0;
     ble_ota_download_address_set();
-    memset(&sg_ota_reply_info, 0, sizeof(sg_ota_reply_info));
+    memset(&ota->reply_info, 0, sizeof(ota->reply_info));
 
 #if BLE_QIOT_SUPPORT_RESUMING
     // start from 0 if read flash fail, but ota will continue so ignored the return code
-    ble_read_flash(BLE_QIOT_OTA_INFO_FLASH_ADDR, (char *)&sg_ota_info, sizeof(sg_ota_info));
-    ble_qiot_log_hex(BLE_QIOT_LOG_LEVEL_INFO, "ota info", &sg_ota_info, sizeof(sg_ota_info));
+    ble_read_flash(BLE_QIOT_OTA_INFO_FLASH_ADDR, (char *)&ota->info, sizeof(ota->info));
+    ble_qiot_log_hex(BLE_QIOT_LOG_LEVEL_INFO, "ota info", &ota->info, sizeof(ota->info));
     // check if the valid flag legalled
     if (ble_qiot_ota_info_valid()) {
         // the ota info write to flash may be mismatch the file write to flash, we should download file from the byte
         // align the flash page
-        if (ble_ota_download_address_get() == sg_ota_info.last_address) {
-            size_align = sg_ota_info.last_file_size / BLE_QIOT_RECORD_FLASH_PAGESIZE * BLE_QIOT_RECORD_FLASH_PAGESIZE;
+        if (ble_ota_download_address_get() == ota->info.last_address) {
+            size_align = ota->info.last_file_size / BLE_QIOT_RECORD_FLASH_PAGESIZE * BLE_QIOT_RECORD_FLASH_PAGESIZE;
             ble_ota_download_size_inc(size_align);
-            file_percent = size_align * 100 / sg_ota_info.download_file_info.file_size;
+            file_percent = size_align * 100 / ota->info.download_file_info.file_size;
             ble_ota_file_percent_set(file_percent);
             ble_qiot_log_i("align file size: %x, the percent: %d", size_align, file_percent);
         } else {
-            memset(&sg_ota_info, 0, sizeof(ble_ota_info_record));
+            memset(&ota->info, 0, sizeof(ble_ota_info_record));
         }
     } else {
-        memset(&sg_ota_info, 0, sizeof(ble_ota_info_record));
+        memset(&ota->info, 0, sizeof(ble_ota_info_record));
     }
 #endif //BLE_QIOT_SUPPORT_RESUMING
     return BLE_QIOT_RS_OK;
@@ -271,11 +295,13 @@ static ble_qiot_ret_status_t ble_ota_init(void)
 // stop ota if ble disconnect
 void ble_ota_stop(void)
 {
+    ble_ota_ctx_t *ota = ble_ota_ctx();
+
     if (!BLE_QIOT_OTA_FLAG_IS_SET(BLE_QIOT_OTA_REQUEST_BIT)) {
-        ble_qiot_log_w("ota not start");
+        ble_qiot_log_d("ota not start");
         return;
     }
-    sg_ota_flag = 0;
+    ota->flag = 0;
     ble_ota_timer_delete();
     // write data to flash if the ota stop
     ble_ota_write_data_to_flash();
@@ -287,6 +313,7 @@ ble_qiot_ret_status_t ble_ota_request_handle(const char *in_buf, int buf_len)
 {
     BUFF_LEN_SANITY_CHECK(buf_len, sizeof(ble_ota_file_info) - BLE_QIOT_OTA_MAX_VERSION_STR, BLE_QIOT_RS_ERR_PARA);
 
+    ble_ota_ctx_t *    ota         = ble_ota_ctx();
     uint8_t            ret         = 0;
     uint8_t            reply_flag  = 0;
     uint32_t           file_size   = 0;
@@ -321,15 +348,15 @@ ble_qiot_ret_status_t ble_ota_request_handle(const char *in_buf, int buf_len)
 #if BLE_QIOT_SUPPORT_RESUMING
         reply_flag |= BLE_QIOT_OTA_RESUME_ENABLE;
         // check file crc to determine its the same file, download the new file if its different
-        if (ble_qiot_ota_info_valid() && (file_crc == sg_ota_info.download_file_info.file_crc) &&
-            (file_size == sg_ota_info.download_file_info.file_size)) {
+        if (ble_qiot_ota_info_valid() && (file_crc == ota->info.download_file_info.file_crc) &&
+            (file_size == ota->info.download_file_info.file_size)) {
             ota_reply_info.last_file_size = HTONL(ble_ota_download_size_get());
         }
 #endif //BLE_QIOT_SUPPORT_RESUMING
 
-        sg_ota_info.download_file_info.file_size = file_size;
-        sg_ota_info.download_file_info.file_crc  = file_crc;
-        memcpy(sg_ota_info.download_file_info.file_version, p, version_len);
+        ota->info.download_file_info.file_size = file_size;
+        ota->info.download_file_info.file_crc  = file_crc;
+        memcpy(ota->info.download_file_info.file_version, p, version_len);
 
         ble_ota_user_start_cb();
         ble_ota_timer_start();
@@ -348,28 +375,29 @@ ble_qiot_ret_status_t ble_ota_request_handle(const char *in_buf, int buf_len)
 // call the function after the server inform or the device receive the last package
 ble_qiot_ret_status_t ble_ota_file_end_handle(void)
 {
-    int      crc_buf_len  = 0;
-    uint32_t crc_file_len = 0;
-    uint32_t crc          = 0;
+    ble_ota_ctx_t *ota          = ble_ota_ctx();
+    int            crc_buf_len  = 0;
+    uint32_t       crc_file_len = 0;
+    uint32_t       crc          = 0;
 
     // the function called only once in the same ota process
-    sg_ota_flag = 0;
+    ota->flag = 0;
     ble_ota_timer_delete();
 
     ble_qiot_log_i("calc crc start");
-    while (crc_file_len < sg_ota_info.download_file_info.file_size) {
-        crc_buf_len = sizeof(sg_ota_data_buf) > (sg_ota_info.download_file_info.file_size - crc_file_len)
-                          ? (sg_ota_info.download_file_info.file_size - crc_file_len)
-                          : sizeof(sg_ota_data_buf);
-        memset(sg_ota_data_buf, 0, sizeof(sg_ota_data_buf));
-        ble_read_flash(ble_ota_download_address_get() + crc_file_len, (char *)sg_ota_data_buf, crc_buf_len);
+    while (crc_file_len < ota->info.download_file_info.file_size) {
+        crc_buf_len = sizeof(ota->data_buf) > (ota->info.download_file_info.file_size - crc_file_len)
+                          ? (ota->info.download_file_info.file_size - crc_file_len)
+                          : sizeof(ota->data_buf);
+        memset(ota->data_buf, 0, sizeof(ota->data_buf));
+        ble_read_flash(ble_ota_download_address_get() + crc_file_len, (char *)ota->data_buf, crc_buf_len);
         crc_file_len += crc_buf_len;
-        crc = ble_qiot_crc32(crc, (const uint8_t *)sg_ota_data_buf, crc_buf_len);
+        crc = ble_qiot_crc32(crc, (const uint8_t *)ota->data_buf, crc_buf_len);
         // maybe need task delay
     }
-    ble_qiot_log_i("calc crc %x, file crc %x", crc, sg_ota_info.download_file_info.file_crc);
+    ble_qiot_log_i("calc crc %x, file crc %x", crc, ota->info.download_file_info.file_crc);
 
-    if (crc == sg_ota_info.download_file_info.file_crc) {
+    if (crc == ota->info.download_file_info.file_crc) {
         if (BLE_QIOT_RS_OK == ble_ota_user_valid_cb()) {
             int ret = ble_ota_report_check_result(BLE_QIOT_OTA_VALID_SUCCESS, 0);
             ble_ota_user_stop_cb(BLE_QIOT_OTA_SUCCESS);
@@ -387,22 +415,23 @@ ble_qiot_ret_status_t ble_ota_file_end_handle(void)
 
 static ble_qiot_ret_status_t ble_qiot_ota_data_saved(char *data, uint16_t data_len)
 {
-    int     ret     = 0;
-    uint8_t percent = 0;
+    ble_ota_ctx_t *ota     = ble_ota_ctx();
+    int            ret     = 0;
+    uint8_t        percent = 0;
 
     // write data to flash if the buffer overflow
-    if ((data_len + sg_ota_data_buf_size) > sizeof(sg_ota_data_buf)) {
-        memcpy(sg_ota_data_buf + sg_ota_data_buf_size, data, sizeof(sg_ota_data_buf) - sg_ota_data_buf_size);
-        ble_ota_download_size_inc((sizeof(sg_ota_data_buf) - sg_ota_data_buf_size));
-        data += (sizeof(sg_ota_data_buf) - sg_ota_data_buf_size);
-        data_len -= (sizeof(sg_ota_data_buf) - sg_ota_data_buf_size);
-        sg_ota_data_buf_size += (sizeof(sg_ota_data_buf) - sg_ota_data_buf_size);
+    if ((data_len + ota->data_buf_size) > sizeof(ota->data_buf)) {
+        memcpy(ota->data_buf + ota->data_buf_size, data, sizeof(ota->data_buf) - ota->data_buf_size);
+        ble_ota_download_size_inc((sizeof(ota->data_buf) - ota->data_buf_size));
+        data += (sizeof(ota->data_buf) - ota->data_buf_size);
+        data_len -= (sizeof(ota->data_buf) - ota->data_buf_size);
+        ota->data_buf_size += (sizeof(ota->data_buf) - ota->data_buf_size);
         // ble_qiot_log_e("data buf overflow, write data");
         if (BLE_QIOT_RS_OK != ble_ota_write_data_to_flash()) {
             return BLE_QIOT_RS_ERR;
         }
         // update the ota info if support resuming
-        percent = (ble_ota_download_size_get() + sg_ota_data_buf_size) * 100 / sg_ota_info.download_file_info.file_size;
+        percent = (ble_ota_download_size_get() + ota->data_buf_size) * 100 / ota->info.download_file_info.file_size;
         if (percent > ble_ota_file_percent_get()) {
             ble_ota_file_percent_set(percent);
             ret = ble_ota_write_info();
@@ -411,16 +440,16 @@ static ble_qiot_ret_status_t ble_qiot_ota_data_saved(char *data, uint16_t data_l
                 return BLE_QIOT_RS_ERR;
             }
         }
-        memset(sg_ota_data_buf, 0, sizeof(sg_ota_data_buf));
-        sg_ota_data_buf_size = 0;
+        memset(ota->data_buf, 0, sizeof(ota->data_buf));
+        ota->data_buf_size = 0;
     }
 
-    memcpy(sg_ota_data_buf + sg_ota_data_buf_size, data, data_len);
-    sg_ota_data_buf_size += data_len;
+    memcpy(ota->data_buf + ota->data_buf_size, data, data_len);
+    ota->data_buf_size += data_len;
     ble_ota_download_size_inc(data_len);
 
     // if the last package, write to flash and reply the server
-    if (ble_ota_download_size_get() == sg_ota_info.download_file_info.file_size) {
+    if (ble_ota_download_size_get() == ota->info.download_file_info.file_size) {
         ble_qiot_log_i("receive the last package");
         if (BLE_QIOT_RS_OK != ble_ota_write_data_to_flash()) {
             return BLE_QIOT_RS_ERR;
@@ -428,8 +457,8 @@ static ble_qiot_ret_status_t ble_qiot_ota_data_saved(char *data, uint16_t data_l
         ble_ota_reply_ota_data();
         // set the file receive end bit
         BLE_QIOT_OTA_FLAG_SET(BLE_QIOT_OTA_RECV_END_BIT);
-        memset(sg_ota_data_buf, 0, sizeof(sg_ota_data_buf));
-        sg_ota_data_buf_size = 0;
+        memset(ota->data_buf, 0, sizeof(ota->data_buf));
+        ota->data_buf_size = 0;
     }
 
     return BLE_QIOT_RS_OK;
@@ -439,9 +468,10 @@ ble_qiot_ret_status_t ble_ota_data_handle(const char *in_buf, int buf_len)
 {
     POINTER_SANITY_CHECK(in_buf, BLE_QIOT_RS_ERR_PARA);
 
-    uint8_t  seq      = 0;
-    char *   data     = NULL;
-    uint16_t data_len = 0;
+    ble_ota_ctx_t *ota      = ble_ota_ctx();
+    uint8_t        seq      = 0;
+    char *         data     = NULL;
+    uint16_t       data_len = 0;
 
     if (!BLE_QIOT_OTA_FLAG_IS_SET(BLE_QIOT_OTA_REQUEST_BIT)) {
         ble_qiot_log_w("ota request is need first");
@@ -456,8 +486,9 @@ ble_qiot_ret_status_t ble_ota_data_handle(const char *in_buf, int buf_len)
     if (seq == ble_ota_next_seq_get()) {
         BLE_QIOT_OTA_FLAG_SET(BLE_QIOT_OTA_RECV_DATA_BIT);
         BLE_QIOT_OTA_FLAG_SET(BLE_QIOT_OTA_FIRST_RETRY_BIT);
-        sg_ota_timeout_cnt = 0;
+        ota->timeout_cnt = 0;
         ble_ota_next_seq_inc();
+        BLE_QIOT_METRIC_OTA_PACKET(data_len);
 
         if (BLE_QIOT_RS_OK != ble_qiot_ota_data_saved(data, data_len)) {
             // stop ota and inform the server
@@ -471,7 +502,7 @@ ble_qiot_ret_status_t ble_ota_data_handle(const char *in_buf, int buf_len)
         if (BLE_QIOT_TOTAL_PACKAGES == ble_ota_next_seq_get()) {
             // ble_qiot_log_e("reply loop");
             ble_ota_reply_ota_data();
-            sg_ota_next_seq = 0;
+            ota->next_seq = 0;
         }
         BLE_QIOT_OTA_FLAG_SET(BLE_QIOT_OTA_RECV_DATA_BIT);
     } else {
@@ -480,6 +511,7 @@ ble_qiot_ret_status_t ble_ota_data_handle(const char *in_buf, int buf_len)
         if (BLE_QIOT_OTA_FLAG_IS_SET(BLE_QIOT_OTA_FIRST_RETRY_BIT)) {
             BLE_QIOT_OTA_FLAG_CLR(BLE_QIOT_OTA_FIRST_RETRY_BIT);
             BLE_QIOT_OTA_FLAG_CLR(BLE_QIOT_OTA_RECV_DATA_BIT);
+            BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_OTA_SEQ_MISS);
             ble_ota_reply_ota_data();
             // refresh the timer
             ble_ota_timer_start();
@@ -20,6 +20,7 @@ extern "C" {
 
 #include "ble_qiot_config.h"
 #include "ble_qiot_export.h"
+#include "ble_qiot_import.h"
 
 #define BLE_QIOT_GET_OTA_REQUEST_HEADER_LEN 3  // the ota request header len
 #define BLE_QIOT_OTA_DATA_HEADER_LEN        3  // the ota data header len
@@ -109,6 +110,25 @@ typedef struct ble_ota_reply_t_ {
     uint8_t  req;
 } ble_ota_reply_t;
 
+#if BLE_QIOT_SUPPORT_OTA
+// the ota state of a device
+typedef struct ble_ota_ctx_t_ {
+    ble_ota_user_callback user_cb;  // user callback
+    // 1. monitor the data and request from the server if data lost; 2. call the user function if no data for a long time
+    ble_timer_t         timer;
+    uint8_t             timeout_cnt;                      // count the number of no data times
+    uint8_t             data_buf[BLE_QIOT_OTA_BUF_SIZE];  // storage ota data and write to the flash at once
+    uint16_t            data_buf_size;                    // the data size in the buffer
+    uint32_t            download_file_size;               // the data size download from the server
+    uint8_t             next_seq;                         // the next expect seq
+    uint32_t            download_address;                 // the address saved ota file
+    uint8_t             download_percent;                 // the percent of file had download
+    uint8_t             flag;                             // ota control info
+    ble_ota_info_record info;                             // the ota info storage in flash if support resuming
+    ble_ota_reply_t     reply_info;                       // record the last reply info
+} ble_ota_ctx_t;
+#endif  // BLE_QIOT_SUPPORT_OTA
+
 ble_qiot_ret_status_t ble_ota_request_handle(const char *in_buf, int buf_len);
 
 ble_qiot_ret_status_t ble_ota_data_handle(const char *in_buf, int buf_len);
@@ -10,6 +10,8 @@
  *
  */
 
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_DATA_LEVEL
+
 #include <stdio.h>
 #include <string.h>
 
@@ -141,9 +143,11 @@ static int ble_qiot_data_array_get(void *ctx, char *in_buf, int buf_len, int str
     uint16_t index = 0;
     int16_t data_len = 0;
     int ret_len;
+    // the live elements only, the rest of the elements allocated are not sent
+    uint8_t elem_cnt = ble_struct_array_get_elem_cnt(ctx);
 
     void *member_ctx = ble_struct_array_get_elem_ctx(ctx, index);
-    while (member_ctx) {
+    while (member_ctx && index < elem_cnt) {
         in_buf[data_len ++] = BLE_QIOT_PACKAGE_TLV_HEAD(type, index);
         switch (type & 0xf0) {
         case BLE_QIOT_ARRAY_INT_BIT_MASK:
@@ -184,8 +188,29 @@ static int ble_qiot_data_array_get(void *ctx, char *in_buf, int buf_len, int str
 }
 
 //.................
-static int ble_qiot_data_struct_set(void *ctx, const e_ble_tlv *tlv, int array_member);
-static int ble_qiot_data_array_set(void *ctx, const e_ble_tlv *tlv, int struct_member)
+// the set functions only check the values can be set if check is not 0, nothing is set then
+static int ble_qiot_data_value_set(void *ctx, const char *buf, uint16_t buf_len, int check)
+{
+    return check ? ble_qiot_data_check(ctx, buf, buf_len) : ble_qiot_data_set(ctx, buf, buf_len);
+}
+
+static int ble_qiot_data_array_elem_set(void *ctx, uint8_t index, const char *val, int len, int check)
+{
+    void *elem_ctx = NULL;
+
+    if (!check) {
+        return ble_struct_array_elem_set(ctx, index, val, len);
+    }
+    elem_ctx = ble_struct_array_get_elem_ctx(ctx, index);
+    if (elem_ctx == NULL) {
+        ble_qiot_log_e("array element %d over the size", index);
+        return BLE_QIOT_RS_ERR;
+    }
+    return ble_qiot_data_check(elem_ctx, val, len);
+}
+
+static int ble_qiot_data_struct_set(void *ctx, const e_ble_tlv *tlv, int array_member, int check);
+static int ble_qiot_data_array_set(void *ctx, const e_ble_tlv *tlv, int struct_member, int check)
 {
     if (ctx == NULL) {
         ble_qiot_log_e("invalid ctx");
@@ -206,21 +231,36 @@ static int ble_qiot_data_array_set(void *ctx, const e_ble_tlv *tlv, int struct_m
         switch (type & 0xF0) {
         case BLE_QIOT_ARRAY_INT_BIT_MASK:
         case BLE_QIOT_ARRAY_FLOAT_BIT_MASK:
-            ret = ble_struct_array_elem_set(ctx, index, tlv->val + parse_len, sizeof(uint32_t));
+            if (parse_len + sizeof(uint32_t) > tlv->len) {
+                return BLE_QIOT_RS_ERR;
+            }
+            ret = ble_qiot_data_array_elem_set(ctx, index, tlv->val + parse_len, sizeof(uint32_t), check);
             parse_len += sizeof(uint32_t);
             break;
         case BLE_QIOT_ARRAY_STRING_BIT_MASK:
+            if (parse_len + sizeof(uint16_t) > tlv->len) {
+                return BLE_QIOT_RS_ERR;
+            }
             memcpy(&member_len, &tlv->val[parse_len], sizeof(uint16_t));
             member_len = NTOHS(member_len);
             parse_len += sizeof(uint16_t);
-            ret = ble_struct_array_elem_set(ctx, index, tlv->val + parse_len, member_len);
+            if (parse_len + member_len > tlv->len) {
+                return BLE_QIOT_RS_ERR;
+            }
+            ret = ble_qiot_data_array_elem_set(ctx, index, tlv->val + parse_len, member_len, check);
             parse_len += member_len;
             break;
         case BLE_QIOT_ARRAY_STRUCT_BIT_MASK:
             if (struct_member) {
+                if (parse_len + sizeof(uint16_t) > tlv->len) {
+                    return BLE_QIOT_RS_ERR;
+                }
                 memcpy(&member_len, &tlv->val[parse_len], sizeof(uint16_t));
                 member_len = NTOHS(member_len);
                 parse_len += sizeof(uint16_t);
+                if (parse_len + member_len > tlv->len) {
+                    return BLE_QIOT_RS_ERR;
+                }
                 void *member_ctx = ble_struct_array_get_elem_ctx(ctx, index);
                 if (member_ctx == NULL) {
                     ble_qiot_log_e("member property id error");
@@ -231,7 +271,7 @@ static int ble_qiot_data_array_set(void *ctx, const e_ble_tlv *tlv, int struct_m
                 child_tlv.id = index;
                 child_tlv.val = tlv->val + parse_len;
                 child_tlv.len = member_len;
-                ret = ble_qiot_data_struct_set(member_ctx, &child_tlv, 0);
+                ret = ble_qiot_data_struct_set(member_ctx, &child_tlv, 0, check);
                 parse_len += member_len;
             } else {
                 ret = BLE_QIOT_RS_ERR;
@@ -244,10 +284,14 @@ static int ble_qiot_data_array_set(void *ctx, const e_ble_tlv *tlv, int struct_m
         }
         index++;
     }
-    return parse_len == tlv->len ? BLE_QIOT_RS_OK : BLE_QIOT_RS_ERR;
+    if (parse_len != tlv->len) {
+        return BLE_QIOT_RS_ERR;
+    }
+    // the elements written are the live ones
+    return check ? BLE_QIOT_RS_OK : ble_struct_array_set_elem_cnt(ctx, index);
 }
 
-static int ble_qiot_data_struct_set(void *ctx, const e_ble_tlv *tlv, int array_member)
+static int ble_qiot_data_struct_set(void *ctx, const e_ble_tlv *tlv, int array_member, int check)
 {
     if (ctx == NULL) {
         ble_qiot_log_e("invalid ctx");
@@ -288,11 +332,11 @@ static int ble_qiot_data_struct_set(void *ctx, const e_ble_tlv *tlv, int array_m
         case BLE_QIOT_DATA_TYPE_FLOAT:
         case BLE_QIOT_DATA_TYPE_ENUM:
         case BLE_QIOT_DATA_TYPE_TIME:
-            ret = ble_qiot_data_set(member_ctx, child_tlv.val, child_tlv.len);
+            ret = ble_qiot_data_value_set(member_ctx, child_tlv.val, child_tlv.len, check);
             break;
         case BLE_QIOT_DATA_TYPE_ARRAY:
             if (array_member)
-                ret = ble_qiot_data_array_set(member_ctx, &child_tlv, 0);
+                ret = ble_qiot_data_array_set(member_ctx, &child_tlv, 0, check);
             else
                 ret = BLE_QIOT_RS_ERR;
             break;
@@ -310,42 +354,54 @@ static int ble_qiot_data_struct_set(void *ctx, const e_ble_tlv *tlv, int array_m
     return (parse_len == tlv->len) ? BLE_QIOT_RS_OK : BLE_QIOT_RS_ERR;
 }
 
-
-int ble_user_property_set_data(const e_ble_tlv *tlv)
+static int ble_user_property_data_handle(const e_ble_tlv *tlv, int check)
 {
-    POINTER_SANITY_CHECK(tlv, BLE_QIOT_RS_ERR_PARA);
     void *ctx = ble_property_ctx_get(tlv->id);
     if (ctx == NULL)
         return BLE_QIOT_RS_ERR;
+    if (check && (ble_qiot_data_type_get(ctx) & 0x0f) != (tlv->type & 0x0f)) {
+        ble_qiot_log_e("property id %d type %d error", tlv->id, tlv->type);
+        return BLE_QIOT_RS_ERR;
+    }
 
     switch (tlv->type & 0x0f) {
     case BLE_QIOT_DATA_TYPE_ARRAY:
-        return ble_qiot_data_array_set(ctx, tlv, 1);
+        return ble_qiot_data_array_set(ctx, tlv, 1, check);
     case BLE_QIOT_DATA_TYPE_STRUCT:
-        return ble_qiot_data_struct_set(ctx, tlv, 1);
+        return ble_qiot_data_struct_set(ctx, tlv, 1, check);
     case BLE_QIOT_DATA_TYPE_BOOL:
     case BLE_QIOT_DATA_TYPE_INT:
     case BLE_QIOT_DATA_TYPE_STRING:
     case BLE_QIOT_DATA_TYPE_FLOAT:
     case BLE_QIOT_DATA_TYPE_ENUM:
     case BLE_QIOT_DATA_TYPE_TIME:
-        return ble_qiot_data_set(ctx, tlv->val, tlv->len);
+        return ble_qiot_data_value_set(ctx, tlv->val, tlv->len, check);
     }
     return BLE_QIOT_RS_ERR;
 }
 
-int ble_user_property_get_data_by_id(uint8_t id, char *buf, uint16_t buf_len)
+int ble_user_property_set_data(const e_ble_tlv *tlv)
 {
-    int ret_len = 0;
+    POINTER_SANITY_CHECK(tlv, BLE_QIOT_RS_ERR_PARA);
+    return ble_user_property_data_handle(tlv, 0);
+}
+
+// the tlv is checked as ble_user_property_set_data() does, nothing is set
+int ble_user_property_check_data(const e_ble_tlv *tlv)
+{
+    POINTER_SANITY_CHECK(tlv, BLE_QIOT_RS_ERR_PARA);
+    return ble_user_property_data_handle(tlv, 1);
+}
 
+// the value of a property or an event param, a struct or an array as the tlvs of its members
+int ble_qiot_data_value_get(void *ctx, char *buf, uint16_t buf_len)
+{
+    POINTER_SANITY_CHECK(ctx, BLE_QIOT_RS_ERR_PARA);
     POINTER_SANITY_CHECK(buf, BLE_QIOT_RS_ERR_PARA);
-    void *ctx = ble_property_ctx_get(id);
-    if (ctx == NULL)
-        return -1;
 
     uint8_t type = ble_qiot_data_type_get(ctx) & 0x0f;
     if (!ble_check_space_enough_by_type(type, buf_len)) {
-        ble_qiot_log_e("not enough space get property id %d data", id);
+        ble_qiot_log_e("not enough space get data, type %d", type);
         return -1;
     }
     switch (type) {
@@ -362,10 +418,18 @@ int ble_user_property_get_data_by_id(uint8_t id, char *buf, uint16_t buf_len)
         return ble_qiot_data_get(ctx, buf, buf_len);
     }
 
-    ble_qiot_log_e("invalid callback, property id %d", id);
+    ble_qiot_log_e("invalid data type %d", type);
     return -1;
 }
 
+int ble_user_property_get_data_by_id(uint8_t id, char *buf, uint16_t buf_len)
+{
+    void *ctx = ble_property_ctx_get(id);
+    if (ctx == NULL)
+        return -1;
+    return ble_qiot_data_value_get(ctx, buf, buf_len);
+}
+
 #ifdef BLE_QIOT_INCLUDE_EVENT
 
 int ble_user_event_reply_handle(uint8_t event_id, uint8_t result)
@@ -385,7 +449,7 @@ int ble_user_actions_input_set(const e_ble_tlv *tlv)
     if (ctx == NULL)
         return BLE_QIOT_RS_ERR;
 
-    return ble_qiot_data_struct_set(ctx, tlv, 0);
+    return ble_qiot_data_struct_set(ctx, tlv, 0, 0);
 }
 
 #endif
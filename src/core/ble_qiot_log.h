@@ -38,10 +38,85 @@ typedef enum {
 
 extern e_ble_qiot_log_level llsync_g_log_level;
 
+// the compile-time log level of the module the source file belongs to, define it before including any header, e.g.
+// #define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_OTA_LEVEL
+#ifndef BLE_QIOT_LOG_MODULE_LEVEL
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_BUILD_LEVEL
+#endif
+
+// the module level is a constant, a log site above it is removed by the compiler with its arguments
+#define BLE_QIOT_LOG_ENABLED(level) ((BLE_QIOT_LOG_MODULE_LEVEL >= (level)) && (llsync_g_log_level >= (level)))
+
+#if BLE_QIOT_LOG_RING_ENABLE
+enum {
+    BLE_QIOT_LOG_RECORD_FMT = 0,  // formatted log, fmt is the format string
+    BLE_QIOT_LOG_RECORD_HEX = 1,  // hex dump, fmt is the name and data is the head of the dump
+};
+
+// a log record in the ring, the arguments are packaged according to the format string and formatted when drained
+typedef struct {
+    uint32_t    timestamp;  // unit: us
+    const char *fmt;        // format id, the address of the format string in the image
+    uint8_t     level;
+    uint8_t     type;
+    uint8_t     nargs;
+    uint8_t     data_len;                          // the bytes used in data
+    uintptr_t   args[BLE_QIOT_LOG_RING_MAX_ARGS];  // integer arguments, a string argument is the offset in data
+    char        data[BLE_QIOT_LOG_RING_DATA_SIZE];
+} ble_qiot_log_record;
+
+#define BLE_QIOT_LOG_STR_(_X) #_X
+#define BLE_QIOT_LOG_STR(_X)  BLE_QIOT_LOG_STR_(_X)
+// the file and line are folded into the format string, so the format address identifies the log site
+#define BLE_QIOT_LOG_SITE "(" __FILE__ "|" BLE_QIOT_LOG_STR(__LINE__) "): "
+
+#define ble_qiot_log_d(fmt, args...)                                                 \
+    do {                                                                             \
+        if (!BLE_QIOT_LOG_ENABLED(BLE_QIOT_LOG_LEVEL_DEBUG))                         \
+            break;                                                                   \
+        ble_qiot_log_ring_put(BLE_QIOT_LOG_LEVEL_DEBUG, "qiot debug: " fmt, ##args); \
+    } while (0)
+
+#define ble_qiot_log_i(fmt, args...)                                               \
+    do {                                                                           \
+        if (!BLE_QIOT_LOG_ENABLED(BLE_QIOT_LOG_LEVEL_INFO))                        \
+            break;                                                                 \
+        ble_qiot_log_ring_put(BLE_QIOT_LOG_LEVEL_INFO, "qiot info: " fmt, ##args); \
+    } while (0)
+
+#define ble_qiot_log_w(fmt, args...)                                                               \
+    do {                                                                                           \
+        if (!BLE_QIOT_LOG_ENABLED(BLE_QIOT_LOG_LEVEL_WARN))                                        \
+            break;                                                                                 \
+        ble_qiot_log_ring_put(BLE_QIOT_LOG_LEVEL_WARN, "qiot warn" BLE_QIOT_LOG_SITE fmt, ##args); \
+    } while (0)
+
+#define ble_qiot_log_e(fmt, args...)                                                             \
+    do {                                                                                         \
+        if (!BLE_QIOT_LOG_ENABLED(BLE_QIOT_LOG_LEVEL_ERR))                                       \
+            break;                                                                               \
+        ble_qiot_log_ring_put(BLE_QIOT_LOG_LEVEL_ERR, "qiot err" BLE_QIOT_LOG_SITE fmt, ##args); \
+    } while (0)
+
+#define ble_qiot_log(level, fmt, args...)                                       \
+    do {                                                                        \
+        if (!BLE_QIOT_LOG_ENABLED(level))                                       \
+            break;                                                              \
+        ble_qiot_log_ring_put(level, "qiot log" BLE_QIOT_LOG_SITE fmt, ##args); \
+    } while (0)
+
+#define ble_qiot_log_hex(level, hex_name, data, data_len)                             \
+    do {                                                                              \
+        if (!BLE_QIOT_LOG_ENABLED(level))                                             \
+            break;                                                                    \
+        ble_qiot_log_ring_put_hex(level, hex_name, (const char *)(data), (data_len)); \
+    } while (0)
+#endif  // BLE_QIOT_LOG_RING_ENABLE
+
 #ifndef ble_qiot_log_d
 #define ble_qiot_log_d(fmt, args...)                                       \
     do {                                                                   \
-        if (llsync_g_log_level < BLE_QIOT_LOG_LEVEL_DEBUG)                        \
+        if (!BLE_QIOT_LOG_ENABLED(BLE_QIOT_LOG_LEVEL_DEBUG))               \
             break;                                                         \
         BLE_QIOT_LOG_PRINT("qiot debug: " fmt LOG_LINE_FEED_TYPE, ##args); \
     } while (0)
@@ -50,7 +125,7 @@ extern e_ble_qiot_log_level llsync_g_log_level;
 #ifndef ble_qiot_log_i
 #define ble_qiot_log_i(fmt, args...)                                      \
     do {                                                                  \
-        if (llsync_g_log_level < BLE_QIOT_LOG_LEVEL_INFO)                        \
+        if (!BLE_QIOT_LOG_ENABLED(BLE_QIOT_LOG_LEVEL_INFO))               \
             break;                                                        \
         BLE_QIOT_LOG_PRINT("qiot info: " fmt LOG_LINE_FEED_TYPE, ##args); \
     } while (0)
@@ -59,7 +134,7 @@ extern e_ble_qiot_log_level llsync_g_log_level;
 #ifndef ble_qiot_log_w
 #define ble_qiot_log_w(fmt, args...)                                                                 \
     do {                                                                                             \
-        if (llsync_g_log_level < BLE_QIOT_LOG_LEVEL_WARN)                                                   \
+        if (!BLE_QIOT_LOG_ENABLED(BLE_QIOT_LOG_LEVEL_WARN))                                          \
             break;                                                                                   \
         BLE_QIOT_LOG_PRINT("qiot warn(%s|%d): " fmt LOG_LINE_FEED_TYPE, __FILE__, __LINE__, ##args); \
     } while (0)
@@ -68,7 +143,7 @@ extern e_ble_qiot_log_level llsync_g_log_level;
 #ifndef ble_qiot_log_e
 #define ble_qiot_log_e(fmt, args...)                                                                \
     do {                                                                                            \
-        if (llsync_g_log_level < BLE_QIOT_LOG_LEVEL_ERR)                                                   \
+        if (!BLE_QIOT_LOG_ENABLED(BLE_QIOT_LOG_LEVEL_ERR))                                          \
             break;                                                                                  \
         BLE_QIOT_LOG_PRINT("qiot err(%s|%d): " fmt LOG_LINE_FEED_TYPE, __FILE__, __LINE__, ##args); \
     } while (0)
@@ -77,7 +152,7 @@ extern e_ble_qiot_log_level llsync_g_log_level;
 #ifndef ble_qiot_log
 #define ble_qiot_log(level, fmt, args...)                                                           \
     do {                                                                                            \
-        if (llsync_g_log_level < level)                                                                    \
+        if (!BLE_QIOT_LOG_ENABLED(level))                                                           \
             break;                                                                                  \
         BLE_QIOT_LOG_PRINT("qiot log(%s|%d): " fmt LOG_LINE_FEED_TYPE, __FILE__, __LINE__, ##args); \
     } while (0)
@@ -93,10 +168,48 @@ extern e_ble_qiot_log_level llsync_g_log_level;
 
 void ble_qiot_set_log_level(e_ble_qiot_log_level level);
 
-#if !BLE_QIOT_USER_DEFINE_HEXDUMP
+#if !BLE_QIOT_USER_DEFINE_HEXDUMP && !BLE_QIOT_LOG_RING_ENABLE
 void ble_qiot_log_hex(e_ble_qiot_log_level level, const char *hex_name, const char *data, uint32_t data_len);
+#define ble_qiot_log_hex(level, hex_name, data, data_len)                      \
+    do {                                                                       \
+        if (BLE_QIOT_LOG_MODULE_LEVEL < (level))                               \
+            break;                                                             \
+        (ble_qiot_log_hex)(level, hex_name, (const char *)(data), (data_len)); \
+    } while (0)
 #endif  // BLE_QIOT_USER_DEFINE_HEXDUMP
 
+#if BLE_QIOT_LOG_RING_ENABLE
+/**
+ * @brief record a formatted log into the ring, only the conversions d i u x X o c p s f and the length modifiers h l z
+ * are supported, ll only where it fits uintptr_t. a string argument is truncated to the space left in the record
+ * @note  lock-free and never blocks, the record is dropped if the ring is full
+ */
+void ble_qiot_log_ring_put(uint8_t level, const char *fmt, ...);
+
+/**
+ * @brief record the head of a hex dump into the ring, at most BLE_QIOT_LOG_RING_DATA_SIZE bytes are kept
+ */
+void ble_qiot_log_ring_put_hex(uint8_t level, const char *hex_name, const char *data, uint32_t data_len);
+
+/**
+ * @brief take the oldest record from the ring, for offline decoding
+ * @return 1 if a record is read, 0 if the ring is empty
+ */
+int ble_qiot_log_ring_read(ble_qiot_log_record *record);
+
+/**
+ * @brief format and print the records in the ring, call it in a low priority task
+ * @param max_records the max number of records printed in this call
+ * @return the number of records printed
+ */
+int ble_qiot_log_ring_drain(uint16_t max_records);
+
+/**
+ * @brief the number of records dropped because the ring is full
+ */
+uint32_t ble_qiot_log_ring_dropped(void);
+#endif  // BLE_QIOT_LOG_RING_ENABLE
+
 #ifdef __cplusplus
 }
 #endif
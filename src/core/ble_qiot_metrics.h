@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef QCLOUD_BLE_QIOT_METRICS_H
+#define QCLOUD_BLE_QIOT_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ble_qiot_config.h"
+#include "ble_qiot_import.h"
+
+typedef enum {
+    BLE_QIOT_METRIC_DEVICE_INFO_IN_FRAMES = 0,  // writes on the device info characteristic
+    BLE_QIOT_METRIC_DEVICE_INFO_IN_BYTES,
+    BLE_QIOT_METRIC_DATA_IN_FRAMES,  // writes on the data characteristic
+    BLE_QIOT_METRIC_DATA_IN_BYTES,
+    BLE_QIOT_METRIC_OTA_IN_FRAMES,  // writes on the ota characteristic
+    BLE_QIOT_METRIC_OTA_IN_BYTES,
+    BLE_QIOT_METRIC_EVENT_OUT_FRAMES,  // notifications on the event characteristic
+    BLE_QIOT_METRIC_EVENT_OUT_BYTES,
+    BLE_QIOT_METRIC_NOTIFY_FAILED,
+    BLE_QIOT_METRIC_SLICE_REASSEMBLED,  // sliced messages reassembled
+    BLE_QIOT_METRIC_SLICE_DROPPED,      // slices dropped, no header, type mismatch or too long
+    BLE_QIOT_METRIC_REPORT_SENT,        // property reports posted, a failed post is also in notify failed
+    BLE_QIOT_METRIC_REPORT_SUPPRESSED,  // properties left out of the reports, no data to post
+    BLE_QIOT_METRIC_ACTION,             // actions received
+    BLE_QIOT_METRIC_EVENT,              // events posted
+    BLE_QIOT_METRIC_OTA_PACKETS,        // ota packets accepted
+    BLE_QIOT_METRIC_OTA_BYTES,          // ota file bytes accepted
+    BLE_QIOT_METRIC_OTA_ACTIVE_US,      // the time spent receiving ota packets, for the ota rate
+    BLE_QIOT_METRIC_OTA_RETRANSMIT,     // ota data requested again by the timer
+    BLE_QIOT_METRIC_OTA_SEQ_MISS,       // ota data requested again because of unexpected seq
+    BLE_QIOT_METRIC_DISPATCH_QUEUED,    // writes queued to the worker
+    BLE_QIOT_METRIC_DISPATCH_BLOCKED,   // writes and events waiting in the callback for a free buffer
+    BLE_QIOT_METRIC_DISPATCH_INLINE,    // writes handled in the callback, too long or no worker
+    BLE_QIOT_METRIC_ACTION_TIMEOUT,     // actions replied failed because not completed in time
+    BLE_QIOT_METRIC_DISPATCH_STALLED,   // waits for a free buffer timed out, BLE_QIOT_DISPATCH_WAIT_MS each
+    BLE_QIOT_METRIC_BUTT,
+} e_ble_qiot_metric;
+
+#if BLE_QIOT_METRICS_ENABLE
+typedef struct {
+    uint32_t counter[BLE_QIOT_METRIC_BUTT];
+    uint32_t ota_bytes_per_sec;  // the ota rate while receiving packets
+} ble_qiot_metrics;
+
+// the counters of a core, aligned to avoid false sharing between cores
+typedef struct {
+    uint32_t counter[BLE_QIOT_METRIC_BUTT];
+} __attribute__((aligned(64))) ble_qiot_metrics_core;
+
+extern ble_qiot_metrics_core llsync_g_metrics[BLE_QIOT_METRICS_CORE_NUM];
+
+static inline void ble_qiot_metrics_add(uint8_t id, uint32_t n)
+{
+    // tasks on the same core may preempt each other, so the add is still atomic
+    __atomic_fetch_add(&llsync_g_metrics[ble_get_core_id() % BLE_QIOT_METRICS_CORE_NUM].counter[id], n,
+                       __ATOMIC_RELAXED);
+}
+
+#define BLE_QIOT_METRIC_ADD(id, n)     ble_qiot_metrics_add(id, n)
+#define BLE_QIOT_METRIC_INC(id)        ble_qiot_metrics_add(id, 1)
+#define BLE_QIOT_METRIC_OTA_PACKET(n)  ble_qiot_metrics_ota_packet(n)
+
+/**
+ * @brief count an accepted ota packet and the time since the last one
+ */
+void ble_qiot_metrics_ota_packet(uint16_t len);
+
+/**
+ * @brief sum the counters of all cores
+ * @param reset clear the counters read, the counts between the read and the clear are not lost
+ */
+void ble_qiot_metrics_snapshot(ble_qiot_metrics *metrics, bool reset);
+
+/**
+ * @brief the name of a counter, for telemetry
+ */
+const char *ble_qiot_metric_name(uint8_t id);
+#else
+#define BLE_QIOT_METRIC_ADD(id, n)
+#define BLE_QIOT_METRIC_INC(id)
+#define BLE_QIOT_METRIC_OTA_PACKET(n)
+#endif  // BLE_QIOT_METRICS_ENABLE
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_METRICS_H
@@ -13,9 +13,13 @@
 extern "C" {
 #endif
 
+#define BLE_QIOT_LOG_MODULE_LEVEL BLE_QIOT_LOG_SERVICE_LEVEL
+
 #include <stdio.h>
 
 #include "ble_qiot_config.h"
+#include "ble_qiot_context.h"
+#include "ble_qiot_dispatch.h"
 
 #include "ble_qiot_export.h"
 #include "ble_qiot_import.h"
@@ -24,21 +28,13 @@ extern "C" {
 #include "ble_qiot_llsync_event.h"
 #include "ble_qiot_log.h"
 #include "ble_qiot_llsync_ota.h"
+#include "ble_qiot_metrics.h"
 #include "ble_qiot_param_check.h"
 #include "ble_qiot_service.h"
+#include "ble_qiot_stack.h"
 #include "ble_qiot_template.h"
 #include "ble_qiot_service.h"
-
-// llsync support data fragment, so we need to package all the data before parsing if the data is slice
-static ble_event_slice_t sg_ble_slice_data;
-
-#if BLE_QIOT_BUTTON_BROADCAST
-static ble_timer_t sg_bind_timer = NULL;
-#endif  // BLE_QIOT_BUTTON_BROADCAST
-
-#if BLE_QIOT_SECURE_BIND
-static ble_bind_data sg_bind_auth_data;
-#endif  // BLE_QIOT_SECURE_BIND
+#include "ble_qiot_trace.h"
 
 static qiot_service_init_s service_info = {
     .service_uuid16  = IOT_BLE_UUID_SERVICE,
@@ -81,8 +77,10 @@ const qiot_service_init_s *ble_get_qiot_services(void)
 #if BLE_QIOT_SECURE_BIND
 static ble_qiot_ret_status_t ble_secure_bind_handle(const char *data, uint16_t len)
 {
-    memset(&sg_bind_auth_data, 0, sizeof(ble_bind_data));
-    memcpy(&sg_bind_auth_data, data, sizeof(ble_bind_data));
+    ble_qiot_ctx_t *ctx = ble_qiot_ctx_get();
+
+    memset(&ctx->bind_auth_data, 0, sizeof(ble_bind_data));
+    memcpy(&ctx->bind_auth_data, data, sizeof(ble_bind_data));
     ble_event_sync_wait_time();
     ble_secure_bind_user_cb();
 
@@ -91,12 +89,13 @@ static ble_qiot_ret_status_t ble_secure_bind_handle(const char *data, uint16_t l
 
 ble_qiot_ret_status_t ble_secure_bind_user_confirm(ble_qiot_secure_bind_t choose)
 {
-    char    out_buf[80] = {0};
-    int     ret_len     = 0;
-    uint8_t flag        = 0;
+    ble_qiot_ctx_t *ctx         = ble_qiot_ctx_get();
+    char            out_buf[80] = {0};
+    int             ret_len     = 0;
+    uint8_t         flag        = 0;
 
     ble_qiot_log_i("user choose: %d", choose);
-    ret_len = ble_bind_get_authcode(&sg_bind_auth_data, sizeof(ble_bind_data), out_buf, sizeof(out_buf));
+    ret_len = ble_bind_get_authcode(&ctx->bind_auth_data, sizeof(ble_bind_data), out_buf, sizeof(out_buf));
     if (ret_len <= 0) {
         ble_qiot_log_e("get bind authcode failed");
         return BLE_QIOT_RS_ERR;
@@ -106,14 +105,34 @@ ble_qiot_ret_status_t ble_secure_bind_user_confirm(ble_qiot_secure_bind_t choose
 }
 #endif  // BLE_QIOT_SECURE_BIND
 
-void ble_lldata_write_cb(const uint8_t *buf, uint16_t len)
+static void ble_lldata_write_handle(const uint8_t *buf, uint16_t len)
 {
+    BLE_QIOT_STACK_ENTER(BLE_QIOT_STACK_DATA_WRITE);
+    BLE_QIOT_TRACE_MSG_BEGIN();
     (void)ble_lldata_msg_handle((const char *)buf, len);
+    BLE_QIOT_TRACE_MSG_END(ble_qiot_ctx_get()->slice_data.have_data);
+    BLE_QIOT_STACK_EXIT(BLE_QIOT_STACK_DATA_WRITE);
 }
 
-void ble_ota_write_cb(const uint8_t *buf, uint16_t len)
+void ble_lldata_write_cb(const uint8_t *buf, uint16_t len)
+{
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_DATA_IN_FRAMES);
+    BLE_QIOT_METRIC_ADD(BLE_QIOT_METRIC_DATA_IN_BYTES, len);
+    BLE_QIOT_DISPATCH(ble_lldata_write_handle, buf, len);
+}
+
+static void ble_ota_write_handle(const uint8_t *buf, uint16_t len)
 {
+    BLE_QIOT_STACK_ENTER(BLE_QIOT_STACK_OTA_WRITE);
     (void)ble_ota_msg_handle((const char *)buf, len);
+    BLE_QIOT_STACK_EXIT(BLE_QIOT_STACK_OTA_WRITE);
+}
+
+void ble_ota_write_cb(const uint8_t *buf, uint16_t len)
+{
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_OTA_IN_FRAMES);
+    BLE_QIOT_METRIC_ADD(BLE_QIOT_METRIC_OTA_IN_BYTES, len);
+    BLE_QIOT_DISPATCH(ble_ota_write_handle, buf, len);
 }
 
 #endif  // BLE_QIOT_LLSYNC_STANDARD
@@ -121,17 +140,22 @@ void ble_ota_write_cb(const uint8_t *buf, uint16_t len)
 #if BLE_QIOT_BUTTON_BROADCAST
 static void ble_bind_timer_callback(void *param)
 {
+    BLE_QIOT_STACK_ENTER(BLE_QIOT_STACK_BIND_TIMER);
     ble_qiot_log_i("timer timeout");
     if (E_LLSYNC_BIND_WAIT == llsync_bind_state_get()) {
         ble_advertising_stop();
         llsync_bind_state_set(E_LLSYNC_BIND_IDLE);
         ble_qiot_log_i("stop advertising");
     }
+    BLE_QIOT_STACK_EXIT(BLE_QIOT_STACK_BIND_TIMER);
 }
 #endif  // BLE_QIOT_BUTTON_BROADCAST
 
 ble_qiot_ret_status_t ble_qiot_advertising_start(void)
 {
+#if BLE_QIOT_BUTTON_BROADCAST
+    ble_qiot_ctx_t *ctx = ble_qiot_ctx_get();
+#endif  // BLE_QIOT_BUTTON_BROADCAST
     adv_info_s my_adv_info;
     uint16_t   uuids[1];
     uint8_t    adv_data[32] = {0};
@@ -143,9 +167,9 @@ ble_qiot_ret_status_t ble_qiot_advertising_start(void)
 
     if (E_LLSYNC_BIND_IDLE == llsync_bind_state_get()) {
 #if BLE_QIOT_BUTTON_BROADCAST
-        if (NULL == sg_bind_timer) {
-            sg_bind_timer = ble_timer_create(BLE_TIMER_ONE_SHOT_TYPE, ble_bind_timer_callback);
-            if (NULL == sg_bind_timer) {
+        if (NULL == ctx->bind_timer) {
+            ctx->bind_timer = ble_timer_create(BLE_TIMER_ONE_SHOT_TYPE, ble_bind_timer_callback);
+            if (NULL == ctx->bind_timer) {
                 ble_qiot_log_e("create bind timer failed");
                 return BLE_QIOT_RS_ERR;
             }
@@ -163,7 +187,7 @@ ble_qiot_ret_status_t ble_qiot_advertising_start(void)
         ble_qiot_log_i("start wait advertising");
 
 #if BLE_QIOT_BUTTON_BROADCAST
-        ble_timer_start(sg_bind_timer, BLE_QIOT_BIND_TIMEOUT);
+        ble_timer_start(ctx->bind_timer, BLE_QIOT_BIND_TIMEOUT);
 #endif  // BLE_QIOT_BUTTON_BROADCAST
     } else if (E_LLSYNC_BIND_WAIT == llsync_bind_state_get()) {
         ble_advertising_stop();
@@ -175,8 +199,8 @@ ble_qiot_ret_status_t ble_qiot_advertising_start(void)
         ble_qiot_log_i("restart wait advertising");
 
 #if BLE_QIOT_BUTTON_BROADCAST
-        ble_timer_stop(sg_bind_timer);
-        ble_timer_start(sg_bind_timer, BLE_QIOT_BIND_TIMEOUT);
+        ble_timer_stop(ctx->bind_timer);
+        ble_timer_start(ctx->bind_timer, BLE_QIOT_BIND_TIMEOUT);
 #endif  // BLE_QIOT_BUTTON_BROADCAST
     } else if (E_LLSYNC_BIND_SUCC == llsync_bind_state_get()) {
         ble_advertising_stop();
@@ -214,23 +238,42 @@ ble_qiot_ret_status_t ble_qiot_explorer_init(void)
         return ret_code;
     }
 
+#if BLE_QIOT_DISPATCH_ENABLE
+    // the writes are handled in the callback if the worker is not created, so the error is not returned
+    (void)ble_qiot_dispatch_init();
+#endif  // BLE_QIOT_DISPATCH_ENABLE
+
     return ret_code;
 }
 
-void ble_device_info_write_cb(const uint8_t *buf, uint16_t len)
+static void ble_device_info_write_handle(const uint8_t *buf, uint16_t len)
 {
+    BLE_QIOT_STACK_ENTER(BLE_QIOT_STACK_DEVICE_INFO_WRITE);
     (void)ble_device_info_msg_handle((const char *)buf, len);
+    BLE_QIOT_STACK_EXIT(BLE_QIOT_STACK_DEVICE_INFO_WRITE);
+}
+
+void ble_device_info_write_cb(const uint8_t *buf, uint16_t len)
+{
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_DEVICE_INFO_IN_FRAMES);
+    BLE_QIOT_METRIC_ADD(BLE_QIOT_METRIC_DEVICE_INFO_IN_BYTES, len);
+    BLE_QIOT_DISPATCH(ble_device_info_write_handle, buf, len);
+}
+
+static void ble_gap_connect_handle(const uint8_t *buf, uint16_t len)
+{
+    ble_connection_state_set(E_BLE_CONNECTED);
 }
 
 // when gap get ble connect event, use this function
 void ble_gap_connect_cb(void)
 {
-    ble_connection_state_set(E_BLE_CONNECTED);
+    // keep the order with the writes
+    BLE_QIOT_DISPATCH_EVENT(ble_gap_connect_handle);
 }
 
 void llsync_connect_status_notify(int status);
-// when gap get ble disconnect event, use this function
-void ble_gap_disconnect_cb(void)
+static void ble_gap_disconnect_handle(const uint8_t *buf, uint16_t len)
 {
     llsync_mtu_update(0);
     llsync_connection_state_set(E_LLSYNC_DISCONNECTED);
@@ -241,6 +284,12 @@ void ble_gap_disconnect_cb(void)
 #endif  // BLE_QIOT_SUPPORT_OTA
 }
 
+// when gap get ble disconnect event, use this function
+void ble_gap_disconnect_cb(void)
+{
+    BLE_QIOT_DISPATCH_EVENT(ble_gap_disconnect_handle);
+}
+
 static uint8_t ble_msg_type_header_len(uint8_t type)
 {
     if (type == BLE_QIOT_GET_STATUS_REPLY_DATA_TYPE) {
@@ -253,43 +302,49 @@ static uint8_t ble_msg_type_header_len(uint8_t type)
 static int8_t ble_package_slice_data(uint8_t data_type, uint8_t flag, uint8_t header_len, const char *in_buf,
                                      int in_len)
 {
+    ble_qiot_ctx_t *ctx = ble_qiot_ctx_get();
+
     if (!BLE_QIOT_IS_SLICE_HEADER(flag)) {
-        if (!sg_ble_slice_data.have_data) {
+        if (!ctx->slice_data.have_data) {
             ble_qiot_log_e("slice no header");
+            BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_SLICE_DROPPED);
             return -1;
         }
-        if (data_type != sg_ble_slice_data.type) {
-            ble_qiot_log_e("msg type: %d != %d", data_type, sg_ble_slice_data.type);
+        if (data_type != ctx->slice_data.type) {
+            ble_qiot_log_e("msg type: %d != %d", data_type, ctx->slice_data.type);
+            BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_SLICE_DROPPED);
             return -1;
         }
-        if (sg_ble_slice_data.buf_len + (in_len - header_len) > sizeof(sg_ble_slice_data.buf)) {
-            ble_qiot_log_e("too long data: %d > %d", sg_ble_slice_data.buf_len + (in_len - header_len),
-                           sizeof(sg_ble_slice_data.buf));
+        if (ctx->slice_data.buf_len + (in_len - header_len) > sizeof(ctx->slice_data.buf)) {
+            ble_qiot_log_e("too long data: %d > %d", ctx->slice_data.buf_len + (in_len - header_len),
+                           sizeof(ctx->slice_data.buf));
+            BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_SLICE_DROPPED);
             return -1;
         }
     }
 
     if (BLE_QIOT_IS_SLICE_HEADER(flag)) {
-        if (sg_ble_slice_data.have_data) {
+        if (ctx->slice_data.have_data) {
             ble_qiot_log_i("new data coming, clean the package buffer");
-            memset(&sg_ble_slice_data, 0, sizeof(sg_ble_slice_data));
+            memset(&ctx->slice_data, 0, sizeof(ctx->slice_data));
         }
-        sg_ble_slice_data.have_data = true;
-        sg_ble_slice_data.type      = data_type;
+        ctx->slice_data.have_data = true;
+        ctx->slice_data.type      = data_type;
         // reserved space for payload length field
-        sg_ble_slice_data.buf_len += header_len;
-        sg_ble_slice_data.buf[0] = in_buf[0];
-        memcpy(sg_ble_slice_data.buf + sg_ble_slice_data.buf_len, in_buf + header_len, in_len - header_len);
-        sg_ble_slice_data.buf_len += (in_len - header_len);
+        ctx->slice_data.buf_len += header_len;
+        ctx->slice_data.buf[0] = in_buf[0];
+        memcpy(ctx->slice_data.buf + ctx->slice_data.buf_len, in_buf + header_len, in_len - header_len);
+        ctx->slice_data.buf_len += (in_len - header_len);
 
         return 1;
     } else if (BLE_QIOT_IS_SLICE_BODY(flag)) {
-        memcpy(sg_ble_slice_data.buf + sg_ble_slice_data.buf_len, in_buf + header_len, in_len - header_len);
-        sg_ble_slice_data.buf_len += (in_len - header_len);
+        memcpy(ctx->slice_data.buf + ctx->slice_data.buf_len, in_buf + header_len, in_len - header_len);
+        ctx->slice_data.buf_len += (in_len - header_len);
         return 1;
     } else {
-        memcpy(sg_ble_slice_data.buf + sg_ble_slice_data.buf_len, in_buf + header_len, in_len - header_len);
-        sg_ble_slice_data.buf_len += (in_len - header_len);
+        memcpy(ctx->slice_data.buf + ctx->slice_data.buf_len, in_buf + header_len, in_len - header_len);
+        ctx->slice_data.buf_len += (in_len - header_len);
+        BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_SLICE_REASSEMBLED);
 
         return 0;
     }
@@ -298,20 +353,17 @@ static int8_t ble_package_slice_data(uint8_t data_type, uint8_t flag, uint8_t he
 int ble_device_info_msg_handle(const char *in_buf, int in_len)
 {
     POINTER_SANITY_CHECK(in_buf, BLE_QIOT_RS_ERR_PARA);
-    uint8_t  ch;
-    char     out_buf[100] = {0};
-    char *   p_data       = NULL;
-    int      p_data_len   = 0;
-    int      ret_len      = 0;
-    uint16_t tmp_len      = 0;
-    uint8_t  header_len   = 0;
-    int      ret          = BLE_QIOT_RS_OK;
-    char *   p_ssid       = NULL;
-    char *   p_passwd     = NULL;
-    // This flag is use to avoid attacker jump "ble_conn_get_authcode()" step, then
-    // send 'E_DEV_MSG_CONN_SUCC' msg, and device straightly set 'E_LLSYNC_CONNECTED' flag.
-    // This behavior make signature check useless lead to risk.
-    static bool conn_flag = false;
+    ble_qiot_ctx_t *ctx          = ble_qiot_ctx_get();
+    uint8_t         ch;
+    char            out_buf[100] = {0};
+    char *          p_data       = NULL;
+    int             p_data_len   = 0;
+    int             ret_len      = 0;
+    uint16_t        tmp_len      = 0;
+    uint8_t         header_len   = 0;
+    int             ret          = BLE_QIOT_RS_OK;
+    char *          p_ssid       = NULL;
+    char *          p_passwd     = NULL;
 
     p_data     = (char *)in_buf;
     p_data_len = in_len;
@@ -326,10 +378,10 @@ int ble_device_info_msg_handle(const char *in_buf, int in_len)
         if (ret < 0) {
             return BLE_QIOT_RS_ERR;
         } else if (ret == 0) {
-            tmp_len = HTONS(sg_ble_slice_data.buf_len - header_len);
-            memcpy(&sg_ble_slice_data.buf[1], &tmp_len, sizeof(tmp_len));
-            p_data     = sg_ble_slice_data.buf;
-            p_data_len = sg_ble_slice_data.buf_len;
+            tmp_len = HTONS(ctx->slice_data.buf_len - header_len);
+            memcpy(&ctx->slice_data.buf[1], &tmp_len, sizeof(tmp_len));
+            p_data     = ctx->slice_data.buf;
+            p_data_len = ctx->slice_data.buf_len;
         } else if (ret > 0) {
             return BLE_QIOT_RS_OK;
         }
@@ -372,7 +424,7 @@ int ble_device_info_msg_handle(const char *in_buf, int in_len)
                 break;
             }
             ret       = ble_event_notify((uint8_t)BLE_QIOT_EVENT_UP_CONN_SIGN_RET, NULL, 0, out_buf, ret_len);
-            conn_flag = true;
+            ctx->conn_flag = true;
             break;
         case E_DEV_MSG_BIND_SUCC:
             if (BLE_QIOT_RS_OK != ble_bind_write_result(p_data + 3, p_data_len - 3)) {
@@ -393,10 +445,10 @@ int ble_device_info_msg_handle(const char *in_buf, int in_len)
             ret = ble_event_notify((uint8_t)BLE_QIOT_EVENT_UP_UNBIND_SIGN_RET, NULL, 0, out_buf, ret_len);
             break;
         case E_DEV_MSG_CONN_SUCC:
-            if (!conn_flag) {
+            if (!ctx->conn_flag) {
                 break;
             }
-            conn_flag = false;
+            ctx->conn_flag = false;
             ble_qiot_log_i("get msg connect success");
             llsync_connection_state_set(E_LLSYNC_CONNECTED);
             llsync_connect_status_notify(E_LLSYNC_CONNECTED);
@@ -474,7 +526,7 @@ int ble_device_info_msg_handle(const char *in_buf, int in_len)
             ble_qiot_log_e("unknow type %d", ch);
             break;
     }
-    memset(&sg_ble_slice_data, 0, sizeof(sg_ble_slice_data));
+    memset(&ctx->slice_data, 0, sizeof(ctx->slice_data));
 
     return ret;
 }
@@ -485,16 +537,17 @@ int ble_lldata_msg_handle(const char *in_buf, int in_len)
 {
     POINTER_SANITY_CHECK(in_buf, BLE_QIOT_RS_ERR_PARA);
 
-    uint8_t  data_type   = 0;
-    uint8_t  data_effect = 0;
-    uint8_t  id          = 0;
-    uint8_t  slice_flag  = 0;
-    uint8_t  header_len  = 0;
-    uint8_t  slice_type  = 0;
-    uint16_t tmp_len     = 0;
-    char *   p_data      = NULL;
-    int      p_data_len  = 0;
-    int      ret         = 0;
+    ble_qiot_ctx_t *ctx         = ble_qiot_ctx_get();
+    uint8_t         data_type   = 0;
+    uint8_t         data_effect = 0;
+    uint8_t         id          = 0;
+    uint8_t         slice_flag  = 0;
+    uint8_t         header_len  = 0;
+    uint8_t         slice_type  = 0;
+    uint16_t        tmp_len     = 0;
+    char *          p_data      = NULL;
+    int             p_data_len  = 0;
+    int             ret         = 0;
 
     if (!llsync_is_connected()) {
         ble_qiot_log_e("operation negate, device not connected");
@@ -530,21 +583,22 @@ int ble_lldata_msg_handle(const char *in_buf, int in_len)
             if (ret < 0) {
                 return BLE_QIOT_RS_ERR;
             } else if (ret == 0) {
-                tmp_len = HTONS(sg_ble_slice_data.buf_len - header_len);
+                tmp_len = HTONS(ctx->slice_data.buf_len - header_len);
                 if (BLE_QIOT_GET_STATUS_REPLY_DATA_TYPE == slice_type) {
-                    sg_ble_slice_data.buf[1] = in_buf[1];
-                    memcpy(&sg_ble_slice_data.buf[2], &tmp_len, sizeof(tmp_len));
+                    ctx->slice_data.buf[1] = in_buf[1];
+                    memcpy(&ctx->slice_data.buf[2], &tmp_len, sizeof(tmp_len));
                 } else {
-                    memcpy(&sg_ble_slice_data.buf[1], &tmp_len, sizeof(tmp_len));
+                    memcpy(&ctx->slice_data.buf[1], &tmp_len, sizeof(tmp_len));
                 }
-                p_data     = sg_ble_slice_data.buf;
-                p_data_len = sg_ble_slice_data.buf_len;
+                p_data     = ctx->slice_data.buf;
+                p_data_len = ctx->slice_data.buf_len;
             } else if (ret > 0) {
                 return BLE_QIOT_RS_OK;
             }
         }
     }
     // ble_qiot_log_hex(BLE_QIOT_LOG_LEVEL_INFO, "tlv", p_data, p_data_len);
+    BLE_QIOT_TRACE_MSG_READY(data_type, data_effect);
 
     switch (data_type) {
         case BLE_QIOT_MSG_TYPE_PROPERTY:
@@ -577,7 +631,7 @@ int ble_lldata_msg_handle(const char *in_buf, int in_len)
         default:
             break;
     }
-    memset(&sg_ble_slice_data, 0, sizeof(sg_ble_slice_data));
+    memset(&ctx->slice_data, 0, sizeof(ctx->slice_data));
 
     return ret;
 }
@@ -592,13 +646,14 @@ int ble_ota_msg_handle(const char *buf, uint16_t len)
 {
     POINTER_SANITY_CHECK(buf, BLE_QIOT_RS_ERR_PARA);
 
-    uint8_t  data_type  = 0;
-    int      ret        = BLE_QIOT_RS_OK;
-    uint8_t  header_len = 0;
-    uint8_t  slice_flag = 0;
-    char *   p_data     = NULL;
-    int      p_data_len = 0;
-    uint16_t tmp_len    = 0;
+    ble_qiot_ctx_t *ctx        = ble_qiot_ctx_get();
+    uint8_t         data_type  = 0;
+    int             ret        = BLE_QIOT_RS_OK;
+    uint8_t         header_len = 0;
+    uint8_t         slice_flag = 0;
+    char *          p_data     = NULL;
+    int             p_data_len = 0;
+    uint16_t        tmp_len    = 0;
 
     if (!llsync_is_connected()) {
         ble_qiot_log_e("upgrade forbidden, device not connected");
@@ -623,16 +678,16 @@ int ble_ota_msg_handle(const char *buf, uint16_t len)
             return BLE_QIOT_RS_ERR;
         } else if (ret == 0) {
             if (data_type == BLE_QIOT_OTA_MSG_REQUEST) {
-                tmp_len = HTONS(sg_ble_slice_data.buf_len - header_len);
-                memcpy(&sg_ble_slice_data.buf[1], &tmp_len, sizeof(tmp_len));
+                tmp_len = HTONS(ctx->slice_data.buf_len - header_len);
+                memcpy(&ctx->slice_data.buf[1], &tmp_len, sizeof(tmp_len));
             } else {
-                sg_ble_slice_data.buf[1] = sg_ble_slice_data.buf_len - header_len;
+                ctx->slice_data.buf[1] = ctx->slice_data.buf_len - header_len;
             }
             if (data_type == BLE_QIOT_OTA_MSG_DATA) {
-                sg_ble_slice_data.buf[2] = buf[2];
+                ctx->slice_data.buf[2] = buf[2];
             }
-            p_data     = sg_ble_slice_data.buf;
-            p_data_len = sg_ble_slice_data.buf_len;
+            p_data     = ctx->slice_data.buf;
+            p_data_len = ctx->slice_data.buf_len;
         } else if (ret > 0) {
             return BLE_QIOT_RS_OK;
         }
@@ -652,7 +707,7 @@ int ble_ota_msg_handle(const char *buf, uint16_t len)
         default:
             break;
     }
-    memset(&sg_ble_slice_data, 0, sizeof(sg_ble_slice_data));
+    memset(&ctx->slice_data, 0, sizeof(ctx->slice_data));
 
     return ret;
 }
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef QCLOUD_BLE_QIOT_STACK_H
+#define QCLOUD_BLE_QIOT_STACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ble_qiot_config.h"
+
+// keep the big buffers of a function out of the frames of its caller, so they are not on the stack while the caller
+// runs the user handlers
+#define BLE_QIOT_NOINLINE __attribute__((noinline))
+
+// the entry points of the sdk, the functions called by the ble stack, the timers and the user. the deepest stack used
+// by each with the log off and the user handlers doing nothing, measured on the x86-64 host port built by gcc -O2 with
+// BLE_QIOT_EVENT_MAX_SIZE 2048, a 32 bits mcu uses less:
+//   device info write  1.0 KB, the hmac of the bind and the connection
+//   data write         2.8 KB, the reply of an action. the 2 KB encoding of the output is not on the stack while the
+//                      action handler runs, a report or an event posted by a handler adds its own entry point
+//   ota write          0.9 KB, the flash write is up to the port
+//   ota timer          0.8 KB
+//   report, event post 2.6 KB, BLE_QIOT_EVENT_MAX_SIZE of the encoding and a slice of the notification
+// the log printing adds the stack of the printf of the platform
+typedef enum {
+    BLE_QIOT_STACK_DEVICE_INFO_WRITE = 0,  // ble_device_info_write_cb(), in the dispatch task if enabled
+    BLE_QIOT_STACK_DATA_WRITE,             // ble_lldata_write_cb(), in the dispatch task if enabled
+    BLE_QIOT_STACK_OTA_WRITE,              // ble_ota_write_cb(), in the dispatch task if enabled
+    BLE_QIOT_STACK_OTA_TIMER,              // the ota retry timer
+    BLE_QIOT_STACK_BIND_TIMER,             // the bind timeout timer of BLE_QIOT_BUTTON_BROADCAST
+    BLE_QIOT_STACK_REPORT,                 // ble_event_report_property() and ble_user_property_get_report_data()
+    BLE_QIOT_STACK_EVENT_POST,             // ble_event_post()
+    BLE_QIOT_STACK_BUTT,
+} e_ble_qiot_stack_entry;
+
+#if BLE_QIOT_STACK_ENABLE
+typedef struct {
+    uint32_t calls;
+    uint32_t max;        // the deepest stack used below the entry point, unit: byte
+    uint32_t saturated;  // the calls which wrote all the bytes painted, max is less than the real use
+} ble_qiot_stack_stats;
+
+// the hooks, in pairs at the start and the end of an entry point in the same function. the stack below the frame is
+// painted on the way in and scanned for the deepest byte written on the way out
+#define BLE_QIOT_STACK_ENTER(entry) uintptr_t ble_qiot_stack_painted_ = ble_qiot_stack_paint()
+#define BLE_QIOT_STACK_EXIT(entry) \
+    ble_qiot_stack_scan(entry, (uintptr_t)__builtin_frame_address(0), ble_qiot_stack_painted_)
+
+/**
+ * @brief paint BLE_QIOT_STACK_PAINT_SIZE bytes of the stack below the caller
+ * @return the lowest address painted, for ble_qiot_stack_scan()
+ */
+uintptr_t ble_qiot_stack_paint(void);
+
+/**
+ * @brief find the deepest byte written since ble_qiot_stack_paint() and add the use to the entry point
+ * @param entry   e_ble_qiot_stack_entry
+ * @param top     the frame of the entry point, the use is counted from here
+ * @param painted the return of ble_qiot_stack_paint()
+ */
+void ble_qiot_stack_scan(uint8_t entry, uintptr_t top, uintptr_t painted);
+
+/**
+ * @brief copy the high-water mark of an entry point
+ * @param entry e_ble_qiot_stack_entry
+ * @return BLE_QIOT_RS_OK is success, other is error
+ */
+int ble_qiot_stack_get(uint8_t entry, ble_qiot_stack_stats *stats);
+
+/**
+ * @brief clear the high-water marks
+ */
+void ble_qiot_stack_reset(void);
+
+/**
+ * @brief the name of an entry point, for telemetry
+ */
+const char *ble_qiot_stack_entry_name(uint8_t entry);
+#else
+#define BLE_QIOT_STACK_ENTER(entry)
+#define BLE_QIOT_STACK_EXIT(entry)
+#endif  // BLE_QIOT_STACK_ENABLE
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_STACK_H
@@ -63,6 +63,9 @@ typedef struct{	uint8_t type;
 #define BLE_QIOT_DATA_ENUM_TYPE_LEN    2
 #define BLE_QIOT_DATA_BOOL_TYPE_LEN    1
 #define BLE_QIOT_PROPERTY_DEFAULT_ARRAY_SIZE   3
+#define BLE_QIOT_PROPERTY_MAX_ARRAY_SIZE       64  // the "size" of an array in the model, the elements allocated
+#define BLE_QIOT_PROPERTY_ID_MAX               32  // the id of a tlv has 5 bits
+#define BLE_QIOT_ACTION_REPLY_DEFERRED         (-1)  // see ble_actions_input_notify()
 
 #define	BLE_QIOT_INCLUDE_PROPERTY
 #define	BLE_QIOT_INCLUDE_EVENT
@@ -70,8 +73,13 @@ typedef struct{	uint8_t type;
 
 uint8_t ble_qiot_data_type_get(void *ctx);
 int ble_qiot_data_set(void *ctx, const char *buf, uint16_t buf_len);
+// BLE_QIOT_RS_OK if ble_qiot_data_set() accepts the value, nothing is set
+int ble_qiot_data_check(void *ctx, const char *buf, uint16_t buf_len);
 int ble_qiot_data_get(void *ctx, char *buf, uint16_t buf_len);
+// the value of ctx as sent, with the tlvs of the members of a struct or an array
+int ble_qiot_data_value_get(void *ctx, char *buf, uint16_t buf_len);
 uint8_t ble_struct_array_get_elem_cnt(void *ctx);
+int ble_struct_array_set_elem_cnt(void *ctx, uint8_t cnt);
 int ble_struct_array_elem_set(void *ctx, uint8_t id, const char *val, int len);
 void *ble_struct_array_get_elem_ctx(void *ctx, uint8_t id);
 
@@ -81,23 +89,28 @@ uint8_t ble_get_property_size();
 uint8_t ble_get_property_type_by_id(uint8_t id);
 void *ble_property_ctx_get(uint8_t id);
 int ble_user_property_set_data(const e_ble_tlv *tlv);
+int ble_user_property_check_data(const e_ble_tlv *tlv);
 int ble_user_property_get_data_by_id(uint8_t id, char *buf, uint16_t buf_len);
 int ble_user_property_report_reply_handle(uint8_t result);
 int ble_lldata_parse_tlv(const char *buf, int buf_len, e_ble_tlv *tlv);
-void ble_property_change_notify(const e_ble_tlv *tlv);
+// the properties set by one control, each id once in ascending order
+void ble_property_changes_notify(const uint8_t *ids, uint8_t num);
 #endif
 // event module
 #ifdef BLE_QIOT_INCLUDE_EVENT
-int     ble_event_get_id_array_size(uint8_t event_id);
-uint8_t ble_event_get_param_id_type(uint8_t event_id, uint8_t param_id);
-int     ble_event_get_data_by_id(uint8_t event_id, uint8_t param_id, char *out_buf, uint16_t buf_len);
-int     ble_user_event_reply_handle(uint8_t event_id, uint8_t result);
+// the struct of the params of event id, NULL if no such event
+void *ble_event_ctx_get(uint8_t event_id);
+int   ble_user_event_reply_handle(uint8_t event_id, uint8_t result);
 #endif
 // action module
 #ifdef BLE_QIOT_INCLUDE_ACTION
 void *ble_actions_input_ctx_get(uint8_t id);
 int ble_user_actions_input_set(const e_ble_tlv *tlv);
-void ble_actions_input_notify(uint8_t id, uint8_t output_flag[]);
+// the input of action id is set, output_flag[] marks the output params to reply. returns the reply to send now,
+// BLE_QIOT_REPLY_SUCCESS with the output or another e_ble_qiot_reply, or BLE_QIOT_ACTION_REPLY_DEFERRED if the action
+// is replied later by ble_action_reply()
+int ble_actions_input_notify(uint8_t id, uint8_t output_flag[]);
+int ble_action_reply(uint8_t action_id, int8_t result, const uint8_t *output_flag, uint8_t output_num);
 uint8_t ble_action_get_output_type_by_id(uint8_t action_id, uint8_t output_id);
 int     ble_action_user_handle_output_param(uint8_t action_id, uint8_t output_id, char *buf, uint16_t buf_len);
 #endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef QCLOUD_BLE_QIOT_TRACE_H
+#define QCLOUD_BLE_QIOT_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ble_qiot_config.h"
+
+// the message types traced, the messages written by Tencent Lianlian on the lldata characteristic
+typedef enum {
+    BLE_QIOT_TRACE_MSG_CONTROL = 0,     // property control
+    BLE_QIOT_TRACE_MSG_PROPERTY_REPLY,  // reply of property report or get status
+    BLE_QIOT_TRACE_MSG_EVENT_REPLY,     // reply of event post
+    BLE_QIOT_TRACE_MSG_ACTION,          // action input
+    BLE_QIOT_TRACE_MSG_BUTT,
+} e_ble_qiot_trace_msg;
+
+// the stages of a message, a trace point closes the stage started by the previous point
+typedef enum {
+    BLE_QIOT_TRACE_WRITE = 0,     // between the slices written by the remote
+    BLE_QIOT_TRACE_REASSEMBLE,    // the last write to the message reassembled
+    BLE_QIOT_TRACE_SET,           // parse and set the value, ble_user_property_set_data() or the action input
+    BLE_QIOT_TRACE_HANDLER,       // the user handler, ThingModel::PropertyNotify() or the action handler, until
+                                  // ble_action_reply() if the action is deferred
+    BLE_QIOT_TRACE_NOTIFY,        // build and send a slice of the reply by ble_send_notify()
+    BLE_QIOT_TRACE_TOTAL,         // the first write to the end of handling, or to the reply of a deferred action
+    BLE_QIOT_TRACE_STAGE_BUTT,
+} e_ble_qiot_trace_stage;
+
+#if BLE_QIOT_TRACE_ENABLE
+typedef struct {
+    uint32_t count;
+    uint32_t max;  // unit: us
+    uint64_t sum;  // unit: us
+    uint32_t bucket[BLE_QIOT_TRACE_HIST_BUCKETS];
+} ble_qiot_trace_hist;
+
+// a stage recorded for exporting
+typedef struct {
+    uint32_t timestamp;  // the end of the stage, unit: us
+    uint32_t duration;   // unit: us
+    uint16_t seq;        // the sequence of the message, 0 means the stage is out of any message
+    uint8_t  msg_type;
+    uint8_t  stage;
+} ble_qiot_trace_event;
+
+// the hooks. a message belongs to the task handling its writes, the ble stack or the dispatch worker, and only the
+// points of that task are added to it. a notification of another task, like a property report or an action completed
+// by the app, is recorded as an event out of any message. a deferred action keeps its message open until
+// ble_action_reply(), the reply is added to it by the task sending it
+#define BLE_QIOT_TRACE_MSG_BEGIN()                    ble_qiot_trace_msg_begin()
+#define BLE_QIOT_TRACE_MSG_READY(data_type, effect)   ble_qiot_trace_msg_ready(data_type, effect)
+#define BLE_QIOT_TRACE_POINT(stage)                   ble_qiot_trace_point(stage)
+#define BLE_QIOT_TRACE_MSG_END(pending)               ble_qiot_trace_msg_end(pending)
+#define BLE_QIOT_TRACE_ACTION_HANDLE(action_id)       ble_qiot_trace_action_handle(action_id)
+#define BLE_QIOT_TRACE_ACTION_DEFER(deferred)         ble_qiot_trace_action_defer(deferred)
+#define BLE_QIOT_TRACE_ACTION_REPLY_BEGIN(action_id)  ble_qiot_trace_action_reply_begin(action_id)
+#define BLE_QIOT_TRACE_ACTION_REPLY_END()             ble_qiot_trace_action_reply_end()
+
+/**
+ * @brief a write from the remote, starts a message if there is no message in progress. the write is out of any
+ *        message if another task has one in progress
+ */
+void ble_qiot_trace_msg_begin(void);
+
+/**
+ * @brief the message is reassembled and going to be handled
+ * @param data_type BLE_QIOT_MSG_TYPE_PROPERTY, BLE_QIOT_MSG_TYPE_EVENT or BLE_QIOT_MSG_TYPE_ACTION
+ * @param effect    BLE_QIOT_EFFECT_REQUEST or BLE_QIOT_EFFECT_REPLY
+ */
+void ble_qiot_trace_msg_ready(uint8_t data_type, uint8_t effect);
+
+/**
+ * @brief close the stage, the time since the previous point is added to it
+ */
+void ble_qiot_trace_point(uint8_t stage);
+
+/**
+ * @brief the write is handled, the message is aggregated into the histograms if it is reassembled
+ * @param pending true if the message waits for more slices
+ */
+void ble_qiot_trace_msg_end(bool pending);
+
+/**
+ * @brief the action handler is going to be called, a slot is reserved to keep the message if the action is deferred
+ * @param action_id the action id of the current context
+ */
+void ble_qiot_trace_action_handle(uint8_t action_id);
+
+/**
+ * @brief the action handler returned, the message of a deferred action is kept until the reply. it is aggregated
+ *        when handled as before if BLE_QIOT_TRACE_DEFERRED_NUM actions are deferred already, or if the action is
+ *        replied before the handler returns to here
+ * @param deferred true if the action is replied later by ble_action_reply()
+ */
+void ble_qiot_trace_action_defer(bool deferred);
+
+/**
+ * @brief the reply of an action is going to be sent, the points of the task until the end are added to the
+ *        message of the action if it is deferred
+ * @param action_id the action id of the current context
+ */
+void ble_qiot_trace_action_reply_begin(uint8_t action_id);
+
+/**
+ * @brief the reply of an action is sent, the message of the deferred action is aggregated into the histograms
+ */
+void ble_qiot_trace_action_reply_end(void);
+
+/**
+ * @brief copy the latency histogram of a stage
+ * @param msg_type e_ble_qiot_trace_msg
+ * @param stage    e_ble_qiot_trace_stage
+ * @return BLE_QIOT_RS_OK is success, other is error
+ */
+int ble_qiot_trace_hist_get(uint8_t msg_type, uint8_t stage, ble_qiot_trace_hist *hist);
+
+/**
+ * @brief copy the recent stages, the oldest first
+ * @return the number of stages copied
+ */
+int ble_qiot_trace_events_get(ble_qiot_trace_event *events, uint16_t max_events);
+
+/**
+ * @brief clear the histograms and the recent stages
+ */
+void ble_qiot_trace_reset(void);
+#else
+#define BLE_QIOT_TRACE_MSG_BEGIN()
+#define BLE_QIOT_TRACE_MSG_READY(data_type, effect)
+#define BLE_QIOT_TRACE_POINT(stage)
+#define BLE_QIOT_TRACE_MSG_END(pending)
+#define BLE_QIOT_TRACE_ACTION_HANDLE(action_id)
+#define BLE_QIOT_TRACE_ACTION_DEFER(deferred)
+#define BLE_QIOT_TRACE_ACTION_REPLY_BEGIN(action_id)
+#define BLE_QIOT_TRACE_ACTION_REPLY_END()
+#endif  // BLE_QIOT_TRACE_ENABLE
+
+#ifdef __cplusplus
+}
+#endif
+#endif  // QCLOUD_BLE_QIOT_TRACE_H
@@ -357,8 +357,9 @@ static int aes_init_done = 0;
 static void aes_gen_tables(void)
 {
     int i, x, y, z;
-    int pow[256];
-    int log[256];
+    // the values are bytes, the tables are on the stack of the first bind or connection
+    uint8_t pow[256];
+    uint8_t log[256];
 
     /*
      * compute pow and log tables over GF(2^8)
@@ -16,8 +16,12 @@ extern "C" {
 #include "ble_qiot_log.h"
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
+
+#include "ble_qiot_import.h"
 
 #define HEX_DUMP_BYTE_PER_LINE 16
 
@@ -29,8 +33,9 @@ void ble_qiot_set_log_level(e_ble_qiot_log_level level)
     return;
 }
 
-#if !BLE_QIOT_USER_DEFINE_HEXDUMP
-void ble_qiot_log_hex(e_ble_qiot_log_level level, const char *hex_name, const char *data, uint32_t data_len)
+#if !BLE_QIOT_USER_DEFINE_HEXDUMP && !BLE_QIOT_LOG_RING_ENABLE
+// the name is parenthesized to bypass the ble_qiot_log_hex macro of ble_qiot_log.h
+void (ble_qiot_log_hex)(e_ble_qiot_log_level level, const char *hex_name, const char *data, uint32_t data_len)
 {
     char buf[HEX_DUMP_BYTE_PER_LINE * 5] = {0};
     int  line_count = 0, line = 0, byte = 0, rest = 0, start_byte = 0;
@@ -56,7 +61,7 @@ void ble_qiot_log_hex(e_ble_qiot_log_level level, const char *hex_name, const ch
 
         for (byte = 0; byte < HEX_DUMP_BYTE_PER_LINE; byte++) {
             if (byte < rest) {
-                sprintf(&buf[byte * 3], "%02X ", data[start_byte + byte]);
+                sprintf(&buf[byte * 3], "%02X ", (uint8_t)data[start_byte + byte]);
             } else {
                 sprintf(&buf[byte * 3], "   ");
             }
@@ -78,6 +83,338 @@ void ble_qiot_log_hex(e_ble_qiot_log_level level, const char *hex_name, const ch
 }
 #endif  // BLE_QIOT_USER_DEFINE_HEXDUMP
 
+#if BLE_QIOT_LOG_RING_ENABLE
+#if (BLE_QIOT_LOG_RING_SIZE & (BLE_QIOT_LOG_RING_SIZE - 1)) != 0
+#error "BLE_QIOT_LOG_RING_SIZE must be power of 2"
+#endif
+
+#define LOG_RING_MASK          (BLE_QIOT_LOG_RING_SIZE - 1)
+#define LOG_RING_LINE_SIZE     192
+#define LOG_RING_SPEC_SIZE     16
+#define LOG_RING_STR_TRUNCATED ((uintptr_t)-1)
+
+// length modifier of a conversion
+enum {
+    LOG_RING_LEN_INT = 0,
+    LOG_RING_LEN_LONG,
+    LOG_RING_LEN_LLONG,
+    LOG_RING_LEN_SIZE,
+};
+
+// the slot is writable for the position pos if (seq + index) == pos, readable if (seq + index) == pos + 1, the index is
+// added so that the zero initialized ring is writable without an init function
+typedef struct {
+    uint32_t            seq;
+    ble_qiot_log_record record;
+} ble_qiot_log_slot;
+
+static ble_qiot_log_slot sg_log_ring[BLE_QIOT_LOG_RING_SIZE];
+static uint32_t          sg_log_ring_head    = 0;  // the next position to write
+static uint32_t          sg_log_ring_tail    = 0;  // the next position to read
+static uint32_t          sg_log_ring_dropped = 0;  // records dropped because the ring is full
+
+static inline uint32_t ble_qiot_log_slot_seq(uint32_t pos)
+{
+    return __atomic_load_n(&sg_log_ring[pos & LOG_RING_MASK].seq, __ATOMIC_ACQUIRE) + (pos & LOG_RING_MASK);
+}
+
+static inline void ble_qiot_log_slot_seq_set(uint32_t pos, uint32_t seq)
+{
+    __atomic_store_n(&sg_log_ring[pos & LOG_RING_MASK].seq, seq - (pos & LOG_RING_MASK), __ATOMIC_RELEASE);
+}
+
+// reserve a slot for writing, return NULL if the ring is full
+static ble_qiot_log_record *ble_qiot_log_ring_reserve(uint32_t *pos_out)
+{
+    uint32_t pos = __atomic_load_n(&sg_log_ring_head, __ATOMIC_RELAXED);
+    int32_t  dif = 0;
+
+    for (;;) {
+        dif = (int32_t)(ble_qiot_log_slot_seq(pos) - pos);
+        if (0 == dif) {
+            if (__atomic_compare_exchange_n(&sg_log_ring_head, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                *pos_out = pos;
+                return &sg_log_ring[pos & LOG_RING_MASK].record;
+            }
+        } else if (dif < 0) {
+            __atomic_fetch_add(&sg_log_ring_dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&sg_log_ring_head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static inline void ble_qiot_log_ring_commit(uint32_t pos)
+{
+    ble_qiot_log_slot_seq_set(pos, pos + 1);
+}
+
+void ble_qiot_log_ring_put(uint8_t level, const char *fmt, ...)
+{
+    ble_qiot_log_record *record = NULL;
+    uint32_t             pos    = 0;
+    const char *         p      = fmt;
+    const char *         str    = NULL;
+    uint8_t              len    = LOG_RING_LEN_INT;
+    uint16_t             copy   = 0;
+    uintptr_t            arg    = 0;
+    double               dval   = 0;
+    float                fval   = 0;
+    va_list              ap;
+
+    record = ble_qiot_log_ring_reserve(&pos);
+    if (NULL == record) {
+        return;
+    }
+    record->timestamp = ble_get_timestamp_us();
+    record->fmt       = fmt;
+    record->level     = level;
+    record->type      = BLE_QIOT_LOG_RECORD_FMT;
+    record->nargs     = 0;
+    record->data_len  = 0;
+
+    // package the arguments by the format string, the same walk is done again when the record is formatted
+    va_start(ap, fmt);
+    while ((NULL != (p = strchr(p, '%'))) && (record->nargs < BLE_QIOT_LOG_RING_MAX_ARGS)) {
+        p++;
+        if ('%' == *p) {
+            p++;
+            continue;
+        }
+        while (('\0' != *p) && (NULL != strchr("-+ #0123456789.", *p))) {
+            p++;
+        }
+        len = LOG_RING_LEN_INT;
+        for (; ('h' == *p) || ('l' == *p) || ('z' == *p); p++) {
+            if ('l' == *p) {
+                len = (LOG_RING_LEN_LONG == len) ? LOG_RING_LEN_LLONG : LOG_RING_LEN_LONG;
+            } else if ('z' == *p) {
+                len = LOG_RING_LEN_SIZE;
+            }
+        }
+        switch (*p) {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            case 'c':
+                if (LOG_RING_LEN_LONG == len) {
+                    arg = (uintptr_t)va_arg(ap, unsigned long);
+                } else if (LOG_RING_LEN_LLONG == len) {
+                    if (sizeof(unsigned long long) > sizeof(uintptr_t)) {
+                        // the slot of a 32 bits target can not keep it, the drain prints '?' instead of a truncated
+                        // value and the arguments after it can not be fetched
+                        goto end;
+                    }
+                    arg = (uintptr_t)va_arg(ap, unsigned long long);
+                } else if (LOG_RING_LEN_SIZE == len) {
+                    arg = (uintptr_t)va_arg(ap, size_t);
+                } else {
+                    arg = (uintptr_t)va_arg(ap, unsigned int);
+                }
+                break;
+            case 'p':
+                arg = (uintptr_t)va_arg(ap, void *);
+                break;
+            case 's':
+                // copy the string, the caller's buffer may not live until the record is formatted
+                str = va_arg(ap, const char *);
+                arg = LOG_RING_STR_TRUNCATED;
+                if ((NULL != str) && (record->data_len < sizeof(record->data))) {
+                    copy = strnlen(str, sizeof(record->data) - record->data_len - 1);
+                    memcpy(record->data + record->data_len, str, copy);
+                    record->data[record->data_len + copy] = '\0';
+                    arg = record->data_len;
+                    record->data_len += copy + 1;
+                }
+                break;
+            case 'f':
+            case 'e':
+            case 'g':
+                dval = va_arg(ap, double);
+                fval = (float)dval;
+                memcpy(&arg, &fval, sizeof(fval));
+                break;
+            default:
+                // unsupported conversion, the arguments after it can not be fetched
+                goto end;
+        }
+        record->args[record->nargs++] = arg;
+        p++;
+    }
+end:
+    va_end(ap);
+    ble_qiot_log_ring_commit(pos);
+}
+
+void ble_qiot_log_ring_put_hex(uint8_t level, const char *hex_name, const char *data, uint32_t data_len)
+{
+    ble_qiot_log_record *record = NULL;
+    uint32_t             pos    = 0;
+
+    record = ble_qiot_log_ring_reserve(&pos);
+    if (NULL == record) {
+        return;
+    }
+    record->timestamp = ble_get_timestamp_us();
+    record->fmt       = hex_name;
+    record->level     = level;
+    record->type      = BLE_QIOT_LOG_RECORD_HEX;
+    record->nargs     = 1;
+    record->args[0]   = data_len;
+    record->data_len  = data_len > sizeof(record->data) ? sizeof(record->data) : data_len;
+    memcpy(record->data, data, record->data_len);
+    ble_qiot_log_ring_commit(pos);
+}
+
+int ble_qiot_log_ring_read(ble_qiot_log_record *record)
+{
+    uint32_t pos = __atomic_load_n(&sg_log_ring_tail, __ATOMIC_RELAXED);
+    int32_t  dif = 0;
+
+    for (;;) {
+        dif = (int32_t)(ble_qiot_log_slot_seq(pos) - (pos + 1));
+        if (0 == dif) {
+            if (__atomic_compare_exchange_n(&sg_log_ring_tail, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                memcpy(record, &sg_log_ring[pos & LOG_RING_MASK].record, sizeof(ble_qiot_log_record));
+                ble_qiot_log_slot_seq_set(pos, pos + BLE_QIOT_LOG_RING_SIZE);
+                return 1;
+            }
+        } else if (dif < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&sg_log_ring_tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+uint32_t ble_qiot_log_ring_dropped(void)
+{
+    return __atomic_load_n(&sg_log_ring_dropped, __ATOMIC_RELAXED);
+}
+
+// format one conversion of a record, return the length written
+static int ble_qiot_log_ring_format_arg(const ble_qiot_log_record *record, const char *spec, char conv, uint8_t len,
+                                        uintptr_t arg, char *out, int out_len)
+{
+    float fval = 0;
+
+    switch (conv) {
+        case 'd':
+        case 'i':
+            if (LOG_RING_LEN_LONG == len) {
+                return snprintf(out, out_len, spec, (long)arg);
+            } else if (LOG_RING_LEN_LLONG == len) {
+                return snprintf(out, out_len, spec, (long long)(intptr_t)arg);
+            } else if (LOG_RING_LEN_SIZE == len) {
+                return snprintf(out, out_len, spec, (size_t)arg);
+            }
+            return snprintf(out, out_len, spec, (int)arg);
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+            if (LOG_RING_LEN_LONG == len) {
+                return snprintf(out, out_len, spec, (unsigned long)arg);
+            } else if (LOG_RING_LEN_LLONG == len) {
+                return snprintf(out, out_len, spec, (unsigned long long)arg);
+            } else if (LOG_RING_LEN_SIZE == len) {
+                return snprintf(out, out_len, spec, (size_t)arg);
+            }
+            return snprintf(out, out_len, spec, (unsigned int)arg);
+        case 'p':
+            return snprintf(out, out_len, spec, (void *)arg);
+        case 's':
+            return snprintf(out, out_len, spec, (LOG_RING_STR_TRUNCATED == arg) ? "..." : record->data + arg);
+        case 'f':
+        case 'e':
+        case 'g':
+            memcpy(&fval, &arg, sizeof(fval));
+            return snprintf(out, out_len, spec, (double)fval);
+        default:
+            return 0;
+    }
+}
+
+static void ble_qiot_log_ring_format(const ble_qiot_log_record *record, char *line, int line_size)
+{
+    const char *p                        = record->fmt;
+    const char *spec_start               = NULL;
+    char        spec[LOG_RING_SPEC_SIZE] = {0};
+    int         line_len                 = 0;
+    int         ret                      = 0;
+    uint8_t     arg_index                = 0;
+    uint8_t     len                      = LOG_RING_LEN_INT;
+
+    while (('\0' != *p) && (line_len < line_size - 1)) {
+        if ('%' != *p) {
+            line[line_len++] = *p++;
+            continue;
+        }
+        spec_start = p++;
+        if ('%' == *p) {
+            line[line_len++] = *p++;
+            continue;
+        }
+        while (('\0' != *p) && (NULL != strchr("-+ #0123456789.", *p))) {
+            p++;
+        }
+        len = LOG_RING_LEN_INT;
+        for (; ('h' == *p) || ('l' == *p) || ('z' == *p); p++) {
+            if ('l' == *p) {
+                len = (LOG_RING_LEN_LONG == len) ? LOG_RING_LEN_LLONG : LOG_RING_LEN_LONG;
+            } else if ('z' == *p) {
+                len = LOG_RING_LEN_SIZE;
+            }
+        }
+        if (('\0' == *p) || (arg_index >= record->nargs) || (p - spec_start + 2 > (int)sizeof(spec))) {
+            // the argument is not recorded
+            line_len += snprintf(line + line_len, line_size - line_len, "?");
+            break;
+        }
+        memcpy(spec, spec_start, p - spec_start + 1);
+        spec[p - spec_start + 1] = '\0';
+        ret = ble_qiot_log_ring_format_arg(record, spec, *p, len, record->args[arg_index++], line + line_len,
+                                           line_size - line_len);
+        line_len += (ret > 0) ? ret : 0;
+        p++;
+    }
+    line_len       = (line_len > line_size - 1) ? line_size - 1 : line_len;
+    line[line_len] = '\0';
+}
+
+int ble_qiot_log_ring_drain(uint16_t max_records)
+{
+    ble_qiot_log_record record;
+    char                line[LOG_RING_LINE_SIZE];
+    uint16_t            count = 0;
+    int                 i     = 0;
+
+    while ((count < max_records) && ble_qiot_log_ring_read(&record)) {
+        if (BLE_QIOT_LOG_RECORD_HEX == record.type) {
+            ble_qiot_log_raw("[%u] ble qiot dump: %s, length: %u" LOG_LINE_FEED_TYPE, record.timestamp, record.fmt,
+                             (unsigned int)record.args[0]);
+            for (i = 0; i < record.data_len; i++) {
+                ble_qiot_log_raw("%02X ", (uint8_t)record.data[i]);
+            }
+            ble_qiot_log_raw("%s" LOG_LINE_FEED_TYPE, (record.args[0] > record.data_len) ? "..." : "");
+        } else {
+            ble_qiot_log_ring_format(&record, line, sizeof(line));
+            ble_qiot_log_raw("[%u] %s" LOG_LINE_FEED_TYPE, record.timestamp, line);
+        }
+        count++;
+    }
+
+    return count;
+}
+#endif  // BLE_QIOT_LOG_RING_ENABLE
+
 #ifdef __cplusplus
 }
 #endif
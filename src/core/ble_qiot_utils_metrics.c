@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ble_qiot_metrics.h"
+
+#if BLE_QIOT_METRICS_ENABLE
+
+#include <string.h>
+
+ble_qiot_metrics_core llsync_g_metrics[BLE_QIOT_METRICS_CORE_NUM];
+
+static const char *sg_metric_name[BLE_QIOT_METRIC_BUTT] = {
+    "device_info_in_frames", "device_info_in_bytes", "data_in_frames",    "data_in_bytes",
+    "ota_in_frames",         "ota_in_bytes",         "event_out_frames",  "event_out_bytes",
+    "notify_failed",         "slice_reassembled",    "slice_dropped",     "report_sent",
+    "report_suppressed",     "action",               "event",             "ota_packets",
+    "ota_bytes",             "ota_active_us",        "ota_retransmit",    "ota_seq_miss",
+    "dispatch_queued",       "dispatch_blocked",     "dispatch_inline",   "action_timeout",
+    "dispatch_stalled",
+};
+
+#if BLE_QIOT_SUPPORT_OTA
+static uint32_t sg_ota_last_packet_us = 0;
+
+void ble_qiot_metrics_ota_packet(uint16_t len)
+{
+    uint32_t now = ble_get_timestamp_us();
+
+    BLE_QIOT_METRIC_INC(BLE_QIOT_METRIC_OTA_PACKETS);
+    BLE_QIOT_METRIC_ADD(BLE_QIOT_METRIC_OTA_BYTES, len);
+    // the gap longer than the retry timeout means the ota stopped between the packets, not counted into the rate
+    if (sg_ota_last_packet_us && (now - sg_ota_last_packet_us) < BLE_QIOT_RETRY_TIMEOUT * 1000000u) {
+        BLE_QIOT_METRIC_ADD(BLE_QIOT_METRIC_OTA_ACTIVE_US, now - sg_ota_last_packet_us);
+    }
+    sg_ota_last_packet_us = now;
+}
+#endif  // BLE_QIOT_SUPPORT_OTA
+
+void ble_qiot_metrics_snapshot(ble_qiot_metrics *metrics, bool reset)
+{
+    uint8_t   core    = 0;
+    uint8_t   id      = 0;
+    uint32_t *counter = NULL;
+
+    memset(metrics, 0, sizeof(ble_qiot_metrics));
+    for (core = 0; core < BLE_QIOT_METRICS_CORE_NUM; core++) {
+        for (id = 0; id < BLE_QIOT_METRIC_BUTT; id++) {
+            counter = &llsync_g_metrics[core].counter[id];
+            metrics->counter[id] += reset ? __atomic_exchange_n(counter, 0, __ATOMIC_RELAXED)
+                                          : __atomic_load_n(counter, __ATOMIC_RELAXED);
+        }
+    }
+    if (metrics->counter[BLE_QIOT_METRIC_OTA_ACTIVE_US]) {
+        metrics->ota_bytes_per_sec = (uint32_t)((uint64_t)metrics->counter[BLE_QIOT_METRIC_OTA_BYTES] * 1000000u /
+                                                metrics->counter[BLE_QIOT_METRIC_OTA_ACTIVE_US]);
+    }
+}
+
+const char *ble_qiot_metric_name(uint8_t id)
+{
+    return id < BLE_QIOT_METRIC_BUTT ? sg_metric_name[id] : "unknown";
+}
+
+#endif  // BLE_QIOT_METRICS_ENABLE
+
+#ifdef __cplusplus
+}
+#endif
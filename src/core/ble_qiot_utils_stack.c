@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ble_qiot_stack.h"
+
+#if BLE_QIOT_STACK_ENABLE
+
+#include <string.h>
+
+#include "ble_qiot_export.h"
+#include "ble_qiot_param_check.h"
+
+#define BLE_QIOT_STACK_PATTERN 0xA5
+
+static ble_qiot_stack_stats sg_stack_stats[BLE_QIOT_STACK_BUTT];
+
+static const char *sg_stack_entry_name[BLE_QIOT_STACK_BUTT] = {
+    "device_info_write", "data_write", "ota_write", "ota_timer", "bind_timer", "report", "event_post",
+};
+
+// the area is below the frame of the caller, the stack its callees will use. the asm tells the compiler the area is
+// read out of its sight, so the stores are kept
+BLE_QIOT_NOINLINE uintptr_t ble_qiot_stack_paint(void)
+{
+    uint8_t   area[BLE_QIOT_STACK_PAINT_SIZE];
+    uintptr_t painted = (uintptr_t)area;
+
+    memset(area, BLE_QIOT_STACK_PATTERN, sizeof(area));
+    __asm__ __volatile__("" : "+r"(painted) : : "memory");
+    return painted;
+}
+
+// the area is read below the frame of the scan, out of any object for the address sanitizer. the scan frame is on the
+// top of the area, it is counted only if the callees of the entry point used less stack
+__attribute__((no_sanitize_address)) BLE_QIOT_NOINLINE void ble_qiot_stack_scan(uint8_t entry, uintptr_t top,
+                                                                                  uintptr_t painted)
+{
+    const volatile uint8_t *area = (const volatile uint8_t *)painted;
+    uint32_t                i    = 0;
+    uint32_t                used = 0;
+    uint32_t                max  = 0;
+
+    if (entry >= BLE_QIOT_STACK_BUTT || top <= painted + BLE_QIOT_STACK_PAINT_SIZE) {
+        return;
+    }
+    // the stack grows down, the deepest byte written is the lowest one not of the pattern
+    while (i < BLE_QIOT_STACK_PAINT_SIZE && BLE_QIOT_STACK_PATTERN == area[i]) {
+        i++;
+    }
+    used = (uint32_t)(top - painted - i);
+    __atomic_fetch_add(&sg_stack_stats[entry].calls, 1, __ATOMIC_RELAXED);
+    if (0 == i) {
+        __atomic_fetch_add(&sg_stack_stats[entry].saturated, 1, __ATOMIC_RELAXED);
+    }
+    max = __atomic_load_n(&sg_stack_stats[entry].max, __ATOMIC_RELAXED);
+    while (used > max &&
+           !__atomic_compare_exchange_n(&sg_stack_stats[entry].max, &max, used, true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+    }
+}
+
+int ble_qiot_stack_get(uint8_t entry, ble_qiot_stack_stats *stats)
+{
+    POINTER_SANITY_CHECK(stats, BLE_QIOT_RS_ERR_PARA);
+    if (entry >= BLE_QIOT_STACK_BUTT) {
+        return BLE_QIOT_RS_ERR_PARA;
+    }
+    stats->calls     = __atomic_load_n(&sg_stack_stats[entry].calls, __ATOMIC_RELAXED);
+    stats->max       = __atomic_load_n(&sg_stack_stats[entry].max, __ATOMIC_RELAXED);
+    stats->saturated = __atomic_load_n(&sg_stack_stats[entry].saturated, __ATOMIC_RELAXED);
+    return BLE_QIOT_RS_OK;
+}
+
+void ble_qiot_stack_reset(void)
+{
+    uint8_t entry = 0;
+
+    for (entry = 0; entry < BLE_QIOT_STACK_BUTT; entry++) {
+        __atomic_store_n(&sg_stack_stats[entry].calls, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&sg_stack_stats[entry].max, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&sg_stack_stats[entry].saturated, 0, __ATOMIC_RELAXED);
+    }
+}
+
+const char *ble_qiot_stack_entry_name(uint8_t entry)
+{
+    return entry < BLE_QIOT_STACK_BUTT ? sg_stack_entry_name[entry] : "unknown";
+}
+
+#endif  // BLE_QIOT_STACK_ENABLE
+
+#ifdef __cplusplus
+}
+#endif
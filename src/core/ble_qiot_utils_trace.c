@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+ * Licensed under the MIT License (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://opensource.org/licenses/MIT
+ * Unless required by applicable law or agreed to in writing, software distributed under the License is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ble_qiot_trace.h"
+
+#if BLE_QIOT_TRACE_ENABLE
+
+#include <string.h>
+
+#include "ble_qiot_context.h"
+#include "ble_qiot_export.h"
+#include "ble_qiot_import.h"
+#include "ble_qiot_param_check.h"
+#include "ble_qiot_service.h"
+
+#if (BLE_QIOT_TRACE_EVENT_NUM & (BLE_QIOT_TRACE_EVENT_NUM - 1)) != 0
+#error "BLE_QIOT_TRACE_EVENT_NUM must be power of 2"
+#endif
+
+// the message in progress
+typedef struct {
+    bool     active;
+    bool     ready;  // reassembled, the message type is known
+    uint8_t  msg_type;
+    uint8_t  stage_mask;
+    uint16_t seq;
+    uint32_t start;
+    uint32_t last;
+    uint32_t stage_us[BLE_QIOT_TRACE_STAGE_BUTT];
+} ble_trace_msg_t;
+
+// the states of a slot keeping the message of a deferred action
+enum {
+    BLE_TRACE_SLOT_FREE = 0,
+    BLE_TRACE_SLOT_CLAIMED,   // the key is being written
+    BLE_TRACE_SLOT_HANDLING,  // the action handler is running
+    BLE_TRACE_SLOT_DEFERRED,  // the message is kept until the reply
+    BLE_TRACE_SLOT_REPLIED,   // replied before the handler returned to the core, the message is not kept
+    BLE_TRACE_SLOT_REPLYING,  // the reply is being sent, the slot is owned by the task sending it
+};
+
+typedef struct {
+    uint8_t          state;
+    uint8_t          action_id;
+    ble_qiot_ctx_t  *ctx;
+    ble_trace_msg_t  msg;
+    ble_trace_msg_t *prev;  // the message owned by the task before the reply
+} ble_trace_slot_t;
+
+static ble_trace_msg_t      sg_trace_msg;
+static uint16_t             sg_trace_seq;
+static ble_qiot_trace_hist  sg_trace_hist[BLE_QIOT_TRACE_MSG_BUTT][BLE_QIOT_TRACE_STAGE_BUTT];
+static ble_qiot_trace_event sg_trace_events[BLE_QIOT_TRACE_EVENT_NUM];
+static uint32_t             sg_trace_event_head;
+// the message of the task writing it, the notifications of other tasks, like a property report of the app, are out
+// of it
+static __thread ble_trace_msg_t *sg_trace_owned;
+// the messages of the deferred actions, until replied
+static ble_trace_slot_t          sg_trace_slots[BLE_QIOT_TRACE_DEFERRED_NUM];
+// the slot of the action handled or replied by the task
+static __thread ble_trace_slot_t *sg_trace_slot;
+
+static void ble_trace_event_put(const ble_trace_msg_t *msg, uint32_t now, uint32_t duration, uint8_t stage)
+{
+    uint32_t              index = __atomic_fetch_add(&sg_trace_event_head, 1, __ATOMIC_RELAXED);
+    ble_qiot_trace_event *event = &sg_trace_events[index & (BLE_QIOT_TRACE_EVENT_NUM - 1)];
+
+    event->timestamp = now;
+    event->duration  = duration;
+    event->seq       = msg ? msg->seq : 0;
+    event->msg_type  = msg ? msg->msg_type : BLE_QIOT_TRACE_MSG_BUTT;
+    event->stage     = stage;
+}
+
+static void ble_trace_hist_add(ble_qiot_trace_hist *hist, uint32_t us)
+{
+    uint8_t  bucket = us ? (32 - __builtin_clz(us)) : 0;
+    uint32_t max    = 0;
+
+    if (bucket >= BLE_QIOT_TRACE_HIST_BUCKETS) {
+        bucket = BLE_QIOT_TRACE_HIST_BUCKETS - 1;
+    }
+    // the reply of a deferred action is aggregated by the task sending it, at the same time as other messages
+    __atomic_fetch_add(&hist->bucket[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, us, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while (us > max && !__atomic_compare_exchange_n(&hist->max, &max, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // max is reloaded by the failed exchange
+    }
+}
+
+static void ble_trace_stage_close(ble_trace_msg_t *msg, uint32_t now, uint8_t stage)
+{
+    uint32_t duration = now - msg->last;
+
+    msg->stage_us[stage] += duration;
+    msg->stage_mask |= 1 << stage;
+    msg->last = now;
+    ble_trace_event_put(msg, now, duration, stage);
+}
+
+void ble_qiot_trace_msg_begin(void)
+{
+    uint32_t now    = ble_get_timestamp_us();
+    bool     active = false;
+
+    if (sg_trace_owned) {
+        // the next slice of the message
+        ble_trace_stage_close(sg_trace_owned, now, BLE_QIOT_TRACE_WRITE);
+        return;
+    }
+    // another task is writing a message, like a second device, the write is out of any message
+    if (!__atomic_compare_exchange_n(&sg_trace_msg.active, &active, true, false, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+        ble_trace_event_put(NULL, now, 0, BLE_QIOT_TRACE_WRITE);
+        return;
+    }
+    // active is kept, the message is claimed
+    sg_trace_msg.ready      = false;
+    sg_trace_msg.stage_mask = 0;
+    memset(sg_trace_msg.stage_us, 0, sizeof(sg_trace_msg.stage_us));
+    // sequence 0 means out of any message
+    if (0 == ++sg_trace_seq) {
+        ++sg_trace_seq;
+    }
+    sg_trace_msg.seq      = sg_trace_seq;
+    sg_trace_msg.msg_type = BLE_QIOT_TRACE_MSG_BUTT;
+    sg_trace_msg.start    = now;
+    sg_trace_msg.last     = now;
+    sg_trace_owned        = &sg_trace_msg;
+}
+
+void ble_qiot_trace_msg_ready(uint8_t data_type, uint8_t effect)
+{
+    ble_trace_msg_t *msg = sg_trace_owned;
+
+    if (!msg) {
+        return;
+    }
+    if (BLE_QIOT_MSG_TYPE_PROPERTY == data_type) {
+        msg->msg_type =
+            (BLE_QIOT_EFFECT_REQUEST == effect) ? BLE_QIOT_TRACE_MSG_CONTROL : BLE_QIOT_TRACE_MSG_PROPERTY_REPLY;
+    } else if (BLE_QIOT_MSG_TYPE_EVENT == data_type) {
+        msg->msg_type = BLE_QIOT_TRACE_MSG_EVENT_REPLY;
+    } else {
+        msg->msg_type = BLE_QIOT_TRACE_MSG_ACTION;
+    }
+    msg->ready = true;
+    ble_trace_stage_close(msg, ble_get_timestamp_us(), BLE_QIOT_TRACE_REASSEMBLE);
+}
+
+void ble_qiot_trace_point(uint8_t stage)
+{
+    uint32_t now = ble_get_timestamp_us();
+
+    if (!sg_trace_owned) {
+        // a notification out of any message, like property report
+        ble_trace_event_put(NULL, now, 0, stage);
+        return;
+    }
+    ble_trace_stage_close(sg_trace_owned, now, stage);
+}
+
+static void ble_trace_msg_aggregate(const ble_trace_msg_t *msg)
+{
+    uint32_t now   = ble_get_timestamp_us();
+    uint32_t total = now - msg->start;
+    uint8_t  stage = 0;
+
+    for (stage = 0; stage < BLE_QIOT_TRACE_TOTAL; stage++) {
+        if (msg->stage_mask & (1 << stage)) {
+            ble_trace_hist_add(&sg_trace_hist[msg->msg_type][stage], msg->stage_us[stage]);
+        }
+    }
+    ble_trace_hist_add(&sg_trace_hist[msg->msg_type][BLE_QIOT_TRACE_TOTAL], total);
+    ble_trace_event_put(msg, now, total, BLE_QIOT_TRACE_TOTAL);
+}
+
+void ble_qiot_trace_msg_end(bool pending)
+{
+    ble_trace_msg_t *msg = sg_trace_owned;
+
+    if (!msg || pending) {
+        return;
+    }
+    // the message dropped before reassembled, or kept for the reply of a deferred action, is not aggregated
+    if (msg->ready) {
+        ble_trace_msg_aggregate(msg);
+    }
+    sg_trace_owned = NULL;
+    __atomic_store_n(&msg->active, false, __ATOMIC_RELEASE);
+}
+
+static bool ble_trace_slot_match(ble_trace_slot_t *slot, ble_qiot_ctx_t *ctx, uint8_t action_id)
+{
+    return __atomic_load_n(&slot->ctx, __ATOMIC_RELAXED) == ctx &&
+           __atomic_load_n(&slot->action_id, __ATOMIC_RELAXED) == action_id;
+}
+
+void ble_qiot_trace_action_handle(uint8_t action_id)
+{
+    ble_qiot_ctx_t   *ctx   = ble_qiot_ctx_get();
+    ble_trace_slot_t *slot  = NULL;
+    uint8_t           state = 0;
+    int               i     = 0;
+
+    sg_trace_slot = NULL;
+    if (!sg_trace_owned || !sg_trace_owned->ready) {
+        return;
+    }
+    // the action is not running, a slot still kept for it is of a run never replied
+    for (i = 0; i < BLE_QIOT_TRACE_DEFERRED_NUM && !sg_trace_slot; i++) {
+        slot  = &sg_trace_slots[i];
+        state = BLE_TRACE_SLOT_DEFERRED;
+        if (ble_trace_slot_match(slot, ctx, action_id) &&
+            __atomic_compare_exchange_n(&slot->state, &state, BLE_TRACE_SLOT_CLAIMED, false, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            sg_trace_slot = slot;
+        }
+    }
+    for (i = 0; i < BLE_QIOT_TRACE_DEFERRED_NUM && !sg_trace_slot; i++) {
+        slot  = &sg_trace_slots[i];
+        state = BLE_TRACE_SLOT_FREE;
+        if (__atomic_compare_exchange_n(&slot->state, &state, BLE_TRACE_SLOT_CLAIMED, false, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            sg_trace_slot = slot;
+        }
+    }
+    if (!sg_trace_slot) {
+        return;
+    }
+    __atomic_store_n(&sg_trace_slot->ctx, ctx, __ATOMIC_RELAXED);
+    __atomic_store_n(&sg_trace_slot->action_id, action_id, __ATOMIC_RELAXED);
+    __atomic_store_n(&sg_trace_slot->state, BLE_TRACE_SLOT_HANDLING, __ATOMIC_RELEASE);
+}
+
+void ble_qiot_trace_action_defer(bool deferred)
+{
+    ble_trace_slot_t *slot  = sg_trace_slot;
+    uint8_t           state = BLE_TRACE_SLOT_HANDLING;
+
+    if (!slot) {
+        return;
+    }
+    sg_trace_slot = NULL;
+    if (deferred) {
+        slot->msg = *sg_trace_owned;
+        // the reply is sent by another task from now on
+        if (__atomic_compare_exchange_n(&slot->state, &state, BLE_TRACE_SLOT_DEFERRED, false, __ATOMIC_RELEASE,
+                                        __ATOMIC_ACQUIRE)) {
+            sg_trace_owned->ready = false;
+            return;
+        }
+    }
+    __atomic_store_n(&slot->state, BLE_TRACE_SLOT_FREE, __ATOMIC_RELEASE);
+}
+
+void ble_qiot_trace_action_reply_begin(uint8_t action_id)
+{
+    ble_qiot_ctx_t   *ctx   = ble_qiot_ctx_get();
+    ble_trace_slot_t *slot  = NULL;
+    uint8_t           state = 0;
+    int               i     = 0;
+
+    sg_trace_slot = NULL;
+    for (i = 0; i < BLE_QIOT_TRACE_DEFERRED_NUM; i++) {
+        slot  = &sg_trace_slots[i];
+        state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        while ((BLE_TRACE_SLOT_HANDLING == state || BLE_TRACE_SLOT_DEFERRED == state) &&
+               ble_trace_slot_match(slot, ctx, action_id)) {
+            if (BLE_TRACE_SLOT_HANDLING == state) {
+                // the handler has not returned to the core yet, the message is aggregated when handled
+                if (__atomic_compare_exchange_n(&slot->state, &state, BLE_TRACE_SLOT_REPLIED, false,
+                                                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                    return;
+                }
+            } else if (__atomic_compare_exchange_n(&slot->state, &state, BLE_TRACE_SLOT_REPLYING, false,
+                                                   __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+                // the time since the handler returned is of the action running
+                ble_trace_stage_close(&slot->msg, ble_get_timestamp_us(), BLE_QIOT_TRACE_HANDLER);
+                slot->prev     = sg_trace_owned;
+                sg_trace_owned = &slot->msg;
+                sg_trace_slot  = slot;
+                return;
+            }
+        }
+    }
+}
+
+void ble_qiot_trace_action_reply_end(void)
+{
+    ble_trace_slot_t *slot = sg_trace_slot;
+
+    if (!slot) {
+        return;
+    }
+    ble_trace_msg_aggregate(&slot->msg);
+    sg_trace_owned = slot->prev;
+    sg_trace_slot  = NULL;
+    __atomic_store_n(&slot->state, BLE_TRACE_SLOT_FREE, __ATOMIC_RELEASE);
+}
+
+int ble_qiot_trace_hist_get(uint8_t msg_type, uint8_t stage, ble_qiot_trace_hist *hist)
+{
+    POINTER_SANITY_CHECK(hist, BLE_QIOT_RS_ERR_PARA);
+    if (msg_type >= BLE_QIOT_TRACE_MSG_BUTT || stage >= BLE_QIOT_TRACE_STAGE_BUTT) {
+        return BLE_QIOT_RS_ERR_PARA;
+    }
+    memcpy(hist, &sg_trace_hist[msg_type][stage], sizeof(ble_qiot_trace_hist));
+
+    return BLE_QIOT_RS_OK;
+}
+
+int ble_qiot_trace_events_get(ble_qiot_trace_event *events, uint16_t max_events)
+{
+    uint32_t head  = __atomic_load_n(&sg_trace_event_head, __ATOMIC_RELAXED);
+    uint32_t count = head < BLE_QIOT_TRACE_EVENT_NUM ? head : BLE_QIOT_TRACE_EVENT_NUM;
+    uint32_t i     = 0;
+
+    POINTER_SANITY_CHECK(events, 0);
+    if (count > max_events) {
+        count = max_events;
+    }
+    for (i = 0; i < count; i++) {
+        events[i] = sg_trace_events[(head - count + i) & (BLE_QIOT_TRACE_EVENT_NUM - 1)];
+    }
+
+    return count;
+}
+
+void ble_qiot_trace_reset(void)
+{
+    memset(sg_trace_hist, 0, sizeof(sg_trace_hist));
+    memset(sg_trace_events, 0, sizeof(sg_trace_events));
+    __atomic_store_n(&sg_trace_event_head, 0, __ATOMIC_RELAXED);
+}
+
+#endif  // BLE_QIOT_TRACE_ENABLE
+
+#ifdef __cplusplus
+}
+#endif